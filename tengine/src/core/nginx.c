@@ -32,6 +32,13 @@ static ngx_conf_enum_t  ngx_debug_points[] = {
 };
 
 
+static ngx_conf_enum_t  ngx_time_sources[] = {
+    { ngx_string("precise"), NGX_TIME_SOURCE_PRECISE },
+    { ngx_string("coarse"), NGX_TIME_SOURCE_COARSE },
+    { ngx_null_string, 0 }
+};
+
+
 static ngx_command_t  ngx_core_commands[] = {
 
     { ngx_string("daemon"),
@@ -55,6 +62,13 @@ static ngx_command_t  ngx_core_commands[] = {
       offsetof(ngx_core_conf_t, timer_resolution),
       NULL },
 
+    { ngx_string("time_source"),
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_enum_slot,
+      0,
+      offsetof(ngx_core_conf_t, time_source),
+      &ngx_time_sources },
+
     { ngx_string("pid"),
       NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_str_slot,
@@ -125,6 +139,13 @@ static ngx_command_t  ngx_core_commands[] = {
       offsetof(ngx_core_conf_t, rlimit_sigpending),
       NULL },
 
+    { ngx_string("worker_slab_cache"),
+      NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_core_conf_t, slab_cache),
+      NULL },
+
     { ngx_string("working_directory"),
       NGX_MAIN_CONF|NGX_DIRECT_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_str_slot,
@@ -986,6 +1007,7 @@ ngx_core_module_create_conf(ngx_cycle_t *cycle)
     ccf->daemon = NGX_CONF_UNSET;
     ccf->master = NGX_CONF_UNSET;
     ccf->timer_resolution = NGX_CONF_UNSET_MSEC;
+    ccf->time_source = NGX_CONF_UNSET_UINT;
 
     ccf->worker_processes = NGX_CONF_UNSET;
     ccf->debug_points = NGX_CONF_UNSET;
@@ -993,6 +1015,7 @@ ngx_core_module_create_conf(ngx_cycle_t *cycle)
     ccf->rlimit_nofile = NGX_CONF_UNSET;
     ccf->rlimit_core = NGX_CONF_UNSET;
     ccf->rlimit_sigpending = NGX_CONF_UNSET;
+    ccf->slab_cache = NGX_CONF_UNSET;
 
     ccf->user = (ngx_uid_t) NGX_CONF_UNSET_UINT;
     ccf->group = (ngx_gid_t) NGX_CONF_UNSET_UINT;
@@ -1031,7 +1054,21 @@ ngx_core_module_init_conf(ngx_cycle_t *cycle, void *conf)
     ngx_conf_init_value(ccf->daemon, 1);
     ngx_conf_init_value(ccf->master, 1);
     ngx_conf_init_msec_value(ccf->timer_resolution, 0);
+    ngx_conf_init_uint_value(ccf->time_source, NGX_TIME_SOURCE_PRECISE);
+
+#if !(NGX_HAVE_CLOCK_COARSE)
+
+    if (ccf->time_source == NGX_TIME_SOURCE_COARSE) {
+        ngx_log_error(NGX_LOG_WARN, cycle->log, 0,
+                      "\"time_source coarse\" is not supported "
+                      "on this platform, ignored");
+
+        ccf->time_source = NGX_TIME_SOURCE_PRECISE;
+    }
+
+#endif
     ngx_conf_init_value(ccf->debug_points, 0);
+    ngx_conf_init_value(ccf->slab_cache, 0);
 
 #if (NGX_HAVE_CPU_AFFINITY)
 
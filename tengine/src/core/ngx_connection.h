@@ -33,6 +33,9 @@ struct ngx_listening_s {
     int                 keepintvl;
     int                 keepcnt;
 #endif
+#if (NGX_HAVE_TCP_FASTOPEN)
+    int                 fastopen;
+#endif
 
     /* handler of accepted connection */
     ngx_connection_handler_pt   handler;
@@ -51,6 +54,8 @@ struct ngx_listening_s {
     ngx_listening_t    *previous;
     ngx_connection_t   *connection;
 
+    ngx_uint_t          worker;
+
     unsigned            open:1;
     unsigned            remain:1;
     unsigned            ignore:1;
@@ -68,6 +73,11 @@ struct ngx_listening_s {
 #endif
     unsigned            keepalive:2;
 
+#if (NGX_HAVE_REUSEPORT)
+    unsigned            reuseport:1;
+    unsigned            add_reuseport:1;
+#endif
+
 #if (NGX_HAVE_DEFERRED_ACCEPT)
     unsigned            deferred_accept:1;
     unsigned            delete_deferred:1;
@@ -75,6 +85,9 @@ struct ngx_listening_s {
 #ifdef SO_ACCEPTFILTER
     char               *accept_filter;
 #endif
+#ifdef TCP_DEFER_ACCEPT
+    ngx_msec_t          deferred_timeout;
+#endif
 #endif
 #if (NGX_HAVE_SETFIB)
     int                 setfib;
@@ -162,6 +175,8 @@ struct ngx_connection_s {
     unsigned            reusable:1;
     unsigned            close:1;
 
+    unsigned            need_last_flush:1;
+
     unsigned            sendfile:1;
     unsigned            sndlowat:1;
     unsigned            tcp_nodelay:2;   /* ngx_connection_tcp_nodelay_e */
@@ -176,6 +191,10 @@ struct ngx_connection_s {
     ngx_buf_t          *busy_sendfile;
 #endif
 
+#if (NGX_THREAD_POOL)
+    ngx_thread_task_t  *sendfile_task;
+#endif
+
 #if (NGX_THREADS)
     ngx_atomic_t        lock;
 #endif
@@ -184,6 +203,7 @@ struct ngx_connection_s {
 
 ngx_listening_t *ngx_create_listening(ngx_conf_t *cf, void *sockaddr,
     socklen_t socklen);
+ngx_int_t ngx_clone_listening(ngx_conf_t *cf, ngx_listening_t *ls);
 ngx_int_t ngx_set_inherited_sockets(ngx_cycle_t *cycle);
 ngx_int_t ngx_open_listening_sockets(ngx_cycle_t *cycle);
 void ngx_configure_listening_sockets(ngx_cycle_t *cycle);
@@ -20,6 +20,13 @@
  * CRC32 loop, but the cache misses overhead is bigger than overhead of
  * the additional code.  For example, ngx_crc32_short() of 16 bytes of data
  * takes half as much CPU clocks than ngx_crc32_long().
+ *
+ * Data of NGX_CRC32_BLOCK bytes and more are processed 8 bytes at a time
+ * using the "slicing-by-8" tables built from the 256 element table, or,
+ * for long data, by folding 64 bytes at a time with the PCLMULQDQ carry-less
+ * multiplication as described in Intel's "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction".  Both methods yield the same
+ * values as the table-driven code.
  */
 
 
@@ -101,11 +108,245 @@ uint32_t  ngx_crc32_table256[] = {
 
 uint32_t *ngx_crc32_table_short = ngx_crc32_table16;
 
+static uint32_t  ngx_crc32_table_slice[8][256];
+static uint32_t  ngx_crc32c_table[256];
+
+
+#if (NGX_HAVE_CRC32_INTRINSICS)
+
+#include <nmmintrin.h>
+#include <wmmintrin.h>
+
+static uint32_t ngx_crc32_pclmul(uint32_t crc, u_char *p, size_t len);
+static uint32_t ngx_crc32c_sse42(uint32_t crc, u_char *p, size_t len);
+
+#endif
+
+
+uint32_t
+ngx_crc32_update_block(uint32_t crc, u_char *p, size_t len)
+{
+    uint32_t   c;
+    uint32_t  (*t)[256];
+
+#if (NGX_HAVE_CRC32_INTRINSICS)
+
+    if (len >= 64 && (ngx_cpu_features & NGX_CPU_PCLMUL)) {
+        crc = ngx_crc32_pclmul(crc, p, len & ~15);
+
+        p += len & ~15;
+        len &= 15;
+    }
+
+#endif
+
+    t = ngx_crc32_table_slice;
+    c = crc;
+
+    while (len >= 8) {
+        c ^= (uint32_t) p[0] | (uint32_t) p[1] << 8
+             | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+
+        c = t[7][c & 0xff] ^ t[6][(c >> 8) & 0xff]
+            ^ t[5][(c >> 16) & 0xff] ^ t[4][c >> 24]
+            ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+
+        p += 8;
+        len -= 8;
+    }
+
+    while (len--) {
+        c = t[0][(c ^ *p++) & 0xff] ^ (c >> 8);
+    }
+
+    return c;
+}
+
+
+uint32_t
+ngx_crc32c_update(uint32_t crc, u_char *p, size_t len)
+{
+#if (NGX_HAVE_CRC32_INTRINSICS)
+
+    if (ngx_cpu_features & NGX_CPU_SSE42) {
+        return ngx_crc32c_sse42(crc, p, len);
+    }
+
+#endif
+
+    while (len--) {
+        crc = ngx_crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+
+#if (NGX_HAVE_CRC32_INTRINSICS)
+
+/*
+ * the folding and Barrett reduction constants are the ones given
+ * in the Intel paper for the bit-reflected polynomial 0x04c11db7
+ */
+
+__attribute__((target("pclmul")))
+static uint32_t
+ngx_crc32_pclmul(uint32_t crc, u_char *p, size_t len)
+{
+    __m128i  x1, x2, x3, x4, x5, x6, x7, x8, k, mask;
+
+    x1 = _mm_loadu_si128((__m128i *) p);
+    x2 = _mm_loadu_si128((__m128i *) (p + 16));
+    x3 = _mm_loadu_si128((__m128i *) (p + 32));
+    x4 = _mm_loadu_si128((__m128i *) (p + 48));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+
+    p += 64;
+    len -= 64;
+
+    k = _mm_set_epi64x(0x1c6e41596LL, 0x154442bd4LL);
+
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, k, 0x11);
+        x6 = _mm_clmulepi64_si128(x2, k, 0x11);
+        x7 = _mm_clmulepi64_si128(x3, k, 0x11);
+        x8 = _mm_clmulepi64_si128(x4, k, 0x11);
+
+        x1 = _mm_clmulepi64_si128(x1, k, 0x00);
+        x2 = _mm_clmulepi64_si128(x2, k, 0x00);
+        x3 = _mm_clmulepi64_si128(x3, k, 0x00);
+        x4 = _mm_clmulepi64_si128(x4, k, 0x00);
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                           _mm_loadu_si128((__m128i *) p));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+                           _mm_loadu_si128((__m128i *) (p + 16)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+                           _mm_loadu_si128((__m128i *) (p + 32)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+                           _mm_loadu_si128((__m128i *) (p + 48)));
+
+        p += 64;
+        len -= 64;
+    }
+
+    /* fold 4 x 128 bits into 128 bits */
+
+    k = _mm_set_epi64x(0x0ccaa009eLL, 0x1751997d0LL);
+
+    x5 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), x2);
+
+    x5 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), x3);
+
+    x5 = _mm_clmulepi64_si128(x1, k, 0x11);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), x4);
+
+    while (len >= 16) {
+        x5 = _mm_clmulepi64_si128(x1, k, 0x11);
+        x1 = _mm_clmulepi64_si128(x1, k, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                           _mm_loadu_si128((__m128i *) p));
+        p += 16;
+        len -= 16;
+    }
+
+    /* fold 128 bits into 64 bits */
+
+    x2 = _mm_clmulepi64_si128(k, x1, 0x01);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+    mask = _mm_setr_epi32(-1, 0, 0, 0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, mask);
+    x1 = _mm_clmulepi64_si128(x1, _mm_set_epi64x(0, 0x163cd6124LL), 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction into 32 bits */
+
+    k = _mm_set_epi64x(0x1f7011641LL, 0x1db710641LL);
+
+    x2 = x1;
+    x1 = _mm_and_si128(x1, mask);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x10);
+    x1 = _mm_and_si128(x1, mask);
+    x1 = _mm_clmulepi64_si128(x1, k, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+
+__attribute__((target("sse4.2")))
+static uint32_t
+ngx_crc32c_sse42(uint32_t crc, u_char *p, size_t len)
+{
+#if (NGX_PTR_SIZE == 8)
+    uint64_t  c, w;
+
+    c = crc;
+
+    while (len >= 8) {
+        ngx_memcpy(&w, p, 8);
+        c = _mm_crc32_u64(c, w);
+        p += 8;
+        len -= 8;
+    }
+
+    crc = (uint32_t) c;
+
+#else
+    uint32_t  w;
+
+    while (len >= 4) {
+        ngx_memcpy(&w, p, 4);
+        crc = _mm_crc32_u32(crc, w);
+        p += 4;
+        len -= 4;
+    }
+
+#endif
+
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+
+    return crc;
+}
+
+#endif
+
 
 ngx_int_t
 ngx_crc32_table_init(void)
 {
-    void  *p;
+    void        *p;
+    uint32_t     c;
+    ngx_uint_t   i, k;
+
+    for (i = 0; i < 256; i++) {
+        c = ngx_crc32_table256[i];
+        ngx_crc32_table_slice[0][i] = c;
+
+        for (k = 1; k < 8; k++) {
+            c = ngx_crc32_table256[c & 0xff] ^ (c >> 8);
+            ngx_crc32_table_slice[k][i] = c;
+        }
+
+        c = (uint32_t) i;
+
+        for (k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ 0x82f63b78 : (c >> 1);
+        }
+
+        ngx_crc32c_table[i] = c;
+    }
 
     if (((uintptr_t) ngx_crc32_table_short
           & ~((uintptr_t) ngx_cacheline_size - 1))
@@ -17,6 +17,13 @@ extern uint32_t  *ngx_crc32_table_short;
 extern uint32_t   ngx_crc32_table256[];
 
 
+#define NGX_CRC32_BLOCK  16
+
+
+uint32_t ngx_crc32_update_block(uint32_t crc, u_char *p, size_t len);
+uint32_t ngx_crc32c_update(uint32_t crc, u_char *p, size_t len);
+
+
 static ngx_inline uint32_t
 ngx_crc32_short(u_char *p, size_t len)
 {
@@ -35,21 +42,6 @@ ngx_crc32_short(u_char *p, size_t len)
 }
 
 
-static ngx_inline uint32_t
-ngx_crc32_long(u_char *p, size_t len)
-{
-    uint32_t  crc;
-
-    crc = 0xffffffff;
-
-    while (len--) {
-        crc = ngx_crc32_table256[(crc ^ *p++) & 0xff] ^ (crc >> 8);
-    }
-
-    return crc ^ 0xffffffff;
-}
-
-
 #define ngx_crc32_init(crc)                                                   \
     crc = 0xffffffff
 
@@ -59,6 +51,11 @@ ngx_crc32_update(uint32_t *crc, u_char *p, size_t len)
 {
     uint32_t  c;
 
+    if (len >= NGX_CRC32_BLOCK) {
+        *crc = ngx_crc32_update_block(*crc, p, len);
+        return;
+    }
+
     c = *crc;
 
     while (len--) {
@@ -73,6 +70,31 @@ ngx_crc32_update(uint32_t *crc, u_char *p, size_t len)
     crc ^= 0xffffffff
 
 
+static ngx_inline uint32_t
+ngx_crc32_long(u_char *p, size_t len)
+{
+    uint32_t  crc;
+
+    ngx_crc32_init(crc);
+    ngx_crc32_update(&crc, p, len);
+    ngx_crc32_final(crc);
+
+    return crc;
+}
+
+
+/*
+ * CRC32C (Castagnoli) uses another polynomial and therefore yields
+ * values different from ngx_crc32_*(), so it must not replace them in
+ * anything stored on disk or visible to users, e.g. the cache file header
+ * or the ngx.crc32_*() Lua API; it is much faster on CPUs with SSE4.2
+ * and is intended for in-memory hash tables
+ */
+
+#define ngx_crc32c(p, len)                                                    \
+    (ngx_crc32c_update(0xffffffff, p, len) ^ 0xffffffff)
+
+
 ngx_int_t ngx_crc32_table_init(void);
 
 
@@ -602,6 +602,16 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
                     continue;
                 }
 
+                /* each reuseport clone takes over its own old socket */
+
+                if (ls[i].remain) {
+                    continue;
+                }
+
+                if (ls[i].type != nls[n].type) {
+                    continue;
+                }
+
                 if (ngx_cmp_sockaddr(nls[n].sockaddr, ls[i].sockaddr) == NGX_OK)
                 {
                     nls[n].fd = ls[i].fd;
@@ -612,6 +622,12 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
                         nls[n].listen = 1;
                     }
 
+#if (NGX_HAVE_REUSEPORT)
+                    if (nls[n].reuseport && !ls[i].reuseport) {
+                        nls[n].add_reuseport = 1;
+                    }
+#endif
+
 #if (NGX_HAVE_DEFERRED_ACCEPT && defined SO_ACCEPTFILTER)
 
                     /*
@@ -645,6 +661,12 @@ ngx_init_cycle(ngx_cycle_t *old_cycle)
                     } else if (ls[i].deferred_accept != nls[n].deferred_accept)
                     {
                         nls[n].add_deferred = 1;
+
+                    } else if (nls[n].deferred_accept
+                               && ls[i].deferred_timeout
+                                  != nls[n].deferred_timeout)
+                    {
+                        nls[n].add_deferred = 1;
                     }
 #endif
                     break;
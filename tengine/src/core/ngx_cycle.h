@@ -75,6 +75,7 @@ typedef struct {
      ngx_flag_t               master;
 
      ngx_msec_t               timer_resolution;
+     ngx_uint_t               time_source;
 
      ngx_int_t                worker_processes;
      ngx_int_t                debug_points;
@@ -83,6 +84,8 @@ typedef struct {
      ngx_int_t                rlimit_sigpending;
      off_t                    rlimit_core;
 
+     ngx_int_t                slab_cache;
+
      int                      priority;
 
 #if (NGX_HAVE_CPU_AFFINITY)
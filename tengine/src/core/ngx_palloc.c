@@ -11,6 +11,52 @@
 
 static void *ngx_palloc_block(ngx_pool_t *pool, size_t size);
 static void *ngx_palloc_large(ngx_pool_t *pool, size_t size);
+static void ngx_pool_add_large(ngx_pool_t *pool, ngx_pool_large_t *large);
+static void ngx_pool_index_build(ngx_pool_t *pool, ngx_uint_t n);
+static ngx_int_t ngx_pool_index_insert(ngx_pool_t *pool,
+    ngx_pool_large_t *large);
+static ngx_pool_large_t *ngx_pool_index_delete(ngx_pool_index_t *index,
+    void *p);
+
+
+/* the number of the large allocations scanned before building a hash */
+#define NGX_POOL_INDEX_SCAN  8
+
+#define ngx_pool_index_key(p)                                                 \
+    ((uintptr_t) (p) >> 4 ^ (uintptr_t) (p) >> 12)
+
+#define ngx_pool_account(pool, n)                                             \
+    (pool)->size += (n);                                                      \
+    if ((pool)->size > (pool)->peak) {                                        \
+        (pool)->peak = (pool)->size;                                          \
+    }                                                                         \
+    if ((pool)->stat) {                                                       \
+        (void) ngx_atomic_fetch_add((pool)->stat, (ngx_atomic_int_t) (n));    \
+    }
+
+#define ngx_pool_unaccount(pool, n)                                           \
+    (pool)->size -= (n);                                                      \
+    if ((pool)->stat) {                                                       \
+        (void) ngx_atomic_fetch_add((pool)->stat, -(ngx_atomic_int_t) (n));   \
+    }
+
+
+static ngx_inline void *
+ngx_palloc_recycled(ngx_pool_t *pool, size_t size)
+{
+    void       **m;
+    ngx_uint_t   slot;
+
+    slot = (size + NGX_ALIGNMENT - 1) / NGX_ALIGNMENT - 1;
+
+    m = pool->recycle[slot];
+
+    if (m) {
+        pool->recycle[slot] = *m;
+    }
+
+    return m;
+}
 
 
 ngx_pool_t *
@@ -36,6 +82,12 @@ ngx_create_pool(size_t size, ngx_log_t *log)
     p->large = NULL;
     p->cleanup = NULL;
     p->log = log;
+    p->index = NULL;
+    p->recycle = NULL;
+
+    p->size = (size_t) (p->d.end - (u_char *) p);
+    p->peak = p->size;
+    p->stat = NULL;
 
     return p;
 }
@@ -56,6 +108,11 @@ ngx_destroy_pool(ngx_pool_t *pool)
         }
     }
 
+    if (pool->stat) {
+        (void) ngx_atomic_fetch_add(pool->stat,
+                                    -(ngx_atomic_int_t) pool->size);
+    }
+
     for (l = pool->large; l; l = l->next) {
 
         ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, pool->log, 0, "free: %p", l->alloc);
@@ -65,6 +122,10 @@ ngx_destroy_pool(ngx_pool_t *pool)
         }
     }
 
+    if (pool->index) {
+        ngx_free(pool->index);
+    }
+
 #if (NGX_DEBUG)
 
     /*
@@ -72,6 +133,10 @@ ngx_destroy_pool(ngx_pool_t *pool)
      * so we cannot use this log while free()ing the pool
      */
 
+    ngx_log_debug3(NGX_LOG_DEBUG_ALLOC, pool->log, 0,
+                   "pool: %p, size: %uz, peak: %uz",
+                   pool, pool->size, pool->peak);
+
     for (p = pool, n = pool->d.next; /* void */; p = n, n = n->d.next) {
         ngx_log_debug2(NGX_LOG_DEBUG_ALLOC, pool->log, 0,
                        "free: %p, unused: %uz", p, p->d.end - p->d.last);
@@ -101,15 +166,28 @@ ngx_reset_pool(ngx_pool_t *pool)
 
     for (l = pool->large; l; l = l->next) {
         if (l->alloc) {
+            ngx_pool_unaccount(pool, l->size);
             ngx_free(l->alloc);
         }
     }
 
     pool->large = NULL;
 
+    if (pool->index) {
+        ngx_free(pool->index);
+        pool->index = NULL;
+    }
+
     for (p = pool; p; p = p->d.next) {
         p->d.last = (u_char *) p + sizeof(ngx_pool_t);
     }
+
+    /* the free lists were allocated from the pool */
+
+    if (pool->recycle) {
+        pool->recycle = NULL;
+        (void) ngx_pool_set_recycle(pool);
+    }
 }
 
 
@@ -119,6 +197,14 @@ ngx_palloc(ngx_pool_t *pool, size_t size)
     u_char      *m;
     ngx_pool_t  *p;
 
+    if (pool->recycle && size - 1 < NGX_POOL_RECYCLE_MAX) {
+        m = ngx_palloc_recycled(pool, size);
+
+        if (m) {
+            return m;
+        }
+    }
+
     if (size <= pool->max) {
 
         p = pool->current;
@@ -149,6 +235,14 @@ ngx_pnalloc(ngx_pool_t *pool, size_t size)
     u_char      *m;
     ngx_pool_t  *p;
 
+    if (pool->recycle && size - 1 < NGX_POOL_RECYCLE_MAX) {
+        m = ngx_palloc_recycled(pool, size);
+
+        if (m) {
+            return m;
+        }
+    }
+
     if (size <= pool->max) {
 
         p = pool->current;
@@ -187,6 +281,8 @@ ngx_palloc_block(ngx_pool_t *pool, size_t size)
         return NULL;
     }
 
+    ngx_pool_account(pool, psize);
+
     new = (ngx_pool_t *) m;
 
     new->d.end = m + psize;
@@ -230,6 +326,8 @@ ngx_palloc_large(ngx_pool_t *pool, size_t size)
     for (large = pool->large; large; large = large->next) {
         if (large->alloc == NULL) {
             large->alloc = p;
+            large->size = size;
+            ngx_pool_add_large(pool, large);
             return p;
         }
 
@@ -245,9 +343,12 @@ ngx_palloc_large(ngx_pool_t *pool, size_t size)
     }
 
     large->alloc = p;
+    large->size = size;
     large->next = pool->large;
     pool->large = large;
 
+    ngx_pool_add_large(pool, large);
+
     return p;
 }
 
@@ -270,30 +371,301 @@ ngx_pmemalign(ngx_pool_t *pool, size_t size, size_t alignment)
     }
 
     large->alloc = p;
+    large->size = size;
     large->next = pool->large;
     pool->large = large;
 
+    ngx_pool_add_large(pool, large);
+
     return p;
 }
 
 
+static void
+ngx_pool_add_large(ngx_pool_t *pool, ngx_pool_large_t *large)
+{
+    ngx_pool_account(pool, large->size);
+
+    if (pool->index && ngx_pool_index_insert(pool, large) != NGX_OK) {
+
+        /* the list is still complete, so just fall back to scanning it */
+
+        ngx_free(pool->index);
+        pool->index = NULL;
+    }
+}
+
+
 ngx_int_t
 ngx_pfree(ngx_pool_t *pool, void *p)
 {
+    ngx_uint_t         n;
     ngx_pool_large_t  *l;
 
+    if (pool->index) {
+        l = ngx_pool_index_delete(pool->index, p);
+
+        if (l == NULL) {
+            return NGX_DECLINED;
+        }
+
+        goto found;
+    }
+
+    n = 0;
+
     for (l = pool->large; l; l = l->next) {
         if (p == l->alloc) {
-            ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, pool->log, 0,
-                           "free: %p", l->alloc);
-            ngx_free(l->alloc);
-            l->alloc = NULL;
+            break;
+        }
+
+        if (l->alloc) {
+            n++;
+        }
+    }
+
+    if (n > NGX_POOL_INDEX_SCAN) {
+        ngx_pool_index_build(pool, n);
+    }
+
+    if (l == NULL) {
+        return NGX_DECLINED;
+    }
+
+    if (pool->index) {
+        (void) ngx_pool_index_delete(pool->index, p);
+    }
+
+found:
+
+    ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, pool->log, 0, "free: %p", l->alloc);
+
+    ngx_free(l->alloc);
+    l->alloc = NULL;
+
+    ngx_pool_unaccount(pool, l->size);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_pool_index_build(ngx_pool_t *pool, ngx_uint_t n)
+{
+    ngx_uint_t         size;
+    ngx_pool_large_t  *l;
+    ngx_pool_index_t  *index;
+
+    /* keep the hash at most half full */
+
+    for (size = 4 * NGX_POOL_INDEX_SCAN; size < 2 * n; size *= 2) {
+        /* void */
+    }
+
+    index = ngx_alloc(sizeof(ngx_pool_index_t)
+                      + (size - 1) * sizeof(ngx_pool_large_t *), pool->log);
+    if (index == NULL) {
+        return;
+    }
+
+    ngx_memzero(index->buckets, size * sizeof(ngx_pool_large_t *));
+
+    index->mask = size - 1;
+    index->nelts = 0;
+
+    pool->index = index;
+
+    for (l = pool->large; l; l = l->next) {
+        if (l->alloc && ngx_pool_index_insert(pool, l) != NGX_OK) {
+            ngx_free(pool->index);
+            pool->index = NULL;
+            return;
+        }
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_ALLOC, pool->log, 0,
+                   "pool large index: %p, %ui", pool, pool->index->nelts);
+}
+
+
+static ngx_int_t
+ngx_pool_index_insert(ngx_pool_t *pool, ngx_pool_large_t *large)
+{
+    ngx_uint_t         i, size;
+    ngx_pool_large_t  *l;
+    ngx_pool_index_t  *index, *old;
+
+    index = pool->index;
+
+    if (2 * (index->nelts + 1) > index->mask + 1) {
+
+        size = 2 * (index->mask + 1);
+
+        index = ngx_alloc(sizeof(ngx_pool_index_t)
+                          + (size - 1) * sizeof(ngx_pool_large_t *),
+                          pool->log);
+        if (index == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_memzero(index->buckets, size * sizeof(ngx_pool_large_t *));
+
+        index->mask = size - 1;
+        index->nelts = 0;
+
+        old = pool->index;
+        pool->index = index;
+
+        for (i = 0; i <= old->mask; i++) {
+            if (old->buckets[i]) {
+                (void) ngx_pool_index_insert(pool, old->buckets[i]);
+            }
+        }
+
+        ngx_free(old);
+    }
+
+    /* open addressing with linear probing */
+
+    i = ngx_pool_index_key(large->alloc) & index->mask;
+
+    for ( ;; ) {
+        l = index->buckets[i];
+
+        if (l == NULL) {
+            break;
+        }
+
+        i = (i + 1) & index->mask;
+    }
+
+    index->buckets[i] = large;
+    index->nelts++;
+
+    return NGX_OK;
+}
+
+
+static ngx_pool_large_t *
+ngx_pool_index_delete(ngx_pool_index_t *index, void *p)
+{
+    ngx_uint_t         i, j, k;
+    ngx_pool_large_t  *l, *found;
+
+    i = ngx_pool_index_key(p) & index->mask;
+
+    for ( ;; ) {
+        found = index->buckets[i];
+
+        if (found == NULL) {
+            return NULL;
+        }
+
+        if (found->alloc == p) {
+            break;
+        }
+
+        i = (i + 1) & index->mask;
+    }
+
+    /*
+     * shift back the following entries of the cluster which are not
+     * in their buckets, so the lookups do not need the tombstones
+     */
+
+    j = i;
+
+    for ( ;; ) {
+        j = (j + 1) & index->mask;
+
+        l = index->buckets[j];
+
+        if (l == NULL) {
+            break;
+        }
+
+        k = ngx_pool_index_key(l->alloc) & index->mask;
+
+        if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+            index->buckets[i] = l;
+            i = j;
+        }
+    }
+
+    index->buckets[i] = NULL;
+    index->nelts--;
+
+    return found;
+}
+
+
+ngx_int_t
+ngx_pool_set_recycle(ngx_pool_t *pool)
+{
+    if (pool->recycle) {
+        return NGX_OK;
+    }
+
+    pool->recycle = ngx_pcalloc(pool, NGX_POOL_RECYCLE_SLOTS * sizeof(void *));
+    if (pool->recycle == NULL) {
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+/*
+ * puts a small object back to the pool, it is used for the objects which
+ * have been allocated from the pool by ngx_palloc() and are not referenced
+ * anymore, a noop if the pool is not in the recycling mode or the object
+ * does not lie in the used part of one of the pool blocks
+ */
 
-            return NGX_OK;
+void
+ngx_pool_recycle(ngx_pool_t *pool, void *p, size_t size)
+{
+    void       **m;
+    ngx_uint_t   slot;
+    ngx_pool_t  *b;
+
+    if (pool->recycle == NULL
+        || size < NGX_ALIGNMENT
+        || size > pool->max
+        || ((uintptr_t) p & (NGX_ALIGNMENT - 1)))
+    {
+        return;
+    }
+
+    for (b = pool; b; b = b->d.next) {
+        if ((u_char *) p >= (u_char *) b + (b == pool ? sizeof(ngx_pool_t)
+                                                      : sizeof(ngx_pool_data_t))
+            && (u_char *) p + size <= b->d.last)
+        {
+            break;
         }
     }
 
-    return NGX_DECLINED;
+    if (b == NULL) {
+        return;
+    }
+
+    /* the object can serve the allocations rounded up to its size class */
+
+    slot = ngx_min(size, NGX_POOL_RECYCLE_MAX) / NGX_ALIGNMENT - 1;
+
+    m = p;
+    *m = pool->recycle[slot];
+    pool->recycle[slot] = m;
+}
+
+
+void
+ngx_pool_set_stat(ngx_pool_t *pool, ngx_atomic_t *stat)
+{
+    pool->stat = stat;
+
+    (void) ngx_atomic_fetch_add(stat, (ngx_atomic_int_t) pool->size);
 }
 
 
@@ -323,8 +695,8 @@ ngx_prealloc(ngx_pool_t *pool, void *p, size_t old_size, size_t new_size)
     if (new_size == 0) {
         if ((u_char *) p + old_size == pool->d.last) {
            pool->d.last = p;
-        } else {
-           ngx_pfree(pool, p);
+        } else if (ngx_pfree(pool, p) == NGX_DECLINED) {
+           ngx_pool_recycle(pool, p, old_size);
         }
 
         return NULL;
@@ -344,7 +716,9 @@ ngx_prealloc(ngx_pool_t *pool, void *p, size_t old_size, size_t new_size)
 
     ngx_memcpy(new, p, old_size);
 
-    ngx_pfree(pool, p);
+    if (ngx_pfree(pool, p) == NGX_DECLINED) {
+        ngx_pool_recycle(pool, p, old_size);
+    }
 
     return new;
 }
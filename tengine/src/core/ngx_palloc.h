@@ -22,6 +22,14 @@
 #define NGX_DEFAULT_POOL_SIZE    (16 * 1024)
 
 #define NGX_POOL_ALIGNMENT       16
+
+/*
+ * in the recycling mode the freed small objects up to NGX_POOL_RECYCLE_MAX
+ * are kept in the per-size free lists, a size class per NGX_ALIGNMENT bytes
+ */
+#define NGX_POOL_RECYCLE_MAX     256
+#define NGX_POOL_RECYCLE_SLOTS   (NGX_POOL_RECYCLE_MAX / NGX_ALIGNMENT)
+
 #define NGX_MIN_POOL_SIZE                                                     \
     ngx_align((sizeof(ngx_pool_t) + 2 * sizeof(ngx_pool_large_t)),            \
               NGX_POOL_ALIGNMENT)
@@ -43,9 +51,22 @@ typedef struct ngx_pool_large_s  ngx_pool_large_t;
 struct ngx_pool_large_s {
     ngx_pool_large_t     *next;
     void                 *alloc;
+    size_t                size;
 };
 
 
+/*
+ * the hash of the large allocations is built on demand when ngx_pfree()
+ * has to scan a long list, it makes ngx_pfree() O(1)
+ */
+
+typedef struct {
+    ngx_uint_t            mask;
+    ngx_uint_t            nelts;
+    ngx_pool_large_t     *buckets[1];
+} ngx_pool_index_t;
+
+
 typedef struct {
     u_char               *last;
     u_char               *end;
@@ -62,6 +83,15 @@ struct ngx_pool_s {
     ngx_pool_large_t     *large;
     ngx_pool_cleanup_t   *cleanup;
     ngx_log_t            *log;
+    ngx_pool_index_t     *index;
+    void                **recycle;
+
+    /* the memory held by the pool and its high-water mark */
+    size_t                size;
+    size_t                peak;
+
+    /* a shared gauge the memory held by the pool is added to */
+    ngx_atomic_t         *stat;
 };
 
 
@@ -86,6 +116,10 @@ void *ngx_prealloc(ngx_pool_t *pool, void *p, size_t old_size, size_t new_size);
 void *ngx_pmemalign(ngx_pool_t *pool, size_t size, size_t alignment);
 ngx_int_t ngx_pfree(ngx_pool_t *pool, void *p);
 
+ngx_int_t ngx_pool_set_recycle(ngx_pool_t *pool);
+void ngx_pool_recycle(ngx_pool_t *pool, void *p, size_t size);
+void ngx_pool_set_stat(ngx_pool_t *pool, ngx_atomic_t *stat);
+
 
 ngx_pool_cleanup_t *ngx_pool_cleanup_add(ngx_pool_t *p, size_t size);
 void ngx_pool_run_cleanup_file(ngx_pool_t *p, ngx_fd_t fd);
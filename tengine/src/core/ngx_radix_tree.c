@@ -9,7 +9,27 @@
 #include <ngx_core.h>
 
 
+typedef struct {
+    ngx_radix_node_t  *node;
+    uintptr_t          value;
+    ngx_uint_t         level;
+} ngx_radix_entry_t;
+
+
+typedef struct {
+    ngx_radix_entry_t  *entries;
+    ngx_uint_t          levels;
+    ngx_uint_t          nnodes;
+    ngx_uint_t          nleaves;
+} ngx_radix_table_ctx_t;
+
+
 static void *ngx_radix_alloc(ngx_radix_tree_t *tree);
+static void ngx_radix_table_expand(ngx_radix_entry_t *e,
+    ngx_radix_node_t *node, uintptr_t value, ngx_uint_t n, ngx_uint_t last);
+static void ngx_radix_table_count(ngx_radix_table_ctx_t *ctx,
+    ngx_radix_node_t *node, uintptr_t value, ngx_uint_t level);
+static ngx_inline ngx_uint_t ngx_radix_popcount(uint64_t x);
 
 
 ngx_radix_tree_t *
@@ -263,6 +283,478 @@ ngx_radix32tree_find(ngx_radix_tree_t *tree, uint32_t key)
 }
 
 
+#if (NGX_HAVE_INET6)
+
+ngx_int_t
+ngx_radix128tree_insert(ngx_radix_tree_t *tree, u_char *key, u_char *mask,
+    uintptr_t value)
+{
+    u_char             bit;
+    ngx_uint_t         i;
+    ngx_radix_node_t  *node, *next;
+
+    i = 0;
+    bit = 0x80;
+
+    node = tree->root;
+    next = tree->root;
+
+    while (bit & mask[i]) {
+        if (key[i] & bit) {
+            next = node->right;
+
+        } else {
+            next = node->left;
+        }
+
+        if (next == NULL) {
+            break;
+        }
+
+        bit >>= 1;
+        node = next;
+
+        if (bit == 0) {
+            if (++i == 16) {
+                break;
+            }
+
+            bit = 0x80;
+        }
+    }
+
+    if (next) {
+        if (node->value != NGX_RADIX_NO_VALUE) {
+            return NGX_BUSY;
+        }
+
+        node->value = value;
+        return NGX_OK;
+    }
+
+    while (bit & mask[i]) {
+        next = ngx_radix_alloc(tree);
+        if (next == NULL) {
+            return NGX_ERROR;
+        }
+
+        next->right = NULL;
+        next->left = NULL;
+        next->parent = node;
+        next->value = NGX_RADIX_NO_VALUE;
+
+        if (key[i] & bit) {
+            node->right = next;
+
+        } else {
+            node->left = next;
+        }
+
+        bit >>= 1;
+        node = next;
+
+        if (bit == 0) {
+            if (++i == 16) {
+                break;
+            }
+
+            bit = 0x80;
+        }
+    }
+
+    node->value = value;
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_radix128tree_delete(ngx_radix_tree_t *tree, u_char *key, u_char *mask)
+{
+    u_char             bit;
+    ngx_uint_t         i;
+    ngx_radix_node_t  *node;
+
+    i = 0;
+    bit = 0x80;
+    node = tree->root;
+
+    while (node && (bit & mask[i])) {
+        if (key[i] & bit) {
+            node = node->right;
+
+        } else {
+            node = node->left;
+        }
+
+        bit >>= 1;
+
+        if (bit == 0) {
+            if (++i == 16) {
+                break;
+            }
+
+            bit = 0x80;
+        }
+    }
+
+    if (node == NULL) {
+        return NGX_ERROR;
+    }
+
+    if (node->right || node->left) {
+        if (node->value != NGX_RADIX_NO_VALUE) {
+            node->value = NGX_RADIX_NO_VALUE;
+            return NGX_OK;
+        }
+
+        return NGX_ERROR;
+    }
+
+    for ( ;; ) {
+        if (node->parent->right == node) {
+            node->parent->right = NULL;
+
+        } else {
+            node->parent->left = NULL;
+        }
+
+        node->right = tree->free;
+        tree->free = node;
+
+        node = node->parent;
+
+        if (node->right || node->left) {
+            break;
+        }
+
+        if (node->value != NGX_RADIX_NO_VALUE) {
+            break;
+        }
+
+        if (node->parent == NULL) {
+            break;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+uintptr_t
+ngx_radix128tree_find(ngx_radix_tree_t *tree, u_char *key)
+{
+    u_char             bit;
+    uintptr_t          value;
+    ngx_uint_t         i;
+    ngx_radix_node_t  *node;
+
+    i = 0;
+    bit = 0x80;
+    value = NGX_RADIX_NO_VALUE;
+    node = tree->root;
+
+    while (node) {
+        if (node->value != NGX_RADIX_NO_VALUE) {
+            value = node->value;
+        }
+
+        if (i == 16) {
+            break;
+        }
+
+        if (key[i] & bit) {
+            node = node->right;
+
+        } else {
+            node = node->left;
+        }
+
+        bit >>= 1;
+
+        if (bit == 0) {
+            i++;
+            bit = 0x80;
+        }
+    }
+
+    return value;
+}
+
+#endif
+
+
+ngx_radix_table_t *
+ngx_radix_table_create(ngx_radix_tree_t *tree, ngx_pool_t *pool,
+    ngx_uint_t bits)
+{
+    uint64_t                 bit;
+    uintptr_t                prev;
+    ngx_uint_t               i, n, c, b, leaf, level;
+    ngx_radix_entry_t       *e, *queue;
+    ngx_radix_chunk_t       *chunk;
+    ngx_radix_table_t       *table;
+    ngx_radix_table_ctx_t    ctx;
+
+    table = ngx_palloc(pool, sizeof(ngx_radix_table_t));
+    if (table == NULL) {
+        return NULL;
+    }
+
+    ctx.levels = bits / 8;
+    ctx.nnodes = 0;
+    ctx.nleaves = 0;
+
+    ctx.entries = ngx_alloc(ctx.levels * 256 * sizeof(ngx_radix_entry_t),
+                            ngx_cycle->log);
+    if (ctx.entries == NULL) {
+        return NULL;
+    }
+
+    /* the first pass counts the nodes and the leaves */
+
+    ngx_radix_table_count(&ctx, tree->root, tree->root->value, 0);
+
+    if (ctx.nnodes > NGX_MAX_UINT32_VALUE
+        || ctx.nleaves > NGX_MAX_UINT32_VALUE)
+    {
+        ngx_log_error(NGX_LOG_EMERG, ngx_cycle->log, 0,
+                      "radix tree is too large");
+        goto failed;
+    }
+
+    table->nnodes = ctx.nnodes;
+    table->nleaves = ctx.nleaves;
+
+    table->nodes = ngx_palloc(pool,
+                              ctx.nnodes * sizeof(ngx_radix_table_node_t));
+    if (table->nodes == NULL) {
+        goto failed;
+    }
+
+    table->leaves = ngx_palloc(pool, ctx.nleaves * sizeof(uintptr_t));
+    if (table->leaves == NULL) {
+        goto failed;
+    }
+
+    queue = ngx_alloc(ctx.nnodes * sizeof(ngx_radix_entry_t), ngx_cycle->log);
+    if (queue == NULL) {
+        goto failed;
+    }
+
+    /*
+     * the second pass lays the nodes out in breadth-first order,
+     * the queue keeps the tree nodes of the table nodes
+     */
+
+    queue[0].node = tree->root;
+    queue[0].value = tree->root->value;
+    queue[0].level = 0;
+
+    n = 1;
+    leaf = 0;
+
+    for (i = 0; i < ctx.nnodes; i++) {
+
+        e = ctx.entries;
+        level = queue[i].level;
+
+        ngx_radix_table_expand(e, queue[i].node->left, queue[i].value, 128,
+                               level + 1 == ctx.levels);
+        ngx_radix_table_expand(e + 128, queue[i].node->right, queue[i].value,
+                               128, level + 1 == ctx.levels);
+
+        prev = NGX_RADIX_NO_VALUE;
+        chunk = table->nodes[i].chunk;
+
+        for (c = 0; c < 4; c++) {
+            chunk[c].vector = 0;
+            chunk[c].leafvec = 0;
+            chunk[c].child = (uint32_t) n;
+            chunk[c].leaf = (uint32_t) leaf;
+
+            for (b = 0; b < 64; b++, e++) {
+                bit = (uint64_t) 1 << b;
+
+                if (e->node) {
+                    chunk[c].vector |= bit;
+
+                    queue[n].node = e->node;
+                    queue[n].value = e->value;
+                    queue[n].level = level + 1;
+                    n++;
+
+                    continue;
+                }
+
+                if (leaf == chunk[0].leaf || e->value != prev) {
+                    chunk[c].leafvec |= bit;
+                    table->leaves[leaf++] = e->value;
+                    prev = e->value;
+                }
+            }
+        }
+    }
+
+    ngx_free(queue);
+    ngx_free(ctx.entries);
+
+    return table;
+
+failed:
+
+    ngx_free(ctx.entries);
+
+    return NULL;
+}
+
+
+uintptr_t
+ngx_radix32table_find(ngx_radix_table_t *table, uint32_t key)
+{
+    uint64_t                 bit, mask;
+    ngx_uint_t               b, shift;
+    ngx_radix_chunk_t       *chunk;
+    ngx_radix_table_node_t  *node;
+
+    node = table->nodes;
+
+    for (shift = 24; /* void */; shift -= 8) {
+        b = (key >> shift) & 0xff;
+
+        chunk = &node->chunk[b >> 6];
+        bit = (uint64_t) 1 << (b & 63);
+        mask = (bit << 1) - 1;
+
+        if (!(chunk->vector & bit)) {
+            break;
+        }
+
+        node = &table->nodes[chunk->child
+                             + ngx_radix_popcount(chunk->vector & mask) - 1];
+    }
+
+    return table->leaves[chunk->leaf
+                         + ngx_radix_popcount(chunk->leafvec & mask) - 1];
+}
+
+
+#if (NGX_HAVE_INET6)
+
+uintptr_t
+ngx_radix128table_find(ngx_radix_table_t *table, u_char *key)
+{
+    uint64_t                 bit, mask;
+    ngx_uint_t               i;
+    ngx_radix_chunk_t       *chunk;
+    ngx_radix_table_node_t  *node;
+
+    node = table->nodes;
+
+    for (i = 0; /* void */; i++) {
+        chunk = &node->chunk[key[i] >> 6];
+        bit = (uint64_t) 1 << (key[i] & 63);
+        mask = (bit << 1) - 1;
+
+        if (!(chunk->vector & bit)) {
+            break;
+        }
+
+        node = &table->nodes[chunk->child
+                             + ngx_radix_popcount(chunk->vector & mask) - 1];
+    }
+
+    return table->leaves[chunk->leaf
+                         + ngx_radix_popcount(chunk->leafvec & mask) - 1];
+}
+
+#endif
+
+
+/*
+ * expands the subtree of the node into n entries, the entries of
+ * the subtrees which continue below the 8 bits become the child nodes
+ */
+
+static void
+ngx_radix_table_expand(ngx_radix_entry_t *e, ngx_radix_node_t *node,
+    uintptr_t value, ngx_uint_t n, ngx_uint_t last)
+{
+    ngx_uint_t  i;
+
+    if (node == NULL) {
+        for (i = 0; i < n; i++) {
+            e[i].node = NULL;
+            e[i].value = value;
+        }
+
+        return;
+    }
+
+    if (node->value != NGX_RADIX_NO_VALUE) {
+        value = node->value;
+    }
+
+    if (n == 1) {
+        e->node = (last || (node->left == NULL && node->right == NULL))
+                  ? NULL : node;
+        e->value = value;
+        return;
+    }
+
+    n /= 2;
+
+    ngx_radix_table_expand(e, node->left, value, n, last);
+    ngx_radix_table_expand(e + n, node->right, value, n, last);
+}
+
+
+static void
+ngx_radix_table_count(ngx_radix_table_ctx_t *ctx, ngx_radix_node_t *node,
+    uintptr_t value, ngx_uint_t level)
+{
+    uintptr_t           prev;
+    ngx_uint_t          i, last, leaves;
+    ngx_radix_entry_t  *e;
+
+    e = ctx->entries + level * 256;
+    last = (level + 1 == ctx->levels);
+
+    ngx_radix_table_expand(e, node->left, value, 128, last);
+    ngx_radix_table_expand(e + 128, node->right, value, 128, last);
+
+    ctx->nnodes++;
+
+    prev = NGX_RADIX_NO_VALUE;
+    leaves = 0;
+
+    for (i = 0; i < 256; i++) {
+        if (e[i].node) {
+            ngx_radix_table_count(ctx, e[i].node, e[i].value, level + 1);
+            continue;
+        }
+
+        if (leaves == 0 || e[i].value != prev) {
+            prev = e[i].value;
+            leaves++;
+        }
+    }
+
+    ctx->nleaves += leaves;
+}
+
+
+static ngx_inline ngx_uint_t
+ngx_radix_popcount(uint64_t x)
+{
+    x -= (x >> 1) & 0x5555555555555555ULL;
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+
+    return (ngx_uint_t) ((x * 0x0101010101010101ULL) >> 56);
+}
+
+
 static void *
 ngx_radix_alloc(ngx_radix_tree_t *tree)
 {
@@ -34,6 +34,37 @@ typedef struct {
 } ngx_radix_tree_t;
 
 
+/*
+ * ngx_radix_table_t is a read-only form of the tree built at configuration
+ * time.  Each node covers 8 bits of the key and has 256 entries, an entry
+ * is either a child node or a leaf value.  The entries are not stored
+ * themselves, the "vector" bitmap marks the child entries, and the
+ * "leafvec" bitmap marks the entries where a run of equal leaves starts,
+ * so a child node and a leaf are found by counting the bits set before
+ * the entry.  The children of a node are stored contiguously.
+ */
+
+typedef struct {
+    uint64_t           vector;
+    uint64_t           leafvec;
+    uint32_t           child;
+    uint32_t           leaf;
+} ngx_radix_chunk_t;
+
+
+typedef struct {
+    ngx_radix_chunk_t  chunk[4];
+} ngx_radix_table_node_t;
+
+
+typedef struct {
+    ngx_radix_table_node_t  *nodes;
+    uintptr_t               *leaves;
+    ngx_uint_t               nnodes;
+    ngx_uint_t               nleaves;
+} ngx_radix_table_t;
+
+
 ngx_radix_tree_t *ngx_radix_tree_create(ngx_pool_t *pool,
     ngx_int_t preallocate);
 ngx_int_t ngx_radix32tree_insert(ngx_radix_tree_t *tree,
@@ -42,5 +73,20 @@ ngx_int_t ngx_radix32tree_delete(ngx_radix_tree_t *tree,
     uint32_t key, uint32_t mask);
 uintptr_t ngx_radix32tree_find(ngx_radix_tree_t *tree, uint32_t key);
 
+#if (NGX_HAVE_INET6)
+ngx_int_t ngx_radix128tree_insert(ngx_radix_tree_t *tree,
+    u_char *key, u_char *mask, uintptr_t value);
+ngx_int_t ngx_radix128tree_delete(ngx_radix_tree_t *tree,
+    u_char *key, u_char *mask);
+uintptr_t ngx_radix128tree_find(ngx_radix_tree_t *tree, u_char *key);
+#endif
+
+ngx_radix_table_t *ngx_radix_table_create(ngx_radix_tree_t *tree,
+    ngx_pool_t *pool, ngx_uint_t bits);
+uintptr_t ngx_radix32table_find(ngx_radix_table_t *table, uint32_t key);
+#if (NGX_HAVE_INET6)
+uintptr_t ngx_radix128table_find(ngx_radix_table_t *table, u_char *key);
+#endif
+
 
 #endif /* _NGX_RADIX_TREE_H_INCLUDED_ */
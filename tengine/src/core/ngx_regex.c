@@ -14,6 +14,7 @@ typedef struct {
 } ngx_regex_conf_t;
 
 
+static ngx_int_t ngx_regex_check_union(ngx_str_t *pattern);
 static void * ngx_libc_cdecl ngx_regex_malloc(size_t size);
 static void ngx_libc_cdecl ngx_regex_free(void *p);
 #if (NGX_HAVE_PCRE_JIT)
@@ -67,6 +68,7 @@ ngx_module_t  ngx_regex_module = {
 
 static ngx_pool_t  *ngx_pcre_pool;
 static ngx_list_t  *ngx_pcre_studies;
+static ngx_list_t  *ngx_pcre_unions;
 
 
 void
@@ -208,6 +210,205 @@ failed:
 }
 
 
+/*
+ * ngx_regex_compile_union() joins several compiled regexes into one
+ * alternation, so a single ngx_regex_exec() tells whether any of them
+ * matches.  The union finds the leftmost match, but not necessarily the
+ * one of the first regex in order, hence it may only be used to reject
+ * a subject before the regexes are tried one by one.
+ *
+ * Without JIT the union is slower than the regexes it joins, so it is
+ * only compiled while configuration is read, and its code is reset to
+ * NULL if the JIT compilation is not done: the caller must check it.
+ *
+ * NGX_DECLINED is returned if a regex uses backreferences, recursion
+ * or other constructs that change their meaning once the groups are
+ * renumbered, or if the union can not be compiled, e.g., it is too large.
+ * Named groups are kept, "(?J)" allows the same name in several regexes.
+ */
+
+ngx_int_t
+ngx_regex_compile_union(ngx_regex_compile_t *rc, ngx_regex_elt_t *elts,
+    ngx_uint_t n)
+{
+    int               rv;
+    u_char           *p;
+    size_t            len;
+    ngx_str_t         pattern;
+    ngx_uint_t        i;
+    unsigned long     options;
+    ngx_regex_elt_t  *elt;
+
+#if !(NGX_HAVE_PCRE_JIT)
+    return NGX_DECLINED;
+#endif
+
+    if (ngx_pcre_unions == NULL) {
+        return NGX_DECLINED;
+    }
+
+    len = 0;
+
+    for (i = 0; i < n; i++) {
+        pattern.data = elts[i].name;
+        pattern.len = ngx_strlen(elts[i].name);
+
+        if (ngx_regex_check_union(&pattern) != NGX_OK) {
+            rc->err.len = ngx_snprintf(rc->err.data, rc->err.len,
+                                       "\"%V\" can not be joined", &pattern)
+                          - rc->err.data;
+            return NGX_DECLINED;
+        }
+
+        len += sizeof("|(?:(?i))") - 1 + pattern.len;
+    }
+
+    p = ngx_pnalloc(rc->pool, sizeof("(?J)") - 1 + len + 1);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    rc->pattern.data = p;
+
+    p = ngx_cpymem(p, "(?J)", sizeof("(?J)") - 1);
+
+    for (i = 0; i < n; i++) {
+
+        rv = pcre_fullinfo(elts[i].regex->code, NULL, PCRE_INFO_OPTIONS,
+                           &options);
+        if (rv < 0) {
+            options = 0;
+        }
+
+        if (i) {
+            *p++ = '|';
+        }
+
+        p = ngx_cpymem(p, "(?:", sizeof("(?:") - 1);
+
+        if (options & PCRE_CASELESS) {
+            p = ngx_cpymem(p, "(?i)", sizeof("(?i)") - 1);
+        }
+
+        p = ngx_cpymem(p, elts[i].name, ngx_strlen(elts[i].name));
+        *p++ = ')';
+    }
+
+    *p = '\0';
+
+    rc->pattern.len = p - rc->pattern.data;
+    rc->options = 0;
+
+    if (ngx_regex_compile(rc) != NGX_OK) {
+        return NGX_DECLINED;
+    }
+
+    elt = ngx_list_push(ngx_pcre_unions);
+    if (elt == NULL) {
+        return NGX_ERROR;
+    }
+
+    elt->regex = rc->regex;
+    elt->name = rc->pattern.data;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_regex_check_union(ngx_str_t *pattern)
+{
+    u_char      *p, *last;
+    ngx_uint_t   class;
+
+    class = 0;
+
+    p = pattern->data;
+    last = p + pattern->len;
+
+    while (p < last) {
+
+        switch (*p) {
+
+        case '\\':
+            if (p + 1 == last) {
+                return NGX_DECLINED;
+            }
+
+            switch (p[1]) {
+
+            /* backreferences and quoted text */
+            case '1': case '2': case '3': case '4': case '5':
+            case '6': case '7': case '8': case '9':
+            case 'g': case 'k': case 'Q':
+                return NGX_DECLINED;
+            }
+
+            p += 2;
+            continue;
+
+        case '[':
+            class = 1;
+            break;
+
+        case ']':
+            class = 0;
+            break;
+
+        case '#':
+            /* a comment in the extended mode would swallow the ")" */
+            return NGX_DECLINED;
+
+        case '(':
+            if (class || p + 2 >= last) {
+                break;
+            }
+
+            if (p[1] == '*') {
+                /* backtracking control verbs */
+                return NGX_DECLINED;
+            }
+
+            if (p[1] != '?') {
+                break;
+            }
+
+            switch (p[2]) {
+
+            /*
+             * branch reset, recursion, subroutine calls, and conditions
+             * on groups, which are renumbered or ambiguous in the union
+             */
+            case '|': case 'R': case '&': case '+': case '(':
+            case '0': case '1': case '2': case '3': case '4':
+            case '5': case '6': case '7': case '8': case '9':
+                return NGX_DECLINED;
+
+            case 'P':
+                /* named backreferences and subroutine calls */
+                if (p + 3 < last && p[3] != '<') {
+                    return NGX_DECLINED;
+                }
+                break;
+
+            case '-':
+                if (p + 3 < last && p[3] >= '0' && p[3] <= '9') {
+                    return NGX_DECLINED;
+                }
+                break;
+            }
+
+            break;
+        }
+
+        p++;
+    }
+
+    return NGX_OK;
+}
+
+
+
 ngx_int_t
 ngx_regex_exec_array(ngx_array_t *a, ngx_str_t *s, ngx_log_t *log)
 {
@@ -315,7 +516,7 @@ ngx_pcre_free_studies(void *data)
 static ngx_int_t
 ngx_regex_module_init(ngx_cycle_t *cycle)
 {
-    int               opt;
+    int               opt, jit;
     const char       *errstr;
     ngx_uint_t        i;
     ngx_list_part_t  *part;
@@ -377,7 +578,7 @@ ngx_regex_module_init(ngx_cycle_t *cycle)
 
 #if (NGX_HAVE_PCRE_JIT)
         if (opt & PCRE_STUDY_JIT_COMPILE) {
-            int jit, n;
+            int  n;
 
             jit = 0;
             n = pcre_fullinfo(elts[i].regex->code, elts[i].regex->extra,
@@ -394,7 +595,41 @@ ngx_regex_module_init(ngx_cycle_t *cycle)
 
     ngx_regex_malloc_done();
 
+    part = &ngx_pcre_unions->part;
+    elts = part->elts;
+
+    for (i = 0 ; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            elts = part->elts;
+            i = 0;
+        }
+
+        jit = 0;
+
+#if (NGX_HAVE_PCRE_JIT)
+        if (opt & PCRE_STUDY_JIT_COMPILE) {
+            if (pcre_fullinfo(elts[i].regex->code, elts[i].regex->extra,
+                              PCRE_INFO_JIT, &jit)
+                != 0)
+            {
+                jit = 0;
+            }
+        }
+#endif
+
+        if (jit != 1) {
+            elts[i].regex->code = NULL;
+        }
+    }
+
     ngx_pcre_studies = NULL;
+    ngx_pcre_unions = NULL;
 
     return NGX_OK;
 }
@@ -417,6 +652,11 @@ ngx_regex_create_conf(ngx_cycle_t *cycle)
         return NULL;
     }
 
+    ngx_pcre_unions = ngx_list_create(cycle->pool, 4, sizeof(ngx_regex_elt_t));
+    if (ngx_pcre_unions == NULL) {
+        return NULL;
+    }
+
     return rcf;
 }
 
@@ -48,6 +48,8 @@ typedef struct {
 
 void ngx_regex_init(void);
 ngx_int_t ngx_regex_compile(ngx_regex_compile_t *rc);
+ngx_int_t ngx_regex_compile_union(ngx_regex_compile_t *rc,
+    ngx_regex_elt_t *elts, ngx_uint_t n);
 
 #define ngx_regex_exec(re, s, captures, size)                                \
     pcre_exec(re->code, re->extra, (const char *) (s)->data, (s)->len, 0, 0, \
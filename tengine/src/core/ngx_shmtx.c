@@ -12,6 +12,26 @@
 #if (NGX_HAVE_ATOMIC_OPS)
 
 
+#define NGX_SHMTX_MIN_SPIN  16
+
+
+#if (NGX_HAVE_FUTEX)
+
+/*
+ * the futex is the low half of the wakeups counter, the futex is not
+ * private as the lock is shared by processes
+ */
+
+#if (NGX_HAVE_LITTLE_ENDIAN)
+#define ngx_shmtx_futex(mtx)  ((uint32_t *) (mtx)->wakeups)
+#else
+#define ngx_shmtx_futex(mtx)                                                 \
+    ((uint32_t *) (mtx)->wakeups + sizeof(ngx_atomic_t) / 4 - 1)
+#endif
+
+#endif
+
+
 static void ngx_shmtx_wakeup(ngx_shmtx_t *mtx);
 
 
@@ -19,6 +39,13 @@ ngx_int_t
 ngx_shmtx_create(ngx_shmtx_t *mtx, ngx_shmtx_sh_t *addr, u_char *name)
 {
     mtx->lock = &addr->lock;
+    mtx->adaptive = &addr->spin;
+    mtx->stat = &addr->stat;
+
+#if (NGX_HAVE_FUTEX)
+    mtx->wait = &addr->wait;
+    mtx->wakeups = &addr->wakeups;
+#endif
 
     if (mtx->spin == (ngx_uint_t) -1) {
         return NGX_OK;
@@ -26,7 +53,7 @@ ngx_shmtx_create(ngx_shmtx_t *mtx, ngx_shmtx_sh_t *addr, u_char *name)
 
     mtx->spin = 2048;
 
-#if (NGX_HAVE_POSIX_SEM)
+#if (NGX_HAVE_POSIX_SEM && !NGX_HAVE_FUTEX)
 
     mtx->wait = &addr->wait;
 
@@ -46,7 +73,7 @@ ngx_shmtx_create(ngx_shmtx_t *mtx, ngx_shmtx_sh_t *addr, u_char *name)
 void
 ngx_shmtx_destroy(ngx_shmtx_t *mtx)
 {
-#if (NGX_HAVE_POSIX_SEM)
+#if (NGX_HAVE_POSIX_SEM && !NGX_HAVE_FUTEX)
 
     if (mtx->semaphore) {
         if (sem_destroy(&mtx->sem) == -1) {
@@ -62,46 +89,110 @@ ngx_shmtx_destroy(ngx_shmtx_t *mtx)
 ngx_uint_t
 ngx_shmtx_trylock(ngx_shmtx_t *mtx)
 {
-    return (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid));
+    if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
+        mtx->stat->acquired++;
+        return 1;
+    }
+
+    return 0;
 }
 
 
 void
 ngx_shmtx_lock(ngx_shmtx_t *mtx)
 {
-    ngx_uint_t         i, n;
+    ngx_int_t          usec;
+    ngx_uint_t         i, n, spin, spun, adaptive;
+    struct timeval     start, end;
+#if (NGX_HAVE_FUTEX)
+    uint32_t           wakeups;
+    ngx_err_t          err;
+#endif
 
     ngx_log_debug0(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0, "shmtx lock");
 
-    for ( ;; ) {
+    if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
+        mtx->stat->acquired++;
+        return;
+    }
 
-        if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
-            return;
-        }
+    ngx_gettimeofday(&start);
+
+    /*
+     * the number of pauses spent spinning adapts to how long the lock
+     * is usually held: it follows twice the number of pauses after which
+     * the lock was acquired while spinning, and decays if spinning fails
+     */
+
+    adaptive = ngx_min(*mtx->adaptive, mtx->spin);
+    spin = ngx_max(adaptive, NGX_SHMTX_MIN_SPIN);
+
+    spun = 0;
+
+    for ( ;; ) {
 
         if (ngx_ncpu > 1) {
 
-            for (n = 1; n < mtx->spin; n <<= 1) {
+            for (n = 1, spun = 0; spun < spin; n <<= 1) {
 
                 for (i = 0; i < n; i++) {
                     ngx_cpu_pause();
                 }
 
+                spun += n;
+
                 if (*mtx->lock == 0
                     && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid))
                 {
-                    return;
+                    goto locked;
                 }
             }
+
+            spun = 0;
+        }
+
+#if (NGX_HAVE_FUTEX)
+
+        /*
+         * a wakeup after the counter is read makes futex() return at once,
+         * so a wakeup is not lost even if the lock has been acquired and
+         * released by the same process in the meantime
+         */
+
+        wakeups = (uint32_t) *mtx->wakeups;
+
+        (void) ngx_atomic_fetch_add(mtx->wait, 1);
+
+        if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
+            goto locked;
         }
 
-#if (NGX_HAVE_POSIX_SEM)
+        ngx_log_debug1(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
+                       "shmtx wait %uA", *mtx->wait);
+
+        if (syscall(SYS_futex, ngx_shmtx_futex(mtx), FUTEX_WAIT, wakeups,
+                    NULL, NULL, 0)
+            == -1)
+        {
+            err = ngx_errno;
+
+            if (err != NGX_EAGAIN && err != NGX_EINTR) {
+                ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, err,
+                              "futex() failed while waiting on shmtx");
+            }
+        }
+
+        ngx_log_debug0(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0, "shmtx awoke");
+
+        continue;
+
+#elif (NGX_HAVE_POSIX_SEM)
 
         if (mtx->semaphore) {
             (void) ngx_atomic_fetch_add(mtx->wait, 1);
 
             if (*mtx->lock == 0 && ngx_atomic_cmp_set(mtx->lock, 0, ngx_pid)) {
-                return;
+                goto locked;
             }
 
             ngx_log_debug1(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
@@ -129,6 +220,19 @@ ngx_shmtx_lock(ngx_shmtx_t *mtx)
 
         ngx_sched_yield();
     }
+
+locked:
+
+    ngx_gettimeofday(&end);
+
+    usec = (end.tv_sec - start.tv_sec) * 1000000
+           + (end.tv_usec - start.tv_usec);
+
+    *mtx->adaptive = adaptive - adaptive / 8 + spun / 4;
+
+    mtx->stat->acquired++;
+    mtx->stat->contended++;
+    mtx->stat->wait_time += ngx_max(usec, 0);
 }
 
 
@@ -163,12 +267,14 @@ ngx_shmtx_force_unlock(ngx_shmtx_t *mtx, ngx_pid_t pid)
 static void
 ngx_shmtx_wakeup(ngx_shmtx_t *mtx)
 {
-#if (NGX_HAVE_POSIX_SEM)
+#if (NGX_HAVE_FUTEX || NGX_HAVE_POSIX_SEM)
     ngx_atomic_uint_t  wait;
 
+#if (NGX_HAVE_POSIX_SEM && !NGX_HAVE_FUTEX)
     if (!mtx->semaphore) {
         return;
     }
+#endif
 
     for ( ;; ) {
 
@@ -186,11 +292,26 @@ ngx_shmtx_wakeup(ngx_shmtx_t *mtx)
     ngx_log_debug1(NGX_LOG_DEBUG_CORE, ngx_cycle->log, 0,
                    "shmtx wake %uA", wait);
 
+#if (NGX_HAVE_FUTEX)
+
+    (void) ngx_atomic_fetch_add(mtx->wakeups, 1);
+
+    if (syscall(SYS_futex, ngx_shmtx_futex(mtx), FUTEX_WAKE, 1, NULL, NULL, 0)
+        == -1)
+    {
+        ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
+                      "futex() failed while wake shmtx");
+    }
+
+#else
+
     if (sem_post(&mtx->sem) == -1) {
         ngx_log_error(NGX_LOG_ALERT, ngx_cycle->log, ngx_errno,
                       "sem_post() failed while wake shmtx");
     }
 
+#endif
+
 #endif
 }
 
@@ -201,6 +322,8 @@ ngx_shmtx_wakeup(ngx_shmtx_t *mtx)
 ngx_int_t
 ngx_shmtx_create(ngx_shmtx_t *mtx, ngx_shmtx_sh_t *addr, u_char *name)
 {
+    mtx->stat = &addr->stat;
+
     if (mtx->name) {
 
         if (ngx_strcmp(name, mtx->name) == 0) {
@@ -249,6 +372,7 @@ ngx_shmtx_trylock(ngx_shmtx_t *mtx)
     err = ngx_trylock_fd(mtx->fd);
 
     if (err == 0) {
+        mtx->stat->acquired++;
         return 1;
     }
 
@@ -278,6 +402,7 @@ ngx_shmtx_lock(ngx_shmtx_t *mtx)
     err = ngx_lock_fd(mtx->fd);
 
     if (err == 0) {
+        mtx->stat->acquired++;
         return;
     }
 
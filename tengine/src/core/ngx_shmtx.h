@@ -13,27 +13,49 @@
 #include <ngx_core.h>
 
 
+/*
+ * the statistics are updated by the lock owner only, the wait time
+ * of the contended acquisitions is in microseconds
+ */
+
 typedef struct {
-    ngx_atomic_t   lock;
-#if (NGX_HAVE_POSIX_SEM)
-    ngx_atomic_t   wait;
+    ngx_atomic_t       acquired;
+    ngx_atomic_t       contended;
+    ngx_atomic_t       wait_time;
+} ngx_shmtx_stat_t;
+
+
+typedef struct {
+    ngx_atomic_t       lock;
+#if (NGX_HAVE_FUTEX || NGX_HAVE_POSIX_SEM)
+    ngx_atomic_t       wait;
+#endif
+#if (NGX_HAVE_FUTEX)
+    ngx_atomic_t       wakeups;
 #endif
+    ngx_atomic_t       spin;
+    ngx_shmtx_stat_t   stat;
 } ngx_shmtx_sh_t;
 
 
 typedef struct {
 #if (NGX_HAVE_ATOMIC_OPS)
-    ngx_atomic_t  *lock;
-#if (NGX_HAVE_POSIX_SEM)
-    ngx_atomic_t  *wait;
-    ngx_uint_t     semaphore;
-    sem_t          sem;
+    ngx_atomic_t      *lock;
+#if (NGX_HAVE_FUTEX)
+    ngx_atomic_t      *wait;
+    ngx_atomic_t      *wakeups;
+#elif (NGX_HAVE_POSIX_SEM)
+    ngx_atomic_t      *wait;
+    ngx_uint_t         semaphore;
+    sem_t              sem;
 #endif
+    ngx_atomic_t      *adaptive;
 #else
-    ngx_fd_t       fd;
-    u_char        *name;
+    ngx_fd_t           fd;
+    u_char            *name;
 #endif
-    ngx_uint_t     spin;
+    ngx_shmtx_stat_t  *stat;
+    ngx_uint_t         spin;
 } ngx_shmtx_t;
 
 
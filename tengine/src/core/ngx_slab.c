@@ -56,6 +56,57 @@
 
 #endif
 
+/*
+ * The per-process slab cache keeps up to ngx_slab_cache_size free chunks
+ * of every size class of every shared zone: ngx_slab_alloc() and
+ * ngx_slab_free() do not take the zone mutex on a cache hit, and the locked
+ * variants do not search the slab pages, so the mutex is held for less time.
+ * The cache is refilled and flushed by batches of a half of its size.
+ * The cached chunks are accounted as used ones in the zone statistics.
+ *
+ * The cache itself is allocated in the zone and linked to pool->caches
+ * (a zone too small for it is used without the cache), so the chunks
+ * cached by a process which has died without flushing them are reclaimed
+ * by the next process which builds its cache for the zone.
+ * The chunk is stored before the counter is incremented, and the counter
+ * is decremented before the chunk is freed, hence a crash may leak a chunk
+ * but never frees it twice.
+ */
+
+typedef struct {
+    ngx_uint_t          n;
+    void              **chunks;
+} ngx_slab_cache_slot_t;
+
+
+typedef struct ngx_slab_cache_sh_s  ngx_slab_cache_sh_t;
+
+struct ngx_slab_cache_sh_s {
+    ngx_slab_cache_sh_t    *next;
+    ngx_pid_t               pid;
+    ngx_uint_t              nslots;
+    ngx_slab_cache_slot_t  *slots;
+};
+
+
+typedef struct {
+    ngx_slab_pool_t        *pool;
+    ngx_slab_cache_slot_t  *slots;
+    ngx_uint_t              nslots;
+    ngx_slab_cache_sh_t    *sh;
+} ngx_slab_cache_t;
+
+
+static void *ngx_slab_alloc_chunk_locked(ngx_slab_pool_t *pool, size_t size);
+static void ngx_slab_free_chunk_locked(ngx_slab_pool_t *pool, void *p);
+static ngx_slab_cache_t *ngx_slab_cache_get(ngx_slab_pool_t *pool);
+static void *ngx_slab_cache_alloc(ngx_slab_cache_t *cache, size_t size,
+    ngx_uint_t locked);
+static ngx_int_t ngx_slab_cache_free(ngx_slab_cache_t *cache, void *p,
+    ngx_uint_t locked);
+static ngx_uint_t ngx_slab_cache_flush(ngx_slab_cache_t *cache,
+    ngx_uint_t locked);
+static void ngx_slab_cache_reclaim(ngx_slab_pool_t *pool);
 static ngx_slab_page_t *ngx_slab_alloc_pages(ngx_slab_pool_t *pool,
     ngx_uint_t pages);
 static void ngx_slab_free_pages(ngx_slab_pool_t *pool, ngx_slab_page_t *page,
@@ -68,6 +119,10 @@ static ngx_uint_t  ngx_slab_max_size;
 static ngx_uint_t  ngx_slab_exact_size;
 static ngx_uint_t  ngx_slab_exact_shift;
 
+static ngx_uint_t         ngx_slab_cache_size;
+static ngx_slab_cache_t  *ngx_slab_caches;
+static ngx_uint_t         ngx_slab_ncaches;
+
 
 void
 ngx_slab_init(ngx_slab_pool_t *pool)
@@ -106,6 +161,13 @@ ngx_slab_init(ngx_slab_pool_t *pool)
 
     p += n * sizeof(ngx_slab_page_t);
 
+    pool->stats = (ngx_slab_stat_t *) p;
+    ngx_memzero(pool->stats, n * sizeof(ngx_slab_stat_t));
+
+    p += n * sizeof(ngx_slab_stat_t);
+
+    size -= n * (sizeof(ngx_slab_page_t) + sizeof(ngx_slab_stat_t));
+
     pages = (ngx_uint_t) (size / (ngx_pagesize + sizeof(ngx_slab_page_t)));
 
     ngx_memzero(p, pages * sizeof(ngx_slab_page_t));
@@ -129,6 +191,13 @@ ngx_slab_init(ngx_slab_pool_t *pool)
         pool->pages->slab = pages;
     }
 
+    pool->npages = pages;
+    pool->pfree = pages;
+    pool->pfails = 0;
+
+    pool->caches = NULL;
+
+    pool->log_nomem = 1;
     pool->log_ctx = &pool->zero;
     pool->zero = '\0';
 }
@@ -137,11 +206,20 @@ ngx_slab_init(ngx_slab_pool_t *pool)
 void *
 ngx_slab_alloc(ngx_slab_pool_t *pool, size_t size)
 {
-    void  *p;
+    void              *p;
+    ngx_slab_cache_t  *cache;
+
+    if (ngx_slab_cache_size && size < ngx_slab_max_size) {
+        cache = ngx_slab_cache_get(pool);
+
+        if (cache) {
+            return ngx_slab_cache_alloc(cache, size, 0);
+        }
+    }
 
     ngx_shmtx_lock(&pool->mutex);
 
-    p = ngx_slab_alloc_locked(pool, size);
+    p = ngx_slab_alloc_chunk_locked(pool, size);
 
     ngx_shmtx_unlock(&pool->mutex);
 
@@ -151,6 +229,23 @@ ngx_slab_alloc(ngx_slab_pool_t *pool, size_t size)
 
 void *
 ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
+{
+    ngx_slab_cache_t  *cache;
+
+    if (ngx_slab_cache_size && size < ngx_slab_max_size) {
+        cache = ngx_slab_cache_get(pool);
+
+        if (cache) {
+            return ngx_slab_cache_alloc(cache, size, 1);
+        }
+    }
+
+    return ngx_slab_alloc_chunk_locked(pool, size);
+}
+
+
+static void *
+ngx_slab_alloc_chunk_locked(ngx_slab_pool_t *pool, size_t size)
 {
     size_t            s;
     uintptr_t         p, n, m, mask, *bitmap;
@@ -189,6 +284,8 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
     ngx_log_debug2(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
                    "slab alloc: %uz slot: %ui", size, slot);
 
+    pool->stats[slot].reqs++;
+
     slots = (ngx_slab_page_t *) ((u_char *) pool + sizeof(ngx_slab_pool_t));
     page = slots[slot].next;
 
@@ -222,6 +319,8 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
                                      if (bitmap[n] != NGX_SLAB_BUSY) {
                                          p = (uintptr_t) bitmap + i;
 
+                                         pool->stats[slot].used++;
+
                                          goto done;
                                      }
                                 }
@@ -237,6 +336,8 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
 
                             p = (uintptr_t) bitmap + i;
 
+                            pool->stats[slot].used++;
+
                             goto done;
                         }
                     }
@@ -272,6 +373,8 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
                         p += i << shift;
                         p += (uintptr_t) pool->start;
 
+                        pool->stats[slot].used++;
+
                         goto done;
                     }
                 }
@@ -314,6 +417,8 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
                         p += i << shift;
                         p += (uintptr_t) pool->start;
 
+                        pool->stats[slot].used++;
+
                         goto done;
                     }
                 }
@@ -355,6 +460,9 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
             p = ((page - pool->pages) << ngx_pagesize_shift) + s * n;
             p += (uintptr_t) pool->start;
 
+            pool->stats[slot].total += (ngx_pagesize >> shift) - n;
+            pool->stats[slot].used++;
+
             goto done;
 
         } else if (shift == ngx_slab_exact_shift) {
@@ -368,6 +476,9 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
             p = (page - pool->pages) << ngx_pagesize_shift;
             p += (uintptr_t) pool->start;
 
+            pool->stats[slot].total += 8 * sizeof(uintptr_t);
+            pool->stats[slot].used++;
+
             goto done;
 
         } else { /* shift > ngx_slab_exact_shift */
@@ -381,12 +492,17 @@ ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size)
             p = (page - pool->pages) << ngx_pagesize_shift;
             p += (uintptr_t) pool->start;
 
+            pool->stats[slot].total += ngx_pagesize >> shift;
+            pool->stats[slot].used++;
+
             goto done;
         }
     }
 
     p = 0;
 
+    pool->stats[slot].fails++;
+
 done:
 
     ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0, "slab alloc: %p", p);
@@ -398,9 +514,19 @@ done:
 void
 ngx_slab_free(ngx_slab_pool_t *pool, void *p)
 {
+    ngx_slab_cache_t  *cache;
+
+    if (ngx_slab_cache_size) {
+        cache = ngx_slab_cache_get(pool);
+
+        if (cache && ngx_slab_cache_free(cache, p, 0) == NGX_OK) {
+            return;
+        }
+    }
+
     ngx_shmtx_lock(&pool->mutex);
 
-    ngx_slab_free_locked(pool, p);
+    ngx_slab_free_chunk_locked(pool, p);
 
     ngx_shmtx_unlock(&pool->mutex);
 }
@@ -408,6 +534,23 @@ ngx_slab_free(ngx_slab_pool_t *pool, void *p)
 
 void
 ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
+{
+    ngx_slab_cache_t  *cache;
+
+    if (ngx_slab_cache_size) {
+        cache = ngx_slab_cache_get(pool);
+
+        if (cache && ngx_slab_cache_free(cache, p, 1) == NGX_OK) {
+            return;
+        }
+    }
+
+    ngx_slab_free_chunk_locked(pool, p);
+}
+
+
+static void
+ngx_slab_free_chunk_locked(ngx_slab_pool_t *pool, void *p)
 {
     size_t            size;
     uintptr_t         slab, m, *bitmap;
@@ -458,6 +601,9 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
 
             bitmap[n] &= ~m;
 
+            slot = shift - pool->min_shift;
+            pool->stats[slot].used--;
+
             n = (1 << (ngx_pagesize_shift - shift)) / 8 / (1 << shift);
 
             if (n == 0) {
@@ -470,14 +616,16 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
 
             map = (1 << (ngx_pagesize_shift - shift)) / (sizeof(uintptr_t) * 8);
 
-            for (n = 1; n < map; n++) {
-                if (bitmap[n]) {
+            for (m = 1; m < map; m++) {
+                if (bitmap[m]) {
                     goto done;
                 }
             }
 
             ngx_slab_free_pages(pool, page, 1);
 
+            pool->stats[slot].total -= (ngx_pagesize >> shift) - n;
+
             goto done;
         }
 
@@ -508,12 +656,17 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
 
             page->slab &= ~m;
 
+            slot = ngx_slab_exact_shift - pool->min_shift;
+            pool->stats[slot].used--;
+
             if (page->slab) {
                 goto done;
             }
 
             ngx_slab_free_pages(pool, page, 1);
 
+            pool->stats[slot].total -= 8 * sizeof(uintptr_t);
+
             goto done;
         }
 
@@ -547,12 +700,17 @@ ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p)
 
             page->slab &= ~m;
 
+            slot = shift - pool->min_shift;
+            pool->stats[slot].used--;
+
             if (page->slab & NGX_SLAB_MAP_MASK) {
                 goto done;
             }
 
             ngx_slab_free_pages(pool, page, 1);
 
+            pool->stats[slot].total -= ngx_pagesize >> shift;
+
             goto done;
         }
 
@@ -614,6 +772,439 @@ fail:
 }
 
 
+ngx_int_t
+ngx_slab_stat(ngx_slab_pool_t *pool, ngx_slab_info_t *info,
+    ngx_pool_t *temp_pool)
+{
+    ngx_uint_t            i, n;
+    ngx_slab_page_t      *page;
+    ngx_slab_cache_sh_t  *sh;
+
+    n = ngx_pagesize_shift - pool->min_shift;
+
+    info->stats = ngx_palloc(temp_pool, n * sizeof(ngx_slab_stat_t));
+    if (info->stats == NULL) {
+        return NGX_ERROR;
+    }
+
+    info->nslots = n;
+    info->min_size = pool->min_size;
+    info->max_free = 0;
+
+    ngx_shmtx_lock(&pool->mutex);
+
+    ngx_memcpy(info->stats, pool->stats, n * sizeof(ngx_slab_stat_t));
+
+    /* the chunks held by the process caches are counted in the snapshot */
+
+    for (sh = pool->caches; sh; sh = sh->next) {
+        for (i = 0; i < n; i++) {
+            info->stats[i].cached += sh->slots[i].n;
+        }
+    }
+
+    info->pages = pool->npages;
+    info->free = pool->pfree;
+    info->fails = pool->pfails;
+
+    /* the largest free run shows the fragmentation of the zone */
+
+    for (page = pool->free.next; page != &pool->free; page = page->next) {
+        if (page->slab > info->max_free) {
+            info->max_free = page->slab;
+        }
+    }
+
+    ngx_shmtx_unlock(&pool->mutex);
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_slab_cache_init(ngx_cycle_t *cycle)
+{
+    void                  **chunks;
+    ngx_uint_t              i, n, size, nslots;
+    ngx_list_part_t        *part;
+    ngx_shm_zone_t         *shm_zone;
+    ngx_core_conf_t        *ccf;
+    ngx_slab_pool_t        *pool;
+    ngx_slab_cache_t       *cache;
+    ngx_slab_cache_sh_t    *sh;
+
+    ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
+
+    size = ccf->slab_cache;
+
+    if (size == 0) {
+        return NGX_OK;
+    }
+
+    n = 0;
+    part = &cycle->shared_memory.part;
+
+    while (part) {
+        n += part->nelts;
+        part = part->next;
+    }
+
+    if (n == 0) {
+        return NGX_OK;
+    }
+
+    ngx_slab_caches = ngx_pcalloc(cycle->pool, n * sizeof(ngx_slab_cache_t));
+    if (ngx_slab_caches == NULL) {
+        return NGX_ERROR;
+    }
+
+    part = &cycle->shared_memory.part;
+    shm_zone = part->elts;
+
+    for (i = 0; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+            part = part->next;
+            shm_zone = part->elts;
+            i = 0;
+        }
+
+        pool = (ngx_slab_pool_t *) shm_zone[i].shm.addr;
+        nslots = ngx_pagesize_shift - pool->min_shift;
+
+        ngx_shmtx_lock(&pool->mutex);
+
+        ngx_slab_cache_reclaim(pool);
+
+        pool->log_nomem = 0;
+
+        sh = ngx_slab_alloc_locked(pool, sizeof(ngx_slab_cache_sh_t)
+                                  + nslots * sizeof(ngx_slab_cache_slot_t)
+                                  + nslots * size * sizeof(void *));
+
+        pool->log_nomem = 1;
+
+        if (sh == NULL) {
+            ngx_shmtx_unlock(&pool->mutex);
+
+            ngx_log_error(NGX_LOG_WARN, cycle->log, 0,
+                          "no memory for worker_slab_cache in zone \"%V\"",
+                          &shm_zone[i].shm.name);
+            continue;
+        }
+
+        sh->pid = ngx_pid;
+        sh->nslots = nslots;
+        sh->slots = (ngx_slab_cache_slot_t *) &sh[1];
+
+        chunks = (void **) &sh->slots[nslots];
+
+        for (n = 0; n < nslots; n++) {
+            sh->slots[n].n = 0;
+            sh->slots[n].chunks = chunks + n * size;
+        }
+
+        sh->next = pool->caches;
+        pool->caches = sh;
+
+        ngx_shmtx_unlock(&pool->mutex);
+
+        cache = &ngx_slab_caches[ngx_slab_ncaches++];
+
+        cache->pool = pool;
+        cache->slots = sh->slots;
+        cache->nslots = nslots;
+        cache->sh = sh;
+    }
+
+    ngx_slab_cache_size = size;
+
+    return NGX_OK;
+}
+
+
+void
+ngx_slab_cache_flush_all(void)
+{
+    ngx_uint_t             i;
+    ngx_slab_pool_t       *pool;
+    ngx_slab_cache_sh_t  **sh;
+
+    ngx_slab_cache_size = 0;
+
+    for (i = 0; i < ngx_slab_ncaches; i++) {
+        pool = ngx_slab_caches[i].pool;
+
+        ngx_shmtx_lock(&pool->mutex);
+
+        (void) ngx_slab_cache_flush(&ngx_slab_caches[i], 1);
+
+        for (sh = (ngx_slab_cache_sh_t **) &pool->caches;
+             *sh;
+             sh = &(*sh)->next)
+        {
+            if (*sh == ngx_slab_caches[i].sh) {
+                *sh = (*sh)->next;
+                ngx_slab_free_chunk_locked(pool, ngx_slab_caches[i].sh);
+                break;
+            }
+        }
+
+        ngx_shmtx_unlock(&pool->mutex);
+    }
+
+    ngx_slab_ncaches = 0;
+}
+
+
+static void
+ngx_slab_cache_reclaim(ngx_slab_pool_t *pool)
+{
+    ngx_uint_t              n, reclaimed;
+    ngx_slab_cache_sh_t    *sh, **prev;
+    ngx_slab_cache_slot_t  *cs;
+
+    prev = (ngx_slab_cache_sh_t **) &pool->caches;
+
+    for (sh = *prev; sh; sh = *prev) {
+
+        /* the caches of the running processes are left alone */
+
+        if (sh->pid != ngx_pid
+            && (kill(sh->pid, 0) == 0 || ngx_errno != NGX_ESRCH))
+        {
+            prev = &sh->next;
+            continue;
+        }
+
+        reclaimed = 0;
+
+        for (n = 0; n < sh->nslots; n++) {
+            cs = &sh->slots[n];
+
+            while (cs->n) {
+                ngx_slab_free_chunk_locked(pool, cs->chunks[--cs->n]);
+                reclaimed++;
+            }
+        }
+
+        ngx_log_error(NGX_LOG_NOTICE, ngx_cycle->log, 0,
+                      "reclaimed %ui slab chunks cached by exited process %P%s",
+                      reclaimed, sh->pid, pool->log_ctx);
+
+        *prev = sh->next;
+
+        ngx_slab_free_chunk_locked(pool, sh);
+    }
+}
+
+
+static ngx_slab_cache_t *
+ngx_slab_cache_get(ngx_slab_pool_t *pool)
+{
+    ngx_uint_t  i;
+
+    for (i = 0; i < ngx_slab_ncaches; i++) {
+        if (ngx_slab_caches[i].pool == pool) {
+            return &ngx_slab_caches[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+static void *
+ngx_slab_cache_alloc(ngx_slab_cache_t *cache, size_t size, ngx_uint_t locked)
+{
+    void                   *p, *c;
+    size_t                  s;
+    ngx_uint_t              shift, slot, batch;
+    ngx_slab_pool_t        *pool;
+    ngx_slab_cache_slot_t  *cs;
+
+    pool = cache->pool;
+
+    if (size > pool->min_size) {
+        shift = 1;
+        for (s = size - 1; s >>= 1; shift++) { /* void */ }
+        slot = shift - pool->min_shift;
+
+    } else {
+        slot = 0;
+    }
+
+    cs = &cache->slots[slot];
+
+    if (cs->n) {
+        p = cs->chunks[--cs->n];
+
+        ngx_log_debug2(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
+                       "slab cache alloc: %uz %p", size, p);
+
+        return p;
+    }
+
+    batch = ngx_slab_cache_size / 2;
+
+    if (!locked) {
+        ngx_shmtx_lock(&pool->mutex);
+    }
+
+    /* the refill stops silently as soon as the zone is exhausted */
+
+    pool->log_nomem = 0;
+
+    p = ngx_slab_alloc_chunk_locked(pool, size);
+
+    if (p) {
+        while (cs->n < batch) {
+            c = ngx_slab_alloc_chunk_locked(pool, size);
+            if (c == NULL) {
+                break;
+            }
+
+            cs->chunks[cs->n] = c;
+            ngx_memory_barrier();
+            cs->n++;
+        }
+
+    } else if (ngx_slab_cache_flush(cache, 1)) {
+
+        /* the chunks of other size classes might be hoarded by the cache */
+
+        p = ngx_slab_alloc_chunk_locked(pool, size);
+    }
+
+    pool->log_nomem = 1;
+
+    if (p == NULL) {
+        ngx_slab_error(pool, NGX_LOG_CRIT,
+                       "ngx_slab_alloc() failed: no memory");
+    }
+
+    if (!locked) {
+        ngx_shmtx_unlock(&pool->mutex);
+    }
+
+    return p;
+}
+
+
+static ngx_int_t
+ngx_slab_cache_free(ngx_slab_cache_t *cache, void *p, ngx_uint_t locked)
+{
+    void                   *c;
+    ngx_uint_t              n, i, shift, type, batch;
+    ngx_slab_page_t        *page;
+    ngx_slab_pool_t        *pool;
+    ngx_slab_cache_slot_t  *cs;
+
+    pool = cache->pool;
+
+    if ((u_char *) p < pool->start || (u_char *) p >= pool->end) {
+        return NGX_DECLINED;
+    }
+
+    /*
+     * the page type and the chunk shift do not change while
+     * the chunk is allocated, so they are safe to read without the lock
+     */
+
+    n = ((u_char *) p - pool->start) >> ngx_pagesize_shift;
+    page = &pool->pages[n];
+    type = page->prev & NGX_SLAB_PAGE_MASK;
+
+    switch (type) {
+
+    case NGX_SLAB_SMALL:
+    case NGX_SLAB_BIG:
+        shift = page->slab & NGX_SLAB_SHIFT_MASK;
+        break;
+
+    case NGX_SLAB_EXACT:
+        shift = ngx_slab_exact_shift;
+        break;
+
+    default: /* NGX_SLAB_PAGE */
+        return NGX_DECLINED;
+    }
+
+    if ((uintptr_t) p & (((uintptr_t) 1 << shift) - 1)) {
+        return NGX_DECLINED;
+    }
+
+    cs = &cache->slots[shift - pool->min_shift];
+
+    if (cs->n == ngx_slab_cache_size) {
+
+        batch = ngx_slab_cache_size / 2;
+
+        if (batch == 0) {
+            return NGX_DECLINED;
+        }
+
+        if (!locked) {
+            ngx_shmtx_lock(&pool->mutex);
+        }
+
+        for (i = 0; i < batch; i++) {
+            c = cs->chunks[--cs->n];
+            ngx_memory_barrier();
+            ngx_slab_free_chunk_locked(pool, c);
+        }
+
+        if (!locked) {
+            ngx_shmtx_unlock(&pool->mutex);
+        }
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_ALLOC, ngx_cycle->log, 0,
+                   "slab cache free: %p", p);
+
+    cs->chunks[cs->n] = p;
+    ngx_memory_barrier();
+    cs->n++;
+
+    return NGX_OK;
+}
+
+
+static ngx_uint_t
+ngx_slab_cache_flush(ngx_slab_cache_t *cache, ngx_uint_t locked)
+{
+    void                   *p;
+    ngx_uint_t              n, flushed;
+    ngx_slab_cache_slot_t  *cs;
+
+    flushed = 0;
+
+    if (!locked) {
+        ngx_shmtx_lock(&cache->pool->mutex);
+    }
+
+    for (n = 0; n < cache->nslots; n++) {
+        cs = &cache->slots[n];
+
+        while (cs->n) {
+            p = cs->chunks[--cs->n];
+            ngx_memory_barrier();
+            ngx_slab_free_chunk_locked(cache->pool, p);
+            flushed++;
+        }
+    }
+
+    if (!locked) {
+        ngx_shmtx_unlock(&cache->pool->mutex);
+    }
+
+    return flushed;
+}
+
+
 static ngx_slab_page_t *
 ngx_slab_alloc_pages(ngx_slab_pool_t *pool, ngx_uint_t pages)
 {
@@ -642,6 +1233,8 @@ ngx_slab_alloc_pages(ngx_slab_pool_t *pool, ngx_uint_t pages)
             page->next = NULL;
             page->prev = NGX_SLAB_PAGE;
 
+            pool->pfree -= pages;
+
             if (--pages == 0) {
                 return page;
             }
@@ -657,7 +1250,12 @@ ngx_slab_alloc_pages(ngx_slab_pool_t *pool, ngx_uint_t pages)
         }
     }
 
-    ngx_slab_error(pool, NGX_LOG_CRIT, "ngx_slab_alloc() failed: no memory");
+    pool->pfails++;
+
+    if (pool->log_nomem) {
+        ngx_slab_error(pool, NGX_LOG_CRIT,
+                       "ngx_slab_alloc() failed: no memory");
+    }
 
     return NULL;
 }
@@ -669,6 +1267,8 @@ ngx_slab_free_pages(ngx_slab_pool_t *pool, ngx_slab_page_t *page,
 {
     ngx_slab_page_t  *prev;
 
+    pool->pfree += pages;
+
     page->slab = pages--;
 
     if (pages) {
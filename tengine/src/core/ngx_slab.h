@@ -22,6 +22,17 @@ struct ngx_slab_page_s {
 };
 
 
+typedef struct {
+    ngx_uint_t        total;
+    ngx_uint_t        used;
+
+    ngx_uint_t        reqs;
+    ngx_uint_t        fails;
+
+    ngx_uint_t        cached;
+} ngx_slab_stat_t;
+
+
 typedef struct {
     ngx_shmtx_sh_t    lock;
 
@@ -31,6 +42,11 @@ typedef struct {
     ngx_slab_page_t  *pages;
     ngx_slab_page_t   free;
 
+    ngx_slab_stat_t  *stats;
+    ngx_uint_t        npages;
+    ngx_uint_t        pfree;
+    ngx_uint_t        pfails;
+
     u_char           *start;
     u_char           *end;
 
@@ -39,16 +55,37 @@ typedef struct {
     u_char           *log_ctx;
     u_char            zero;
 
+    unsigned          log_nomem:1;
+
+    void             *caches;
+
     void             *data;
     void             *addr;
 } ngx_slab_pool_t;
 
 
+typedef struct {
+    ngx_uint_t        pages;
+    ngx_uint_t        free;
+    ngx_uint_t        max_free;
+    ngx_uint_t        fails;
+
+    ngx_uint_t        nslots;
+    size_t            min_size;
+    ngx_slab_stat_t  *stats;
+} ngx_slab_info_t;
+
+
 void ngx_slab_init(ngx_slab_pool_t *pool);
 void *ngx_slab_alloc(ngx_slab_pool_t *pool, size_t size);
 void *ngx_slab_alloc_locked(ngx_slab_pool_t *pool, size_t size);
 void ngx_slab_free(ngx_slab_pool_t *pool, void *p);
 void ngx_slab_free_locked(ngx_slab_pool_t *pool, void *p);
+ngx_int_t ngx_slab_stat(ngx_slab_pool_t *pool, ngx_slab_info_t *info,
+    ngx_pool_t *temp_pool);
+
+ngx_int_t ngx_slab_cache_init(ngx_cycle_t *cycle);
+void ngx_slab_cache_flush_all(void);
 
 
 #endif /* _NGX_SLAB_H_INCLUDED_ */
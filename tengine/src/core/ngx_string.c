@@ -14,6 +14,36 @@ static u_char *ngx_sprintf_num(u_char *buf, u_char *last, uint64_t ui64,
 static ngx_int_t ngx_decode_base64_internal(ngx_str_t *dst, ngx_str_t *src,
     const u_char *basis);
 
+static size_t ngx_escape_html_span(u_char *dst, u_char *src, size_t size);
+static size_t ngx_unescape_span(u_char *dst, u_char *src, size_t size,
+    ngx_uint_t type);
+
+#if (NGX_HAVE_SSE42_INTRINSICS)
+
+#include <nmmintrin.h>
+
+/*
+ * The SSE4.2 versions process 16 byte blocks, they are used if the CPU
+ * supports SSE4.2 and yield the same results as the bytewise code.
+ */
+
+#define NGX_STRING_BLOCK  16
+
+static u_char *ngx_strlcasestrn_sse42(u_char *s1, u_char *last, u_char *s2,
+    size_t n);
+static u_char *ngx_hex_dump_sse42(u_char *dst, u_char *src, size_t len);
+static u_char *ngx_escape_lut(uint32_t *escape);
+static size_t ngx_escape_span_sse42(u_char *dst, u_char *src, size_t size,
+    u_char *lut);
+static ngx_uint_t ngx_escape_count_sse42(u_char *src, size_t size,
+    u_char *lut);
+static size_t ngx_escape_html_span_sse42(u_char *dst, u_char *src,
+    size_t size);
+static size_t ngx_unescape_span_sse42(u_char *dst, u_char *src, size_t size,
+    ngx_uint_t type);
+
+#endif
+
 
 void
 ngx_strlow(u_char *dst, u_char *src, size_t n)
@@ -716,6 +746,16 @@ ngx_strlcasestrn(u_char *s1, u_char *last, u_char *s2, size_t n)
 {
     ngx_uint_t  c1, c2;
 
+#if (NGX_HAVE_SSE42_INTRINSICS)
+
+    if (last - s1 >= (ssize_t) (NGX_STRING_BLOCK + n)
+        && (ngx_cpu_features & NGX_CPU_SSE42))
+    {
+        return ngx_strlcasestrn_sse42(s1, last, s2, n);
+    }
+
+#endif
+
     c2 = (ngx_uint_t) *s2++;
     c2 = (c2 >= 'A' && c2 <= 'Z') ? (c2 | 0x20) : c2;
     last -= n;
@@ -1074,6 +1114,17 @@ ngx_hex_dump(u_char *dst, u_char *src, size_t len)
 {
     static u_char  hex[] = "0123456789abcdef";
 
+#if (NGX_HAVE_SSE42_INTRINSICS)
+
+    if (len >= NGX_STRING_BLOCK && (ngx_cpu_features & NGX_CPU_SSE42)) {
+        dst = ngx_hex_dump_sse42(dst, src, len);
+
+        src += len & ~(NGX_STRING_BLOCK - 1);
+        len &= NGX_STRING_BLOCK - 1;
+    }
+
+#endif
+
     while (len--) {
         *dst++ = hex[*src >> 4];
         *dst++ = hex[*src++ & 0xf];
@@ -1363,10 +1414,383 @@ ngx_utf8_cpystrn(u_char *dst, u_char *src, size_t n, size_t len)
 }
 
 
+/*
+ * ngx_escape_span() copies to dst, if it is not NULL, the longest prefix
+ * of src, which contains no characters to be escaped according to the
+ * escape table, and returns its length.  It checks 16 bytes at a time,
+ * so it may return 0 for short data or without SSE4.2, and it may write
+ * up to 16 bytes beyond the copied prefix, i.e. dst must have room
+ * for size bytes.  Callers escape bytewise NGX_ESCAPE_BLOCK bytes after
+ * the span before the next call.
+ */
+
+size_t
+ngx_escape_span(u_char *dst, u_char *src, size_t size, uint32_t *escape)
+{
+#if (NGX_HAVE_SSE42_INTRINSICS)
+
+    u_char  *lut;
+
+    if (size >= NGX_STRING_BLOCK && (ngx_cpu_features & NGX_CPU_SSE42)) {
+        lut = ngx_escape_lut(escape);
+
+        if (lut) {
+            return ngx_escape_span_sse42(dst, src, size, lut);
+        }
+    }
+
+#endif
+
+    return 0;
+}
+
+
+ngx_uint_t
+ngx_escape_count(u_char *src, size_t size, uint32_t *escape)
+{
+    ngx_uint_t  n;
+#if (NGX_HAVE_SSE42_INTRINSICS)
+    u_char     *lut;
+#endif
+
+    n = 0;
+
+#if (NGX_HAVE_SSE42_INTRINSICS)
+
+    if (size >= NGX_STRING_BLOCK && (ngx_cpu_features & NGX_CPU_SSE42)) {
+        lut = ngx_escape_lut(escape);
+
+        if (lut) {
+            n = ngx_escape_count_sse42(src, size, lut);
+
+            src += size & ~(NGX_STRING_BLOCK - 1);
+            size &= NGX_STRING_BLOCK - 1;
+        }
+    }
+
+#endif
+
+    while (size) {
+        if (escape[*src >> 5] & (1 << (*src & 0x1f))) {
+            n++;
+        }
+        src++;
+        size--;
+    }
+
+    return n;
+}
+
+
+static size_t
+ngx_escape_html_span(u_char *dst, u_char *src, size_t size)
+{
+#if (NGX_HAVE_SSE42_INTRINSICS)
+
+    if (size >= NGX_STRING_BLOCK && (ngx_cpu_features & NGX_CPU_SSE42)) {
+        return ngx_escape_html_span_sse42(dst, src, size);
+    }
+
+#endif
+
+    return 0;
+}
+
+
+static size_t
+ngx_unescape_span(u_char *dst, u_char *src, size_t size, ngx_uint_t type)
+{
+#if (NGX_HAVE_SSE42_INTRINSICS)
+
+    if (size >= NGX_STRING_BLOCK && (ngx_cpu_features & NGX_CPU_SSE42)) {
+        return ngx_unescape_span_sse42(dst, src, size, type);
+    }
+
+#endif
+
+    return 0;
+}
+
+
+#if (NGX_HAVE_SSE42_INTRINSICS)
+
+/*
+ * The escape tables are converted to the form suitable for the PSHUFB
+ * lookup: the bit (c >> 4) & 7 of the byte lut[(c >> 7) * 16 + (c & 0xf)]
+ * is set if the character c is to be escaped.  The converted tables
+ * are cached by the address of the escape table.
+ */
+
+#define NGX_ESCAPE_LUTS  16
+
+static u_char *
+ngx_escape_lut(uint32_t *escape)
+{
+    ngx_uint_t  i, c;
+
+    static ngx_uint_t  nluts;
+    static struct {
+        uint32_t      *escape;
+        u_char         lut[32];
+    } luts[NGX_ESCAPE_LUTS];
+
+    for (i = 0; i < nluts; i++) {
+        if (luts[i].escape == escape) {
+            return luts[i].lut;
+        }
+    }
+
+    if (nluts == NGX_ESCAPE_LUTS) {
+        return NULL;
+    }
+
+    for (c = 0; c < 256; c++) {
+        if (escape[c >> 5] & (1 << (c & 0x1f))) {
+            luts[i].lut[(c >> 7) * 16 + (c & 0xf)] |= 1 << ((c >> 4) & 7);
+        }
+    }
+
+    luts[i].escape = escape;
+    nluts++;
+
+    return luts[i].lut;
+}
+
+
+__attribute__((target("sse4.2")))
+static ngx_inline int
+ngx_escape_mask(__m128i x, __m128i lo, __m128i hi)
+{
+    __m128i  nibble, row, bit;
+
+    nibble = _mm_and_si128(_mm_srli_epi16(x, 4), _mm_set1_epi8(0x0f));
+
+    row = _mm_blendv_epi8(
+              _mm_shuffle_epi8(lo, _mm_and_si128(x, _mm_set1_epi8(0x0f))),
+              _mm_shuffle_epi8(hi, _mm_and_si128(x, _mm_set1_epi8(0x0f))),
+              x);
+
+    bit = _mm_shuffle_epi8(_mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                         1, 2, 4, 8, 16, 32, 64, -128),
+                           nibble);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(row, bit), bit));
+}
+
+
+__attribute__((target("sse4.2")))
+static size_t
+ngx_escape_span_sse42(u_char *dst, u_char *src, size_t size, u_char *lut)
+{
+    int       m;
+    u_char   *p;
+    __m128i   x, lo, hi;
+
+    lo = _mm_loadu_si128((__m128i *) lut);
+    hi = _mm_loadu_si128((__m128i *) (lut + 16));
+
+    for (p = src; size >= NGX_STRING_BLOCK; size -= NGX_STRING_BLOCK) {
+        x = _mm_loadu_si128((__m128i *) p);
+
+        if (dst) {
+            _mm_storeu_si128((__m128i *) dst, x);
+            dst += NGX_STRING_BLOCK;
+        }
+
+        m = ngx_escape_mask(x, lo, hi);
+
+        if (m) {
+            return p - src + __builtin_ctz(m);
+        }
+
+        p += NGX_STRING_BLOCK;
+    }
+
+    return p - src;
+}
+
+
+__attribute__((target("sse4.2")))
+static ngx_uint_t
+ngx_escape_count_sse42(u_char *src, size_t size, u_char *lut)
+{
+    ngx_uint_t  n;
+    __m128i     lo, hi;
+
+    lo = _mm_loadu_si128((__m128i *) lut);
+    hi = _mm_loadu_si128((__m128i *) (lut + 16));
+
+    n = 0;
+
+    for ( /* void */ ; size >= NGX_STRING_BLOCK; size -= NGX_STRING_BLOCK) {
+        n += __builtin_popcount(
+                 ngx_escape_mask(_mm_loadu_si128((__m128i *) src), lo, hi));
+        src += NGX_STRING_BLOCK;
+    }
+
+    return n;
+}
+
+
+__attribute__((target("sse4.2")))
+static size_t
+ngx_escape_html_span_sse42(u_char *dst, u_char *src, size_t size)
+{
+    int       m;
+    u_char   *p;
+    __m128i   x;
+
+    for (p = src; size >= NGX_STRING_BLOCK; size -= NGX_STRING_BLOCK) {
+        x = _mm_loadu_si128((__m128i *) p);
+
+        if (dst) {
+            _mm_storeu_si128((__m128i *) dst, x);
+            dst += NGX_STRING_BLOCK;
+        }
+
+        m = _mm_movemask_epi8(
+                _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('<')),
+                                 _mm_cmpeq_epi8(x, _mm_set1_epi8('>'))),
+                    _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('&')),
+                                 _mm_cmpeq_epi8(x, _mm_set1_epi8('"')))));
+
+        if (m) {
+            return p - src + __builtin_ctz(m);
+        }
+
+        p += NGX_STRING_BLOCK;
+    }
+
+    return p - src;
+}
+
+
+__attribute__((target("sse4.2")))
+static size_t
+ngx_unescape_span_sse42(u_char *dst, u_char *src, size_t size,
+    ngx_uint_t type)
+{
+    int       m;
+    u_char   *p;
+    __m128i   x, plus, question;
+
+    /* "%" is always looked for, "+" and "?" depending on the type */
+
+    plus = _mm_set1_epi8((type & NGX_UNESCAPE_WWW_FORM) ? '+' : '%');
+    question = _mm_set1_epi8((type & (NGX_UNESCAPE_URI|NGX_UNESCAPE_REDIRECT))
+                             ? '?' : '%');
+
+    for (p = src; size >= NGX_STRING_BLOCK; size -= NGX_STRING_BLOCK) {
+        x = _mm_loadu_si128((__m128i *) p);
+
+        m = _mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('%')),
+                             _mm_or_si128(_mm_cmpeq_epi8(x, plus),
+                                          _mm_cmpeq_epi8(x, question))));
+
+        /*
+         * unescaping is often done in place, so the whole block is stored
+         * only if it has been entirely read, and the rest is copied forward
+         */
+
+        if (m) {
+            for (m = __builtin_ctz(m); m; m--) {
+                *dst++ = *p++;
+            }
+
+            return p - src;
+        }
+
+        _mm_storeu_si128((__m128i *) dst, x);
+
+        dst += NGX_STRING_BLOCK;
+        p += NGX_STRING_BLOCK;
+    }
+
+    return p - src;
+}
+
+
+__attribute__((target("sse4.2")))
+static u_char *
+ngx_strlcasestrn_sse42(u_char *s1, u_char *last, u_char *s2, size_t n)
+{
+    int       m;
+    u_char    c1, c2;
+    __m128i   x, lc, uc;
+
+    c2 = *s2++;
+    c2 = (c2 >= 'A' && c2 <= 'Z') ? (c2 | 0x20) : c2;
+
+    lc = _mm_set1_epi8((char) c2);
+    uc = _mm_set1_epi8((char) ((c2 >= 'a' && c2 <= 'z') ? (c2 & ~0x20) : c2));
+
+    last -= n;
+
+    while (last - s1 >= NGX_STRING_BLOCK) {
+        x = _mm_loadu_si128((__m128i *) s1);
+
+        m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, lc),
+                                           _mm_cmpeq_epi8(x, uc)));
+
+        while (m) {
+            if (ngx_strncasecmp(s1 + __builtin_ctz(m) + 1, s2, n) == 0) {
+                return s1 + __builtin_ctz(m);
+            }
+
+            m &= m - 1;
+        }
+
+        s1 += NGX_STRING_BLOCK;
+    }
+
+    for ( /* void */ ; s1 < last; s1++) {
+        c1 = *s1;
+        c1 = (c1 >= 'A' && c1 <= 'Z') ? (c1 | 0x20) : c1;
+
+        if (c1 == c2 && ngx_strncasecmp(s1 + 1, s2, n) == 0) {
+            return s1;
+        }
+    }
+
+    return NULL;
+}
+
+
+__attribute__((target("sse4.2")))
+static u_char *
+ngx_hex_dump_sse42(u_char *dst, u_char *src, size_t len)
+{
+    __m128i  x, hex, hi, lo, mask;
+
+    hex = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                        '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    mask = _mm_set1_epi8(0x0f);
+
+    for ( /* void */ ; len >= NGX_STRING_BLOCK; len -= NGX_STRING_BLOCK) {
+        x = _mm_loadu_si128((__m128i *) src);
+
+        hi = _mm_shuffle_epi8(hex, _mm_and_si128(_mm_srli_epi16(x, 4), mask));
+        lo = _mm_shuffle_epi8(hex, _mm_and_si128(x, mask));
+
+        _mm_storeu_si128((__m128i *) dst, _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *) (dst + 16), _mm_unpackhi_epi8(hi, lo));
+
+        src += NGX_STRING_BLOCK;
+        dst += 2 * NGX_STRING_BLOCK;
+    }
+
+    return dst;
+}
+
+#endif
+
+
 uintptr_t
 ngx_escape_uri(u_char *dst, u_char *src, size_t size, ngx_uint_t type)
 {
-    ngx_uint_t      n;
+    size_t          n, k;
     uint32_t       *escape;
     static u_char   hex[] = "0123456789abcdef";
 
@@ -1522,20 +1946,34 @@ ngx_escape_uri(u_char *dst, u_char *src, size_t size, ngx_uint_t type)
 
         /* find the number of the characters to be escaped */
 
-        n = 0;
+        return (uintptr_t) ngx_escape_count(src, size, escape);
+    }
 
-        while (size) {
-            if (escape[*src >> 5] & (1 << (*src & 0x1f))) {
-                n++;
+    /*
+     * the bytes which need no escaping are copied in spans, and the rest
+     * of a block is handled bytewise before the next span is looked for
+     */
+
+    k = (type == NGX_ESCAPE_WWW_FORM) ? size : 0;
+
+    while (size) {
+
+        if (k == 0) {
+            n = ngx_escape_span(dst, src, size, escape);
+
+            dst += n;
+            src += n;
+            size -= n;
+
+            if (size == 0) {
+                break;
             }
-            src++;
-            size--;
+
+            k = NGX_ESCAPE_BLOCK;
         }
 
-        return (uintptr_t) n;
-    }
+        k--;
 
-    while (size) {
         if (escape[*src >> 5] & (1 << (*src & 0x1f))) {
             *dst++ = '%';
             *dst++ = hex[*src >> 4];
@@ -1563,6 +2001,7 @@ void
 ngx_unescape_uri(u_char **dst, u_char **src, size_t size, ngx_uint_t type)
 {
     u_char  *d, *s, ch, c, decoded;
+    size_t   n, k;
     enum {
         sw_usual = 0,
         sw_quoted,
@@ -1575,7 +2014,30 @@ ngx_unescape_uri(u_char **dst, u_char **src, size_t size, ngx_uint_t type)
     state = 0;
     decoded = 0;
 
-    while (size--) {
+    k = 0;
+
+    while (size) {
+
+        if (state == sw_usual) {
+
+            if (k == 0) {
+                n = ngx_unescape_span(d, s, size, type);
+
+                d += n;
+                s += n;
+                size -= n;
+
+                if (size == 0) {
+                    break;
+                }
+
+                k = NGX_ESCAPE_BLOCK;
+            }
+
+            k--;
+        }
+
+        size--;
 
         ch = *s++;
 
@@ -1700,13 +2162,32 @@ uintptr_t
 ngx_escape_html(u_char *dst, u_char *src, size_t size)
 {
     u_char      ch;
+    size_t      n, k;
     ngx_uint_t  len;
 
+    k = 0;
+
     if (dst == NULL) {
 
         len = 0;
 
         while (size) {
+
+            if (k == 0) {
+                n = ngx_escape_html_span(NULL, src, size);
+
+                src += n;
+                size -= n;
+
+                if (size == 0) {
+                    break;
+                }
+
+                k = NGX_ESCAPE_BLOCK;
+            }
+
+            k--;
+
             switch (*src++) {
 
             case '<':
@@ -1735,6 +2216,23 @@ ngx_escape_html(u_char *dst, u_char *src, size_t size)
     }
 
     while (size) {
+
+        if (k == 0) {
+            n = ngx_escape_html_span(dst, src, size);
+
+            dst += n;
+            src += n;
+            size -= n;
+
+            if (size == 0) {
+                break;
+            }
+
+            k = NGX_ESCAPE_BLOCK;
+        }
+
+        k--;
+
         ch = *src++;
 
         switch (ch) {
@@ -204,8 +204,13 @@ u_char *ngx_utf8_cpystrn(u_char *dst, u_char *src, size_t n, size_t len);
 #define NGX_UNESCAPE_REDIRECT  2
 #define NGX_UNESCAPE_WWW_FORM  4
 
+#define NGX_ESCAPE_BLOCK       16
+
 uintptr_t ngx_escape_uri(u_char *dst, u_char *src, size_t size,
     ngx_uint_t type);
+size_t ngx_escape_span(u_char *dst, u_char *src, size_t size,
+    uint32_t *escape);
+ngx_uint_t ngx_escape_count(u_char *src, size_t size, uint32_t *escape);
 void ngx_unescape_uri(u_char **dst, u_char **src, size_t size, ngx_uint_t type);
 uintptr_t ngx_escape_html(u_char *dst, u_char *src, size_t size);
 
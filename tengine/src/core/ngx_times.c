@@ -11,18 +11,25 @@
 
 /*
  * The time may be updated by signal handler or by several threads.
- * The time update operations are rare and require to hold the ngx_time_lock.
+ * The time update operations are rare and are serialized by the ngx_time_seq
+ * sequence counter, which is odd while an update is in progress: an updater
+ * that finds it odd or fails to increment it just skips the update.
  * The time read operations are frequent, so they are lock-free and get time
  * values and strings from the current slot.  Thus thread may get the corrupted
  * values only if it is preempted while copying and then it is not scheduled
- * to run more than NGX_TIME_SLOTS seconds.
+ * to run more than NGX_TIME_SLOTS seconds.  The milliseconds are updated
+ * in place within a second, ngx_time_snapshot() uses the sequence counter
+ * to get consistent values.
  */
 
 #define NGX_TIME_SLOTS   64
 
 static ngx_uint_t        slot;
-static ngx_atomic_t      ngx_time_lock;
+static ngx_atomic_t      ngx_time_seq;
 
+static ngx_msec_t ngx_monotonic_time(time_t sec, ngx_uint_t msec);
+
+ngx_uint_t               ngx_time_source;
 volatile ngx_msec_t      ngx_current_msec;
 volatile ngx_time_t     *ngx_cached_time;
 volatile ngx_str_t       ngx_cached_err_log_time;
@@ -92,34 +99,57 @@ ngx_time_init(void)
 void
 ngx_time_update(void)
 {
-    u_char          *p0, *p1, *p2, *p3;
+    u_char             *p0, *p1, *p2, *p3;
 #if (NGX_SYSLOG)
-    u_char          *p4;
+    u_char             *p4;
+#endif
+    ngx_tm_t            tm, gmt;
+    time_t              sec;
+    ngx_uint_t          msec, usec;
+    ngx_time_t         *tp;
+    ngx_atomic_uint_t   seq;
+    struct timeval      tv;
+#if (NGX_HAVE_CLOCK_COARSE)
+    struct timespec     ts;
 #endif
-    ngx_tm_t         tm, gmt;
-    time_t           sec;
-    ngx_uint_t       msec, usec;
-    ngx_time_t      *tp;
-    struct timeval   tv;
 
-    if (!ngx_trylock(&ngx_time_lock)) {
+    seq = ngx_time_seq;
+
+    if ((seq & 1) || !ngx_atomic_cmp_set(&ngx_time_seq, seq, seq + 1)) {
         return;
     }
 
-    ngx_gettimeofday(&tv);
+#if (NGX_HAVE_CLOCK_COARSE)
 
-    sec = tv.tv_sec;
-    msec = tv.tv_usec / 1000;
-    usec = tv.tv_usec % 1000;
+    if (ngx_time_source == NGX_TIME_SOURCE_COARSE) {
+        (void) clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+
+        sec = ts.tv_sec;
+        msec = ts.tv_nsec / 1000000;
+        usec = ts.tv_nsec / 1000 % 1000;
 
-    ngx_current_msec = (ngx_msec_t) sec * 1000 + msec;
+    } else
+
+#endif
+    {
+        ngx_gettimeofday(&tv);
+
+        sec = tv.tv_sec;
+        msec = tv.tv_usec / 1000;
+        usec = tv.tv_usec % 1000;
+    }
+
+    ngx_current_msec = ngx_monotonic_time(sec, msec);
 
     tp = &cached_time[slot];
 
     if (tp->sec == sec) {
         tp->msec = msec;
         tp->usec = usec;
-        ngx_unlock(&ngx_time_lock);
+
+        ngx_memory_barrier();
+
+        ngx_time_seq = seq + 2;
         return;
     }
 
@@ -214,7 +244,67 @@ ngx_time_update(void)
     ngx_cached_syslog_time.data = p4;
 #endif
 
-    ngx_unlock(&ngx_time_lock);
+    ngx_memory_barrier();
+
+    ngx_time_seq = seq + 2;
+}
+
+
+/*
+ * the monotonic clock is not affected by the system time changes,
+ * the wall clock is used if it is not available
+ */
+
+static ngx_msec_t
+ngx_monotonic_time(time_t sec, ngx_uint_t msec)
+{
+#if (NGX_HAVE_CLOCK_MONOTONIC)
+    struct timespec  ts;
+
+#if (NGX_HAVE_CLOCK_COARSE)
+
+    if (ngx_time_source == NGX_TIME_SOURCE_COARSE) {
+        (void) clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+    } else {
+        (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    }
+
+#else
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+#endif
+
+    sec = ts.tv_sec;
+    msec = ts.tv_nsec / 1000000;
+
+#endif
+
+    return (ngx_msec_t) sec * 1000 + msec;
+}
+
+
+void
+ngx_time_snapshot(ngx_time_t *tp)
+{
+    ngx_atomic_uint_t  seq;
+
+    for ( ;; ) {
+        seq = ngx_time_seq;
+
+        ngx_read_barrier();
+
+        *tp = *ngx_timeofday();
+
+        ngx_read_barrier();
+
+        if (!(seq & 1) && seq == ngx_time_seq) {
+            return;
+        }
+
+        ngx_cpu_pause();
+    }
 }
 
 
@@ -223,13 +313,16 @@ ngx_time_update(void)
 void
 ngx_time_sigsafe_update(void)
 {
-    u_char          *p;
-    ngx_tm_t         tm;
-    time_t           sec;
-    ngx_time_t      *tp;
-    struct timeval   tv;
+    u_char             *p;
+    ngx_tm_t            tm;
+    time_t              sec;
+    ngx_time_t         *tp;
+    ngx_atomic_uint_t   seq;
+    struct timeval      tv;
 
-    if (!ngx_trylock(&ngx_time_lock)) {
+    seq = ngx_time_seq;
+
+    if ((seq & 1) || !ngx_atomic_cmp_set(&ngx_time_seq, seq, seq + 1)) {
         return;
     }
 
@@ -240,7 +333,7 @@ ngx_time_sigsafe_update(void)
     tp = &cached_time[slot];
 
     if (tp->sec == sec) {
-        ngx_unlock(&ngx_time_lock);
+        ngx_time_seq = seq + 2;
         return;
     }
 
@@ -263,7 +356,9 @@ ngx_time_sigsafe_update(void)
 
     ngx_cached_err_log_time.data = p;
 
-    ngx_unlock(&ngx_time_lock);
+    ngx_memory_barrier();
+
+    ngx_time_seq = seq + 2;
 }
 
 #endif
@@ -13,6 +13,10 @@
 #include <ngx_core.h>
 
 
+#define NGX_TIME_SOURCE_PRECISE  0
+#define NGX_TIME_SOURCE_COARSE   1
+
+
 typedef struct {
     time_t      sec;
     ngx_uint_t  msec;
@@ -24,6 +28,7 @@ typedef struct {
 void ngx_time_init(void);
 void ngx_time_update(void);
 void ngx_time_sigsafe_update(void);
+void ngx_time_snapshot(ngx_time_t *tp);
 u_char *ngx_http_time(u_char *buf, time_t t);
 u_char *ngx_http_cookie_time(u_char *buf, time_t t);
 void ngx_gmtime(time_t t, ngx_tm_t *tp);
@@ -45,9 +50,11 @@ extern volatile ngx_str_t    ngx_cached_http_log_iso8601;
 extern volatile ngx_str_t    ngx_cached_syslog_time;
 #endif
 
+extern ngx_uint_t           ngx_time_source;
+
 /*
- * milliseconds elapsed since epoch and truncated to ngx_msec_t,
- * used in event timers
+ * milliseconds of the monotonic clock if it is available, or elapsed since
+ * epoch otherwise, truncated to ngx_msec_t, used in event timers
  */
 extern volatile ngx_msec_t  ngx_current_msec;
 
@@ -8,8 +8,8 @@
 #include <ngx_core.h>
 
 
-#define NGX_TRIE_MAX_QUEUE_SIZE     300
-#define NGX_TRIE_KIND               256
+static ngx_trie_node_t *ngx_trie_child(ngx_trie_node_t *node, u_char ch);
+static ngx_int_t ngx_trie_compile(ngx_trie_t *trie, ngx_array_t *nodes);
 
 
 ngx_trie_t *
@@ -17,7 +17,7 @@ ngx_trie_create(ngx_pool_t *pool)
 {
     ngx_trie_t *trie;
 
-    trie = ngx_palloc(pool, sizeof(ngx_trie_t));
+    trie = ngx_pcalloc(pool, sizeof(ngx_trie_t));
     if (trie == NULL) {
         return NULL;
     }
@@ -54,10 +54,9 @@ ngx_trie_node_t *
 ngx_trie_insert(ngx_trie_t *trie, ngx_str_t *str, ngx_uint_t mode)
 {
     size_t           i;
-    ngx_int_t        pos, step, index;
-    ngx_trie_node_t *p, *root;
+    ngx_int_t        pos, step;
+    ngx_trie_node_t *p, *next;
 
-    root = trie->root;
     i = 0;
 
     if (mode & NGX_TRIE_REVERSE) {
@@ -68,30 +67,25 @@ ngx_trie_insert(ngx_trie_t *trie, ngx_str_t *str, ngx_uint_t mode)
         step = 1;
     }
 
-    p = root;
+    p = trie->root;
 
     while (i < str->len) {
         pos = pos + step;
-        index = str->data[pos];
-
-        if (index < 0 || index >= NGX_TRIE_KIND) {
-            continue;
-        }
 
-        if (p->next == NULL) {
-            p->next = ngx_pcalloc(trie->pool,
-                                  NGX_TRIE_KIND * sizeof(ngx_trie_node_t *));
+        next = ngx_trie_child(p, str->data[pos]);
 
-            if (p->next == NULL) {
+        if (next == NULL) {
+            next = ngx_trie_node_create(trie->pool);
+            if (next == NULL) {
                 return NULL;
             }
-        }
 
-        if (p->next[index] == NULL) {
-            p->next[index] = ngx_trie_node_create(trie->pool);
+            next->ch = str->data[pos];
+            next->sibling = p->child;
+            p->child = next;
         }
 
-        p = p->next[index];
+        p = next;
         i++;
     }
 
@@ -104,57 +98,144 @@ ngx_trie_insert(ngx_trie_t *trie, ngx_str_t *str, ngx_uint_t mode)
 }
 
 
+static ngx_trie_node_t *
+ngx_trie_child(ngx_trie_node_t *node, u_char ch)
+{
+    ngx_trie_node_t  *p;
+
+    for (p = node->child; p; p = p->sibling) {
+        if (p->ch == ch) {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+
 ngx_int_t
 ngx_trie_build_clue(ngx_trie_t *trie)
 {
-    ngx_int_t        i, head, tail;
-    ngx_trie_node_t *q[NGX_TRIE_MAX_QUEUE_SIZE], *p, *t, *root;
+    ngx_uint_t        i;
+    ngx_array_t       nodes;
+    ngx_trie_node_t  *p, *t, *c, *next, *root, **n;
+
+    /* the nodes array is the breadth-first traversal queue */
+
+    if (ngx_array_init(&nodes, trie->pool, 64, sizeof(ngx_trie_node_t *))
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
 
-    head = tail = 0;
     root = trie->root;
-    q[head++] = root;
     root->search_clue = NULL;
+    root->state = 0;
 
-    while (head != tail) {
-        t = q[tail++];
-        tail %= NGX_TRIE_MAX_QUEUE_SIZE;
+    n = ngx_array_push(&nodes);
+    if (n == NULL) {
+        return NGX_ERROR;
+    }
 
-        if (t->next == NULL) {
-            continue;
-        }
+    *n = root;
 
-        p = NULL;
+    for (i = 0; i < nodes.nelts; i++) {
+        t = ((ngx_trie_node_t **) nodes.elts)[i];
 
-        for (i = 0; i< NGX_TRIE_KIND; i++) {
-            if (t->next[i] == NULL) {
-                continue;
-            }
+        for (c = t->child; c; c = c->sibling) {
 
-            if (t == root) {
-                t->next[i]->search_clue = root;
+            c->search_clue = root;
 
-                q[head++] = t->next[i];
-                head %= NGX_TRIE_MAX_QUEUE_SIZE;
+            if (t != root) {
+                for (p = t->search_clue; p; p = p->search_clue) {
+                    next = ngx_trie_child(p, c->ch);
 
-                continue;
+                    if (next) {
+                        c->search_clue = next;
+                        break;
+                    }
+                }
             }
 
-            p = t->search_clue;
+            c->state = nodes.nelts;
 
-            while (p != NULL) {
-                if (p->next !=NULL && p->next[i] != NULL) {
-                    t->next[i]->search_clue = p->next[i];
-                    break;
-                }
-                p = p->search_clue;
+            n = ngx_array_push(&nodes);
+            if (n == NULL) {
+                return NGX_ERROR;
             }
 
-            if (p == NULL) {
-                t->next[i]->search_clue = root;
-            }
+            *n = c;
+        }
+    }
+
+    return ngx_trie_compile(trie, &nodes);
+}
+
+
+static ngx_int_t
+ngx_trie_compile(ngx_trie_t *trie, ngx_array_t *nodes)
+{
+    uint32_t          *row;
+    ngx_uint_t         i, nclasses;
+    ngx_trie_node_t   *t, *c, **node;
+
+    node = nodes->elts;
+
+    ngx_memzero(trie->classes, sizeof(trie->classes));
 
-            q[head++] = t->next[i];
-            head %= NGX_TRIE_MAX_QUEUE_SIZE;
+    /* the class 0 is of the bytes not found in the trie */
+
+    nclasses = 1;
+
+    for (i = 1; i < nodes->nelts; i++) {
+        if (trie->classes[node[i]->ch] == 0) {
+            trie->classes[node[i]->ch] = (uint16_t) nclasses++;
+        }
+    }
+
+    if (nodes->nelts * nclasses >= NGX_TRIE_MATCH) {
+        ngx_log_error(NGX_LOG_EMERG, ngx_cycle->log, 0, "trie is too large");
+        return NGX_ERROR;
+    }
+
+    trie->states = ngx_palloc(trie->pool,
+                              nodes->nelts * nclasses * sizeof(uint32_t));
+    if (trie->states == NULL) {
+        return NGX_ERROR;
+    }
+
+    trie->matches = ngx_palloc(trie->pool,
+                               nodes->nelts * sizeof(ngx_trie_node_t *));
+    if (trie->matches == NULL) {
+        return NGX_ERROR;
+    }
+
+    trie->nstates = nodes->nelts;
+    trie->nclasses = nclasses;
+
+    /*
+     * a missing transition of a state is the transition of its search clue,
+     * which precedes the state in the breadth-first order; the transitions
+     * are stored as the offsets of the rows of the target states
+     */
+
+    for (i = 0; i < nodes->nelts; i++) {
+        t = node[i];
+        row = trie->states + i * nclasses;
+
+        trie->matches[i] = t;
+
+        if (t->search_clue == NULL) {
+            ngx_memzero(row, nclasses * sizeof(uint32_t));
+
+        } else {
+            ngx_memcpy(row, trie->states + t->search_clue->state * nclasses,
+                       nclasses * sizeof(uint32_t));
+        }
+
+        for (c = t->child; c; c = c->sibling) {
+            row[trie->classes[c->ch]] = (uint32_t) (c->state * nclasses)
+                                        | (c->key ? NGX_TRIE_MATCH : 0);
         }
     }
 
@@ -168,12 +249,16 @@ ngx_trie_query(ngx_trie_t *trie, ngx_str_t *str, ngx_int_t *version_pos,
 {
     void            *value;
     size_t           i;
-    ngx_int_t        step, pos, index;
-    ngx_trie_node_t *p, *root;
+    uint32_t         next, state;
+    ngx_int_t        step, pos;
+    ngx_trie_node_t *p;
+
+    if (trie->states == NULL) {
+        return NULL;
+    }
 
     value = NULL;
-    root = trie->root;
-    p = root;
+    state = 0;
     i = 0;
 
     if (mode & NGX_TRIE_REVERSE) {
@@ -184,33 +269,21 @@ ngx_trie_query(ngx_trie_t *trie, ngx_str_t *str, ngx_int_t *version_pos,
         step = 1;
     }
 
-    if (p->next == NULL) {
-        return NULL;
-    }
-
     while (i < str->len) {
         pos += step;
-        index = str->data[pos];
-        if (index < 0 || index >= NGX_TRIE_KIND) {
-            index = 0;
-        }
 
-        while (p->next[index] == NULL) {
-            if (p == root) {
-                break;
-            }
-            p = p->search_clue;
-        }
+        next = trie->states[state + trie->classes[str->data[pos]]];
+        state = next & ~NGX_TRIE_MATCH;
+
+        if (next & NGX_TRIE_MATCH) {
+            p = trie->matches[state / trie->nclasses];
 
-        p = p->next[index];
-        p = p == NULL ? root : p;
-        if (p->key) {
             value = p->value;
             *version_pos = pos + p->key;
             if (!p->greedy) {
                 return value;
             }
-            p = root;
+            state = 0;
         }
 
         i++;
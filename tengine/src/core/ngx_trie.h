@@ -29,19 +29,39 @@ typedef void *(*ngx_trie_query_pt)(ngx_trie_t *trie,
 struct ngx_trie_node_s {
     void                           *value;
     ngx_trie_node_t                *search_clue;
-    ngx_trie_node_t               **next;
+    ngx_trie_node_t                *child;
+    ngx_trie_node_t                *sibling;
+    ngx_uint_t                      state;
 
     unsigned                        key:31;
     unsigned                        greedy:1;
+    u_char                          ch;
 };
 
 
+/*
+ * ngx_trie_build_clue() compiles the trie into the automaton: the states
+ * are numbered in breadth-first order, the bytes are mapped to classes
+ * of bytes which are not distinguished by the trie, and the transitions
+ * of a state for all classes are stored contiguously, the state with
+ * the NGX_TRIE_MATCH bit set is the terminal one.
+ */
+
+#define NGX_TRIE_MATCH              0x80000000
+
+
 struct ngx_trie_s {
     ngx_trie_node_t                *root;
     ngx_pool_t                     *pool;
     ngx_trie_insert_pt              insert;
     ngx_trie_query_pt               query;
     ngx_trie_build_clue_pt          build_clue;
+
+    ngx_uint_t                      nstates;
+    ngx_uint_t                      nclasses;
+    uint32_t                       *states;
+    ngx_trie_node_t               **matches;
+    uint16_t                        classes[256];
 };
 
 
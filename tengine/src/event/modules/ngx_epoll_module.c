@@ -91,10 +91,20 @@ struct io_event {
 
 typedef struct {
     ngx_uint_t  events;
+    ngx_uint_t  events_max;
+    ngx_uint_t  busy_poll;
     ngx_uint_t  aio_requests;
 } ngx_epoll_conf_t;
 
 
+/*
+ * the batch is halved after so many wakeups in a row
+ * that used less than a quarter of it
+ */
+
+#define NGX_EPOLL_SHRINK_WAKEUPS  16
+
+
 static ngx_int_t ngx_epoll_init(ngx_cycle_t *cycle, ngx_msec_t timer);
 static void ngx_epoll_done(ngx_cycle_t *cycle);
 static ngx_int_t ngx_epoll_add_event(ngx_event_t *ev, ngx_int_t event,
@@ -107,16 +117,39 @@ static ngx_int_t ngx_epoll_del_connection(ngx_connection_t *c,
 static ngx_int_t ngx_epoll_process_events(ngx_cycle_t *cycle, ngx_msec_t timer,
     ngx_uint_t flags);
 
+#if (NGX_HAVE_SYS_EVENTFD_H)
+static ngx_int_t ngx_epoll_notify_init(ngx_log_t *log);
+static void ngx_epoll_notify_handler(ngx_event_t *ev);
+static ngx_int_t ngx_epoll_notify(ngx_event_handler_pt handler);
+#endif
+
 #if (NGX_HAVE_FILE_AIO)
 static void ngx_epoll_eventfd_handler(ngx_event_t *ev);
 #endif
 
+static int ngx_epoll_wait(int events, ngx_msec_t timer);
+static ngx_inline uint64_t ngx_epoll_usec(void);
+
+static ngx_int_t ngx_epoll_module_init(ngx_cycle_t *cycle);
 static void *ngx_epoll_create_conf(ngx_cycle_t *cycle);
 static char *ngx_epoll_init_conf(ngx_cycle_t *cycle, void *conf);
 
 static int                  ep = -1;
 static struct epoll_event  *event_list;
 static ngx_uint_t           nevents;
+static ngx_uint_t           nevents_min;
+static ngx_uint_t           nevents_max;
+static ngx_uint_t           nunderused;
+static ngx_uint_t           busy_poll;
+#if (NGX_STAT_STUB)
+static uint64_t             wakeup_time;
+#endif
+
+#if (NGX_HAVE_SYS_EVENTFD_H)
+static int                  notify_fd = -1;
+static ngx_event_t          notify_event;
+static ngx_connection_t     notify_conn;
+#endif
 
 #if (NGX_HAVE_FILE_AIO)
 
@@ -139,6 +172,20 @@ static ngx_command_t  ngx_epoll_commands[] = {
       offsetof(ngx_epoll_conf_t, events),
       NULL },
 
+    { ngx_string("epoll_events_max"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_epoll_conf_t, events_max),
+      NULL },
+
+    { ngx_string("epoll_busy_poll"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_epoll_conf_t, busy_poll),
+      NULL },
+
     { ngx_string("worker_aio_requests"),
       NGX_EVENT_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_num_slot,
@@ -162,6 +209,11 @@ ngx_event_module_t  ngx_epoll_module_ctx = {
         ngx_epoll_del_event,             /* disable an event */
         ngx_epoll_add_connection,        /* add an connection */
         ngx_epoll_del_connection,        /* delete an connection */
+#if (NGX_HAVE_SYS_EVENTFD_H)
+        ngx_epoll_notify,                /* trigger a notify */
+#else
+        NULL,                            /* trigger a notify */
+#endif
         NULL,                            /* process the changes */
         ngx_epoll_process_events,        /* process the events */
         ngx_epoll_init,                  /* init the events */
@@ -175,7 +227,7 @@ ngx_module_t  ngx_epoll_module = {
     ngx_epoll_commands,                  /* module directives */
     NGX_EVENT_MODULE,                    /* module type */
     NULL,                                /* init master */
-    NULL,                                /* init module */
+    ngx_epoll_module_init,               /* init module */
     NULL,                                /* init process */
     NULL,                                /* init thread */
     NULL,                                /* exit thread */
@@ -289,6 +341,99 @@ failed:
 #endif
 
 
+#if (NGX_HAVE_SYS_EVENTFD_H)
+
+/*
+ * The notification eventfd wakes up the worker from another thread,
+ * e.g., when a thread pool task is completed.  The handler to call
+ * is passed in the event data.
+ */
+
+static ngx_int_t
+ngx_epoll_notify_init(ngx_log_t *log)
+{
+    struct epoll_event  ee;
+
+    notify_fd = eventfd(0, EFD_NONBLOCK);
+
+    if (notify_fd == -1) {
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno, "eventfd() failed");
+        return NGX_ERROR;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0,
+                   "notify eventfd: %d", notify_fd);
+
+    notify_event.handler = ngx_epoll_notify_handler;
+    notify_event.log = log;
+    notify_event.active = 1;
+
+    notify_conn.fd = notify_fd;
+    notify_conn.read = &notify_event;
+    notify_conn.log = log;
+
+    ee.events = EPOLLIN|EPOLLET;
+    ee.data.ptr = &notify_conn;
+
+    if (epoll_ctl(ep, EPOLL_CTL_ADD, notify_fd, &ee) == -1) {
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno,
+                      "epoll_ctl(EPOLL_CTL_ADD, eventfd) failed");
+
+        if (close(notify_fd) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                          "eventfd close() failed");
+        }
+
+        notify_fd = -1;
+
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_epoll_notify_handler(ngx_event_t *ev)
+{
+    ssize_t               n;
+    uint64_t              count;
+    ngx_event_handler_pt  handler;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, ev->log, 0, "notify event");
+
+    n = read(notify_fd, &count, sizeof(uint64_t));
+
+    if (n == -1 && ngx_errno != NGX_EAGAIN) {
+        ngx_log_error(NGX_LOG_ALERT, ev->log, ngx_errno,
+                      "read() eventfd %d failed", notify_fd);
+    }
+
+    handler = ev->data;
+    handler(ev);
+}
+
+
+static ngx_int_t
+ngx_epoll_notify(ngx_event_handler_pt handler)
+{
+    static uint64_t  inc = 1;
+
+    notify_event.data = handler;
+
+    if ((size_t) write(notify_fd, &inc, sizeof(uint64_t)) != sizeof(uint64_t))
+    {
+        ngx_log_error(NGX_LOG_ALERT, notify_event.log, ngx_errno,
+                      "write() to eventfd %d failed", notify_fd);
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+#endif
+
+
 static ngx_int_t
 ngx_epoll_init(ngx_cycle_t *cycle, ngx_msec_t timer)
 {
@@ -305,6 +450,14 @@ ngx_epoll_init(ngx_cycle_t *cycle, ngx_msec_t timer)
             return NGX_ERROR;
         }
 
+#if (NGX_HAVE_SYS_EVENTFD_H)
+
+        if (ngx_epoll_notify_init(cycle->log) != NGX_OK) {
+            ngx_epoll_module_ctx.actions.notify = NULL;
+        }
+
+#endif
+
 #if (NGX_HAVE_FILE_AIO)
 
         ngx_epoll_aio_init(cycle, epcf);
@@ -312,12 +465,12 @@ ngx_epoll_init(ngx_cycle_t *cycle, ngx_msec_t timer)
 #endif
     }
 
-    if (nevents < epcf->events) {
+    if (nevents_max < epcf->events_max) {
         if (event_list) {
             ngx_free(event_list);
         }
 
-        event_list = ngx_alloc(sizeof(struct epoll_event) * epcf->events,
+        event_list = ngx_alloc(sizeof(struct epoll_event) * epcf->events_max,
                                cycle->log);
         if (event_list == NULL) {
             return NGX_ERROR;
@@ -325,6 +478,11 @@ ngx_epoll_init(ngx_cycle_t *cycle, ngx_msec_t timer)
     }
 
     nevents = epcf->events;
+    nevents_min = epcf->events;
+    nevents_max = epcf->events_max;
+    nunderused = 0;
+
+    busy_poll = epcf->busy_poll;
 
     ngx_io = ngx_os_io;
 
@@ -352,6 +510,17 @@ ngx_epoll_done(ngx_cycle_t *cycle)
 
     ep = -1;
 
+#if (NGX_HAVE_SYS_EVENTFD_H)
+
+    if (notify_fd != -1 && close(notify_fd) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "eventfd close() failed");
+    }
+
+    notify_fd = -1;
+
+#endif
+
 #if (NGX_HAVE_FILE_AIO)
 
     if (ngx_eventfd != -1) {
@@ -568,16 +737,68 @@ ngx_epoll_process_events(ngx_cycle_t *cycle, ngx_msec_t timer, ngx_uint_t flags)
     ngx_err_t          err;
     ngx_event_t       *rev, *wev, **queue;
     ngx_connection_t  *c;
+#if (NGX_STAT_STUB)
+    uint64_t           start;
+#endif
 
     /* NGX_TIMER_INFINITE == INFTIM */
 
-    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
-                   "epoll timer: %M", timer);
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "epoll timer: %M, batch: %ui", timer, nevents);
+
+#if (NGX_STAT_STUB)
+    start = ngx_epoll_usec();
+
+    if (wakeup_time) {
+        ngx_stat_loop->loop_time += start - wakeup_time;
+    }
+#endif
+
+    if (busy_poll && timer) {
+        events = ngx_epoll_wait((int) nevents, timer);
 
-    events = epoll_wait(ep, event_list, (int) nevents, timer);
+    } else {
+        events = epoll_wait(ep, event_list, (int) nevents, timer);
+    }
 
     err = (events == -1) ? ngx_errno : 0;
 
+#if (NGX_STAT_STUB)
+    wakeup_time = ngx_epoll_usec();
+
+    ngx_stat_loop->wait_time += wakeup_time - start;
+    ngx_stat_loop->wakeups++;
+    ngx_stat_loop->batch = nevents;
+
+    if (events > 0) {
+        ngx_stat_loop->events += events;
+    }
+#endif
+
+    if (nevents_max > nevents_min && events >= 0) {
+
+        /*
+         * the batch is doubled as soon as it is filled up,
+         * and shrinks back slowly when the load goes down
+         */
+
+        if ((ngx_uint_t) events == nevents) {
+            nevents = ngx_min(nevents * 2, nevents_max);
+            nunderused = 0;
+
+        } else if ((ngx_uint_t) events < nevents / 4
+                   && nevents > nevents_min)
+        {
+            if (++nunderused == NGX_EPOLL_SHRINK_WAKEUPS) {
+                nevents = ngx_max(nevents / 2, nevents_min);
+                nunderused = 0;
+            }
+
+        } else {
+            nunderused = 0;
+        }
+    }
+
     if (flags & NGX_UPDATE_TIME || ngx_event_timer_alarm) {
         ngx_time_update();
     }
@@ -718,10 +939,73 @@ ngx_epoll_process_events(ngx_cycle_t *cycle, ngx_msec_t timer, ngx_uint_t flags)
 
     ngx_mutex_unlock(ngx_posted_events_mutex);
 
+#if (NGX_STAT_STUB)
+    ngx_stat_loop->handler_time += ngx_epoll_usec() - wakeup_time;
+#endif
+
     return NGX_OK;
 }
 
 
+/*
+ * polls for events without blocking for up to "epoll_busy_poll"
+ * microseconds before going to sleep, this saves the wakeup latency
+ * at the cost of the CPU time
+ */
+
+static int
+ngx_epoll_wait(int events, ngx_msec_t timer)
+{
+    int        n;
+    uint64_t   now, start, end;
+
+    start = ngx_epoll_usec();
+    end = start + busy_poll;
+
+    if (timer != NGX_TIMER_INFINITE && (uint64_t) timer * 1000 < busy_poll) {
+        end = start + (uint64_t) timer * 1000;
+    }
+
+    do {
+        n = epoll_wait(ep, event_list, events, 0);
+
+        if (n != 0) {
+#if (NGX_STAT_STUB)
+            if (n > 0) {
+                ngx_stat_loop->busy_polls++;
+            }
+#endif
+            return n;
+        }
+
+        ngx_cpu_pause();
+
+        now = ngx_epoll_usec();
+
+    } while (now < end);
+
+    if (timer != NGX_TIMER_INFINITE) {
+        timer -= ngx_min(timer, (ngx_msec_t) ((now - start) / 1000));
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, ngx_cycle->log, 0,
+                   "epoll busy poll timed out, timer: %M", timer);
+
+    return epoll_wait(ep, event_list, events, timer);
+}
+
+
+static ngx_inline uint64_t
+ngx_epoll_usec(void)
+{
+    struct timespec  ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+
 #if (NGX_HAVE_FILE_AIO)
 
 static void
@@ -808,6 +1092,54 @@ ngx_epoll_eventfd_handler(ngx_event_t *ev)
 #endif
 
 
+static ngx_int_t
+ngx_epoll_module_init(ngx_cycle_t *cycle)
+{
+#if (NGX_HAVE_SO_BUSY_POLL)
+
+    int                busy;
+    ngx_uint_t         i;
+    ngx_listening_t   *ls;
+    ngx_epoll_conf_t  *epcf;
+    ngx_event_conf_t  *ecf;
+
+    /*
+     * the accepted sockets inherit SO_BUSY_POLL of the listening ones;
+     * raising it needs CAP_NET_ADMIN, so it is done in the master process
+     */
+
+    ecf = ngx_event_get_conf(cycle->conf_ctx, ngx_event_core_module);
+    epcf = ngx_event_get_conf(cycle->conf_ctx, ngx_epoll_module);
+
+    if (ecf->use != ngx_epoll_module.ctx_index || epcf->busy_poll == 0) {
+        return NGX_OK;
+    }
+
+    busy = (int) epcf->busy_poll;
+
+    ls = cycle->listening.elts;
+    for (i = 0; i < cycle->listening.nelts; i++) {
+
+        if (ls[i].fd == -1) {
+            continue;
+        }
+
+        if (setsockopt(ls[i].fd, SOL_SOCKET, SO_BUSY_POLL,
+                       (const void *) &busy, sizeof(int))
+            == -1)
+        {
+            ngx_log_error(NGX_LOG_WARN, cycle->log, ngx_socket_errno,
+                          "setsockopt(SO_BUSY_POLL, %d) %V failed, ignored",
+                          busy, &ls[i].addr_text);
+        }
+    }
+
+#endif
+
+    return NGX_OK;
+}
+
+
 static void *
 ngx_epoll_create_conf(ngx_cycle_t *cycle)
 {
@@ -819,6 +1151,8 @@ ngx_epoll_create_conf(ngx_cycle_t *cycle)
     }
 
     epcf->events = NGX_CONF_UNSET;
+    epcf->events_max = NGX_CONF_UNSET;
+    epcf->busy_poll = NGX_CONF_UNSET;
     epcf->aio_requests = NGX_CONF_UNSET;
 
     return epcf;
@@ -831,7 +1165,22 @@ ngx_epoll_init_conf(ngx_cycle_t *cycle, void *conf)
     ngx_epoll_conf_t *epcf = conf;
 
     ngx_conf_init_uint_value(epcf->events, 512);
+    ngx_conf_init_uint_value(epcf->events_max, epcf->events);
+    ngx_conf_init_uint_value(epcf->busy_poll, 0);
     ngx_conf_init_uint_value(epcf->aio_requests, 32);
 
+    if (epcf->events == 0) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, 0,
+                      "\"epoll_events\" must not be zero");
+        return NGX_CONF_ERROR;
+    }
+
+    if (epcf->events_max < epcf->events) {
+        ngx_log_error(NGX_LOG_EMERG, cycle->log, 0,
+                      "\"epoll_events_max\" must not be less than "
+                      "\"epoll_events\"");
+        return NGX_CONF_ERROR;
+    }
+
     return NGX_CONF_OK;
 }
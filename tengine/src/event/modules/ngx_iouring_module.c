@@ -0,0 +1,970 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_event.h>
+
+
+/*
+ * The module uses io_uring as a readiness notification mechanism: every
+ * read or write event is a poll request in the ring.  The events added
+ * with NGX_CLEAR_EVENT are multishot poll requests, which are triggered
+ * by the socket wakeups just like EPOLLET; the level events, that is
+ * listening sockets and channels, are single poll requests rearmed after
+ * each notification.
+ *
+ * Adding and deleting events does not cost a syscall: the poll and poll
+ * remove requests are queued in the submission ring and are passed to
+ * the kernel in the same io_uring_enter() that waits for the events.
+ * The kernel handles the requests in order, so a request to remove
+ * the poll of a closed connection always precedes the poll of a new
+ * connection that got the same descriptor.
+ *
+ * A poll request is identified by the event pointer with the instance
+ * bit, and the low 16 bits of the connection number in the upper bits,
+ * as a completion of an old poll may be still in the ring when
+ * the connection is reused.  A poll remove request completes only
+ * if it fails; it fails with EALREADY if the poll is being triggered
+ * at the moment, and then the remove is queued again.
+ *
+ * With file AIO the module also handles ngx_file_aio_read() with
+ * IORING_OP_READ, which is asynchronous for buffered files too.
+ */
+
+
+#define NGX_IOURING_AIO         0x2
+#define NGX_IOURING_REMOVE      0x4
+#define NGX_IOURING_PTR_MASK    0x0000fffffffffff8ULL
+
+#define ngx_iouring_data(ev, c)                                               \
+    ((uint64_t) (uintptr_t) (ev) | (ev)->instance                             \
+     | ((uint64_t) ((c)->number & 0xffff) << 48))
+
+#if (NGX_HAVE_LITTLE_ENDIAN)
+#define ngx_iouring_poll_mask(m)  (m)
+#else
+#define ngx_iouring_poll_mask(m)  ((m) << 16 | (m) >> 16)
+#endif
+
+
+typedef struct {
+    ngx_uint_t  entries;
+} ngx_iouring_conf_t;
+
+
+static ngx_int_t ngx_iouring_init(ngx_cycle_t *cycle, ngx_msec_t timer);
+static void ngx_iouring_done(ngx_cycle_t *cycle);
+static ngx_int_t ngx_iouring_add_event(ngx_event_t *ev, ngx_int_t event,
+    ngx_uint_t flags);
+static ngx_int_t ngx_iouring_del_event(ngx_event_t *ev, ngx_int_t event,
+    ngx_uint_t flags);
+static ngx_int_t ngx_iouring_add_connection(ngx_connection_t *c);
+static ngx_int_t ngx_iouring_del_connection(ngx_connection_t *c,
+    ngx_uint_t flags);
+static ngx_int_t ngx_iouring_process_events(ngx_cycle_t *cycle,
+    ngx_msec_t timer, ngx_uint_t flags);
+
+static ngx_int_t ngx_iouring_poll(ngx_event_t *ev);
+#if (NGX_HAVE_SYS_EVENTFD_H)
+static ngx_int_t ngx_iouring_notify_init(ngx_log_t *log);
+static void ngx_iouring_notify_handler(ngx_event_t *ev);
+static ngx_int_t ngx_iouring_notify(ngx_event_handler_pt handler);
+#endif
+static ngx_int_t ngx_iouring_poll_remove(uint64_t data, ngx_log_t *log);
+static struct io_uring_sqe *ngx_iouring_get_sqe(ngx_log_t *log);
+static int ngx_iouring_enter(u_int to_submit, u_int min_complete,
+    u_int flags, struct io_uring_getevents_arg *arg);
+
+static void *ngx_iouring_create_conf(ngx_cycle_t *cycle);
+static char *ngx_iouring_init_conf(ngx_cycle_t *cycle, void *conf);
+
+
+static int                    ring = -1;
+static u_char                *rings;
+static size_t                 rings_size;
+static struct io_uring_sqe   *sqes;
+static size_t                 sqes_size;
+
+static unsigned              *sq_head;
+static unsigned              *sq_tail;
+static unsigned               sq_mask;
+static unsigned               sq_entries;
+static unsigned               sq_local_tail;
+
+static unsigned              *cq_head;
+static unsigned              *cq_tail;
+static unsigned               cq_mask;
+static struct io_uring_cqe   *cqes;
+
+static unsigned               remove_flags;
+
+static struct io_uring_cqe   *event_list;
+static ngx_uint_t             nevents;
+
+#if (NGX_HAVE_SYS_EVENTFD_H)
+static int                    notify_fd = -1;
+static ngx_event_t            notify_event;
+static ngx_connection_t       notify_conn;
+static ngx_event_handler_pt   notify_handler;
+#endif
+
+#if (NGX_HAVE_FILE_AIO)
+ngx_uint_t                    ngx_iouring_aio;
+#endif
+
+
+static ngx_str_t      iouring_name = ngx_string("io_uring");
+
+static ngx_command_t  ngx_iouring_commands[] = {
+
+    { ngx_string("io_uring_entries"),
+      NGX_EVENT_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      0,
+      offsetof(ngx_iouring_conf_t, entries),
+      NULL },
+
+      ngx_null_command
+};
+
+
+ngx_event_module_t  ngx_iouring_module_ctx = {
+    &iouring_name,
+    ngx_iouring_create_conf,             /* create configuration */
+    ngx_iouring_init_conf,               /* init configuration */
+
+    {
+        ngx_iouring_add_event,           /* add an event */
+        ngx_iouring_del_event,           /* delete an event */
+        ngx_iouring_add_event,           /* enable an event */
+        ngx_iouring_del_event,           /* disable an event */
+        ngx_iouring_add_connection,      /* add an connection */
+        ngx_iouring_del_connection,      /* delete an connection */
+#if (NGX_HAVE_SYS_EVENTFD_H)
+        ngx_iouring_notify,              /* trigger a notify */
+#else
+        NULL,                            /* trigger a notify */
+#endif
+        NULL,                            /* process the changes */
+        ngx_iouring_process_events,      /* process the events */
+        ngx_iouring_init,                /* init the events */
+        ngx_iouring_done,                /* done the events */
+    }
+};
+
+ngx_module_t  ngx_iouring_module = {
+    NGX_MODULE_V1,
+    &ngx_iouring_module_ctx,             /* module context */
+    ngx_iouring_commands,                /* module directives */
+    NGX_EVENT_MODULE,                    /* module type */
+    NULL,                                /* init master */
+    NULL,                                /* init module */
+    NULL,                                /* init process */
+    NULL,                                /* init thread */
+    NULL,                                /* exit thread */
+    NULL,                                /* exit process */
+    NULL,                                /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+/*
+ * We call io_uring_setup() and io_uring_enter() directly as syscalls
+ * for the same reasons as the AIO syscalls in the epoll module:
+ * liburing is not a part of the usual build environment.
+ */
+
+static int
+io_uring_setup(u_int entries, struct io_uring_params *p)
+{
+    return syscall(SYS_io_uring_setup, entries, p);
+}
+
+
+static ngx_int_t
+ngx_iouring_init(ngx_cycle_t *cycle, ngx_msec_t timer)
+{
+    u_int                    i, cq;
+    ngx_iouring_conf_t      *iocf;
+    struct io_uring_params   p;
+
+    iocf = ngx_event_get_conf(cycle->conf_ctx, ngx_iouring_module);
+
+    if (ring == -1) {
+
+        /* each connection may have both read and write polls */
+
+        cq = 2 * cycle->connection_n + iocf->entries;
+
+        if (cq > 65536) {
+            cq = 65536;
+        }
+
+        ngx_memzero(&p, sizeof(struct io_uring_params));
+
+        p.flags = IORING_SETUP_CQSIZE;
+        p.cq_entries = cq;
+
+#ifdef IORING_SETUP_DEFER_TASKRUN
+        p.flags |= IORING_SETUP_SINGLE_ISSUER|IORING_SETUP_DEFER_TASKRUN;
+#endif
+
+        ring = io_uring_setup(iocf->entries, &p);
+
+#ifdef IORING_SETUP_DEFER_TASKRUN
+        if (ring == -1 && ngx_errno == NGX_EINVAL) {
+
+            /* Linux before 6.1 */
+
+            ngx_memzero(&p, sizeof(struct io_uring_params));
+
+            p.flags = IORING_SETUP_CQSIZE;
+            p.cq_entries = cq;
+
+            ring = io_uring_setup(iocf->entries, &p);
+        }
+#endif
+
+        if (ring == -1) {
+            ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                          "io_uring_setup() failed");
+            return NGX_ERROR;
+        }
+
+        /*
+         * multishot poll requests appeared in Linux 5.13
+         * along with IORING_FEAT_RSRC_TAGS
+         */
+
+        if ((p.features & (IORING_FEAT_SINGLE_MMAP|IORING_FEAT_NODROP
+                           |IORING_FEAT_EXT_ARG|IORING_FEAT_RSRC_TAGS))
+            != (IORING_FEAT_SINGLE_MMAP|IORING_FEAT_NODROP
+                |IORING_FEAT_EXT_ARG|IORING_FEAT_RSRC_TAGS))
+        {
+            ngx_log_error(NGX_LOG_EMERG, cycle->log, 0,
+                          "io_uring features %08xD are not sufficient, "
+                          "at least Linux 5.13 is required", p.features);
+            goto failed;
+        }
+
+        remove_flags = (p.features & IORING_FEAT_CQE_SKIP)
+                       ? IOSQE_CQE_SKIP_SUCCESS : 0;
+
+        /* both rings are mapped at once with IORING_FEAT_SINGLE_MMAP */
+
+        rings_size = ngx_max(p.sq_off.array + p.sq_entries * sizeof(u_int),
+                             p.cq_off.cqes
+                             + p.cq_entries * sizeof(struct io_uring_cqe));
+
+        rings = mmap(NULL, rings_size, PROT_READ|PROT_WRITE,
+                     MAP_SHARED|MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+
+        if (rings == MAP_FAILED) {
+            ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                          "mmap(IORING_OFF_SQ_RING) failed");
+            rings = NULL;
+            goto failed;
+        }
+
+        sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+        sqes = mmap(NULL, sqes_size, PROT_READ|PROT_WRITE,
+                    MAP_SHARED|MAP_POPULATE, ring, IORING_OFF_SQES);
+
+        if (sqes == MAP_FAILED) {
+            ngx_log_error(NGX_LOG_EMERG, cycle->log, ngx_errno,
+                          "mmap(IORING_OFF_SQES) failed");
+            sqes = NULL;
+            goto failed;
+        }
+
+        sq_head = (unsigned *) (rings + p.sq_off.head);
+        sq_tail = (unsigned *) (rings + p.sq_off.tail);
+        sq_mask = *(unsigned *) (rings + p.sq_off.ring_mask);
+        sq_entries = p.sq_entries;
+        sq_local_tail = *sq_tail;
+
+        /* the submission queue entries are always used in order */
+
+        for (i = 0; i < sq_entries; i++) {
+            ((unsigned *) (rings + p.sq_off.array))[i] = i;
+        }
+
+        cq_head = (unsigned *) (rings + p.cq_off.head);
+        cq_tail = (unsigned *) (rings + p.cq_off.tail);
+        cq_mask = *(unsigned *) (rings + p.cq_off.ring_mask);
+        cqes = (struct io_uring_cqe *) (rings + p.cq_off.cqes);
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                       "io_uring: fd:%d sq:%ud cq:%ud",
+                       ring, p.sq_entries, p.cq_entries);
+
+#if (NGX_HAVE_SYS_EVENTFD_H)
+        if (ngx_iouring_notify_init(cycle->log) != NGX_OK) {
+            ngx_iouring_module_ctx.actions.notify = NULL;
+        }
+#endif
+
+#if (NGX_HAVE_FILE_AIO)
+        ngx_iouring_aio = 1;
+#endif
+    }
+
+    if (nevents < iocf->entries) {
+        if (event_list) {
+            ngx_free(event_list);
+        }
+
+        event_list = ngx_alloc(sizeof(struct io_uring_cqe) * iocf->entries,
+                               cycle->log);
+        if (event_list == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    nevents = iocf->entries;
+
+    ngx_io = ngx_os_io;
+
+    ngx_event_actions = ngx_iouring_module_ctx.actions;
+
+    ngx_event_flags = NGX_USE_CLEAR_EVENT
+                      |NGX_USE_GREEDY_EVENT
+                      |NGX_USE_EPOLL_EVENT;
+
+    return NGX_OK;
+
+failed:
+
+    ngx_iouring_done(cycle);
+
+    return NGX_ERROR;
+}
+
+
+static void
+ngx_iouring_done(ngx_cycle_t *cycle)
+{
+    if (sqes) {
+        if (munmap(sqes, sqes_size) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                          "munmap(IORING_OFF_SQES) failed");
+        }
+
+        sqes = NULL;
+    }
+
+    if (rings) {
+        if (munmap(rings, rings_size) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                          "munmap(IORING_OFF_SQ_RING) failed");
+        }
+
+        rings = NULL;
+    }
+
+    if (ring != -1 && close(ring) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "io_uring close() failed");
+    }
+
+    ring = -1;
+
+#if (NGX_HAVE_SYS_EVENTFD_H)
+
+    if (notify_fd != -1 && close(notify_fd) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, cycle->log, ngx_errno,
+                      "eventfd close() failed");
+    }
+
+    notify_fd = -1;
+
+#endif
+
+#if (NGX_HAVE_FILE_AIO)
+    ngx_iouring_aio = 0;
+#endif
+
+    ngx_free(event_list);
+
+    event_list = NULL;
+    nevents = 0;
+}
+
+
+static ngx_int_t
+ngx_iouring_add_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
+{
+    if (ev->active) {
+        return NGX_OK;
+    }
+
+    /* the level events are single poll requests rearmed on notification */
+
+    ev->oneshot = (flags & NGX_CLEAR_EVENT) ? 0 : 1;
+
+    if (ngx_iouring_poll(ev) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ev->active = 1;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_iouring_del_event(ngx_event_t *ev, ngx_int_t event, ngx_uint_t flags)
+{
+    ngx_connection_t  *c;
+
+    /*
+     * unlike epoll, a poll request holds a file reference, so it has
+     * to be removed explicitly even if the descriptor is being closed
+     */
+
+    if (!ev->active) {
+        return NGX_OK;
+    }
+
+    c = ev->data;
+
+    if (ngx_iouring_poll_remove(ngx_iouring_data(ev, c), ev->log) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    ev->active = 0;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_iouring_add_connection(ngx_connection_t *c)
+{
+    if (ngx_iouring_add_event(c->read, NGX_READ_EVENT, NGX_CLEAR_EVENT)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    return ngx_iouring_add_event(c->write, NGX_WRITE_EVENT, NGX_CLEAR_EVENT);
+}
+
+
+static ngx_int_t
+ngx_iouring_del_connection(ngx_connection_t *c, ngx_uint_t flags)
+{
+    if (ngx_iouring_del_event(c->read, NGX_READ_EVENT, flags) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    return ngx_iouring_del_event(c->write, NGX_WRITE_EVENT, flags);
+}
+
+
+static ngx_int_t
+ngx_iouring_poll(ngx_event_t *ev)
+{
+    uint32_t              events;
+    ngx_connection_t     *c;
+    struct io_uring_sqe  *sqe;
+
+    c = ev->data;
+
+    sqe = ngx_iouring_get_sqe(ev->log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    events = ev->write ? POLLOUT : POLLIN;
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = c->fd;
+    sqe->poll32_events = ngx_iouring_poll_mask(events);
+    sqe->len = ev->oneshot ? 0 : IORING_POLL_ADD_MULTI;
+    sqe->user_data = ngx_iouring_data(ev, c);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "io_uring poll: fd:%d ev:%04XD multi:%d",
+                   c->fd, events, !ev->oneshot);
+
+    return NGX_OK;
+}
+
+
+#if (NGX_HAVE_SYS_EVENTFD_H)
+
+/*
+ * Other threads must not touch the ring, so they wake up the worker
+ * with an eventfd polled by a usual multishot poll request.
+ */
+
+static ngx_int_t
+ngx_iouring_notify_init(ngx_log_t *log)
+{
+    notify_fd = eventfd(0, EFD_NONBLOCK);
+
+    if (notify_fd == -1) {
+        ngx_log_error(NGX_LOG_EMERG, log, ngx_errno, "eventfd() failed");
+        return NGX_ERROR;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0,
+                   "notify eventfd: %d", notify_fd);
+
+    notify_event.handler = ngx_iouring_notify_handler;
+    notify_event.data = &notify_conn;
+    notify_event.log = log;
+
+    notify_conn.fd = notify_fd;
+    notify_conn.read = &notify_event;
+    notify_conn.log = log;
+
+    if (ngx_iouring_add_event(&notify_event, NGX_READ_EVENT, NGX_CLEAR_EVENT)
+        != NGX_OK)
+    {
+        if (close(notify_fd) == -1) {
+            ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                          "eventfd close() failed");
+        }
+
+        notify_fd = -1;
+
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_iouring_notify_handler(ngx_event_t *ev)
+{
+    ssize_t   n;
+    uint64_t  count;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, ev->log, 0, "notify event");
+
+    n = read(notify_fd, &count, sizeof(uint64_t));
+
+    if (n == -1 && ngx_errno != NGX_EAGAIN) {
+        ngx_log_error(NGX_LOG_ALERT, ev->log, ngx_errno,
+                      "read() eventfd %d failed", notify_fd);
+    }
+
+    notify_handler(ev);
+}
+
+
+static ngx_int_t
+ngx_iouring_notify(ngx_event_handler_pt handler)
+{
+    static uint64_t  inc = 1;
+
+    notify_handler = handler;
+
+    if ((size_t) write(notify_fd, &inc, sizeof(uint64_t)) != sizeof(uint64_t))
+    {
+        ngx_log_error(NGX_LOG_ALERT, notify_event.log, ngx_errno,
+                      "write() to eventfd %d failed", notify_fd);
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+#endif
+
+
+static ngx_int_t
+ngx_iouring_poll_remove(uint64_t data, ngx_log_t *log)
+{
+    struct io_uring_sqe  *sqe;
+
+    sqe = ngx_iouring_get_sqe(log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->flags = remove_flags;
+    sqe->addr = data;
+    sqe->user_data = data | NGX_IOURING_REMOVE;
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0,
+                   "io_uring poll remove: %016xL", data);
+
+    return NGX_OK;
+}
+
+
+static struct io_uring_sqe *
+ngx_iouring_get_sqe(ngx_log_t *log)
+{
+    struct io_uring_sqe  *sqe;
+
+    if (sq_local_tail - *(volatile unsigned *) sq_head == sq_entries) {
+
+        /* the submission queue is full, pass it to the kernel */
+
+        if (ngx_iouring_enter(sq_entries, 0, 0, NULL) == -1
+            && ngx_errno != NGX_EAGAIN && ngx_errno != NGX_EBUSY)
+        {
+            ngx_log_error(NGX_LOG_ALERT, log, ngx_errno,
+                          "io_uring_enter() failed");
+        }
+
+        if (sq_local_tail - *(volatile unsigned *) sq_head == sq_entries) {
+            ngx_log_error(NGX_LOG_ALERT, log, 0,
+                          "io_uring submission queue overflow");
+            return NULL;
+        }
+    }
+
+    sqe = &sqes[sq_local_tail & sq_mask];
+    sq_local_tail++;
+
+    ngx_memzero(sqe, sizeof(struct io_uring_sqe));
+
+    return sqe;
+}
+
+
+static int
+ngx_iouring_enter(u_int to_submit, u_int min_complete, u_int flags,
+    struct io_uring_getevents_arg *arg)
+{
+    if (*sq_tail != sq_local_tail) {
+        ngx_memory_barrier();
+        *(volatile unsigned *) sq_tail = sq_local_tail;
+    }
+
+    if (arg) {
+        flags |= IORING_ENTER_EXT_ARG;
+    }
+
+    return syscall(SYS_io_uring_enter, ring, to_submit, min_complete, flags,
+                   arg, sizeof(struct io_uring_getevents_arg));
+}
+
+
+static ngx_int_t
+ngx_iouring_process_events(ngx_cycle_t *cycle, ngx_msec_t timer,
+    ngx_uint_t flags)
+{
+    int                              rc;
+    u_int                            to_submit, min_complete;
+    uint32_t                         revents;
+    uint64_t                         data;
+    unsigned                         head, tail;
+    ngx_int_t                        instance;
+    ngx_uint_t                       i, events, level;
+    ngx_err_t                        err;
+    ngx_event_t                     *ev, **queue;
+    ngx_connection_t                *c;
+    struct __kernel_timespec         ts;
+    struct io_uring_getevents_arg    arg, *argp;
+#if (NGX_HAVE_FILE_AIO)
+    ngx_event_aio_t                 *aio;
+#endif
+
+    /* NGX_TIMER_INFINITE == INFTIM */
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                   "io_uring timer: %M", timer);
+
+    to_submit = sq_local_tail - *(volatile unsigned *) sq_head;
+
+    head = *cq_head;
+    tail = *(volatile unsigned *) cq_tail;
+
+    if (head != tail || timer == 0) {
+
+        /* the completions left from the previous iteration */
+
+        min_complete = 0;
+        argp = NULL;
+
+    } else {
+        min_complete = 1;
+        argp = NULL;
+
+        if (timer != NGX_TIMER_INFINITE) {
+            ngx_memzero(&arg, sizeof(struct io_uring_getevents_arg));
+
+            ts.tv_sec = timer / 1000;
+            ts.tv_nsec = (timer % 1000) * 1000000;
+            arg.ts = (uint64_t) (uintptr_t) &ts;
+
+            argp = &arg;
+        }
+    }
+
+    if (to_submit || min_complete || head == tail) {
+        rc = ngx_iouring_enter(to_submit, min_complete,
+                               IORING_ENTER_GETEVENTS, argp);
+
+        err = (rc == -1) ? ngx_errno : 0;
+
+    } else {
+        err = 0;
+    }
+
+    if (flags & NGX_UPDATE_TIME || ngx_event_timer_alarm) {
+        ngx_time_update();
+    }
+
+    /* ETIME is the timeout, EBUSY means the completion queue overflow */
+
+    if (err && err != ETIME && err != NGX_EBUSY && err != NGX_EAGAIN) {
+        if (err == NGX_EINTR) {
+
+            if (ngx_event_timer_alarm) {
+                ngx_event_timer_alarm = 0;
+                return NGX_OK;
+            }
+
+            level = NGX_LOG_INFO;
+
+        } else {
+            level = NGX_LOG_ALERT;
+        }
+
+        ngx_log_error(level, cycle->log, err, "io_uring_enter() failed");
+        return NGX_ERROR;
+    }
+
+    /* copy out the completions to free the ring for the handlers */
+
+    head = *cq_head;
+    tail = *(volatile unsigned *) cq_tail;
+
+    ngx_read_barrier();
+
+    for (events = 0; head != tail && events < nevents; head++, events++) {
+        event_list[events] = cqes[head & cq_mask];
+    }
+
+    ngx_memory_barrier();
+
+    *(volatile unsigned *) cq_head = head;
+
+    if (events == 0) {
+        return NGX_OK;
+    }
+
+    ngx_mutex_lock(ngx_posted_events_mutex);
+
+    for (i = 0; i < events; i++) {
+        data = event_list[i].user_data;
+
+        if (data & NGX_IOURING_REMOVE) {
+
+            /*
+             * ENOENT means that the poll has been already completed,
+             * EALREADY means that it is being triggered right now and
+             * will be still armed after that
+             */
+
+            ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                           "io_uring poll remove: %016xL res:%d",
+                           data, event_list[i].res);
+
+            if (event_list[i].res != -NGX_EALREADY) {
+                continue;
+            }
+
+            /*
+             * the removal is retried unless the same poll request
+             * has been added again in the meantime
+             */
+
+            data &= ~NGX_IOURING_REMOVE;
+
+            ev = (ngx_event_t *) (uintptr_t) (data & NGX_IOURING_PTR_MASK);
+            c = ev->data;
+
+            if (ev->active && c->fd != -1
+                && ngx_iouring_data(ev, c) == data)
+            {
+                ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                               "io_uring poll rearmed: %p", ev);
+                continue;
+            }
+
+            (void) ngx_iouring_poll_remove(data, cycle->log);
+
+            continue;
+        }
+
+        ev = (ngx_event_t *) (uintptr_t) (data & NGX_IOURING_PTR_MASK);
+
+#if (NGX_HAVE_FILE_AIO)
+
+        if (data & NGX_IOURING_AIO) {
+
+            ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                           "io_uring aio: %p res:%d", ev, event_list[i].res);
+
+            ev->complete = 1;
+            ev->active = 0;
+            ev->ready = 1;
+
+            aio = ev->data;
+            aio->res = event_list[i].res;
+
+            ngx_locked_post_event(ev, &ngx_posted_events);
+            continue;
+        }
+
+#endif
+
+        instance = data & 1;
+        c = ev->data;
+
+        if (c->fd == -1 || ev->instance != instance
+            || (data >> 48) != (c->number & 0xffff))
+        {
+            /*
+             * the stale event from a file descriptor
+             * that was just closed or reused
+             */
+
+            ngx_log_debug1(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                           "io_uring: stale event %p", ev);
+            continue;
+        }
+
+        if (event_list[i].res == -NGX_ECANCELED) {
+
+            /* the poll was removed and may have been added again */
+
+            continue;
+        }
+
+        ngx_log_debug4(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                       "io_uring: fd:%d w:%d res:%d f:%uD",
+                       c->fd, ev->write, event_list[i].res,
+                       event_list[i].flags);
+
+        if (!ev->active) {
+            continue;
+        }
+
+        if (event_list[i].res < 0) {
+
+            /* let the handler find out the error, it will add poll again */
+
+            ngx_log_error(NGX_LOG_ALERT, cycle->log, -event_list[i].res,
+                          "io_uring poll on fd:%d failed", c->fd);
+
+            ev->active = 0;
+            revents = POLLERR;
+
+        } else {
+            revents = event_list[i].res;
+
+            if (!(event_list[i].flags & IORING_CQE_F_MORE)) {
+
+                /*
+                 * a level event or a multishot poll terminated
+                 * by the kernel, e.g., on the ring overflow
+                 */
+
+                if (ngx_iouring_poll(ev) != NGX_OK) {
+                    ev->active = 0;
+                }
+            }
+        }
+
+        if (revents & (POLLERR|POLLHUP)) {
+            ngx_log_debug2(NGX_LOG_DEBUG_EVENT, cycle->log, 0,
+                           "io_uring poll error on fd:%d ev:%04XD",
+                           c->fd, revents);
+        }
+
+        if ((flags & NGX_POST_THREAD_EVENTS) && !ev->accept) {
+            ev->posted_ready = 1;
+
+        } else {
+            ev->ready = 1;
+        }
+
+        if (flags & NGX_POST_EVENTS) {
+            queue = (ngx_event_t **) (ev->accept ?
+                           &ngx_posted_accept_events : &ngx_posted_events);
+
+            ngx_locked_post_event(ev, queue);
+
+        } else {
+            ev->handler(ev);
+        }
+    }
+
+    ngx_mutex_unlock(ngx_posted_events_mutex);
+
+    return NGX_OK;
+}
+
+
+#if (NGX_HAVE_FILE_AIO)
+
+ngx_int_t
+ngx_iouring_aio_read(ngx_event_t *ev, ngx_fd_t fd, u_char *buf, size_t size,
+    off_t offset)
+{
+    struct io_uring_sqe  *sqe;
+
+    sqe = ngx_iouring_get_sqe(ev->log);
+    if (sqe == NULL) {
+        return NGX_ERROR;
+    }
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) buf;
+    sqe->len = size;
+    sqe->off = offset;
+    sqe->user_data = (uint64_t) (uintptr_t) ev | NGX_IOURING_AIO;
+
+    ngx_log_debug4(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                   "io_uring read: fd:%d %p %uz @%O", fd, buf, size, offset);
+
+    return NGX_OK;
+}
+
+#endif
+
+
+static void *
+ngx_iouring_create_conf(ngx_cycle_t *cycle)
+{
+    ngx_iouring_conf_t  *iocf;
+
+    iocf = ngx_palloc(cycle->pool, sizeof(ngx_iouring_conf_t));
+    if (iocf == NULL) {
+        return NULL;
+    }
+
+    iocf->entries = NGX_CONF_UNSET;
+
+    return iocf;
+}
+
+
+static char *
+ngx_iouring_init_conf(ngx_cycle_t *cycle, void *conf)
+{
+    ngx_iouring_conf_t *iocf = conf;
+
+    ngx_conf_init_uint_value(iocf->entries, 512);
+
+    return NGX_CONF_OK;
+}
@@ -24,6 +24,7 @@ extern ngx_module_t ngx_select_module;
 static char *ngx_event_init_conf(ngx_cycle_t *cycle, void *conf);
 static ngx_int_t ngx_event_module_init(ngx_cycle_t *cycle);
 static ngx_int_t ngx_event_process_init(ngx_cycle_t *cycle);
+static void ngx_event_process_exit(ngx_cycle_t *cycle);
 static char *ngx_events_block(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
 
 static char *ngx_event_connections(ngx_conf_t *cf, ngx_command_t *cmd,
@@ -75,6 +76,18 @@ ngx_atomic_t   ngx_stat_writing0;
 ngx_atomic_t  *ngx_stat_writing = &ngx_stat_writing0;
 ngx_atomic_t   ngx_stat_request_time0;
 ngx_atomic_t  *ngx_stat_request_time = &ngx_stat_request_time0;
+ngx_atomic_t   ngx_stat_ssl_handshakes0;
+ngx_atomic_t  *ngx_stat_ssl_handshakes = &ngx_stat_ssl_handshakes0;
+ngx_atomic_t   ngx_stat_ssl_queued0;
+ngx_atomic_t  *ngx_stat_ssl_queued = &ngx_stat_ssl_queued0;
+ngx_atomic_t   ngx_stat_ssl_handshake_time0;
+ngx_atomic_t  *ngx_stat_ssl_handshake_time = &ngx_stat_ssl_handshake_time0;
+ngx_atomic_t   ngx_stat_conn_memory0;
+ngx_atomic_t  *ngx_stat_conn_memory = &ngx_stat_conn_memory0;
+
+ngx_event_loop_stat_t   ngx_stat_loop0;
+ngx_event_loop_stat_t  *ngx_stat_loop = &ngx_stat_loop0;
+ngx_event_loop_stat_t  *ngx_stat_loops;
 
 #endif
 
@@ -163,6 +176,13 @@ static ngx_command_t  ngx_event_core_commands[] = {
       offsetof(ngx_event_conf_t, accept_mutex_delay),
       NULL },
 
+    { ngx_string("timer_wheel"),
+      NGX_EVENT_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      0,
+      offsetof(ngx_event_conf_t, timer_wheel),
+      NULL },
+
     { ngx_string("debug_connection"),
       NGX_EVENT_CONF|NGX_CONF_TAKE1,
       ngx_event_debug_connection,
@@ -179,7 +199,7 @@ ngx_event_module_t  ngx_event_core_module_ctx = {
     ngx_event_core_create_conf,            /* create configuration */
     ngx_event_core_init_conf,              /* init configuration */
 
-    { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL }
+    { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL }
 };
 
 
@@ -193,7 +213,7 @@ ngx_module_t  ngx_event_core_module = {
     ngx_event_process_init,                /* init process */
     NULL,                                  /* init thread */
     NULL,                                  /* exit thread */
-    NULL,                                  /* exit process */
+    ngx_event_process_exit,                /* exit process */
     NULL,                                  /* exit master */
     NGX_MODULE_V1_PADDING
 };
@@ -461,6 +481,7 @@ ngx_event_module_init(ngx_cycle_t *cycle)
     ccf = (ngx_core_conf_t *) ngx_get_conf(cycle->conf_ctx, ngx_core_module);
 
     ngx_timer_resolution = ccf->timer_resolution;
+    ngx_time_source = ccf->time_source;
 
 #if !(NGX_WIN32)
     {
@@ -514,7 +535,12 @@ ngx_event_module_init(ngx_cycle_t *cycle)
            + cl          /* ngx_stat_active */
            + cl          /* ngx_stat_reading */
            + cl          /* ngx_stat_writing */
-           + cl;         /* ngx_stat_request_time */
+           + cl          /* ngx_stat_request_time */
+           + cl          /* ngx_stat_ssl_handshakes */
+           + cl          /* ngx_stat_ssl_queued */
+           + cl          /* ngx_stat_ssl_handshake_time */
+           + cl          /* ngx_stat_conn_memory */
+           + NGX_MAX_PROCESSES * sizeof(ngx_event_loop_stat_t);
 
 #endif
 
@@ -562,6 +588,11 @@ ngx_event_module_init(ngx_cycle_t *cycle)
     ngx_stat_reading = (ngx_atomic_t *) (shared + 7 * cl);
     ngx_stat_writing = (ngx_atomic_t *) (shared + 8 * cl);
     ngx_stat_request_time = (ngx_atomic_t *) (shared + 9 * cl);
+    ngx_stat_ssl_handshakes = (ngx_atomic_t *) (shared + 10 * cl);
+    ngx_stat_ssl_queued = (ngx_atomic_t *) (shared + 11 * cl);
+    ngx_stat_ssl_handshake_time = (ngx_atomic_t *) (shared + 12 * cl);
+    ngx_stat_conn_memory = (ngx_atomic_t *) (shared + 13 * cl);
+    ngx_stat_loops = (ngx_event_loop_stat_t *) (shared + 14 * cl);
 
 #endif
 
@@ -607,6 +638,41 @@ ngx_event_process_init(ngx_cycle_t *cycle)
         ngx_use_accept_mutex = 0;
     }
 
+#if (NGX_HAVE_REUSEPORT)
+
+    /*
+     * the accept mutex is useless when every worker
+     * has its own listening sockets only
+     */
+
+    if (ngx_use_accept_mutex) {
+        ls = cycle->listening.elts;
+        for (i = 0; i < cycle->listening.nelts; i++) {
+            if (!ls[i].reuseport) {
+                break;
+            }
+        }
+
+        if (i == cycle->listening.nelts) {
+            ngx_use_accept_mutex = 0;
+        }
+    }
+
+#endif
+
+    ngx_event_timer_use_wheel = ecf->timer_wheel;
+
+#if (NGX_STAT_STUB)
+
+    if (ngx_stat_loops) {
+        ngx_stat_loop = &ngx_stat_loops[ngx_process_slot];
+    }
+
+    ngx_memzero(ngx_stat_loop, sizeof(ngx_event_loop_stat_t));
+    ngx_stat_loop->pid = ngx_pid;
+
+#endif
+
 #if (NGX_THREADS)
     ngx_posted_events_mutex = ngx_mutex_init(cycle->log, 0);
     if (ngx_posted_events_mutex == NULL) {
@@ -749,6 +815,14 @@ ngx_event_process_init(ngx_cycle_t *cycle)
     ls = cycle->listening.elts;
     for (i = 0; i < cycle->listening.nelts; i++) {
 
+#if (NGX_HAVE_REUSEPORT)
+        if (ls[i].reuseport && ls[i].worker != ngx_worker
+            && ngx_process != NGX_PROCESS_SINGLE)
+        {
+            continue;
+        }
+#endif
+
         c = ngx_get_connection(ls[i].fd, cycle->log);
 
         if (c == NULL) {
@@ -829,7 +903,12 @@ ngx_event_process_init(ngx_cycle_t *cycle)
 
         rev->handler = ngx_event_accept;
 
-        if (ngx_use_accept_mutex) {
+        if (ngx_use_accept_mutex
+#if (NGX_HAVE_REUSEPORT)
+            && !ls[i].reuseport
+#endif
+           )
+        {
             continue;
         }
 
@@ -852,6 +931,19 @@ ngx_event_process_init(ngx_cycle_t *cycle)
 }
 
 
+static void
+ngx_event_process_exit(ngx_cycle_t *cycle)
+{
+#if (NGX_STAT_STUB)
+
+    /* the slot may be reused by another process */
+
+    ngx_stat_loop->pid = 0;
+
+#endif
+}
+
+
 ngx_int_t
 ngx_send_lowat(ngx_connection_t *c, size_t lowat)
 {
@@ -1179,6 +1271,7 @@ ngx_event_core_create_conf(ngx_cycle_t *cycle)
     ecf->multi_accept = NGX_CONF_UNSET;
     ecf->accept_mutex = NGX_CONF_UNSET;
     ecf->accept_mutex_delay = NGX_CONF_UNSET_MSEC;
+    ecf->timer_wheel = NGX_CONF_UNSET;
     ecf->name = (void *) NGX_CONF_UNSET;
 
 #if (NGX_DEBUG)
@@ -1294,6 +1387,7 @@ ngx_event_core_init_conf(ngx_cycle_t *cycle, void *conf)
     ngx_conf_init_value(ecf->multi_accept, 0);
     ngx_conf_init_value(ecf->accept_mutex, 1);
     ngx_conf_init_msec_value(ecf->accept_mutex_delay, 100);
+    ngx_conf_init_value(ecf->timer_wheel, 0);
 
 
 #if (NGX_HAVE_RTSIG)
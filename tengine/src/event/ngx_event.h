@@ -231,6 +231,8 @@ typedef struct {
     ngx_int_t  (*add_conn)(ngx_connection_t *c);
     ngx_int_t  (*del_conn)(ngx_connection_t *c, ngx_uint_t flags);
 
+    ngx_int_t  (*notify)(ngx_event_handler_pt handler);
+
     ngx_int_t  (*process_changes)(ngx_cycle_t *cycle, ngx_uint_t nowait);
     ngx_int_t  (*process_events)(ngx_cycle_t *cycle, ngx_msec_t timer,
                    ngx_uint_t flags);
@@ -279,7 +281,7 @@ extern ngx_event_actions_t   ngx_event_actions;
 #define NGX_USE_GREEDY_EVENT     0x00000020
 
 /*
- * The event filter is epoll.
+ * The event filter is epoll or io_uring poll.
  */
 #define NGX_USE_EPOLL_EVENT      0x00000040
 
@@ -448,6 +450,8 @@ extern ngx_event_actions_t   ngx_event_actions;
 #define ngx_add_conn         ngx_event_actions.add_conn
 #define ngx_del_conn         ngx_event_actions.del_conn
 
+#define ngx_notify           ngx_event_actions.notify
+
 #define ngx_add_timer        ngx_event_add_timer
 #define ngx_del_timer        ngx_event_del_timer
 
@@ -474,6 +478,8 @@ typedef struct {
 
     ngx_msec_t    accept_mutex_delay;
 
+    ngx_flag_t    timer_wheel;
+
     u_char       *name;
 
 #if (NGX_DEBUG)
@@ -513,6 +519,44 @@ extern ngx_atomic_t  *ngx_stat_reading;
 extern ngx_atomic_t  *ngx_stat_writing;
 extern ngx_atomic_t  *ngx_stat_request_time;
 
+
+/*
+ * the SSL handshakes run in the thread pools: the number of completed
+ * ones, the number of queued or running ones, and the total time they
+ * spent in the pools, in milliseconds
+ */
+
+extern ngx_atomic_t  *ngx_stat_ssl_handshakes;
+extern ngx_atomic_t  *ngx_stat_ssl_queued;
+extern ngx_atomic_t  *ngx_stat_ssl_handshake_time;
+
+
+/* the memory held by the pools of the client connections, in bytes */
+
+extern ngx_atomic_t  *ngx_stat_conn_memory;
+
+
+/*
+ * the event loop statistics of a process, kept in the shared memory
+ * in the slot of the process, and updated by the process only;
+ * the times are in microseconds
+ */
+
+typedef struct {
+    ngx_atomic_t          pid;
+    ngx_atomic_t          wakeups;
+    ngx_atomic_t          events;
+    ngx_atomic_t          batch;
+    ngx_atomic_t          busy_polls;
+    ngx_atomic_t          wait_time;
+    ngx_atomic_t          loop_time;
+    ngx_atomic_t          handler_time;
+} ngx_event_loop_stat_t;
+
+
+extern ngx_event_loop_stat_t  *ngx_stat_loops;
+extern ngx_event_loop_stat_t  *ngx_stat_loop;
+
 #endif
 
 
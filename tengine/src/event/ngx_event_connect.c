@@ -11,6 +11,11 @@
 #include <ngx_event_connect.h>
 
 
+#if (NGX_HAVE_TCP_FASTOPEN_CONNECT)
+static ngx_uint_t  ngx_event_fastopen_connect = 1;
+#endif
+
+
 ngx_int_t
 ngx_event_connect_peer(ngx_peer_connection_t *pc)
 {
@@ -66,6 +71,32 @@ ngx_event_connect_peer(ngx_peer_connection_t *pc)
         goto failed;
     }
 
+#if (NGX_HAVE_TCP_FASTOPEN_CONNECT)
+
+    /*
+     * connect() returns at once, and the SYN is sent along with
+     * the data of the first write, so the peer must not speak first
+     */
+
+    if (pc->fastopen && ngx_event_fastopen_connect
+        && pc->sockaddr->sa_family != AF_UNIX)
+    {
+        int  fastopen = 1;
+
+        if (setsockopt(s, IPPROTO_TCP, TCP_FASTOPEN_CONNECT,
+                       (const void *) &fastopen, sizeof(int))
+            == -1)
+        {
+            ngx_log_error(NGX_LOG_NOTICE, pc->log, ngx_socket_errno,
+                          "setsockopt(TCP_FASTOPEN_CONNECT) failed, "
+                          "fast open to peers is disabled");
+
+            ngx_event_fastopen_connect = 0;
+        }
+    }
+
+#endif
+
     if (pc->local) {
         if (bind(s, pc->local->sockaddr, pc->local->socklen) == -1) {
             ngx_log_error(NGX_LOG_CRIT, pc->log, ngx_socket_errno,
@@ -63,6 +63,9 @@ struct ngx_peer_connection_s {
     ngx_log_t                       *log;
 
     unsigned                         cached:1;
+#if (NGX_HAVE_TCP_FASTOPEN_CONNECT)
+    unsigned                         fastopen:1;
+#endif
 
                                      /* ngx_connection_log_error_e */
     unsigned                         log_error:2;
@@ -8,6 +8,9 @@
 #include <ngx_config.h>
 #include <ngx_core.h>
 #include <ngx_event.h>
+#if (NGX_THREAD_POOL)
+#include <ngx_thread_pool.h>
+#endif
 
 
 typedef struct {
@@ -18,6 +21,20 @@ typedef struct {
 typedef int (ngx_ssl_read_bio_handler_pt)(char *, int, int, void *);
 
 
+#if (NGX_THREAD_POOL)
+
+typedef struct {
+    ngx_connection_t           *connection;
+    ngx_msec_t                  start;
+    int                         n;
+    int                         sslerr;
+    ngx_err_t                   err;
+    ngx_uint_t                  closed;    /* unsigned  closed:1; */
+} ngx_ssl_handshake_ctx_t;
+
+#endif
+
+
 static ngx_str_t ngx_pphrase_rsa = ngx_string("RSA");
 static ngx_str_t ngx_pphrase_dsa = ngx_string("DSA");
 
@@ -25,7 +42,21 @@ static ngx_str_t ngx_pphrase_dsa = ngx_string("DSA");
 static int ngx_http_ssl_verify_callback(int ok, X509_STORE_CTX *x509_store);
 static void ngx_ssl_info_callback(const ngx_ssl_conn_t *ssl_conn, int where,
     int ret);
+static ngx_int_t ngx_ssl_handshaked(ngx_connection_t *c);
 static void ngx_ssl_handshake_handler(ngx_event_t *ev);
+#if (NGX_THREAD_POOL)
+#if (OPENSSL_VERSION_NUMBER < 0x10100000L)
+static ngx_int_t ngx_ssl_thread_locks(ngx_log_t *log);
+static void ngx_ssl_thread_locking(int mode, int n, const char *file,
+    int line);
+#if (OPENSSL_VERSION_NUMBER < 0x10000000L)
+static unsigned long ngx_ssl_thread_id(void);
+#endif
+#endif
+static ngx_int_t ngx_ssl_thread_handshake(ngx_connection_t *c);
+static void ngx_ssl_handshake_thread(void *data, ngx_log_t *log);
+static void ngx_ssl_handshake_thread_event(ngx_event_t *ev);
+#endif
 static ngx_int_t ngx_ssl_handle_recv(ngx_connection_t *c, int n);
 static void ngx_ssl_write_handler(ngx_event_t *wev);
 static void ngx_ssl_read_handler(ngx_event_t *rev);
@@ -40,10 +71,21 @@ static int ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn,
 static ngx_ssl_session_t *ngx_ssl_get_cached_session(ngx_ssl_conn_t *ssl_conn,
     u_char *id, int len, int *copy);
 static void ngx_ssl_remove_session(SSL_CTX *ssl, ngx_ssl_session_t *sess);
-static void ngx_ssl_expire_sessions(ngx_ssl_session_cache_t *cache,
+static void ngx_ssl_free_session_id(ngx_slab_pool_t *shpool,
+    ngx_ssl_sess_id_t *sess_id);
+static void ngx_ssl_expire_sessions(ngx_ssl_session_shard_t *shard,
     ngx_slab_pool_t *shpool, ngx_uint_t n);
 static void ngx_ssl_session_rbtree_insert_value(ngx_rbtree_node_t *temp,
     ngx_rbtree_node_t *node, ngx_rbtree_node_t *sentinel);
+#ifdef SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB
+static int ngx_ssl_session_ticket_key_callback(ngx_ssl_conn_t *ssl_conn,
+    unsigned char *name, unsigned char *iv, EVP_CIPHER_CTX *ectx,
+    HMAC_CTX *hctx, int enc);
+static void ngx_ssl_session_ticket_keys_rotate(ngx_ssl_ticket_keys_ctx_t *ctx,
+    ngx_log_t *log);
+#endif
+static ngx_int_t ngx_ssl_session_ticket_key_generate(ngx_ssl_ticket_key_t *key,
+    ngx_log_t *log);
 
 static void *ngx_openssl_create_conf(ngx_cycle_t *cycle);
 static char *ngx_openssl_engine(ngx_conf_t *cf, ngx_command_t *cmd, void *conf);
@@ -93,6 +135,12 @@ ngx_module_t  ngx_openssl_module = {
 int  ngx_ssl_connection_index;
 int  ngx_ssl_server_conf_index;
 int  ngx_ssl_session_cache_index;
+int  ngx_ssl_ticket_keys_index;
+
+
+#if (NGX_THREAD_POOL && OPENSSL_VERSION_NUMBER < 0x10100000L)
+static pthread_mutex_t  *ngx_ssl_locks;
+#endif
 
 
 ngx_int_t
@@ -146,10 +194,90 @@ ngx_ssl_init(ngx_log_t *log)
         return NGX_ERROR;
     }
 
+    ngx_ssl_ticket_keys_index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL,
+                                                         NULL);
+    if (ngx_ssl_ticket_keys_index == -1) {
+        ngx_ssl_error(NGX_LOG_ALERT, log, 0,
+                      "SSL_CTX_get_ex_new_index() failed");
+        return NGX_ERROR;
+    }
+
+#if (NGX_THREAD_POOL && OPENSSL_VERSION_NUMBER < 0x10100000L)
+
+    if (ngx_ssl_thread_locks(log) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+#endif
+
     return NGX_OK;
 }
 
 
+#if (NGX_THREAD_POOL && OPENSSL_VERSION_NUMBER < 0x10100000L)
+
+/*
+ * OpenSSL prior to 1.1.0 relies on the application locks to be used
+ * from several threads, the handshakes may be run in thread pools
+ */
+
+static ngx_int_t
+ngx_ssl_thread_locks(ngx_log_t *log)
+{
+    int        i, n;
+    ngx_err_t  err;
+
+    n = CRYPTO_num_locks();
+
+    ngx_ssl_locks = ngx_alloc(n * sizeof(pthread_mutex_t), log);
+    if (ngx_ssl_locks == NULL) {
+        return NGX_ERROR;
+    }
+
+    for (i = 0; i < n; i++) {
+        err = pthread_mutex_init(&ngx_ssl_locks[i], NULL);
+        if (err) {
+            ngx_log_error(NGX_LOG_ALERT, log, err,
+                          "pthread_mutex_init() failed");
+            return NGX_ERROR;
+        }
+    }
+
+    CRYPTO_set_locking_callback(ngx_ssl_thread_locking);
+
+#if (OPENSSL_VERSION_NUMBER < 0x10000000L)
+    CRYPTO_set_id_callback(ngx_ssl_thread_id);
+#endif
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_ssl_thread_locking(int mode, int n, const char *file, int line)
+{
+    if (mode & CRYPTO_LOCK) {
+        (void) pthread_mutex_lock(&ngx_ssl_locks[n]);
+
+    } else {
+        (void) pthread_mutex_unlock(&ngx_ssl_locks[n]);
+    }
+}
+
+
+#if (OPENSSL_VERSION_NUMBER < 0x10000000L)
+
+static unsigned long
+ngx_ssl_thread_id(void)
+{
+    return (unsigned long) pthread_self();
+}
+
+#endif
+
+#endif
+
+
 ngx_int_t
 ngx_ssl_create(ngx_ssl_t *ssl, ngx_uint_t protocols, void *data)
 {
@@ -160,6 +288,8 @@ ngx_ssl_create(ngx_ssl_t *ssl, ngx_uint_t protocols, void *data)
         return NGX_ERROR;
     }
 
+    ssl->buffer_size = NGX_SSL_BUFSIZE;
+
     if (SSL_CTX_set_ex_data(ssl->ctx, ngx_ssl_server_conf_index, data) == 0) {
         ngx_ssl_error(NGX_LOG_EMERG, ssl->log, 0,
                       "SSL_CTX_set_ex_data() failed");
@@ -595,6 +725,8 @@ ngx_ssl_create_connection(ngx_ssl_t *ssl, ngx_connection_t *c, ngx_uint_t flags)
     }
 
     sc->buffer = ((flags & NGX_SSL_BUFFER) != 0);
+    sc->buffer_size = ssl->buffer_size;
+    sc->session_ctx = ssl->ctx;
 
     sc->connection = SSL_new(ssl->ctx);
 
@@ -620,6 +752,10 @@ ngx_ssl_create_connection(ngx_ssl_t *ssl, ngx_connection_t *c, ngx_uint_t flags)
         return NGX_ERROR;
     }
 
+#if (NGX_THREAD_POOL)
+    sc->thread_pool = ssl->thread_pool;
+#endif
+
     c->ssl = sc;
 
     return NGX_OK;
@@ -645,83 +781,29 @@ ngx_ssl_handshake(ngx_connection_t *c)
 {
     int        n, sslerr;
     ngx_err_t  err;
+#if (NGX_THREAD_POOL)
+    ngx_int_t  rc;
 
-    ngx_ssl_clear_error(c->log);
-
-    n = SSL_do_handshake(c->ssl->connection);
-
-    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0, "SSL_do_handshake: %d", n);
-
-    if (n == 1) {
+    if (c->ssl->thread_pool) {
+        rc = ngx_ssl_thread_handshake(c);
 
-        if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
-            return NGX_ERROR;
+        if (rc != NGX_DECLINED) {
+            return rc;
         }
 
-        if (ngx_handle_write_event(c->write, 0) != NGX_OK) {
-            return NGX_ERROR;
-        }
-
-#if (NGX_DEBUG)
-        {
-        char         buf[129], *s, *d;
-#if OPENSSL_VERSION_NUMBER >= 0x10000000L
-        const
-#endif
-        SSL_CIPHER  *cipher;
-
-        cipher = SSL_get_current_cipher(c->ssl->connection);
-
-        if (cipher) {
-            SSL_CIPHER_description(cipher, &buf[1], 128);
-
-            for (s = &buf[1], d = buf; *s; s++) {
-                if (*s == ' ' && *d == ' ') {
-                    continue;
-                }
-
-                if (*s == LF || *s == CR) {
-                    continue;
-                }
-
-                *++d = *s;
-            }
-
-            if (*d != ' ') {
-                d++;
-            }
-
-            *d = '\0';
-
-            ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
-                           "SSL: %s, cipher: \"%s\"",
-                           SSL_get_version(c->ssl->connection), &buf[1]);
-
-            if (SSL_session_reused(c->ssl->connection)) {
-                ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, 0,
-                               "SSL reused session");
-            }
+        /* the thread pool queue is full, the handshake is run in place */
+    }
 
-        } else {
-            ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, 0,
-                           "SSL no shared ciphers");
-        }
-        }
 #endif
 
-        c->ssl->handshaked = 1;
+    ngx_ssl_clear_error(c->log);
 
-        c->recv = ngx_ssl_recv;
-        c->send = ngx_ssl_write;
-        c->recv_chain = ngx_ssl_recv_chain;
-        c->send_chain = ngx_ssl_send_chain;
+    n = SSL_do_handshake(c->ssl->connection);
 
-        /* initial handshake done, disable renegotiation (CVE-2009-3555) */
-        if (c->ssl->connection->s3) {
-            c->ssl->connection->s3->flags |= SSL3_FLAGS_NO_RENEGOTIATE_CIPHERS;
-        }
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0, "SSL_do_handshake: %d", n);
 
-        return NGX_OK;
+    if (n == 1) {
+        return ngx_ssl_handshaked(c);
     }
 
     sslerr = SSL_get_error(c->ssl->connection, n);
@@ -773,6 +855,254 @@ ngx_ssl_handshake(ngx_connection_t *c)
 }
 
 
+static ngx_int_t
+ngx_ssl_handshaked(ngx_connection_t *c)
+{
+    if (ngx_handle_read_event(c->read, 0) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    if (ngx_handle_write_event(c->write, 0) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+#if (NGX_DEBUG)
+    {
+    char         buf[129], *s, *d;
+#if OPENSSL_VERSION_NUMBER >= 0x10000000L
+    const
+#endif
+    SSL_CIPHER  *cipher;
+
+    cipher = SSL_get_current_cipher(c->ssl->connection);
+
+    if (cipher) {
+        SSL_CIPHER_description(cipher, &buf[1], 128);
+
+        for (s = &buf[1], d = buf; *s; s++) {
+            if (*s == ' ' && *d == ' ') {
+                continue;
+            }
+
+            if (*s == LF || *s == CR) {
+                continue;
+            }
+
+            *++d = *s;
+        }
+
+        if (*d != ' ') {
+            d++;
+        }
+
+        *d = '\0';
+
+        ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "SSL: %s, cipher: \"%s\"",
+                       SSL_get_version(c->ssl->connection), &buf[1]);
+
+        if (SSL_session_reused(c->ssl->connection)) {
+            ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                           "SSL reused session");
+        }
+
+    } else {
+        ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "SSL no shared ciphers");
+    }
+    }
+#endif
+
+    c->ssl->handshaked = 1;
+
+    c->recv = ngx_ssl_recv;
+    c->send = ngx_ssl_write;
+    c->recv_chain = ngx_ssl_recv_chain;
+    c->send_chain = ngx_ssl_send_chain;
+
+    /* initial handshake done, disable renegotiation (CVE-2009-3555) */
+    if (c->ssl->connection->s3) {
+        c->ssl->connection->s3->flags |= SSL3_FLAGS_NO_RENEGOTIATE_CIPHERS;
+    }
+
+    return NGX_OK;
+}
+
+
+#if (NGX_THREAD_POOL)
+
+/*
+ * SSL_do_handshake() is run in a thread pool, so the private key
+ * operations do not block the worker.  While a thread owns the SSL
+ * connection, the worker does not touch it: the connection events only
+ * leave the readiness and timeout flags, which are checked as soon as
+ * the thread has completed.  The OpenSSL error queue is per thread,
+ * therefore the handshake errors are logged by the thread itself.
+ */
+
+static ngx_int_t
+ngx_ssl_thread_handshake(ngx_connection_t *c)
+{
+    ngx_thread_task_t        *task;
+    ngx_ssl_handshake_ctx_t  *ctx;
+
+    task = c->ssl->handshake_task;
+
+    if (task == NULL) {
+        task = ngx_thread_task_alloc(c->pool, sizeof(ngx_ssl_handshake_ctx_t));
+        if (task == NULL) {
+            return NGX_ERROR;
+        }
+
+        task->handler = ngx_ssl_handshake_thread;
+        task->event.data = c;
+        task->event.handler = ngx_ssl_handshake_thread_event;
+
+        c->ssl->handshake_task = task;
+    }
+
+    if (task->event.active) {
+        return NGX_AGAIN;
+    }
+
+    ctx = task->ctx;
+
+    ctx->connection = c;
+    ctx->start = ngx_current_msec;
+    ctx->closed = 0;
+
+    if (ngx_thread_task_post(c->ssl->thread_pool, task) != NGX_OK) {
+        return NGX_DECLINED;
+    }
+
+#if (NGX_STAT_STUB)
+    (void) ngx_atomic_fetch_add(ngx_stat_ssl_queued, 1);
+#endif
+
+    c->read->ready = 0;
+    c->write->ready = 0;
+
+    c->read->handler = ngx_ssl_handshake_handler;
+    c->write->handler = ngx_ssl_handshake_handler;
+
+    return NGX_AGAIN;
+}
+
+
+static void
+ngx_ssl_handshake_thread(void *data, ngx_log_t *log)
+{
+    ngx_ssl_handshake_ctx_t *ctx = data;
+
+    ngx_connection_t  *c;
+
+    c = ctx->connection;
+
+    ngx_ssl_clear_error(c->log);
+
+    ctx->n = SSL_do_handshake(c->ssl->connection);
+
+    if (ctx->n == 1) {
+        return;
+    }
+
+    ctx->sslerr = SSL_get_error(c->ssl->connection, ctx->n);
+
+    if (ctx->sslerr == SSL_ERROR_WANT_READ
+        || ctx->sslerr == SSL_ERROR_WANT_WRITE)
+    {
+        return;
+    }
+
+    ctx->err = (ctx->sslerr == SSL_ERROR_SYSCALL) ? ngx_errno : 0;
+
+    if (ctx->sslerr == SSL_ERROR_ZERO_RETURN || ERR_peek_error() == 0) {
+        ERR_clear_error();
+        ctx->closed = 1;
+        return;
+    }
+
+    ngx_ssl_connection_error(c, ctx->sslerr, ctx->err,
+                             "SSL_do_handshake() failed");
+}
+
+
+static void
+ngx_ssl_handshake_thread_event(ngx_event_t *ev)
+{
+    ngx_int_t                 rc;
+    ngx_connection_t         *c;
+    ngx_ssl_handshake_ctx_t  *ctx;
+
+    c = ev->data;
+    ctx = c->ssl->handshake_task->ctx;
+
+#if (NGX_STAT_STUB)
+    (void) ngx_atomic_fetch_add(ngx_stat_ssl_queued, -1);
+    (void) ngx_atomic_fetch_add(ngx_stat_ssl_handshakes, 1);
+    (void) ngx_atomic_fetch_add(ngx_stat_ssl_handshake_time,
+                                ngx_current_msec - ctx->start);
+#endif
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "SSL_do_handshake: %d, thread SSL_get_error: %d",
+                   ctx->n, ctx->n == 1 ? 0 : ctx->sslerr);
+
+    if (c->read->timedout || c->write->timedout) {
+        c->ssl->handler(c);
+        return;
+    }
+
+    if (ctx->n == 1) {
+        rc = ngx_ssl_handshaked(c);
+
+    } else if (ctx->sslerr == SSL_ERROR_WANT_READ) {
+
+        if (c->read->ready) {
+            /* the data have arrived while the thread was running */
+            rc = ngx_ssl_handshake(c);
+
+        } else {
+            rc = ngx_handle_read_event(c->read, 0);
+            rc = (rc == NGX_OK) ? NGX_AGAIN : NGX_ERROR;
+        }
+
+    } else if (ctx->sslerr == SSL_ERROR_WANT_WRITE) {
+
+        if (c->write->ready) {
+            rc = ngx_ssl_handshake(c);
+
+        } else {
+            rc = ngx_handle_write_event(c->write, 0);
+            rc = (rc == NGX_OK) ? NGX_AGAIN : NGX_ERROR;
+        }
+
+    } else {
+        c->ssl->no_wait_shutdown = 1;
+        c->ssl->no_send_shutdown = 1;
+        c->read->eof = 1;
+
+        if (ctx->closed) {
+            ngx_log_error(NGX_LOG_INFO, c->log, ctx->err,
+                          "peer closed connection in SSL handshake");
+
+        } else {
+            c->read->error = 1;
+        }
+
+        rc = NGX_ERROR;
+    }
+
+    if (rc == NGX_AGAIN) {
+        return;
+    }
+
+    c->ssl->handler(c);
+}
+
+#endif
+
+
 static void
 ngx_ssl_handshake_handler(ngx_event_t *ev)
 {
@@ -783,6 +1113,15 @@ ngx_ssl_handshake_handler(ngx_event_t *ev)
     ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
                    "SSL handshake handler: %d", ev->write);
 
+#if (NGX_THREAD_POOL)
+
+    if (c->ssl->handshake_task && c->ssl->handshake_task->event.active) {
+        /* the event is handled when the thread has completed */
+        return;
+    }
+
+#endif
+
     if (ev->timedout) {
         c->ssl->handler(c);
         return;
@@ -1078,7 +1417,7 @@ ngx_ssl_send_chain(ngx_connection_t *c, ngx_chain_t *in, off_t limit)
     buf = c->ssl->buf;
 
     if (buf == NULL) {
-        buf = ngx_create_temp_buf(c->pool, NGX_SSL_BUFSIZE);
+        buf = ngx_create_temp_buf(c->pool, c->ssl->buffer_size);
         if (buf == NULL) {
             return NGX_CHAIN_ERROR;
         }
@@ -1087,14 +1426,14 @@ ngx_ssl_send_chain(ngx_connection_t *c, ngx_chain_t *in, off_t limit)
     }
 
     if (buf->start == NULL) {
-        buf->start = ngx_palloc(c->pool, NGX_SSL_BUFSIZE);
+        buf->start = ngx_palloc(c->pool, c->ssl->buffer_size);
         if (buf->start == NULL) {
             return NGX_CHAIN_ERROR;
         }
 
         buf->pos = buf->start;
         buf->last = buf->start;
-        buf->end = buf->start + NGX_SSL_BUFSIZE;
+        buf->end = buf->start + c->ssl->buffer_size;
     }
 
     send = 0;
@@ -1628,37 +1967,152 @@ ngx_ssl_session_cache(ngx_ssl_t *ssl, ngx_str_t *sess_ctx,
 }
 
 
+ngx_shm_zone_t *
+ngx_ssl_session_cache_add(ngx_conf_t *cf, ngx_str_t *name, size_t size,
+    ngx_uint_t shards, void *tag)
+{
+    ngx_shm_zone_t               *shm_zone;
+    ngx_ssl_session_cache_ctx_t  *ctx;
+
+    shm_zone = ngx_shared_memory_add(cf, name, size, tag);
+    if (shm_zone == NULL) {
+        return NULL;
+    }
+
+    if (shm_zone->data) {
+        ctx = shm_zone->data;
+
+        if (shm_zone->init != ngx_ssl_session_cache_init
+            || ctx->shards != shards)
+        {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "shared memory zone \"%V\" is already used "
+                               "with other parameters", name);
+            return NULL;
+        }
+
+        return shm_zone;
+    }
+
+    ctx = ngx_pcalloc(cf->pool, sizeof(ngx_ssl_session_cache_ctx_t));
+    if (ctx == NULL) {
+        return NULL;
+    }
+
+    ctx->shards = shards;
+
+    shm_zone->init = ngx_ssl_session_cache_init;
+    shm_zone->data = ctx;
+
+    return shm_zone;
+}
+
+
+/*
+ * The shared session cache is split into the shards selected by
+ * the session id hash.  Each shard has its own rbtree, expire queue,
+ * mutex and statistics, so the resumptions of the different sessions
+ * do not serialize on the single shared pool mutex: a lookup takes
+ * the shard mutex only, and the shared pool mutex is taken inside it
+ * just to allocate or to free the memory.  Each shard is allocated
+ * separately, so the shards do not share cache lines.
+ */
+
 ngx_int_t
 ngx_ssl_session_cache_init(ngx_shm_zone_t *shm_zone, void *data)
 {
-    size_t                    len;
-    ngx_slab_pool_t          *shpool;
-    ngx_ssl_session_cache_t  *cache;
+    ngx_ssl_session_cache_ctx_t  *octx = data;
+
+    size_t                        len;
+    u_char                       *file;
+    ngx_uint_t                    i;
+    ngx_slab_pool_t              *shpool;
+    ngx_ssl_session_shard_t      *shard;
+    ngx_ssl_session_cache_t      *cache;
+    ngx_ssl_session_cache_ctx_t  *ctx;
+
+    ctx = shm_zone->data;
+
+    if (octx) {
+        if (octx->sh->nshards != ctx->shards) {
+            ngx_log_error(NGX_LOG_EMERG, shm_zone->shm.log, 0,
+                          "SSL session cache \"%V\" uses %ui shards "
+                          "while previously it used %ui shards",
+                          &shm_zone->shm.name, ctx->shards,
+                          octx->sh->nshards);
+            return NGX_ERROR;
+        }
+
+        ctx->sh = octx->sh;
+        ctx->shpool = octx->shpool;
 
-    if (data) {
-        shm_zone->data = data;
         return NGX_OK;
     }
 
+    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    ctx->shpool = shpool;
+
     if (shm_zone->shm.exists) {
-        shm_zone->data = data;
+        ctx->sh = shpool->data;
         return NGX_OK;
     }
 
-    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
-
     cache = ngx_slab_alloc(shpool, sizeof(ngx_ssl_session_cache_t));
     if (cache == NULL) {
         return NGX_ERROR;
     }
 
+    cache->shards = ngx_slab_alloc(shpool,
+                                   ctx->shards
+                                   * sizeof(ngx_ssl_session_shard_t *));
+    if (cache->shards == NULL) {
+        return NGX_ERROR;
+    }
+
+    cache->nshards = ctx->shards;
+
     shpool->data = cache;
-    shm_zone->data = cache;
+    ctx->sh = cache;
+
+    for (i = 0; i < cache->nshards; i++) {
+
+        shard = ngx_slab_alloc(shpool, sizeof(ngx_ssl_session_shard_t));
+        if (shard == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_memzero(shard, sizeof(ngx_ssl_session_shard_t));
 
-    ngx_rbtree_init(&cache->session_rbtree, &cache->sentinel,
-                    ngx_ssl_session_rbtree_insert_value);
+#if (NGX_HAVE_ATOMIC_OPS)
 
-    ngx_queue_init(&cache->expire_queue);
+        file = NULL;
+
+#else
+
+        file = ngx_slab_alloc(shpool, ngx_cycle->lock_file.len
+                                      + shm_zone->shm.name.len
+                                      + 1 + NGX_INT_T_LEN + 1);
+        if (file == NULL) {
+            return NGX_ERROR;
+        }
+
+        (void) ngx_sprintf(file, "%V%V.%ui%Z", &ngx_cycle->lock_file,
+                           &shm_zone->shm.name, i);
+
+#endif
+
+        if (ngx_shmtx_create(&shard->mutex, &shard->lock, file) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        ngx_rbtree_init(&shard->session_rbtree, &shard->sentinel,
+                        ngx_ssl_session_rbtree_insert_value);
+
+        ngx_queue_init(&shard->expire_queue);
+
+        cache->shards[i] = shard;
+    }
 
     len = sizeof(" in SSL session shared cache \"\"") + shm_zone->shm.name.len;
 
@@ -1688,22 +2142,23 @@ ngx_ssl_session_cache_init(ngx_shm_zone_t *shm_zone, void *data)
  * and an ASN1 representation, they take accordingly 128 and 128 bytes.
  *
  * OpenSSL's i2d_SSL_SESSION() and d2i_SSL_SESSION are slow,
- * so they are outside the code locked by shared pool mutex
+ * so they are outside the code locked by shard mutex
  */
 
 static int
 ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn, ngx_ssl_session_t *sess)
 {
-    int                       len;
-    u_char                   *p, *id, *cached_sess;
-    uint32_t                  hash;
-    SSL_CTX                  *ssl_ctx;
-    ngx_shm_zone_t           *shm_zone;
-    ngx_connection_t         *c;
-    ngx_slab_pool_t          *shpool;
-    ngx_ssl_sess_id_t        *sess_id;
-    ngx_ssl_session_cache_t  *cache;
-    u_char                    buf[NGX_SSL_MAX_SESSION_SIZE];
+    int                           len;
+    u_char                       *p, *id, *cached_sess;
+    uint32_t                      hash;
+    SSL_CTX                      *ssl_ctx;
+    ngx_shm_zone_t               *shm_zone;
+    ngx_connection_t             *c;
+    ngx_slab_pool_t              *shpool;
+    ngx_ssl_sess_id_t            *sess_id;
+    ngx_ssl_session_shard_t      *shard;
+    ngx_ssl_session_cache_ctx_t  *ctx;
+    u_char                        buf[NGX_SSL_MAX_SESSION_SIZE];
 
     len = i2d_SSL_SESSION(sess, NULL);
 
@@ -1721,13 +2176,17 @@ ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn, ngx_ssl_session_t *sess)
     ssl_ctx = SSL_get_SSL_CTX(ssl_conn);
     shm_zone = SSL_CTX_get_ex_data(ssl_ctx, ngx_ssl_session_cache_index);
 
-    cache = shm_zone->data;
-    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+    ctx = shm_zone->data;
+    shpool = ctx->shpool;
 
+    hash = ngx_crc32c(sess->session_id, sess->session_id_length);
+    shard = ctx->sh->shards[hash % ctx->sh->nshards];
+
+    ngx_shmtx_lock(&shard->mutex);
     ngx_shmtx_lock(&shpool->mutex);
 
     /* drop one or two expired sessions */
-    ngx_ssl_expire_sessions(cache, shpool, 1);
+    ngx_ssl_expire_sessions(shard, shpool, 1);
 
     cached_sess = ngx_slab_alloc_locked(shpool, len);
 
@@ -1735,7 +2194,7 @@ ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn, ngx_ssl_session_t *sess)
 
         /* drop the oldest non-expired session and try once more */
 
-        ngx_ssl_expire_sessions(cache, shpool, 0);
+        ngx_ssl_expire_sessions(shard, shpool, 0);
 
         cached_sess = ngx_slab_alloc_locked(shpool, len);
 
@@ -1763,12 +2222,12 @@ ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn, ngx_ssl_session_t *sess)
 
 #endif
 
+    ngx_shmtx_unlock(&shpool->mutex);
+
     ngx_memcpy(cached_sess, buf, len);
 
     ngx_memcpy(id, sess->session_id, sess->session_id_length);
 
-    hash = ngx_crc32_short(sess->session_id, sess->session_id_length);
-
     ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
                    "ssl new session: %08XD:%d:%d",
                    hash, sess->session_id_length, len);
@@ -1781,11 +2240,11 @@ ngx_ssl_new_session(ngx_ssl_conn_t *ssl_conn, ngx_ssl_session_t *sess)
 
     sess_id->expire = ngx_time() + SSL_CTX_get_timeout(ssl_ctx);
 
-    ngx_queue_insert_head(&cache->expire_queue, &sess_id->queue);
+    ngx_queue_insert_head(&shard->expire_queue, &sess_id->queue);
 
-    ngx_rbtree_insert(&cache->session_rbtree, &sess_id->node);
+    ngx_rbtree_insert(&shard->session_rbtree, &sess_id->node);
 
-    ngx_shmtx_unlock(&shpool->mutex);
+    ngx_shmtx_unlock(&shard->mutex);
 
     return 0;
 
@@ -1800,6 +2259,7 @@ failed:
     }
 
     ngx_shmtx_unlock(&shpool->mutex);
+    ngx_shmtx_unlock(&shard->mutex);
 
     ngx_log_error(NGX_LOG_ALERT, c->log, 0,
                   "could not add new SSL session to the session cache");
@@ -1815,21 +2275,21 @@ ngx_ssl_get_cached_session(ngx_ssl_conn_t *ssl_conn, u_char *id, int len,
 #if OPENSSL_VERSION_NUMBER >= 0x0090707fL
     const
 #endif
-    u_char                   *p;
-    uint32_t                  hash;
-    ngx_int_t                 rc;
-    ngx_shm_zone_t           *shm_zone;
-    ngx_slab_pool_t          *shpool;
-    ngx_rbtree_node_t        *node, *sentinel;
-    ngx_ssl_session_t        *sess;
-    ngx_ssl_sess_id_t        *sess_id;
-    ngx_ssl_session_cache_t  *cache;
-    u_char                    buf[NGX_SSL_MAX_SESSION_SIZE];
+    u_char                       *p;
+    uint32_t                      hash;
+    ngx_int_t                     rc;
+    ngx_shm_zone_t               *shm_zone;
+    ngx_rbtree_node_t            *node, *sentinel;
+    ngx_ssl_session_t            *sess;
+    ngx_ssl_sess_id_t            *sess_id;
+    ngx_ssl_session_shard_t      *shard;
+    ngx_ssl_session_cache_ctx_t  *ctx;
+    u_char                        buf[NGX_SSL_MAX_SESSION_SIZE];
 #if (NGX_DEBUG)
-    ngx_connection_t         *c;
+    ngx_connection_t             *c;
 #endif
 
-    hash = ngx_crc32_short(id, (size_t) len);
+    hash = ngx_crc32c(id, (size_t) len);
     *copy = 0;
 
 #if (NGX_DEBUG)
@@ -1842,16 +2302,15 @@ ngx_ssl_get_cached_session(ngx_ssl_conn_t *ssl_conn, u_char *id, int len,
     shm_zone = SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl_conn),
                                    ngx_ssl_session_cache_index);
 
-    cache = shm_zone->data;
+    ctx = shm_zone->data;
+    shard = ctx->sh->shards[hash % ctx->sh->nshards];
 
     sess = NULL;
 
-    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+    ngx_shmtx_lock(&shard->mutex);
 
-    ngx_shmtx_lock(&shpool->mutex);
-
-    node = cache->session_rbtree.root;
-    sentinel = cache->session_rbtree.sentinel;
+    node = shard->session_rbtree.root;
+    sentinel = shard->session_rbtree.sentinel;
 
     while (node != sentinel) {
 
@@ -1876,7 +2335,9 @@ ngx_ssl_get_cached_session(ngx_ssl_conn_t *ssl_conn, u_char *id, int len,
             if (sess_id->expire > ngx_time()) {
                 ngx_memcpy(buf, sess_id->session, sess_id->len);
 
-                ngx_shmtx_unlock(&shpool->mutex);
+                shard->hits++;
+
+                ngx_shmtx_unlock(&shard->mutex);
 
                 p = buf;
                 sess = d2i_SSL_SESSION(NULL, &p, sess_id->len);
@@ -1886,13 +2347,9 @@ ngx_ssl_get_cached_session(ngx_ssl_conn_t *ssl_conn, u_char *id, int len,
 
             ngx_queue_remove(&sess_id->queue);
 
-            ngx_rbtree_delete(&cache->session_rbtree, node);
+            ngx_rbtree_delete(&shard->session_rbtree, node);
 
-            ngx_slab_free_locked(shpool, sess_id->session);
-#if (NGX_PTR_SIZE == 4)
-            ngx_slab_free_locked(shpool, sess_id->id);
-#endif
-            ngx_slab_free_locked(shpool, sess_id);
+            ngx_ssl_free_session_id(ctx->shpool, sess_id);
 
             sess = NULL;
 
@@ -1904,7 +2361,9 @@ ngx_ssl_get_cached_session(ngx_ssl_conn_t *ssl_conn, u_char *id, int len,
 
 done:
 
-    ngx_shmtx_unlock(&shpool->mutex);
+    shard->misses++;
+
+    ngx_shmtx_unlock(&shard->mutex);
 
     return sess;
 }
@@ -1922,15 +2381,15 @@ ngx_ssl_remove_cached_session(SSL_CTX *ssl, ngx_ssl_session_t *sess)
 static void
 ngx_ssl_remove_session(SSL_CTX *ssl, ngx_ssl_session_t *sess)
 {
-    size_t                    len;
-    u_char                   *id;
-    uint32_t                  hash;
-    ngx_int_t                 rc;
-    ngx_shm_zone_t           *shm_zone;
-    ngx_slab_pool_t          *shpool;
-    ngx_rbtree_node_t        *node, *sentinel;
-    ngx_ssl_sess_id_t        *sess_id;
-    ngx_ssl_session_cache_t  *cache;
+    size_t                        len;
+    u_char                       *id;
+    uint32_t                      hash;
+    ngx_int_t                     rc;
+    ngx_shm_zone_t               *shm_zone;
+    ngx_rbtree_node_t            *node, *sentinel;
+    ngx_ssl_sess_id_t            *sess_id;
+    ngx_ssl_session_shard_t      *shard;
+    ngx_ssl_session_cache_ctx_t  *ctx;
 
     shm_zone = SSL_CTX_get_ex_data(ssl, ngx_ssl_session_cache_index);
 
@@ -1938,22 +2397,22 @@ ngx_ssl_remove_session(SSL_CTX *ssl, ngx_ssl_session_t *sess)
         return;
     }
 
-    cache = shm_zone->data;
+    ctx = shm_zone->data;
 
     id = sess->session_id;
     len = (size_t) sess->session_id_length;
 
-    hash = ngx_crc32_short(id, len);
+    hash = ngx_crc32c(id, len);
 
     ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ngx_cycle->log, 0,
                    "ssl remove session: %08XD:%uz", hash, len);
 
-    shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+    shard = ctx->sh->shards[hash % ctx->sh->nshards];
 
-    ngx_shmtx_lock(&shpool->mutex);
+    ngx_shmtx_lock(&shard->mutex);
 
-    node = cache->session_rbtree.root;
-    sentinel = cache->session_rbtree.sentinel;
+    node = shard->session_rbtree.root;
+    sentinel = shard->session_rbtree.sentinel;
 
     while (node != sentinel) {
 
@@ -1977,13 +2436,9 @@ ngx_ssl_remove_session(SSL_CTX *ssl, ngx_ssl_session_t *sess)
 
             ngx_queue_remove(&sess_id->queue);
 
-            ngx_rbtree_delete(&cache->session_rbtree, node);
+            ngx_rbtree_delete(&shard->session_rbtree, node);
 
-            ngx_slab_free_locked(shpool, sess_id->session);
-#if (NGX_PTR_SIZE == 4)
-            ngx_slab_free_locked(shpool, sess_id->id);
-#endif
-            ngx_slab_free_locked(shpool, sess_id);
+            ngx_ssl_free_session_id(ctx->shpool, sess_id);
 
             goto done;
         }
@@ -1993,12 +2448,27 @@ ngx_ssl_remove_session(SSL_CTX *ssl, ngx_ssl_session_t *sess)
 
 done:
 
+    ngx_shmtx_unlock(&shard->mutex);
+}
+
+
+static void
+ngx_ssl_free_session_id(ngx_slab_pool_t *shpool, ngx_ssl_sess_id_t *sess_id)
+{
+    ngx_shmtx_lock(&shpool->mutex);
+
+    ngx_slab_free_locked(shpool, sess_id->session);
+#if (NGX_PTR_SIZE == 4)
+    ngx_slab_free_locked(shpool, sess_id->id);
+#endif
+    ngx_slab_free_locked(shpool, sess_id);
+
     ngx_shmtx_unlock(&shpool->mutex);
 }
 
 
 static void
-ngx_ssl_expire_sessions(ngx_ssl_session_cache_t *cache,
+ngx_ssl_expire_sessions(ngx_ssl_session_shard_t *shard,
     ngx_slab_pool_t *shpool, ngx_uint_t n)
 {
     time_t              now;
@@ -2009,11 +2479,11 @@ ngx_ssl_expire_sessions(ngx_ssl_session_cache_t *cache,
 
     while (n < 3) {
 
-        if (ngx_queue_empty(&cache->expire_queue)) {
+        if (ngx_queue_empty(&shard->expire_queue)) {
             return;
         }
 
-        q = ngx_queue_last(&cache->expire_queue);
+        q = ngx_queue_last(&shard->expire_queue);
 
         sess_id = ngx_queue_data(q, ngx_ssl_sess_id_t, queue);
 
@@ -2026,7 +2496,11 @@ ngx_ssl_expire_sessions(ngx_ssl_session_cache_t *cache,
         ngx_log_debug1(NGX_LOG_DEBUG_EVENT, ngx_cycle->log, 0,
                        "expire session: %08Xi", sess_id->node.key);
 
-        ngx_rbtree_delete(&cache->session_rbtree, &sess_id->node);
+        if (sess_id->expire > now) {
+            shard->evictions++;
+        }
+
+        ngx_rbtree_delete(&shard->session_rbtree, &sess_id->node);
 
         ngx_slab_free_locked(shpool, sess_id->session);
 #if (NGX_PTR_SIZE == 4)
@@ -2079,6 +2553,273 @@ ngx_ssl_session_rbtree_insert_value(ngx_rbtree_node_t *temp,
 }
 
 
+/*
+ * The session ticket keys are kept in a small shared memory zone as a ring
+ * of NGX_SSL_TICKET_KEYS_MAX + 1 keys.  New tickets are encrypted with
+ * the current key, the tickets encrypted with one of the "keep" previous
+ * keys are accepted and renewed.  The zone survives reconfiguration, so
+ * the sessions are resumed across reloads as well.
+ *
+ * The keys are looked up without the shared pool mutex.  A rotation writes
+ * a new key into the slot following the current one, which is not visible
+ * to the lookups as long as "keep" does not exceed NGX_SSL_TICKET_KEYS_MAX,
+ * and only then publishes it as the current key.  The rotation itself is
+ * done by the first worker which needs a key after the rotation period
+ * has expired, the others skip it if the mutex is busy.
+ */
+
+ngx_int_t
+ngx_ssl_session_ticket_keys(ngx_ssl_t *ssl, ngx_shm_zone_t *shm_zone)
+{
+#ifdef SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB
+
+    if (SSL_CTX_set_ex_data(ssl->ctx, ngx_ssl_ticket_keys_index,
+                            shm_zone->data)
+        == 0)
+    {
+        ngx_ssl_error(NGX_LOG_EMERG, ssl->log, 0,
+                      "SSL_CTX_set_ex_data() failed");
+        return NGX_ERROR;
+    }
+
+    if (SSL_CTX_set_tlsext_ticket_key_cb(ssl->ctx,
+                                         ngx_ssl_session_ticket_key_callback)
+        == 0)
+    {
+        ngx_log_error(NGX_LOG_WARN, ssl->log, 0,
+                      "nginx was built with Session Tickets support, however, "
+                      "now it is linked dynamically to an OpenSSL library "
+                      "which has no tlsext support, therefore Session Tickets "
+                      "are not available");
+    }
+
+#else
+
+    ngx_log_error(NGX_LOG_WARN, ssl->log, 0,
+                  "\"ssl_session_ticket_keys\" ignored, not supported");
+
+#endif
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_ssl_session_ticket_keys_init(ngx_shm_zone_t *shm_zone, void *data)
+{
+    ngx_ssl_ticket_keys_ctx_t  *octx = data;
+
+    size_t                      len;
+    ngx_ssl_ticket_keys_ctx_t  *ctx;
+
+    ctx = shm_zone->data;
+
+    if (octx) {
+        ctx->sh = octx->sh;
+        ctx->shpool = octx->shpool;
+
+        return NGX_OK;
+    }
+
+    ctx->shpool = (ngx_slab_pool_t *) shm_zone->shm.addr;
+
+    if (shm_zone->shm.exists) {
+        ctx->sh = ctx->shpool->data;
+
+        return NGX_OK;
+    }
+
+    ctx->sh = ngx_slab_alloc(ctx->shpool, sizeof(ngx_ssl_ticket_keys_t));
+    if (ctx->sh == NULL) {
+        return NGX_ERROR;
+    }
+
+    ctx->shpool->data = ctx->sh;
+
+    ngx_memzero(ctx->sh, sizeof(ngx_ssl_ticket_keys_t));
+
+    if (ngx_ssl_session_ticket_key_generate(&ctx->sh->keys[0],
+                                            shm_zone->shm.log)
+        != NGX_OK)
+    {
+        return NGX_ERROR;
+    }
+
+    ctx->sh->current = 0;
+    ctx->sh->rotated = ngx_time();
+    ctx->sh->valid = 1;
+
+    len = sizeof(" in SSL session ticket keys \"\"") + shm_zone->shm.name.len;
+
+    ctx->shpool->log_ctx = ngx_slab_alloc(ctx->shpool, len);
+    if (ctx->shpool->log_ctx == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_sprintf(ctx->shpool->log_ctx, " in SSL session ticket keys \"%V\"%Z",
+                &shm_zone->shm.name);
+
+    return NGX_OK;
+}
+
+
+#ifdef SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB
+
+static int
+ngx_ssl_session_ticket_key_callback(ngx_ssl_conn_t *ssl_conn,
+    unsigned char *name, unsigned char *iv, EVP_CIPHER_CTX *ectx,
+    HMAC_CTX *hctx, int enc)
+{
+    ngx_uint_t                  i, n, valid;
+    ngx_connection_t           *c;
+    ngx_ssl_ticket_key_t       *key;
+    ngx_ssl_ticket_keys_t      *sh;
+    ngx_ssl_ticket_keys_ctx_t  *ctx;
+
+    c = ngx_ssl_get_connection(ssl_conn);
+
+    ctx = SSL_CTX_get_ex_data(c->ssl->session_ctx, ngx_ssl_ticket_keys_index);
+    sh = ctx->sh;
+
+    if (ctx->rotate && ngx_time() - (time_t) sh->rotated >= ctx->rotate) {
+        ngx_ssl_session_ticket_keys_rotate(ctx, c->log);
+    }
+
+    /*
+     * the number of keys is read before the current key, as a rotation
+     * publishes the current key first: the keys counted are then either
+     * up to the key read or up to the previous one
+     */
+
+    valid = sh->valid;
+
+    ngx_memory_barrier();
+
+    n = sh->current;
+
+    if (enc == 1) {
+        /* encrypt session ticket */
+
+        key = &sh->keys[n];
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "ssl session ticket encrypt, key slot: %ui", n);
+
+        if (RAND_bytes(iv, 16) != 1) {
+            ngx_ssl_error(NGX_LOG_ALERT, c->log, 0, "RAND_bytes() failed");
+            return -1;
+        }
+
+        if (EVP_EncryptInit_ex(ectx, EVP_aes_128_cbc(), NULL, key->aes_key, iv)
+            != 1)
+        {
+            ngx_ssl_error(NGX_LOG_ALERT, c->log, 0,
+                          "EVP_EncryptInit_ex() failed");
+            return -1;
+        }
+
+        HMAC_Init_ex(hctx, key->hmac_key, 16, EVP_sha256(), NULL);
+
+        ngx_memcpy(name, key->name, 16);
+
+        return 1;
+    }
+
+    /* decrypt session ticket, the slots never generated are zeroed */
+
+    for (i = 0; i < ctx->keep && i < valid; i++) {
+        key = &sh->keys[(n + NGX_SSL_TICKET_KEYS_MAX + 1 - i)
+                        % (NGX_SSL_TICKET_KEYS_MAX + 1)];
+
+        if (ngx_memcmp(name, key->name, 16) == 0) {
+            goto found;
+        }
+    }
+
+    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "ssl session ticket decrypt, key not found");
+
+    return 0;
+
+found:
+
+    ngx_log_debug1(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "ssl session ticket decrypt, key age: %ui", i);
+
+    HMAC_Init_ex(hctx, key->hmac_key, 16, EVP_sha256(), NULL);
+
+    if (EVP_DecryptInit_ex(ectx, EVP_aes_128_cbc(), NULL, key->aes_key, iv)
+        != 1)
+    {
+        ngx_ssl_error(NGX_LOG_ALERT, c->log, 0, "EVP_DecryptInit_ex() failed");
+        return -1;
+    }
+
+    /* a ticket encrypted with a previous key is renewed */
+
+    return (i == 0) ? 1 : 2;
+}
+
+
+static void
+ngx_ssl_session_ticket_keys_rotate(ngx_ssl_ticket_keys_ctx_t *ctx,
+    ngx_log_t *log)
+{
+    time_t                  now;
+    ngx_uint_t              n;
+    ngx_ssl_ticket_keys_t  *sh;
+
+    if (!ngx_shmtx_trylock(&ctx->shpool->mutex)) {
+        return;
+    }
+
+    sh = ctx->sh;
+    now = ngx_time();
+
+    if (now - (time_t) sh->rotated < ctx->rotate) {
+        ngx_shmtx_unlock(&ctx->shpool->mutex);
+        return;
+    }
+
+    n = (sh->current + 1) % (NGX_SSL_TICKET_KEYS_MAX + 1);
+
+    if (ngx_ssl_session_ticket_key_generate(&sh->keys[n], log) == NGX_OK) {
+        ngx_memory_barrier();
+
+        sh->current = n;
+
+        ngx_memory_barrier();
+
+        if (sh->valid < NGX_SSL_TICKET_KEYS_MAX + 1) {
+            sh->valid++;
+        }
+
+        ngx_log_debug1(NGX_LOG_DEBUG_EVENT, log, 0,
+                       "ssl session ticket key rotated, slot: %ui", n);
+    }
+
+    /* a failed rotation is not retried until the next period */
+
+    sh->rotated = now;
+
+    ngx_shmtx_unlock(&ctx->shpool->mutex);
+}
+
+#endif
+
+
+static ngx_int_t
+ngx_ssl_session_ticket_key_generate(ngx_ssl_ticket_key_t *key, ngx_log_t *log)
+{
+    if (RAND_bytes((u_char *) key, sizeof(ngx_ssl_ticket_key_t)) != 1) {
+        ngx_ssl_error(NGX_LOG_ALERT, log, 0, "RAND_bytes() failed");
+        return NGX_ERROR;
+    }
+
+    return NGX_OK;
+}
+
+
 void
 ngx_ssl_cleanup_ctx(void *data)
 {
@@ -17,6 +17,8 @@
 #include <openssl/conf.h>
 #include <openssl/engine.h>
 #include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
 
 #define NGX_SSL_NAME     "OpenSSL"
 
@@ -28,20 +30,31 @@
 typedef struct {
     SSL_CTX                    *ctx;
     ngx_log_t                  *log;
+    size_t                      buffer_size;
+#if (NGX_THREAD_POOL)
+    struct ngx_thread_pool_s   *thread_pool;
+#endif
 } ngx_ssl_t;
 
 
 typedef struct {
     ngx_ssl_conn_t             *connection;
+    SSL_CTX                    *session_ctx;
 
     ngx_int_t                   last;
     ngx_buf_t                  *buf;
+    size_t                      buffer_size;
 
     ngx_connection_handler_pt   handler;
 
     ngx_event_handler_pt        saved_read_handler;
     ngx_event_handler_pt        saved_write_handler;
 
+#if (NGX_THREAD_POOL)
+    struct ngx_thread_pool_s   *thread_pool;
+    ngx_thread_task_t          *handshake_task;
+#endif
+
     unsigned                    handshaked:1;
     unsigned                    renegotiation:1;
     unsigned                    buffer:1;
@@ -83,12 +96,62 @@ struct ngx_ssl_sess_id_s {
 
 
 typedef struct {
+    ngx_shmtx_sh_t              lock;
+    ngx_shmtx_t                 mutex;
     ngx_rbtree_t                session_rbtree;
     ngx_rbtree_node_t           sentinel;
     ngx_queue_t                 expire_queue;
+    ngx_uint_t                  hits;
+    ngx_uint_t                  misses;
+    ngx_uint_t                  evictions;
+} ngx_ssl_session_shard_t;
+
+
+typedef struct {
+    ngx_uint_t                  nshards;
+    ngx_ssl_session_shard_t   **shards;
 } ngx_ssl_session_cache_t;
 
 
+typedef struct {
+    ngx_ssl_session_cache_t    *sh;
+    ngx_slab_pool_t            *shpool;
+    ngx_uint_t                  shards;
+} ngx_ssl_session_cache_ctx_t;
+
+
+#define NGX_SSL_SESSION_SHARDS_MAX  256
+
+
+#define NGX_SSL_TICKET_KEYS_MAX  16
+
+
+typedef struct {
+    u_char                      name[16];
+    u_char                      hmac_key[16];
+    u_char                      aes_key[16];
+} ngx_ssl_ticket_key_t;
+
+
+typedef struct {
+    ngx_atomic_t                current;
+    ngx_atomic_t                rotated;
+
+    /* the number of keys generated, up to the current one */
+    ngx_atomic_t                valid;
+
+    ngx_ssl_ticket_key_t        keys[NGX_SSL_TICKET_KEYS_MAX + 1];
+} ngx_ssl_ticket_keys_t;
+
+
+typedef struct {
+    ngx_ssl_ticket_keys_t      *sh;
+    ngx_slab_pool_t            *shpool;
+    time_t                      rotate;
+    ngx_uint_t                  keep;
+} ngx_ssl_ticket_keys_ctx_t;
+
+
 
 #define NGX_SSL_SSLv2    0x0002
 #define NGX_SSL_SSLv3    0x0004
@@ -115,7 +178,12 @@ ngx_int_t ngx_ssl_dhparam(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_str_t *file);
 ngx_int_t ngx_ssl_ecdh_curve(ngx_conf_t *cf, ngx_ssl_t *ssl, ngx_str_t *name);
 ngx_int_t ngx_ssl_session_cache(ngx_ssl_t *ssl, ngx_str_t *sess_ctx,
     ssize_t builtin_session_cache, ngx_shm_zone_t *shm_zone, time_t timeout);
+ngx_shm_zone_t *ngx_ssl_session_cache_add(ngx_conf_t *cf, ngx_str_t *name,
+    size_t size, ngx_uint_t shards, void *tag);
 ngx_int_t ngx_ssl_session_cache_init(ngx_shm_zone_t *shm_zone, void *data);
+ngx_int_t ngx_ssl_session_ticket_keys(ngx_ssl_t *ssl, ngx_shm_zone_t *shm_zone);
+ngx_int_t ngx_ssl_session_ticket_keys_init(ngx_shm_zone_t *shm_zone,
+    void *data);
 ngx_int_t ngx_ssl_create_connection(ngx_ssl_t *ssl, ngx_connection_t *c,
     ngx_uint_t flags);
 
@@ -165,6 +233,7 @@ void ngx_ssl_cleanup_ctx(void *data);
 extern int  ngx_ssl_connection_index;
 extern int  ngx_ssl_server_conf_index;
 extern int  ngx_ssl_session_cache_index;
+extern int  ngx_ssl_ticket_keys_index;
 
 
 #if (OPENSSL_VERSION_NUMBER < 0x00904000)
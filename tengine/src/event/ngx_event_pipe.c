@@ -1017,3 +1017,171 @@ ngx_event_pipe_drain_chains(ngx_event_pipe_t *p)
         }
     }
 }
+
+
+#if (NGX_HAVE_SPLICE)
+
+static void ngx_event_splice_cleanup(void *data);
+
+
+ngx_event_splice_t *
+ngx_event_splice_create(ngx_pool_t *pool, ngx_log_t *log)
+{
+    ngx_pool_cleanup_t  *cln;
+    ngx_event_splice_t  *sp;
+
+    cln = ngx_pool_cleanup_add(pool, sizeof(ngx_event_splice_t));
+    if (cln == NULL) {
+        return NULL;
+    }
+
+    sp = cln->data;
+
+    if (pipe2(sp->fd, O_NONBLOCK) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, log, ngx_errno, "pipe2() failed");
+        return NULL;
+    }
+
+    sp->size = 0;
+    sp->log = log;
+
+    cln->handler = ngx_event_splice_cleanup;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, log, 0,
+                   "splice pipe: %d:%d", sp->fd[0], sp->fd[1]);
+
+    return sp;
+}
+
+
+static void
+ngx_event_splice_cleanup(void *data)
+{
+    ngx_event_splice_t  *sp = data;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, sp->log, 0,
+                   "splice pipe cleanup: %d:%d", sp->fd[0], sp->fd[1]);
+
+    if (close(sp->fd[0]) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, sp->log, ngx_errno,
+                      "close() splice pipe %d failed", sp->fd[0]);
+    }
+
+    if (close(sp->fd[1]) == -1) {
+        ngx_log_error(NGX_LOG_ALERT, sp->log, ngx_errno,
+                      "close() splice pipe %d failed", sp->fd[1]);
+    }
+}
+
+
+ssize_t
+ngx_event_splice_read(ngx_event_splice_t *sp, ngx_connection_t *c, size_t size)
+{
+    ssize_t       n;
+    ngx_err_t     err;
+    ngx_event_t  *rev;
+
+    rev = c->read;
+
+    for ( ;; ) {
+        n = splice(c->fd, NULL, sp->fd[1], NULL, size,
+                   SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "splice read: fd:%d %z of %uz", c->fd, n, size);
+
+        if (n > 0) {
+
+            /*
+             * a short read does not mean that the socket is drained,
+             * the pipe may have run out of slots before bytes
+             */
+
+            sp->size += n;
+            return n;
+        }
+
+        if (n == 0) {
+            rev->ready = 0;
+            rev->eof = 1;
+            return 0;
+        }
+
+        err = ngx_socket_errno;
+
+        if (err == NGX_EINTR) {
+            continue;
+        }
+
+        rev->ready = 0;
+
+        if (err == NGX_EAGAIN) {
+            ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, err,
+                           "splice() not ready");
+            return NGX_AGAIN;
+        }
+
+        rev->error = 1;
+
+        (void) ngx_connection_error(c, err, "splice() from socket failed");
+
+        return NGX_ERROR;
+    }
+}
+
+
+ssize_t
+ngx_event_splice_write(ngx_event_splice_t *sp, ngx_connection_t *c)
+{
+    ssize_t       n, sent;
+    ngx_err_t     err;
+    ngx_event_t  *wev;
+
+    wev = c->write;
+    sent = 0;
+
+    while (sp->size) {
+        n = splice(sp->fd[0], NULL, c->fd, NULL, sp->size,
+                   SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+
+        ngx_log_debug3(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                       "splice write: fd:%d %z of %uz", c->fd, n, sp->size);
+
+        if (n > 0) {
+            sp->size -= n;
+            c->sent += n;
+            sent += n;
+            continue;
+        }
+
+        err = (n == 0) ? 0 : ngx_socket_errno;
+
+        if (err == NGX_EINTR) {
+            continue;
+        }
+
+        if (err == NGX_EAGAIN) {
+            wev->ready = 0;
+
+            ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, err,
+                           "splice() not ready");
+
+            return sent ? sent : NGX_AGAIN;
+        }
+
+        wev->error = 1;
+
+        if (n == 0) {
+            ngx_log_error(NGX_LOG_ALERT, c->log, 0, "splice() returned zero");
+            return NGX_ERROR;
+        }
+
+        (void) ngx_connection_error(c, err, "splice() to socket failed");
+
+        return NGX_ERROR;
+    }
+
+    return sent;
+}
+
+#endif
@@ -91,4 +91,27 @@ ngx_int_t ngx_event_pipe_copy_input_filter(ngx_event_pipe_t *p, ngx_buf_t *buf);
 ngx_int_t ngx_event_pipe_add_free_buf(ngx_event_pipe_t *p, ngx_buf_t *b);
 
 
+#if (NGX_HAVE_SPLICE)
+
+/*
+ * a kernel pipe used to relay data between two sockets with splice(),
+ * the data never enters the user space; "size" is the number of bytes
+ * moved into the pipe but not yet sent out
+ */
+
+typedef struct {
+    ngx_fd_t           fd[2];
+    size_t             size;
+    ngx_log_t         *log;
+} ngx_event_splice_t;
+
+
+ngx_event_splice_t *ngx_event_splice_create(ngx_pool_t *pool, ngx_log_t *log);
+ssize_t ngx_event_splice_read(ngx_event_splice_t *sp, ngx_connection_t *c,
+    size_t size);
+ssize_t ngx_event_splice_write(ngx_event_splice_t *sp, ngx_connection_t *c);
+
+#endif
+
+
 #endif /* _NGX_EVENT_PIPE_H_INCLUDED_ */
@@ -15,9 +15,62 @@ ngx_mutex_t  *ngx_event_timer_mutex;
 #endif
 
 
+/*
+ * The hierarchical timer wheel: the root level has 256 slots of 1 millisecond
+ * each, every upper level has 64 slots and each its slot spans the whole lower
+ * level, so four upper levels cover the 2^32 milliseconds range.  The timers
+ * of the upper levels are cascaded to the lower ones as the wheel turns.
+ *
+ * The timer rbtree node is reused as a list link: node->left points to
+ * the previous node, node->right points to the next node.
+ */
+
+#define NGX_TIMER_WHEEL_ROOT_BITS   8
+#define NGX_TIMER_WHEEL_LEVEL_BITS  6
+#define NGX_TIMER_WHEEL_ROOT_SIZE   (1 << NGX_TIMER_WHEEL_ROOT_BITS)
+#define NGX_TIMER_WHEEL_LEVEL_SIZE  (1 << NGX_TIMER_WHEEL_LEVEL_BITS)
+#define NGX_TIMER_WHEEL_ROOT_MASK   (NGX_TIMER_WHEEL_ROOT_SIZE - 1)
+#define NGX_TIMER_WHEEL_LEVEL_MASK  (NGX_TIMER_WHEEL_LEVEL_SIZE - 1)
+#define NGX_TIMER_WHEEL_LEVELS      4
+
+#define NGX_TIMER_WHEEL_SLOTS                                                 \
+    (NGX_TIMER_WHEEL_ROOT_SIZE                                                \
+     + NGX_TIMER_WHEEL_LEVELS * NGX_TIMER_WHEEL_LEVEL_SIZE)
+
+#define NGX_TIMER_WHEEL_WORD        (8 * sizeof(ngx_uint_t))
+
+#define ngx_event_timer_wheel_shift(level)                                    \
+    (NGX_TIMER_WHEEL_ROOT_BITS + ((level) - 1) * NGX_TIMER_WHEEL_LEVEL_BITS)
+
+#define ngx_event_timer_wheel_level(level)                                    \
+    (NGX_TIMER_WHEEL_ROOT_SIZE + ((level) - 1) * NGX_TIMER_WHEEL_LEVEL_SIZE)
+
+
+typedef struct {
+    ngx_msec_t          tick;
+    ngx_uint_t          count;
+
+    /* a set bit means that the slot may be not empty */
+    ngx_uint_t          bitmap[NGX_TIMER_WHEEL_SLOTS / NGX_TIMER_WHEEL_WORD];
+
+    ngx_rbtree_node_t   slots[NGX_TIMER_WHEEL_SLOTS];
+} ngx_event_timer_wheel_t;
+
+
+static void ngx_event_timer_wheel_init(void);
+static void ngx_event_timer_wheel_insert(ngx_rbtree_node_t *node);
+static ngx_uint_t ngx_event_timer_wheel_cascade(ngx_uint_t level);
+static ngx_uint_t ngx_event_timer_wheel_scan(ngx_uint_t from, ngx_uint_t to);
+static ngx_msec_t ngx_event_timer_wheel_find(void);
+static void ngx_event_timer_wheel_expire(void);
+
+
 ngx_thread_volatile ngx_rbtree_t  ngx_event_timer_rbtree;
 static ngx_rbtree_node_t          ngx_event_timer_sentinel;
 
+ngx_uint_t                        ngx_event_timer_use_wheel;
+static ngx_event_timer_wheel_t    ngx_event_timer_wheel;
+
 /*
  * the event timer rbtree may contain the duplicate keys, however,
  * it should not be a problem, because we use the rbtree to find
@@ -30,6 +83,10 @@ ngx_event_timer_init(ngx_log_t *log)
     ngx_rbtree_init(&ngx_event_timer_rbtree, &ngx_event_timer_sentinel,
                     ngx_rbtree_insert_timer_value);
 
+    if (ngx_event_timer_use_wheel) {
+        ngx_event_timer_wheel_init();
+    }
+
 #if (NGX_THREADS)
 
     if (ngx_event_timer_mutex) {
@@ -54,6 +111,10 @@ ngx_event_find_timer(void)
     ngx_msec_int_t      timer;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_use_wheel) {
+        return ngx_event_timer_wheel_find();
+    }
+
     if (ngx_event_timer_rbtree.root == &ngx_event_timer_sentinel) {
         return NGX_TIMER_INFINITE;
     }
@@ -79,6 +140,11 @@ ngx_event_expire_timers(void)
     ngx_event_t        *ev;
     ngx_rbtree_node_t  *node, *root, *sentinel;
 
+    if (ngx_event_timer_use_wheel) {
+        ngx_event_timer_wheel_expire();
+        return;
+    }
+
     sentinel = ngx_event_timer_rbtree.sentinel;
 
     for ( ;; ) {
@@ -156,3 +222,371 @@ ngx_event_expire_timers(void)
 
     ngx_mutex_unlock(ngx_event_timer_mutex);
 }
+
+
+ngx_uint_t
+ngx_event_timer_empty(void)
+{
+    if (ngx_event_timer_use_wheel) {
+        return ngx_event_timer_wheel.count == 0;
+    }
+
+    return ngx_event_timer_rbtree.root == &ngx_event_timer_sentinel;
+}
+
+
+static void
+ngx_event_timer_wheel_init(void)
+{
+    ngx_uint_t          i;
+    ngx_rbtree_node_t  *head;
+
+    ngx_memzero(ngx_event_timer_wheel.bitmap,
+                sizeof(ngx_event_timer_wheel.bitmap));
+
+    for (i = 0; i < NGX_TIMER_WHEEL_SLOTS; i++) {
+        head = &ngx_event_timer_wheel.slots[i];
+        head->left = head;
+        head->right = head;
+    }
+
+    ngx_event_timer_wheel.tick = ngx_current_msec;
+    ngx_event_timer_wheel.count = 0;
+}
+
+
+void
+ngx_event_timer_wheel_add(ngx_rbtree_node_t *node)
+{
+    ngx_event_timer_wheel_insert(node);
+
+    ngx_event_timer_wheel.count++;
+}
+
+
+void
+ngx_event_timer_wheel_del(ngx_rbtree_node_t *node)
+{
+    /* the slot bit is left set, it is cleared lazily by the scan */
+
+    node->left->right = node->right;
+    node->right->left = node->left;
+
+    ngx_event_timer_wheel.count--;
+}
+
+
+static void
+ngx_event_timer_wheel_insert(ngx_rbtree_node_t *node)
+{
+    ngx_uint_t          slot;
+    ngx_msec_t          key, diff;
+    ngx_rbtree_node_t  *head;
+
+    key = node->key;
+    diff = key - ngx_event_timer_wheel.tick;
+
+    if ((ngx_msec_int_t) diff < 0) {
+
+        /* the timer has already expired, run it on the next tick */
+
+        slot = ngx_event_timer_wheel.tick & NGX_TIMER_WHEEL_ROOT_MASK;
+
+    } else if (diff < (ngx_msec_t) 1 << ngx_event_timer_wheel_shift(1)) {
+        slot = key & NGX_TIMER_WHEEL_ROOT_MASK;
+
+    } else if (diff < (ngx_msec_t) 1 << ngx_event_timer_wheel_shift(2)) {
+        slot = ngx_event_timer_wheel_level(1)
+               + ((key >> ngx_event_timer_wheel_shift(1))
+                  & NGX_TIMER_WHEEL_LEVEL_MASK);
+
+    } else if (diff < (ngx_msec_t) 1 << ngx_event_timer_wheel_shift(3)) {
+        slot = ngx_event_timer_wheel_level(2)
+               + ((key >> ngx_event_timer_wheel_shift(2))
+                  & NGX_TIMER_WHEEL_LEVEL_MASK);
+
+    } else if (diff < (ngx_msec_t) 1 << ngx_event_timer_wheel_shift(4)) {
+        slot = ngx_event_timer_wheel_level(3)
+               + ((key >> ngx_event_timer_wheel_shift(3))
+                  & NGX_TIMER_WHEEL_LEVEL_MASK);
+
+    } else {
+
+#if (NGX_PTR_SIZE == 8)
+        /* the wheel covers 2^32 milliseconds, the timer will be cascaded */
+
+        if (diff > 0xffffffff) {
+            key = ngx_event_timer_wheel.tick + 0xffffffff;
+        }
+#endif
+
+        slot = ngx_event_timer_wheel_level(4)
+               + ((key >> ngx_event_timer_wheel_shift(4))
+                  & NGX_TIMER_WHEEL_LEVEL_MASK);
+    }
+
+    head = &ngx_event_timer_wheel.slots[slot];
+
+    node->left = head->left;
+    node->right = head;
+    head->left->right = node;
+    head->left = node;
+
+    ngx_event_timer_wheel.bitmap[slot / NGX_TIMER_WHEEL_WORD] |=
+                              (ngx_uint_t) 1 << (slot % NGX_TIMER_WHEEL_WORD);
+}
+
+
+static ngx_uint_t
+ngx_event_timer_wheel_cascade(ngx_uint_t level)
+{
+    ngx_uint_t          index;
+    ngx_rbtree_node_t  *head, *node, *next;
+
+    index = (ngx_event_timer_wheel.tick >> ngx_event_timer_wheel_shift(level))
+            & NGX_TIMER_WHEEL_LEVEL_MASK;
+
+    head = &ngx_event_timer_wheel.slots[ngx_event_timer_wheel_level(level)
+                                        + index];
+
+    node = head->right;
+
+    head->left = head;
+    head->right = head;
+
+    while (node != head) {
+        next = node->right;
+
+        ngx_event_timer_wheel_insert(node);
+
+        node = next;
+    }
+
+    return index;
+}
+
+
+/* find the first not empty slot in the [from, to) range */
+
+static ngx_uint_t
+ngx_event_timer_wheel_scan(ngx_uint_t from, ngx_uint_t to)
+{
+    ngx_uint_t          n, word, bit;
+    ngx_rbtree_node_t  *head;
+
+    for (n = from; n < to; n++) {
+
+        word = ngx_event_timer_wheel.bitmap[n / NGX_TIMER_WHEEL_WORD];
+
+        if ((word >> (n % NGX_TIMER_WHEEL_WORD)) == 0) {
+            n |= NGX_TIMER_WHEEL_WORD - 1;
+            continue;
+        }
+
+        bit = (ngx_uint_t) 1 << (n % NGX_TIMER_WHEEL_WORD);
+
+        if ((word & bit) == 0) {
+            continue;
+        }
+
+        head = &ngx_event_timer_wheel.slots[n];
+
+        if (head->right != head) {
+            return n;
+        }
+
+        ngx_event_timer_wheel.bitmap[n / NGX_TIMER_WHEEL_WORD] &= ~bit;
+    }
+
+    return to;
+}
+
+
+static ngx_msec_t
+ngx_event_timer_wheel_find(void)
+{
+    ngx_uint_t      level, first, index, n, shift, found;
+    ngx_msec_t      tick, expire, cascade, base;
+    ngx_msec_int_t  timer;
+
+    if (ngx_event_timer_wheel.count == 0) {
+        return NGX_TIMER_INFINITE;
+    }
+
+    found = 0;
+    expire = 0;
+
+    tick = ngx_event_timer_wheel.tick;
+    index = tick & NGX_TIMER_WHEEL_ROOT_MASK;
+
+    n = ngx_event_timer_wheel_scan(index, NGX_TIMER_WHEEL_ROOT_SIZE);
+
+    if (n != NGX_TIMER_WHEEL_ROOT_SIZE) {
+        expire = tick + (n - index);
+        found = 1;
+
+        /* the upper levels are cascaded only when the root level wraps */
+
+        if (index != 0) {
+            goto done;
+        }
+
+    } else {
+        n = ngx_event_timer_wheel_scan(0, index);
+
+        if (n != index) {
+            expire = tick + NGX_TIMER_WHEEL_ROOT_SIZE - index + n;
+            found = 1;
+        }
+    }
+
+    /*
+     * a timer of an upper level slot may expire before the root level timers,
+     * so the wheel should wake up not later than the slot is cascaded
+     */
+
+    for (level = 1; level <= NGX_TIMER_WHEEL_LEVELS; level++) {
+
+        shift = ngx_event_timer_wheel_shift(level);
+        first = ngx_event_timer_wheel_level(level);
+
+        base = (tick + ((ngx_msec_t) 1 << shift) - 1) >> shift;
+        index = base & NGX_TIMER_WHEEL_LEVEL_MASK;
+
+        n = ngx_event_timer_wheel_scan(first + index,
+                                       first + NGX_TIMER_WHEEL_LEVEL_SIZE);
+
+        if (n == first + NGX_TIMER_WHEEL_LEVEL_SIZE) {
+            n = ngx_event_timer_wheel_scan(first, first + index);
+
+            if (n == first + index) {
+                continue;
+            }
+        }
+
+        n -= first;
+
+        cascade = (base + ((n - index) & NGX_TIMER_WHEEL_LEVEL_MASK)) << shift;
+
+        if (!found || (ngx_msec_int_t) (cascade - expire) < 0) {
+            expire = cascade;
+            found = 1;
+        }
+    }
+
+    if (!found) {
+        return NGX_TIMER_INFINITE;
+    }
+
+done:
+
+    timer = (ngx_msec_int_t) (expire - ngx_current_msec);
+
+    return (ngx_msec_t) (timer > 0 ? timer : 0);
+}
+
+
+static void
+ngx_event_timer_wheel_expire(void)
+{
+    ngx_uint_t          index, n;
+    ngx_msec_t          delta;
+    ngx_event_t        *ev;
+    ngx_rbtree_node_t  *head, *node, work;
+
+    ngx_mutex_lock(ngx_event_timer_mutex);
+
+    while ((ngx_msec_int_t) (ngx_current_msec - ngx_event_timer_wheel.tick)
+           >= 0)
+    {
+        if (ngx_event_timer_wheel.count == 0) {
+            ngx_event_timer_wheel.tick = ngx_current_msec + 1;
+            break;
+        }
+
+        index = ngx_event_timer_wheel.tick & NGX_TIMER_WHEEL_ROOT_MASK;
+
+        if (index == 0
+            && ngx_event_timer_wheel_cascade(1) == 0
+            && ngx_event_timer_wheel_cascade(2) == 0
+            && ngx_event_timer_wheel_cascade(3) == 0)
+        {
+            (void) ngx_event_timer_wheel_cascade(4);
+        }
+
+        n = ngx_event_timer_wheel_scan(index, NGX_TIMER_WHEEL_ROOT_SIZE);
+
+        if (n != index) {
+
+            /* skip the empty slots up to the next timer or the level end */
+
+            delta = ngx_current_msec + 1 - ngx_event_timer_wheel.tick;
+
+            if (delta > n - index) {
+                delta = n - index;
+            }
+
+            ngx_event_timer_wheel.tick += delta;
+            continue;
+        }
+
+        /*
+         * the tick is advanced before the handlers are called,
+         * so the timers they add are not lost in the processed slot
+         */
+
+        ngx_event_timer_wheel.tick++;
+
+        head = &ngx_event_timer_wheel.slots[index];
+
+        work.left = head->left;
+        work.right = head->right;
+        work.left->right = &work;
+        work.right->left = &work;
+
+        head->left = head;
+        head->right = head;
+
+        while (work.right != &work) {
+            node = work.right;
+
+            ev = (ngx_event_t *) ((char *) node - offsetof(ngx_event_t, timer));
+
+            ngx_log_debug2(NGX_LOG_DEBUG_EVENT, ev->log, 0,
+                           "event timer del: %d: %M",
+                           ngx_event_ident(ev->data), ev->timer.key);
+
+            ngx_event_timer_wheel_del(node);
+
+            ngx_mutex_unlock(ngx_event_timer_mutex);
+
+#if (NGX_DEBUG)
+            ev->timer.left = NULL;
+            ev->timer.right = NULL;
+            ev->timer.parent = NULL;
+#endif
+
+            ev->timer_set = 0;
+
+#if (NGX_THREADS)
+            if (ngx_threaded) {
+                ev->posted_timedout = 1;
+
+                ngx_post_event(ev, &ngx_posted_events);
+
+                ngx_mutex_lock(ngx_event_timer_mutex);
+
+                continue;
+            }
+#endif
+
+            ev->timedout = 1;
+
+            ev->handler(ev);
+
+            ngx_mutex_lock(ngx_event_timer_mutex);
+        }
+    }
+
+    ngx_mutex_unlock(ngx_event_timer_mutex);
+}
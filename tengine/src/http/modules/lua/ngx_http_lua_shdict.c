@@ -378,7 +378,7 @@ ngx_http_lua_shdict_get(lua_State *L)
                           key.data);
     }
 
-    hash = ngx_crc32_short(key.data, key.len);
+    hash = ngx_crc32c(key.data, key.len);
 
 #if (NGX_DEBUG)
     ngx_log_debug2(NGX_LOG_DEBUG_HTTP, ctx->log, 0,
@@ -608,7 +608,7 @@ ngx_http_lua_shdict_set_helper(lua_State *L, int flags)
                       (int) key.len);
     }
 
-    hash = ngx_crc32_short(key.data, key.len);
+    hash = ngx_crc32c(key.data, key.len);
 
     value_type = lua_type(L, 3);
 
@@ -900,7 +900,7 @@ ngx_http_lua_shdict_incr(lua_State *L)
                       (int) key.len);
     }
 
-    hash = ngx_crc32_short(key.data, key.len);
+    hash = ngx_crc32c(key.data, key.len);
 
     value = luaL_checknumber(L, 3);
 
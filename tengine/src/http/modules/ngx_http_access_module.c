@@ -27,9 +27,14 @@ typedef struct {
 #endif
 
 typedef struct {
-    ngx_array_t      *rules;     /* array of ngx_http_access_rule_t */
+    ngx_array_t        *rules;     /* array of ngx_http_access_rule_t */
 #if (NGX_HAVE_INET6)
-    ngx_array_t      *rules6;    /* array of ngx_http_access_rule6_t */
+    ngx_array_t        *rules6;    /* array of ngx_http_access_rule6_t */
+#endif
+
+    ngx_radix_table_t  *table;
+#if (NGX_HAVE_INET6)
+    ngx_radix_table_t  *table6;
 #endif
 } ngx_http_access_loc_conf_t;
 
@@ -42,6 +47,8 @@ static ngx_int_t ngx_http_access_inet6(ngx_http_request_t *r,
     ngx_http_access_loc_conf_t *alcf, u_char *p);
 #endif
 static ngx_int_t ngx_http_access_found(ngx_http_request_t *r, ngx_uint_t deny);
+static ngx_int_t ngx_http_access_compile(ngx_conf_t *cf,
+    ngx_http_access_loc_conf_t *alcf);
 static char *ngx_http_access_rule(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static void *ngx_http_access_create_loc_conf(ngx_conf_t *cf);
@@ -120,7 +127,7 @@ ngx_http_access_handler(ngx_http_request_t *r)
     switch (r->connection->sockaddr->sa_family) {
 
     case AF_INET:
-        if (alcf->rules) {
+        if (alcf->table) {
             sin = (struct sockaddr_in *) r->connection->sockaddr;
             return ngx_http_access_inet(r, alcf, sin->sin_addr.s_addr);
         }
@@ -132,7 +139,7 @@ ngx_http_access_handler(ngx_http_request_t *r)
         sin6 = (struct sockaddr_in6 *) r->connection->sockaddr;
         p = sin6->sin6_addr.s6_addr;
 
-        if (alcf->rules && IN6_IS_ADDR_V4MAPPED(&sin6->sin6_addr)) {
+        if (alcf->table && IN6_IS_ADDR_V4MAPPED(&sin6->sin6_addr)) {
             addr = p[12] << 24;
             addr += p[13] << 16;
             addr += p[14] << 8;
@@ -140,7 +147,7 @@ ngx_http_access_handler(ngx_http_request_t *r)
             return ngx_http_access_inet(r, alcf, htonl(addr));
         }
 
-        if (alcf->rules6) {
+        if (alcf->table6) {
             return ngx_http_access_inet6(r, alcf, p);
         }
 
@@ -155,22 +162,18 @@ static ngx_int_t
 ngx_http_access_inet(ngx_http_request_t *r, ngx_http_access_loc_conf_t *alcf,
     in_addr_t addr)
 {
-    ngx_uint_t               i;
-    ngx_http_access_rule_t  *rule;
+    uintptr_t  deny;
 
-    rule = alcf->rules->elts;
-    for (i = 0; i < alcf->rules->nelts; i++) {
+    deny = ngx_radix32table_find(alcf->table, ntohl(addr));
 
-        ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "access: %08XD %08XD %08XD",
-                       addr, rule[i].mask, rule[i].addr);
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "access: %08XD %i", addr, (ngx_int_t) deny);
 
-        if ((addr & rule[i].mask) == rule[i].addr) {
-            return ngx_http_access_found(r, rule[i].deny);
-        }
+    if (deny == NGX_RADIX_NO_VALUE) {
+        return NGX_DECLINED;
     }
 
-    return NGX_DECLINED;
+    return ngx_http_access_found(r, deny);
 }
 
 
@@ -180,42 +183,27 @@ static ngx_int_t
 ngx_http_access_inet6(ngx_http_request_t *r, ngx_http_access_loc_conf_t *alcf,
     u_char *p)
 {
-    ngx_uint_t                n;
-    ngx_uint_t                i;
-    ngx_http_access_rule6_t  *rule6;
+    uintptr_t  deny;
 
-    rule6 = alcf->rules6->elts;
-    for (i = 0; i < alcf->rules6->nelts; i++) {
+    deny = ngx_radix128table_find(alcf->table6, p);
 
 #if (NGX_DEBUG)
-        {
-        size_t  cl, ml, al;
-        u_char  ct[NGX_INET6_ADDRSTRLEN];
-        u_char  mt[NGX_INET6_ADDRSTRLEN];
-        u_char  at[NGX_INET6_ADDRSTRLEN];
-
-        cl = ngx_inet6_ntop(p, ct, NGX_INET6_ADDRSTRLEN);
-        ml = ngx_inet6_ntop(rule6[i].mask.s6_addr, mt, NGX_INET6_ADDRSTRLEN);
-        al = ngx_inet6_ntop(rule6[i].addr.s6_addr, at, NGX_INET6_ADDRSTRLEN);
-
-        ngx_log_debug6(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
-                       "access: %*s %*s %*s", cl, ct, ml, mt, al, at);
-        }
-#endif
+    {
+    size_t  cl;
+    u_char  ct[NGX_INET6_ADDRSTRLEN];
 
-        for (n = 0; n < 16; n++) {
-            if ((p[n] & rule6[i].mask.s6_addr[n]) != rule6[i].addr.s6_addr[n]) {
-                goto next;
-            }
-        }
+    cl = ngx_inet6_ntop(p, ct, NGX_INET6_ADDRSTRLEN);
 
-        return ngx_http_access_found(r, rule6[i].deny);
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "access: %*s %i", cl, ct, (ngx_int_t) deny);
+    }
+#endif
 
-    next:
-        continue;
+    if (deny == NGX_RADIX_NO_VALUE) {
+        return NGX_DECLINED;
     }
 
-    return NGX_DECLINED;
+    return ngx_http_access_found(r, deny);
 }
 
 #endif
@@ -351,25 +339,149 @@ ngx_http_access_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_http_access_loc_conf_t  *prev = parent;
     ngx_http_access_loc_conf_t  *conf = child;
 
+    /* the rules of the http level are compiled here as well */
+
+    if (ngx_http_access_compile(cf, prev) != NGX_OK) {
+        return NGX_CONF_ERROR;
+    }
+
 #if (NGX_HAVE_INET6)
 
     if (conf->rules == NULL && conf->rules6 == NULL) {
         conf->rules = prev->rules;
         conf->rules6 = prev->rules6;
+        conf->table = prev->table;
+        conf->table6 = prev->table6;
     }
 
 #else
 
     if (conf->rules == NULL) {
         conf->rules = prev->rules;
+        conf->table = prev->table;
     }
 
 #endif
 
+    if (ngx_http_access_compile(cf, conf) != NGX_OK) {
+        return NGX_CONF_ERROR;
+    }
+
     return NGX_CONF_OK;
 }
 
 
+/*
+ * The rules are checked in order and the first matching rule wins, while
+ * the radix table finds the longest matching prefix.  A rule is the longest
+ * prefix among the previous rules which match an address unless there is
+ * a previous rule for the same or a wider network, in which case the rule
+ * is never reached and is not added.
+ */
+
+static ngx_int_t
+ngx_http_access_compile(ngx_conf_t *cf, ngx_http_access_loc_conf_t *alcf)
+{
+    ngx_uint_t                i, j;
+    ngx_radix_tree_t         *tree;
+    ngx_http_access_rule_t   *rule;
+#if (NGX_HAVE_INET6)
+    u_char                   *addr, *mask;
+    ngx_uint_t                n;
+    ngx_http_access_rule6_t  *rule6;
+#endif
+
+    if (alcf->rules && alcf->table == NULL) {
+
+        tree = ngx_radix_tree_create(cf->temp_pool, 0);
+        if (tree == NULL) {
+            return NGX_ERROR;
+        }
+
+        rule = alcf->rules->elts;
+
+        for (i = 0; i < alcf->rules->nelts; i++) {
+
+            for (j = 0; j < i; j++) {
+                if ((rule[i].addr & rule[j].mask) == rule[j].addr
+                    && (rule[i].mask & rule[j].mask) == rule[j].mask)
+                {
+                    goto next;
+                }
+            }
+
+            if (ngx_radix32tree_insert(tree, ntohl(rule[i].addr),
+                                       ntohl(rule[i].mask), rule[i].deny)
+                != NGX_OK)
+            {
+                return NGX_ERROR;
+            }
+
+        next:
+            continue;
+        }
+
+        alcf->table = ngx_radix_table_create(tree, cf->pool, 32);
+        if (alcf->table == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+#if (NGX_HAVE_INET6)
+
+    if (alcf->rules6 && alcf->table6 == NULL) {
+
+        tree = ngx_radix_tree_create(cf->temp_pool, 0);
+        if (tree == NULL) {
+            return NGX_ERROR;
+        }
+
+        rule6 = alcf->rules6->elts;
+
+        for (i = 0; i < alcf->rules6->nelts; i++) {
+
+            for (j = 0; j < i; j++) {
+                addr = rule6[i].addr.s6_addr;
+                mask = rule6[i].mask.s6_addr;
+
+                for (n = 0; n < 16; n++) {
+                    if ((addr[n] & rule6[j].mask.s6_addr[n])
+                        != rule6[j].addr.s6_addr[n]
+                        || (mask[n] & rule6[j].mask.s6_addr[n])
+                           != rule6[j].mask.s6_addr[n])
+                    {
+                        break;
+                    }
+                }
+
+                if (n == 16) {
+                    goto next6;
+                }
+            }
+
+            if (ngx_radix128tree_insert(tree, rule6[i].addr.s6_addr,
+                                        rule6[i].mask.s6_addr, rule6[i].deny)
+                != NGX_OK)
+            {
+                return NGX_ERROR;
+            }
+
+        next6:
+            continue;
+        }
+
+        alcf->table6 = ngx_radix_table_create(tree, cf->pool, 128);
+        if (alcf->table6 == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+#endif
+
+    return NGX_OK;
+}
+
+
 static ngx_int_t
 ngx_http_access_init(ngx_conf_t *cf)
 {
@@ -68,6 +68,13 @@ ngx_http_chunked_header_filter(ngx_http_request_t *r)
         return ngx_http_next_header_filter(r);
     }
 
+#if (NGX_HTTP_V2)
+    if (r->stream) {
+        /* the end of the response is marked by the END_STREAM flag */
+        return ngx_http_next_header_filter(r);
+    }
+#endif
+
     if (r->headers_out.content_length_n == -1) {
         if (r->http_version < NGX_HTTP_VERSION_11) {
             r->keepalive = 0;
@@ -114,6 +114,10 @@ static u_char *ngx_http_log_connection(ngx_http_request_t *r, u_char *buf,
     ngx_http_log_op_t *op);
 static u_char *ngx_http_log_connection_requests(ngx_http_request_t *r,
     u_char *buf, ngx_http_log_op_t *op);
+static u_char *ngx_http_log_connection_pool_peak(ngx_http_request_t *r,
+    u_char *buf, ngx_http_log_op_t *op);
+static u_char *ngx_http_log_request_pool_peak(ngx_http_request_t *r,
+    u_char *buf, ngx_http_log_op_t *op);
 static u_char *ngx_http_log_pipe(ngx_http_request_t *r, u_char *buf,
     ngx_http_log_op_t *op);
 static u_char *ngx_http_log_time(ngx_http_request_t *r, u_char *buf,
@@ -258,6 +262,10 @@ static ngx_http_log_var_t  ngx_http_log_vars[] = {
     { ngx_string("connection"), NGX_ATOMIC_T_LEN, ngx_http_log_connection },
     { ngx_string("connection_requests"), NGX_INT_T_LEN,
                           ngx_http_log_connection_requests },
+    { ngx_string("connection_pool_peak"), NGX_SIZE_T_LEN,
+                          ngx_http_log_connection_pool_peak },
+    { ngx_string("request_pool_peak"), NGX_SIZE_T_LEN,
+                          ngx_http_log_request_pool_peak },
     { ngx_string("pipe"), 1, ngx_http_log_pipe },
     { ngx_string("time_local"), sizeof("28/Sep/1970:12:00:00 +0600") - 1,
                           ngx_http_log_time },
@@ -634,6 +642,22 @@ ngx_http_log_connection_requests(ngx_http_request_t *r, u_char *buf,
 }
 
 
+static u_char *
+ngx_http_log_connection_pool_peak(ngx_http_request_t *r, u_char *buf,
+    ngx_http_log_op_t *op)
+{
+    return ngx_sprintf(buf, "%uz", r->connection->pool->peak);
+}
+
+
+static u_char *
+ngx_http_log_request_pool_peak(ngx_http_request_t *r, u_char *buf,
+    ngx_http_log_op_t *op)
+{
+    return ngx_sprintf(buf, "%uz", r->pool->peak);
+}
+
+
 static u_char *
 ngx_http_log_pipe(ngx_http_request_t *r, u_char *buf, ngx_http_log_op_t *op)
 {
@@ -664,11 +688,11 @@ ngx_http_log_iso8601(ngx_http_request_t *r, u_char *buf, ngx_http_log_op_t *op)
 static u_char *
 ngx_http_log_msec(ngx_http_request_t *r, u_char *buf, ngx_http_log_op_t *op)
 {
-    ngx_time_t  *tp;
+    ngx_time_t  tp;
 
-    tp = ngx_timeofday();
+    ngx_time_snapshot(&tp);
 
-    return ngx_sprintf(buf, "%T.%03M", tp->sec, tp->msec);
+    return ngx_sprintf(buf, "%T.%03M", tp.sec, tp.msec);
 }
 
 
@@ -676,16 +700,16 @@ static u_char *
 ngx_http_log_request_time(ngx_http_request_t *r, u_char *buf,
     ngx_http_log_op_t *op)
 {
-    ngx_time_t                *tp;
+    ngx_time_t                 tp;
     ngx_msec_int_t             ms;
     struct timeval             tv;
     ngx_http_core_loc_conf_t  *clcf;
 
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
     if (clcf->request_time_cache) {
-        tp = ngx_timeofday();
+        ngx_time_snapshot(&tp);
         ms = (ngx_msec_int_t)
-                 ((tp->sec - r->start_sec) * 1000 + (tp->msec - r->start_msec));
+                 ((tp.sec - r->start_sec) * 1000 + (tp.msec - r->start_msec));
     } else {
         ngx_gettimeofday(&tv);
         ms = (tv.tv_sec - r->start_sec) * 1000
@@ -702,16 +726,16 @@ static u_char *
 ngx_http_log_request_time_msec(ngx_http_request_t *r, u_char *buf,
     ngx_http_log_op_t *op)
 {
-    ngx_time_t                *tp;
+    ngx_time_t                 tp;
     ngx_msec_int_t             ms;
     struct timeval             tv;
     ngx_http_core_loc_conf_t  *clcf;
 
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
     if (clcf->request_time_cache) {
-        tp = ngx_timeofday();
+        ngx_time_snapshot(&tp);
         ms = (ngx_msec_int_t)
-                 ((tp->sec - r->start_sec) * 1000 + (tp->msec - r->start_msec));
+                 ((tp.sec - r->start_sec) * 1000 + (tp.msec - r->start_msec));
     } else {
         ngx_gettimeofday(&tv);
         ms = (tv.tv_sec - r->start_sec) * 1000
@@ -728,18 +752,18 @@ static u_char *
 ngx_http_log_request_time_usec(ngx_http_request_t *r, u_char *buf,
     ngx_http_log_op_t *op)
 {
-    ngx_time_t                *tp;
+    ngx_time_t                 tp;
     ngx_usec_int_t             us;
     struct timeval             tv;
     ngx_http_core_loc_conf_t  *clcf;
 
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
     if (clcf->request_time_cache) {
-        tp = ngx_timeofday();
+        ngx_time_snapshot(&tp);
 
         us = (ngx_usec_int_t) (1000 *
-                 ((tp->sec - r->start_sec) * 1000 + (tp->msec - r->start_msec)))
-                 + tp->usec - r->start_usec;
+                 ((tp.sec - r->start_sec) * 1000 + (tp.msec - r->start_msec)))
+                 + tp.usec - r->start_usec;
     } else {
         ngx_gettimeofday(&tv);
         us = (ngx_usec_int_t) (1000 * ((tv.tv_sec - r->start_sec) * 1000
@@ -885,7 +909,7 @@ ngx_http_log_variable(ngx_http_request_t *r, u_char *buf, ngx_http_log_op_t *op)
 static uintptr_t
 ngx_http_log_escape(u_char *dst, u_char *src, size_t size, ngx_uint_t flag)
 {
-    ngx_uint_t       n;
+    size_t           n, k;
     uint32_t        *escape;
     static u_char    hex[] = "0123456789ABCDEF";
 
@@ -934,20 +958,32 @@ ngx_http_log_escape(u_char *dst, u_char *src, size_t size, ngx_uint_t flag)
         n = 0;
 
         if (flag != NGX_HTTP_LOG_ESCAPE_OFF) {
-
-            while (size) {
-                if (escape[*src >> 5] & (1 << (*src & 0x1f))) {
-                    n++;
-                }
-                src++;
-                size--;
-            }
+            n = ngx_escape_count(src, size, escape);
         }
 
         return (uintptr_t) n;
     }
 
+    k = 0;
+
     while (size) {
+
+        if (k == 0) {
+            n = ngx_escape_span(dst, src, size, escape);
+
+            dst += n;
+            src += n;
+            size -= n;
+
+            if (size == 0) {
+                break;
+            }
+
+            k = NGX_ESCAPE_BLOCK;
+        }
+
+        k--;
+
         if (escape[*src >> 5] & (1 << (*src & 0x1f))) {
             *dst++ = '\\';
             *dst++ = 'x';
@@ -18,7 +18,6 @@
 typedef struct {
     ngx_array_t       *from;     /* array of ngx_cidr_t */
     ngx_uint_t         type;
-    ngx_uint_t         hash;
     ngx_str_t          header;
     ngx_flag_t         recursive;
 } ngx_http_realip_loc_conf_t;
@@ -107,12 +106,10 @@ ngx_module_t  ngx_http_realip_module = {
 static ngx_int_t
 ngx_http_realip_handler(ngx_http_request_t *r)
 {
-    u_char                      *ip, *p;
+    u_char                      *ip;
     size_t                       len;
-    ngx_uint_t                   i, hash;
     ngx_addr_t                   addr;
-    ngx_list_part_t             *part;
-    ngx_table_elt_t             *header;
+    ngx_table_elt_t             *h;
     ngx_connection_t            *c;
     ngx_http_realip_ctx_t       *ctx;
     ngx_http_realip_loc_conf_t  *rlcf;
@@ -155,40 +152,18 @@ ngx_http_realip_handler(ngx_http_request_t *r)
 
     default: /* NGX_HTTP_REALIP_HEADER */
 
-        part = &r->headers_in.headers.part;
-        header = part->elts;
+        h = ngx_http_find_header_in(r, rlcf->header.data, rlcf->header.len,
+                                    NULL);
 
-        hash = rlcf->hash;
-        len = rlcf->header.len;
-        p = rlcf->header.data;
-
-        for (i = 0; /* void */ ; i++) {
-
-            if (i >= part->nelts) {
-                if (part->next == NULL) {
-                    break;
-                }
-
-                part = part->next;
-                header = part->elts;
-                i = 0;
-            }
-
-            if (hash == header[i].hash
-                && len == header[i].key.len
-                && ngx_strncmp(p, header[i].lowcase_key, len) == 0)
-            {
-                len = header[i].value.len;
-                ip = header[i].value.data;
-
-                goto found;
-            }
+        if (h == NULL) {
+            return NGX_DECLINED;
         }
 
-        return NGX_DECLINED;
-    }
+        len = h->value.len;
+        ip = h->value.data;
 
-found:
+        break;
+    }
 
     c = r->connection;
 
@@ -342,7 +317,6 @@ ngx_http_realip(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     }
 
     rlcf->type = NGX_HTTP_REALIP_HEADER;
-    rlcf->hash = ngx_hash_strlow(value[1].data, value[1].data, value[1].len);
     rlcf->header = value[1];
 
     return NGX_CONF_OK;
@@ -363,7 +337,6 @@ ngx_http_realip_create_loc_conf(ngx_conf_t *cf)
      * set by ngx_pcalloc():
      *
      *     conf->from = NULL;
-     *     conf->hash = 0;
      *     conf->header = { 0, NULL };
      */
 
@@ -388,7 +361,6 @@ ngx_http_realip_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_value(conf->recursive, prev->recursive, 0);
 
     if (conf->header.len == 0) {
-        conf->hash = prev->hash;
         conf->header = prev->header;
     }
 
@@ -10,6 +10,9 @@
 #include <ngx_http.h>
 
 
+#define NGX_HTTP_REWRITE_STACK_SIZE  10
+
+
 typedef struct {
     ngx_array_t  *codes;        /* uintptr_t */
 
@@ -138,7 +141,8 @@ ngx_http_rewrite_handler(ngx_http_request_t *r)
 {
     ngx_int_t                     index;
     ngx_http_script_code_pt       code;
-    ngx_http_script_engine_t     *e;
+    ngx_http_script_engine_t     *e, engine;
+    ngx_http_variable_value_t     stack[NGX_HTTP_REWRITE_STACK_SIZE];
     ngx_http_core_srv_conf_t     *cscf;
     ngx_http_core_main_conf_t    *cmcf;
     ngx_http_rewrite_loc_conf_t  *rlcf;
@@ -158,15 +162,24 @@ ngx_http_rewrite_handler(ngx_http_request_t *r)
         return NGX_DECLINED;
     }
 
-    e = ngx_pcalloc(r->pool, sizeof(ngx_http_script_engine_t));
-    if (e == NULL) {
-        return NGX_HTTP_INTERNAL_SERVER_ERROR;
-    }
+    /*
+     * the engine and its stack live only while the codes run,
+     * so they are not allocated from the request pool
+     */
 
-    e->sp = ngx_pcalloc(r->pool,
-                        rlcf->stack_size * sizeof(ngx_http_variable_value_t));
-    if (e->sp == NULL) {
-        return NGX_HTTP_INTERNAL_SERVER_ERROR;
+    e = &engine;
+    ngx_memzero(e, sizeof(ngx_http_script_engine_t));
+
+    if (rlcf->stack_size <= NGX_HTTP_REWRITE_STACK_SIZE) {
+        ngx_memzero(stack, sizeof(stack));
+        e->sp = stack;
+
+    } else {
+        e->sp = ngx_pcalloc(r->pool,
+                          rlcf->stack_size * sizeof(ngx_http_variable_value_t));
+        if (e->sp == NULL) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
     }
 
     e->ip = rlcf->codes->elts;
@@ -255,7 +268,8 @@ ngx_http_rewrite_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_value(conf->log, prev->log, 0);
     ngx_conf_merge_value(conf->uninitialized_variable_warn,
                          prev->uninitialized_variable_warn, 1);
-    ngx_conf_merge_uint_value(conf->stack_size, prev->stack_size, 10);
+    ngx_conf_merge_uint_value(conf->stack_size, prev->stack_size,
+                              NGX_HTTP_REWRITE_STACK_SIZE);
 
     if (conf->codes == NULL) {
         return NGX_CONF_OK;
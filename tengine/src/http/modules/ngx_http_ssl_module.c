@@ -32,6 +32,17 @@ static char *ngx_http_ssl_enable(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
 static char *ngx_http_ssl_session_cache(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static char *ngx_http_ssl_session_ticket_keys(ngx_conf_t *cf,
+    ngx_command_t *cmd, void *conf);
+static char *ngx_http_ssl_async_handshake(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf);
+
+#if (NGX_HTTP_V2                                                              \
+     && defined TLSEXT_TYPE_application_layer_protocol_negotiation)
+static int ngx_http_ssl_alpn_select(ngx_ssl_conn_t *ssl_conn,
+    const unsigned char **out, unsigned char *outlen,
+    const unsigned char *in, unsigned int inlen, void *arg);
+#endif
 
 
 static ngx_conf_bitmask_t  ngx_http_ssl_protocols[] = {
@@ -142,12 +153,26 @@ static ngx_command_t  ngx_http_ssl_commands[] = {
       NULL },
 
     { ngx_string("ssl_session_cache"),
-      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE12,
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE123,
       ngx_http_ssl_session_cache,
       NGX_HTTP_SRV_CONF_OFFSET,
       0,
       NULL },
 
+    { ngx_string("ssl_buffer_size"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_ssl_srv_conf_t, buffer_size),
+      NULL },
+
+    { ngx_string("ssl_session_ticket_keys"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE123,
+      ngx_http_ssl_session_ticket_keys,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
     { ngx_string("ssl_session_timeout"),
       NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
       ngx_conf_set_sec_slot,
@@ -162,6 +187,13 @@ static ngx_command_t  ngx_http_ssl_commands[] = {
       offsetof(ngx_http_ssl_srv_conf_t, crl),
       NULL },
 
+    { ngx_string("ssl_async_handshake"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_http_ssl_async_handshake,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      0,
+      NULL },
+
       ngx_null_command
 };
 
@@ -234,6 +266,46 @@ static ngx_http_variable_t  ngx_http_ssl_vars[] = {
 static ngx_str_t ngx_http_ssl_sess_id_ctx = ngx_string("HTTP");
 
 
+#if (NGX_HTTP_V2                                                              \
+     && defined TLSEXT_TYPE_application_layer_protocol_negotiation)
+
+static int
+ngx_http_ssl_alpn_select(ngx_ssl_conn_t *ssl_conn, const unsigned char **out,
+    unsigned char *outlen, const unsigned char *in, unsigned int inlen,
+    void *arg)
+{
+    ngx_connection_t    *c;
+    ngx_http_request_t  *r;
+
+    c = ngx_ssl_get_connection(ssl_conn);
+    r = c->data;
+
+    /* "h2" is offered only on the listen sockets with the "http2" flag */
+
+    if (!r->http_connection->http2) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+
+    if (SSL_select_next_proto((unsigned char **) out, outlen,
+                              (unsigned char *) NGX_HTTP_V2_ALPN_ADVERTISE
+                                                "\x08http/1.1",
+                              sizeof(NGX_HTTP_V2_ALPN_ADVERTISE "\x08http/1.1")
+                              - 1,
+                              in, inlen)
+        != OPENSSL_NPN_NEGOTIATED)
+    {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "SSL ALPN selected: %*s", (size_t) *outlen, *out);
+
+    return SSL_TLSEXT_ERR_OK;
+}
+
+#endif
+
+
 static ngx_int_t
 ngx_http_ssl_static_variable(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data)
@@ -346,6 +418,11 @@ ngx_http_ssl_create_srv_conf(ngx_conf_t *cf)
     sscf->verify_depth = NGX_CONF_UNSET_UINT;
     sscf->builtin_session_cache = NGX_CONF_UNSET;
     sscf->session_timeout = NGX_CONF_UNSET;
+    sscf->buffer_size = NGX_CONF_UNSET_SIZE;
+    sscf->ticket_keys = NGX_CONF_UNSET_PTR;
+#if (NGX_THREAD_POOL)
+    sscf->thread_pool = NGX_CONF_UNSET_PTR;
+#endif
 
     return sscf;
 }
@@ -375,6 +452,9 @@ ngx_http_ssl_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
     ngx_conf_merge_value(conf->session_timeout,
                          prev->session_timeout, 300);
 
+    ngx_conf_merge_size_value(conf->buffer_size, prev->buffer_size,
+                              NGX_SSL_BUFSIZE);
+
     ngx_conf_merge_value(conf->prefer_server_ciphers,
                          prev->prefer_server_ciphers, 0);
 
@@ -403,6 +483,11 @@ ngx_http_ssl_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
                          "builtin");
 
 
+#if (NGX_THREAD_POOL)
+    ngx_conf_merge_ptr_value(conf->thread_pool, prev->thread_pool, NULL);
+    conf->ssl.thread_pool = conf->thread_pool;
+#endif
+
     conf->ssl.log = cf->log;
 
     if (conf->enable) {
@@ -441,6 +526,8 @@ ngx_http_ssl_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
         return NGX_CONF_ERROR;
     }
 
+    conf->ssl.buffer_size = conf->buffer_size;
+
 #ifdef SSL_CTRL_SET_TLSEXT_HOSTNAME
 
     if (SSL_CTX_set_tlsext_servername_callback(conf->ssl.ctx,
@@ -455,6 +542,11 @@ ngx_http_ssl_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
 
 #endif
 
+#if (NGX_HTTP_V2                                                              \
+     && defined TLSEXT_TYPE_application_layer_protocol_negotiation)
+    SSL_CTX_set_alpn_select_cb(conf->ssl.ctx, ngx_http_ssl_alpn_select, NULL);
+#endif
+
     cln = ngx_pool_cleanup_add(cf->pool, 0);
     if (cln == NULL) {
         return NGX_CONF_ERROR;
@@ -539,6 +631,14 @@ ngx_http_ssl_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
         return NGX_CONF_ERROR;
     }
 
+    ngx_conf_merge_ptr_value(conf->ticket_keys, prev->ticket_keys, NULL);
+
+    if (conf->ticket_keys
+        && ngx_ssl_session_ticket_keys(&conf->ssl, conf->ticket_keys) != NGX_OK)
+    {
+        return NGX_CONF_ERROR;
+    }
+
     return NGX_CONF_OK;
 }
 
@@ -568,13 +668,17 @@ ngx_http_ssl_session_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
     ngx_http_ssl_srv_conf_t *sscf = conf;
 
-    size_t       len;
-    ngx_str_t   *value, name, size;
-    ngx_int_t    n;
+    size_t       len, zone_size;
+    ngx_str_t   *value, name, size, zone;
+    ngx_int_t    n, shards;
     ngx_uint_t   i, j;
 
     value = cf->args->elts;
 
+    ngx_str_null(&zone);
+    zone_size = 0;
+    shards = 1;
+
     for (i = 1; i < cf->args->nelts; i++) {
 
         if (ngx_strcmp(value[i].data, "off") == 0) {
@@ -647,13 +751,19 @@ ngx_http_ssl_session_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
                 return NGX_CONF_ERROR;
             }
 
-            sscf->shm_zone = ngx_shared_memory_add(cf, &name, n,
-                                                   &ngx_http_ssl_module);
-            if (sscf->shm_zone == NULL) {
-                return NGX_CONF_ERROR;
-            }
+            zone = name;
+            zone_size = n;
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "shards=", 7) == 0) {
+
+            shards = ngx_atoi(value[i].data + 7, value[i].len - 7);
 
-            sscf->shm_zone->init = ngx_ssl_session_cache_init;
+            if (shards < 1 || shards > NGX_SSL_SESSION_SHARDS_MAX) {
+                goto invalid;
+            }
 
             continue;
         }
@@ -661,6 +771,20 @@ ngx_http_ssl_session_cache(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         goto invalid;
     }
 
+    if (zone.len) {
+        sscf->shm_zone = ngx_ssl_session_cache_add(cf, &zone, zone_size,
+                                                   shards,
+                                                   &ngx_http_ssl_module);
+        if (sscf->shm_zone == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+    } else if (shards != 1) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"shards\" requires a shared session cache");
+        return NGX_CONF_ERROR;
+    }
+
     if (sscf->shm_zone && sscf->builtin_session_cache == NGX_CONF_UNSET) {
         sscf->builtin_session_cache = NGX_SSL_NO_BUILTIN_SCACHE;
     }
@@ -674,3 +798,178 @@ invalid:
 
     return NGX_CONF_ERROR;
 }
+
+
+static char *
+ngx_http_ssl_session_ticket_keys(ngx_conf_t *cf, ngx_command_t *cmd,
+    void *conf)
+{
+    ngx_http_ssl_srv_conf_t *sscf = conf;
+
+    time_t                      rotate;
+    ngx_str_t                  *value, name, s;
+    ngx_int_t                   keep;
+    ngx_uint_t                  i;
+    ngx_shm_zone_t             *shm_zone;
+    ngx_ssl_ticket_keys_ctx_t  *ctx;
+
+    if (sscf->ticket_keys != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+
+        if (cf->args->nelts > 2) {
+            return "invalid number of arguments";
+        }
+
+        sscf->ticket_keys = NULL;
+        return NGX_CONF_OK;
+    }
+
+    if (value[1].len <= sizeof("shared:") - 1
+        || ngx_strncmp(value[1].data, "shared:", sizeof("shared:") - 1) != 0)
+    {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "invalid session ticket keys \"%V\"", &value[1]);
+        return NGX_CONF_ERROR;
+    }
+
+    name.len = value[1].len - (sizeof("shared:") - 1);
+    name.data = value[1].data + sizeof("shared:") - 1;
+
+    rotate = 3600;
+    keep = 2;
+
+    for (i = 2; i < cf->args->nelts; i++) {
+
+        if (ngx_strncmp(value[i].data, "rotate=", 7) == 0) {
+
+            s.len = value[i].len - 7;
+            s.data = value[i].data + 7;
+
+            rotate = ngx_parse_time(&s, 1);
+            if (rotate == (time_t) NGX_ERROR) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        if (ngx_strncmp(value[i].data, "keep=", 5) == 0) {
+
+            keep = ngx_atoi(value[i].data + 5, value[i].len - 5);
+            if (keep < 1 || keep > NGX_SSL_TICKET_KEYS_MAX) {
+                goto invalid;
+            }
+
+            continue;
+        }
+
+        goto invalid;
+    }
+
+    shm_zone = ngx_shared_memory_add(cf, &name, 8 * ngx_pagesize,
+                                     &ngx_http_ssl_module);
+    if (shm_zone == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    if (shm_zone->data) {
+        ctx = shm_zone->data;
+
+        if (shm_zone->init != ngx_ssl_session_ticket_keys_init
+            || ctx->rotate != rotate
+            || ctx->keep != (ngx_uint_t) keep)
+        {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "shared memory zone \"%V\" is already used "
+                               "with other parameters", &name);
+            return NGX_CONF_ERROR;
+        }
+
+        sscf->ticket_keys = shm_zone;
+        return NGX_CONF_OK;
+    }
+
+    ctx = ngx_pcalloc(cf->pool, sizeof(ngx_ssl_ticket_keys_ctx_t));
+    if (ctx == NULL) {
+        return NGX_CONF_ERROR;
+    }
+
+    ctx->rotate = rotate;
+    ctx->keep = keep;
+
+    shm_zone->init = ngx_ssl_session_ticket_keys_init;
+    shm_zone->data = ctx;
+
+    sscf->ticket_keys = shm_zone;
+
+    return NGX_CONF_OK;
+
+invalid:
+
+    ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                       "invalid parameter \"%V\"", &value[i]);
+
+    return NGX_CONF_ERROR;
+}
+
+
+static char *
+ngx_http_ssl_async_handshake(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
+{
+#if (NGX_THREAD_POOL)
+    ngx_http_ssl_srv_conf_t *sscf = conf;
+
+    ngx_str_t  *value, name;
+
+    if (sscf->thread_pool != NGX_CONF_UNSET_PTR) {
+        return "is duplicate";
+    }
+#else
+    ngx_str_t  *value;
+#endif
+
+    value = cf->args->elts;
+
+    if (ngx_strcmp(value[1].data, "off") == 0) {
+#if (NGX_THREAD_POOL)
+        sscf->thread_pool = NULL;
+#endif
+        return NGX_CONF_OK;
+    }
+
+    if (ngx_strncmp(value[1].data, "threads", 7) == 0
+        && (value[1].len == 7 || value[1].data[7] == '='))
+    {
+#if (NGX_THREAD_POOL)
+
+        if (value[1].len > 8) {
+            name.len = value[1].len - 8;
+            name.data = value[1].data + 8;
+
+            sscf->thread_pool = ngx_thread_pool_add(cf, &name);
+
+        } else {
+            sscf->thread_pool = ngx_thread_pool_add(cf, NULL);
+        }
+
+        if (sscf->thread_pool == NULL) {
+            return NGX_CONF_ERROR;
+        }
+
+        return NGX_CONF_OK;
+
+#else
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"ssl_async_handshake threads\" requires nginx "
+                           "to be built --with-thread-pool");
+        return NGX_CONF_ERROR;
+#endif
+    }
+
+    return "invalid value";
+}
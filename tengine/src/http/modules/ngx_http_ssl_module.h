@@ -30,6 +30,8 @@ typedef struct {
 
     time_t                          session_timeout;
 
+    size_t                          buffer_size;
+
     ngx_str_t                       certificate;
     ngx_str_t                       certificate_key;
     ngx_str_t                       pass_phrase_dialog;
@@ -41,6 +43,11 @@ typedef struct {
     ngx_str_t                       ciphers;
 
     ngx_shm_zone_t                 *shm_zone;
+    ngx_shm_zone_t                 *ticket_keys;
+
+#if (NGX_THREAD_POOL)
+    ngx_thread_pool_t              *thread_pool;
+#endif
 
     u_char                         *file;
     ngx_uint_t                      line;
@@ -10,8 +10,53 @@
 #include <ngx_http.h>
 
 
+#define NGX_HTTP_STATUS_EVENT_LOOPS                                          \
+    "Event loops: pid wakeups events batch busy_polls wait_time loop_time "  \
+    "handler_time\n"
+
+#define NGX_HTTP_STATUS_EVENT_LOOP_LEN  (8 * (1 + NGX_ATOMIC_T_LEN) + 1)
+
+#define NGX_HTTP_STATUS_MEMORY                                               \
+    "Connection memory: total per_connection\n"
+
+#define NGX_HTTP_STATUS_SLAB_ZONES                                           \
+    "Slab zones: zone pages free max_free fails\n"
+
+#define NGX_HTTP_STATUS_SLAB_SIZES                                           \
+    "Slab sizes: zone size total used cached reqs fails\n"
+
+#define NGX_HTTP_STATUS_SSL_HANDSHAKES                                       \
+    "SSL handshakes: threads queued thread_time\n"
+
+#define NGX_HTTP_STATUS_SSL_SESSION_CACHES                                   \
+    "SSL session caches: zone shards hits misses evictions contended\n"
+
+
+typedef struct {
+    ngx_flag_t         locks;
+    ngx_flag_t         event_loops;
+    ngx_flag_t         memory;
+    ngx_flag_t         slabs;
+    ngx_flag_t         ssl_handshakes;
+    ngx_flag_t         ssl_session_caches;
+} ngx_http_stub_status_loc_conf_t;
+
+
+static u_char *ngx_http_status_lock(u_char *p, ngx_str_t *name,
+    ngx_shmtx_t *mtx);
+static u_char *ngx_http_status_event_loop(u_char *p,
+    ngx_event_loop_stat_t *stat);
+static u_char *ngx_http_status_slab_sizes(u_char *p, ngx_str_t *name,
+    ngx_slab_info_t *info);
+#if (NGX_HTTP_SSL)
+static u_char *ngx_http_status_ssl_session_cache(u_char *p,
+    ngx_shm_zone_t *shm_zone);
+#endif
 static char *ngx_http_set_status(ngx_conf_t *cf, ngx_command_t *cmd,
     void *conf);
+static void *ngx_http_stub_status_create_loc_conf(ngx_conf_t *cf);
+static char *ngx_http_stub_status_merge_loc_conf(ngx_conf_t *cf, void *parent,
+    void *child);
 static ngx_int_t ngx_http_stub_status_init(ngx_conf_t *cf);
 
 
@@ -24,6 +69,56 @@ static ngx_command_t  ngx_http_status_commands[] = {
       0,
       NULL },
 
+    { ngx_string("stub_status_locks"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_stub_status_loc_conf_t, locks),
+      NULL },
+
+    { ngx_string("stub_status_event_loops"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_stub_status_loc_conf_t, event_loops),
+      NULL },
+
+    { ngx_string("stub_status_memory"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_stub_status_loc_conf_t, memory),
+      NULL },
+
+    { ngx_string("stub_status_slabs"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_stub_status_loc_conf_t, slabs),
+      NULL },
+
+#if (NGX_HTTP_SSL && NGX_THREAD_POOL)
+
+    { ngx_string("stub_status_ssl_handshakes"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_stub_status_loc_conf_t, ssl_handshakes),
+      NULL },
+
+#endif
+
+#if (NGX_HTTP_SSL)
+
+    { ngx_string("stub_status_ssl_session_caches"),
+      NGX_HTTP_SRV_CONF|NGX_HTTP_LOC_CONF|NGX_CONF_FLAG,
+      ngx_conf_set_flag_slot,
+      NGX_HTTP_LOC_CONF_OFFSET,
+      offsetof(ngx_http_stub_status_loc_conf_t, ssl_session_caches),
+      NULL },
+
+#endif
+
       ngx_null_command
 };
 
@@ -39,8 +134,8 @@ static ngx_http_module_t  ngx_http_stub_status_module_ctx = {
     NULL,                                  /* create server configuration */
     NULL,                                  /* merge server configuration */
 
-    NULL,                                  /* create location configuration */
-    NULL                                   /* merge location configuration */
+    ngx_http_stub_status_create_loc_conf,  /* create location configuration */
+    ngx_http_stub_status_merge_loc_conf    /* merge location configuration */
 };
 
 
@@ -63,11 +158,18 @@ ngx_module_t  ngx_http_stub_status_module = {
 static ngx_int_t
 ngx_http_status_handler(ngx_http_request_t *r)
 {
-    size_t             size;
-    ngx_int_t          rc;
-    ngx_buf_t         *b;
-    ngx_chain_t        out;
-    ngx_atomic_int_t   ap, hn, ac, rq, rd, wr, rt;
+    size_t                            size;
+    ngx_int_t                         rc;
+    ngx_str_t                         name;
+    ngx_buf_t                        *b;
+    ngx_uint_t                        i, n;
+    ngx_chain_t                       out;
+    ngx_shm_zone_t                   *shm_zone;
+    ngx_slab_pool_t                  *sp;
+    ngx_atomic_int_t                  ap, hn, ac, rq, rd, wr, rt;
+    ngx_list_part_t                  *part;
+    ngx_slab_info_t                  *info;
+    ngx_http_stub_status_loc_conf_t  *sscf;
 
     if (r->method != NGX_HTTP_GET && r->method != NGX_HTTP_HEAD) {
         return NGX_HTTP_NOT_ALLOWED;
@@ -96,6 +198,115 @@ ngx_http_status_handler(ngx_http_request_t *r)
            + 6 + 4 * NGX_ATOMIC_T_LEN
            + sizeof("Reading:  Writing:  Waiting:  \n") + 3 * NGX_ATOMIC_T_LEN;
 
+    sscf = ngx_http_get_module_loc_conf(r, ngx_http_stub_status_module);
+
+    if (sscf->locks) {
+        size += sizeof("Locks: acquired contended wait_time\n") - 1
+                + sizeof(" accept_mutex") - 1 + 4 + 3 * NGX_ATOMIC_T_LEN;
+
+        part = (ngx_list_part_t *) &ngx_cycle->shared_memory.part;
+        shm_zone = part->elts;
+
+        for (i = 0; /* void */ ; i++) {
+
+            if (i >= part->nelts) {
+                if (part->next == NULL) {
+                    break;
+                }
+
+                part = part->next;
+                shm_zone = part->elts;
+                i = 0;
+            }
+
+            size += 1 + shm_zone[i].shm.name.len + 4 + 3 * NGX_ATOMIC_T_LEN;
+        }
+    }
+
+    if (sscf->event_loops) {
+        size += sizeof(NGX_HTTP_STATUS_EVENT_LOOPS) - 1;
+
+        if (ngx_stat_loops) {
+            for (i = 0; i < NGX_MAX_PROCESSES; i++) {
+                if (ngx_stat_loops[i].pid) {
+                    size += NGX_HTTP_STATUS_EVENT_LOOP_LEN;
+                }
+            }
+
+        } else {
+            size += NGX_HTTP_STATUS_EVENT_LOOP_LEN;
+        }
+    }
+
+    if (sscf->memory) {
+        size += sizeof(NGX_HTTP_STATUS_MEMORY) - 1 + 3 + 2 * NGX_ATOMIC_T_LEN;
+    }
+
+    n = 0;
+
+    if (sscf->slabs) {
+        size += sizeof(NGX_HTTP_STATUS_SLAB_ZONES) - 1
+                + sizeof(NGX_HTTP_STATUS_SLAB_SIZES) - 1;
+
+        part = (ngx_list_part_t *) &ngx_cycle->shared_memory.part;
+        shm_zone = part->elts;
+
+        for (i = 0; /* void */ ; i++) {
+
+            if (i >= part->nelts) {
+                if (part->next == NULL) {
+                    break;
+                }
+
+                part = part->next;
+                shm_zone = part->elts;
+                i = 0;
+            }
+
+            sp = (ngx_slab_pool_t *) shm_zone[i].shm.addr;
+
+            size += 1 + shm_zone[i].shm.name.len + 5 + 4 * NGX_ATOMIC_T_LEN
+                    + (ngx_pagesize_shift - sp->min_shift)
+                      * (1 + shm_zone[i].shm.name.len
+                         + 7 + 6 * NGX_ATOMIC_T_LEN);
+            n++;
+        }
+    }
+
+    if (sscf->ssl_handshakes) {
+        size += sizeof(NGX_HTTP_STATUS_SSL_HANDSHAKES) - 1
+                + 4 + 3 * NGX_ATOMIC_T_LEN;
+    }
+
+#if (NGX_HTTP_SSL)
+
+    if (sscf->ssl_session_caches) {
+        size += sizeof(NGX_HTTP_STATUS_SSL_SESSION_CACHES) - 1;
+
+        part = (ngx_list_part_t *) &ngx_cycle->shared_memory.part;
+        shm_zone = part->elts;
+
+        for (i = 0; /* void */ ; i++) {
+
+            if (i >= part->nelts) {
+                if (part->next == NULL) {
+                    break;
+                }
+
+                part = part->next;
+                shm_zone = part->elts;
+                i = 0;
+            }
+
+            if (shm_zone[i].init == ngx_ssl_session_cache_init) {
+                size += 1 + shm_zone[i].shm.name.len
+                        + 6 + 5 * NGX_ATOMIC_T_LEN;
+            }
+        }
+    }
+
+#endif
+
     b = ngx_create_temp_buf(r->pool, size);
     if (b == NULL) {
         return NGX_HTTP_INTERNAL_SERVER_ERROR;
@@ -123,6 +334,170 @@ ngx_http_status_handler(ngx_http_request_t *r)
     b->last = ngx_sprintf(b->last, "Reading: %uA Writing: %uA Waiting: %uA \n",
                           rd, wr, ac - (rd + wr));
 
+    if (sscf->locks) {
+        b->last = ngx_cpymem(b->last, "Locks: acquired contended wait_time\n",
+                        sizeof("Locks: acquired contended wait_time\n") - 1);
+
+        if (ngx_accept_mutex_ptr) {
+            ngx_str_set(&name, "accept_mutex");
+            b->last = ngx_http_status_lock(b->last, &name, &ngx_accept_mutex);
+        }
+
+        part = (ngx_list_part_t *) &ngx_cycle->shared_memory.part;
+        shm_zone = part->elts;
+
+        for (i = 0; /* void */ ; i++) {
+
+            if (i >= part->nelts) {
+                if (part->next == NULL) {
+                    break;
+                }
+
+                part = part->next;
+                shm_zone = part->elts;
+                i = 0;
+            }
+
+            sp = (ngx_slab_pool_t *) shm_zone[i].shm.addr;
+
+            b->last = ngx_http_status_lock(b->last, &shm_zone[i].shm.name,
+                                           &sp->mutex);
+        }
+    }
+
+    if (sscf->event_loops) {
+        b->last = ngx_cpymem(b->last, NGX_HTTP_STATUS_EVENT_LOOPS,
+                             sizeof(NGX_HTTP_STATUS_EVENT_LOOPS) - 1);
+
+        if (ngx_stat_loops) {
+
+            /* the processes may have come in the meantime */
+
+            for (i = 0; i < NGX_MAX_PROCESSES; i++) {
+                if (ngx_stat_loops[i].pid
+                    && (size_t) (b->end - b->last)
+                       >= NGX_HTTP_STATUS_EVENT_LOOP_LEN)
+                {
+                    b->last = ngx_http_status_event_loop(b->last,
+                                                         &ngx_stat_loops[i]);
+                }
+            }
+
+        } else {
+            b->last = ngx_http_status_event_loop(b->last, ngx_stat_loop);
+        }
+    }
+
+    if (sscf->memory) {
+        b->last = ngx_cpymem(b->last, NGX_HTTP_STATUS_MEMORY,
+                             sizeof(NGX_HTTP_STATUS_MEMORY) - 1);
+
+        b->last = ngx_sprintf(b->last, " %uA %uA\n", *ngx_stat_conn_memory,
+                              ac ? *ngx_stat_conn_memory / ac : 0);
+    }
+
+    if (sscf->slabs) {
+        b->last = ngx_cpymem(b->last, NGX_HTTP_STATUS_SLAB_ZONES,
+                             sizeof(NGX_HTTP_STATUS_SLAB_ZONES) - 1);
+
+        info = ngx_palloc(r->pool, n * sizeof(ngx_slab_info_t));
+        if (info == NULL) {
+            return NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+
+        part = (ngx_list_part_t *) &ngx_cycle->shared_memory.part;
+        shm_zone = part->elts;
+        n = 0;
+
+        for (i = 0; /* void */ ; i++) {
+
+            if (i >= part->nelts) {
+                if (part->next == NULL) {
+                    break;
+                }
+
+                part = part->next;
+                shm_zone = part->elts;
+                i = 0;
+            }
+
+            sp = (ngx_slab_pool_t *) shm_zone[i].shm.addr;
+
+            if (ngx_slab_stat(sp, &info[n], r->pool) != NGX_OK) {
+                return NGX_HTTP_INTERNAL_SERVER_ERROR;
+            }
+
+            b->last = ngx_sprintf(b->last, " %V %ui %ui %ui %ui\n",
+                                  &shm_zone[i].shm.name, info[n].pages,
+                                  info[n].free, info[n].max_free,
+                                  info[n].fails);
+            n++;
+        }
+
+        b->last = ngx_cpymem(b->last, NGX_HTTP_STATUS_SLAB_SIZES,
+                             sizeof(NGX_HTTP_STATUS_SLAB_SIZES) - 1);
+
+        part = (ngx_list_part_t *) &ngx_cycle->shared_memory.part;
+        shm_zone = part->elts;
+        n = 0;
+
+        for (i = 0; /* void */ ; i++) {
+
+            if (i >= part->nelts) {
+                if (part->next == NULL) {
+                    break;
+                }
+
+                part = part->next;
+                shm_zone = part->elts;
+                i = 0;
+            }
+
+            b->last = ngx_http_status_slab_sizes(b->last,
+                                                 &shm_zone[i].shm.name,
+                                                 &info[n++]);
+        }
+    }
+
+    if (sscf->ssl_handshakes) {
+        b->last = ngx_cpymem(b->last, NGX_HTTP_STATUS_SSL_HANDSHAKES,
+                             sizeof(NGX_HTTP_STATUS_SSL_HANDSHAKES) - 1);
+
+        b->last = ngx_sprintf(b->last, " %uA %uA %uA\n",
+                              *ngx_stat_ssl_handshakes, *ngx_stat_ssl_queued,
+                              *ngx_stat_ssl_handshake_time);
+    }
+
+#if (NGX_HTTP_SSL)
+
+    if (sscf->ssl_session_caches) {
+        b->last = ngx_cpymem(b->last, NGX_HTTP_STATUS_SSL_SESSION_CACHES,
+                             sizeof(NGX_HTTP_STATUS_SSL_SESSION_CACHES) - 1);
+
+        part = (ngx_list_part_t *) &ngx_cycle->shared_memory.part;
+        shm_zone = part->elts;
+
+        for (i = 0; /* void */ ; i++) {
+
+            if (i >= part->nelts) {
+                if (part->next == NULL) {
+                    break;
+                }
+
+                part = part->next;
+                shm_zone = part->elts;
+                i = 0;
+            }
+
+            if (shm_zone[i].init == ngx_ssl_session_cache_init) {
+                b->last = ngx_http_status_ssl_session_cache(b->last,
+                                                            &shm_zone[i]);
+            }
+        }
+    }
+
+#endif
+
     r->headers_out.status = NGX_HTTP_OK;
     r->headers_out.content_length_n = b->last - b->pos;
 
@@ -138,6 +513,80 @@ ngx_http_status_handler(ngx_http_request_t *r)
 }
 
 
+static u_char *
+ngx_http_status_lock(u_char *p, ngx_str_t *name, ngx_shmtx_t *mtx)
+{
+    ngx_shmtx_stat_t  *stat;
+
+    stat = mtx->stat;
+
+    return ngx_sprintf(p, " %V %uA %uA %uA\n", name, stat->acquired,
+                       stat->contended, stat->wait_time);
+}
+
+
+static u_char *
+ngx_http_status_event_loop(u_char *p, ngx_event_loop_stat_t *stat)
+{
+    return ngx_sprintf(p, " %uA %uA %uA %uA %uA %uA %uA %uA\n",
+                       stat->pid, stat->wakeups, stat->events, stat->batch,
+                       stat->busy_polls, stat->wait_time, stat->loop_time,
+                       stat->handler_time);
+}
+
+
+static u_char *
+ngx_http_status_slab_sizes(u_char *p, ngx_str_t *name, ngx_slab_info_t *info)
+{
+    ngx_uint_t        i;
+    ngx_slab_stat_t  *stat;
+
+    for (i = 0; i < info->nslots; i++) {
+        stat = &info->stats[i];
+
+        p = ngx_sprintf(p, " %V %uz %ui %ui %ui %ui %ui\n", name,
+                        info->min_size << i, stat->total, stat->used,
+                        stat->cached, stat->reqs, stat->fails);
+    }
+
+    return p;
+}
+
+
+#if (NGX_HTTP_SSL)
+
+static u_char *
+ngx_http_status_ssl_session_cache(u_char *p, ngx_shm_zone_t *shm_zone)
+{
+    ngx_uint_t                    i, hits, misses, evictions, contended;
+    ngx_ssl_session_shard_t      *shard;
+    ngx_ssl_session_cache_t      *cache;
+    ngx_ssl_session_cache_ctx_t  *ctx;
+
+    ctx = shm_zone->data;
+    cache = ctx->sh;
+
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+    contended = 0;
+
+    for (i = 0; i < cache->nshards; i++) {
+        shard = cache->shards[i];
+
+        hits += shard->hits;
+        misses += shard->misses;
+        evictions += shard->evictions;
+        contended += shard->mutex.stat->contended;
+    }
+
+    return ngx_sprintf(p, " %V %ui %ui %ui %ui %ui\n", &shm_zone->shm.name,
+                       cache->nshards, hits, misses, evictions, contended);
+}
+
+#endif
+
+
 static char *
 ngx_http_set_status(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
@@ -150,6 +599,45 @@ ngx_http_set_status(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 }
 
 
+static void *
+ngx_http_stub_status_create_loc_conf(ngx_conf_t *cf)
+{
+    ngx_http_stub_status_loc_conf_t  *conf;
+
+    conf = ngx_palloc(cf->pool, sizeof(ngx_http_stub_status_loc_conf_t));
+    if (conf == NULL) {
+        return NULL;
+    }
+
+    conf->locks = NGX_CONF_UNSET;
+    conf->event_loops = NGX_CONF_UNSET;
+    conf->memory = NGX_CONF_UNSET;
+    conf->slabs = NGX_CONF_UNSET;
+    conf->ssl_handshakes = NGX_CONF_UNSET;
+    conf->ssl_session_caches = NGX_CONF_UNSET;
+
+    return conf;
+}
+
+
+static char *
+ngx_http_stub_status_merge_loc_conf(ngx_conf_t *cf, void *parent, void *child)
+{
+    ngx_http_stub_status_loc_conf_t *prev = parent;
+    ngx_http_stub_status_loc_conf_t *conf = child;
+
+    ngx_conf_merge_value(conf->locks, prev->locks, 0);
+    ngx_conf_merge_value(conf->event_loops, prev->event_loops, 0);
+    ngx_conf_merge_value(conf->memory, prev->memory, 0);
+    ngx_conf_merge_value(conf->slabs, prev->slabs, 0);
+    ngx_conf_merge_value(conf->ssl_handshakes, prev->ssl_handshakes, 0);
+    ngx_conf_merge_value(conf->ssl_session_caches,
+                         prev->ssl_session_caches, 0);
+
+    return NGX_CONF_OK;
+}
+
+
 static ngx_int_t
 ngx_http_status_log_handler(ngx_http_request_t *r)
 {
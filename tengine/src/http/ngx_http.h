@@ -18,6 +18,7 @@ typedef struct ngx_http_upstream_s    ngx_http_upstream_t;
 typedef struct ngx_http_cache_s       ngx_http_cache_t;
 typedef struct ngx_http_file_cache_s  ngx_http_file_cache_t;
 typedef struct ngx_http_log_ctx_s     ngx_http_log_ctx_t;
+typedef struct ngx_http_v2_stream_s   ngx_http_v2_stream_t;
 
 typedef ngx_int_t (*ngx_http_header_handler_pt)(ngx_http_request_t *r,
     ngx_table_elt_t *h, ngx_uint_t offset);
@@ -43,6 +44,9 @@ typedef u_char *(*ngx_http_log_handler_pt)(ngx_http_request_t *r,
 #if (NGX_HTTP_SSL)
 #include <ngx_http_ssl_module.h>
 #endif
+#if (NGX_HTTP_V2)
+#include <ngx_http_v2.h>
+#endif
 
 
 struct ngx_http_log_ctx_s {
@@ -72,6 +76,14 @@ ngx_int_t ngx_http_add_listen(ngx_conf_t *cf, ngx_http_core_srv_conf_t *cscf,
 
 
 void ngx_http_init_connection(ngx_connection_t *c);
+void ngx_http_init_request(ngx_event_t *rev);
+void ngx_http_close_request(ngx_http_request_t *r, ngx_int_t rc);
+void ngx_http_free_request(ngx_http_request_t *r, ngx_int_t rc);
+void ngx_http_close_connection(ngx_connection_t *c);
+ngx_uint_t ngx_http_headers_index_key(u_char *name, size_t len);
+ngx_http_headers_index_t *ngx_http_headers_in_index(ngx_http_request_t *r);
+ngx_table_elt_t *ngx_http_find_header_in(ngx_http_request_t *r, u_char *name,
+    size_t len, ngx_uint_t *next);
 
 #ifdef SSL_CTRL_SET_TLSEXT_HOSTNAME
 int ngx_http_ssl_servername(ngx_ssl_conn_t *ssl_conn, int *ad, void *arg);
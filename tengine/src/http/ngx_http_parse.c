@@ -98,6 +98,92 @@ static uint32_t  usual[] = {
 #endif
 
 
+#if (NGX_HAVE_SSE42_INTRINSICS)
+
+#include <nmmintrin.h>
+
+/*
+ * The SSE4.2 fast paths skip 16 byte blocks of URI and header lines
+ * which contain none of the characters the current state acts upon,
+ * the remaining bytes are handled by the state machines as usual.
+ * The character sets below are the exact lists of cases of the states.
+ */
+
+#define NGX_HTTP_PARSE_BLOCK  16
+
+static u_char *ngx_http_parse_find(u_char *p, u_char *last, u_char *set,
+    int n);
+static u_char *ngx_http_parse_token_end(u_char *p, u_char *last);
+
+
+#if (NGX_WIN32)
+#define NGX_HTTP_URI_CHARS    "/.%?#+ \r\n\\"
+#else
+#define NGX_HTTP_URI_CHARS    "/.%?#+ \r\n"
+#endif
+#define NGX_HTTP_ARGS_CHARS   "# \r\n"
+#define NGX_HTTP_VALUE_CHARS  " \r\n"
+
+/* sizeof() includes the terminating '\0', it is looked for as well */
+
+static u_char  ngx_http_uri_chars[16] = NGX_HTTP_URI_CHARS;
+static u_char  ngx_http_args_chars[16] = NGX_HTTP_ARGS_CHARS;
+static u_char  ngx_http_value_chars[16] = NGX_HTTP_VALUE_CHARS;
+static u_char  ngx_http_token_ranges[16] = "azAZ09--";
+
+
+__attribute__((target("sse4.2")))
+static u_char *
+ngx_http_parse_find(u_char *p, u_char *last, u_char *set, int n)
+{
+    int      i;
+    __m128i  s;
+
+    s = _mm_loadu_si128((__m128i *) set);
+
+    while (last - p >= NGX_HTTP_PARSE_BLOCK) {
+        i = _mm_cmpestri(s, n, _mm_loadu_si128((__m128i *) p), 16,
+                         _SIDD_UBYTE_OPS|_SIDD_CMP_EQUAL_ANY
+                         |_SIDD_LEAST_SIGNIFICANT);
+
+        if (i != 16) {
+            return p + i;
+        }
+
+        p += 16;
+    }
+
+    return p;
+}
+
+
+__attribute__((target("sse4.2")))
+static u_char *
+ngx_http_parse_token_end(u_char *p, u_char *last)
+{
+    int      i;
+    __m128i  s;
+
+    s = _mm_loadu_si128((__m128i *) ngx_http_token_ranges);
+
+    while (last - p >= NGX_HTTP_PARSE_BLOCK) {
+        i = _mm_cmpestri(s, 8, _mm_loadu_si128((__m128i *) p), 16,
+                         _SIDD_UBYTE_OPS|_SIDD_CMP_RANGES
+                         |_SIDD_NEGATIVE_POLARITY|_SIDD_LEAST_SIGNIFICANT);
+
+        if (i != 16) {
+            return p + i;
+        }
+
+        p += 16;
+    }
+
+    return p;
+}
+
+#endif
+
+
 /* gcc, icc, msvc and others compile these switches as an jump table */
 
 ngx_int_t
@@ -538,6 +624,18 @@ ngx_http_parse_request_line(ngx_http_request_t *r, ngx_buf_t *b)
         case sw_check_uri:
 
             if (usual[ch >> 5] & (1 << (ch & 0x1f))) {
+
+#if (NGX_HAVE_SSE42_INTRINSICS)
+                if (b->last - p > NGX_HTTP_PARSE_BLOCK
+                    && (ngx_cpu_features & NGX_CPU_SSE42))
+                {
+                    m = ngx_http_parse_find(p + 1, b->last,
+                                            ngx_http_uri_chars,
+                                            sizeof(NGX_HTTP_URI_CHARS));
+                    p = m - 1;
+                }
+#endif
+
                 break;
             }
 
@@ -623,6 +721,18 @@ ngx_http_parse_request_line(ngx_http_request_t *r, ngx_buf_t *b)
         case sw_uri:
 
             if (usual[ch >> 5] & (1 << (ch & 0x1f))) {
+
+#if (NGX_HAVE_SSE42_INTRINSICS)
+                if (b->last - p > NGX_HTTP_PARSE_BLOCK
+                    && (ngx_cpu_features & NGX_CPU_SSE42))
+                {
+                    m = ngx_http_parse_find(p + 1, b->last,
+                                            ngx_http_args_chars,
+                                            sizeof(NGX_HTTP_ARGS_CHARS));
+                    p = m - 1;
+                }
+#endif
+
                 break;
             }
 
@@ -824,6 +934,9 @@ ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b,
 {
     u_char      c, ch, *p;
     ngx_uint_t  hash, i;
+#if (NGX_HAVE_SSE42_INTRINSICS)
+    u_char     *m;
+#endif
     enum {
         sw_start = 0,
         sw_name,
@@ -900,6 +1013,26 @@ ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b,
                 hash = ngx_hash(hash, c);
                 r->lowcase_header[i++] = c;
                 i &= (NGX_HTTP_LC_HEADER_LEN - 1);
+
+#if (NGX_HAVE_SSE42_INTRINSICS)
+                if (b->last - p > NGX_HTTP_PARSE_BLOCK
+                    && (ngx_cpu_features & NGX_CPU_SSE42))
+                {
+                    /* letters, digits and "-" are lowercased by 0x20 */
+
+                    m = ngx_http_parse_token_end(p + 1, b->last);
+
+                    for (p++; p < m; p++) {
+                        c = (u_char) (*p | 0x20);
+                        hash = ngx_hash(hash, c);
+                        r->lowcase_header[i++] = c;
+                        i &= (NGX_HTTP_LC_HEADER_LEN - 1);
+                    }
+
+                    p--;
+                }
+#endif
+
                 break;
             }
 
@@ -980,6 +1113,21 @@ ngx_http_parse_header_line(ngx_http_request_t *r, ngx_buf_t *b,
 
         /* header value */
         case sw_value:
+
+#if (NGX_HAVE_SSE42_INTRINSICS)
+            if (b->last - p > NGX_HTTP_PARSE_BLOCK
+                && (ngx_cpu_features & NGX_CPU_SSE42))
+            {
+                m = ngx_http_parse_find(p, b->last, ngx_http_value_chars,
+                                        sizeof(NGX_HTTP_VALUE_CHARS));
+
+                if (m > p) {
+                    p = m - 1;
+                    break;
+                }
+            }
+#endif
+
             switch (ch) {
             case ' ':
                 r->header_end = p;
@@ -1863,7 +2011,17 @@ ngx_int_t
 ngx_http_header_in(ngx_http_request_t *r, u_char *name, size_t len,
     ngx_str_t *value)
 {
-    return ngx_http_header(&r->headers_in.headers.part, name, len, value);
+    ngx_table_elt_t  *h;
+
+    h = ngx_http_find_header_in(r, name, len, NULL);
+
+    if (h == NULL) {
+        return NGX_DECLINED;
+    }
+
+    *value = h->value;
+
+    return NGX_OK;
 }
 
 
@@ -10,7 +10,6 @@
 #include <ngx_http.h>
 
 
-static void ngx_http_init_request(ngx_event_t *ev);
 static void ngx_http_process_request_line(ngx_event_t *rev);
 static void ngx_http_process_request_headers(ngx_event_t *rev);
 static ssize_t ngx_http_read_request_header(ngx_http_request_t *r);
@@ -50,10 +49,7 @@ static void ngx_http_keepalive_handler(ngx_event_t *ev);
 static void ngx_http_set_lingering_close(ngx_http_request_t *r);
 static void ngx_http_lingering_close_handler(ngx_event_t *ev);
 static ngx_int_t ngx_http_post_action(ngx_http_request_t *r);
-static void ngx_http_close_request(ngx_http_request_t *r, ngx_int_t error);
-static void ngx_http_free_request(ngx_http_request_t *r, ngx_int_t error);
 static void ngx_http_log_request(ngx_http_request_t *r);
-static void ngx_http_close_connection(ngx_connection_t *c);
 
 static u_char *ngx_http_log_error(ngx_log_t *log, u_char *buf, size_t len);
 static u_char *ngx_http_log_error_handler(ngx_http_request_t *r,
@@ -208,6 +204,7 @@ ngx_http_init_connection(ngx_connection_t *c)
 
 #if (NGX_STAT_STUB)
     (void) ngx_atomic_fetch_add(ngx_stat_reading, 1);
+    ngx_pool_set_stat(c->pool, ngx_stat_conn_memory);
 #endif
 
     if (rev->ready) {
@@ -234,7 +231,7 @@ ngx_http_init_connection(ngx_connection_t *c)
 }
 
 
-static void
+void
 ngx_http_init_request(ngx_event_t *rev)
 {
     ngx_time_t                 *tp;
@@ -305,6 +302,16 @@ ngx_http_init_request(ngx_event_t *rev)
     c->data = r;
     r->http_connection = hc;
 
+#if (NGX_HTTP_V2)
+    if (hc->stream) {
+        r->stream = hc->stream;
+        r->stream->request = r;
+
+        /* the stream copies the response into DATA frames */
+        r->main_filter_need_in_memory = 1;
+    }
+#endif
+
     c->sent = 0;
     r->signature = NGX_HTTP_MODULE;
 
@@ -396,6 +403,13 @@ ngx_http_init_request(ngx_event_t *rev)
     rev->handler = ngx_http_process_request_line;
     r->read_event_handler = ngx_http_block_reading;
 
+#if (NGX_HTTP_V2)
+    if (addr_conf->http2 && hc->stream == NULL) {
+        hc->http2 = 1;
+        rev->handler = ngx_http_v2_init;
+    }
+#endif
+
 #if (NGX_HTTP_SSL)
 
     {
@@ -441,6 +455,11 @@ ngx_http_init_request(ngx_event_t *rev)
         c->log->log_level = clcf->error_log->log_level;
     }
 
+    if (cscf->pool_recycle && ngx_pool_set_recycle(c->pool) != NGX_OK) {
+        ngx_http_close_connection(c);
+        return;
+    }
+
     if (c->buffer == NULL) {
         c->buffer = ngx_create_temp_buf(c->pool,
                                         cscf->client_header_buffer_size);
@@ -460,6 +479,12 @@ ngx_http_init_request(ngx_event_t *rev)
         return;
     }
 
+    if (cscf->pool_recycle && ngx_pool_set_recycle(r->pool) != NGX_OK) {
+        ngx_destroy_pool(r->pool);
+        ngx_http_close_connection(c);
+        return;
+    }
+
 
     if (ngx_list_init(&r->headers_out.headers, r->pool, 20,
                       sizeof(ngx_table_elt_t))
@@ -624,6 +649,28 @@ ngx_http_ssl_handshake_handler(ngx_connection_t *c)
 
         c->ssl->no_wait_shutdown = 1;
 
+#if (NGX_HTTP_V2                                                              \
+     && defined TLSEXT_TYPE_application_layer_protocol_negotiation)
+        {
+        unsigned int            len;
+        const unsigned char    *data;
+        ngx_http_request_t     *r;
+
+        r = c->data;
+
+        if (r->http_connection->http2) {
+            SSL_get0_alpn_selected(c->ssl->connection, &data, &len);
+
+            if (len == sizeof(NGX_HTTP_V2_ALPN_PROTO) - 1
+                && ngx_strncmp(data, NGX_HTTP_V2_ALPN_PROTO, len) == 0)
+            {
+                ngx_http_v2_init(c->read);
+                return;
+            }
+        }
+        }
+#endif
+
         c->log->action = "reading client request line";
 
         c->read->handler = ngx_http_process_request_line;
@@ -930,6 +977,8 @@ ngx_http_process_request_line(ngx_event_t *rev)
                 return;
             }
 
+            r->http_connection->headers_index.list = NULL;
+
 
             if (ngx_array_init(&r->headers_in.cookies, r->pool, 2,
                                sizeof(ngx_table_elt_t *))
@@ -1225,6 +1274,283 @@ ngx_http_read_request_header(ngx_http_request_t *r)
 }
 
 
+ngx_uint_t
+ngx_http_headers_index_key(u_char *name, size_t len)
+{
+    u_char      ch;
+    ngx_uint_t  i, key;
+
+    key = 0;
+
+    for (i = 0; i < len; i++) {
+        ch = name[i];
+
+        if (ch >= 'A' && ch <= 'Z') {
+            ch |= 0x20;
+
+        } else if (ch == '-') {
+            ch = '_';
+        }
+
+        key = ngx_hash(key, ch);
+    }
+
+    return key;
+}
+
+
+/*
+ * The index is kept in the connection and reused by its requests.  Hashing
+ * all the headers costs about as much as a few linear lookups, so it is
+ * filled only after that many lookups have been done in a request, and then
+ * catches up with the headers added to the list.  If it is another list,
+ * e.g. the one of a subrequest, or the list has been changed otherwise than
+ * by adding headers to its end, e.g. the headers removed in place by Lua,
+ * the index is rebuilt.
+ */
+
+ngx_http_headers_index_t *
+ngx_http_headers_in_index(ngx_http_request_t *r)
+{
+    ngx_uint_t                     i, n, k, key, size, total, added;
+    ngx_list_part_t               *part, *last;
+    ngx_table_elt_t               *header;
+    ngx_http_headers_index_t      *index;
+    ngx_http_headers_index_elt_t  *elts;
+
+    if (r->http_connection == NULL
+        || r->headers_in.headers.part.elts == NULL)
+    {
+        return NULL;
+    }
+
+    index = &r->http_connection->headers_index;
+
+    if (index->list != r->headers_in.headers.part.elts) {
+        index->list = r->headers_in.headers.part.elts;
+        index->lookups = 0;
+    }
+
+    if (index->lookups < NGX_HTTP_HEADERS_INDEX_LOOKUPS) {
+        index->lookups++;
+        return NULL;
+    }
+
+    /*
+     * the headers indexed are intact if the parts before the last one
+     * indexed keep their elements, the last one has got only new elements,
+     * and the parts after it are new
+     */
+
+    total = 0;
+    added = 0;
+    last = NULL;
+
+    for (part = &r->headers_in.headers.part; part; part = part->next) {
+        total += part->nelts;
+
+        if (part == index->last) {
+            last = part;
+
+        } else if (last) {
+            added += part->nelts;
+        }
+    }
+
+    if (index->lookups == NGX_HTTP_HEADERS_INDEX_LOOKUPS
+        || last == NULL
+        || last->elts != index->last_elts
+        || last->nelts < index->last_nelts
+        || r->headers_in.headers.nalloc != index->nalloc
+        || total != index->nelts + last->nelts - index->last_nelts + added)
+    {
+        if (index->nkeys) {
+            ngx_memzero(index->elts, (index->mask + 1)
+                                     * sizeof(ngx_http_headers_index_elt_t));
+        }
+
+        index->lookups = NGX_HTTP_HEADERS_INDEX_LOOKUPS + 1;
+        index->nelts = 0;
+        index->nkeys = 0;
+    }
+
+    if (index->elts == NULL
+        || (index->nkeys + total - index->nelts) * 3 > (index->mask + 1) * 2)
+    {
+        size = index->elts ? index->mask + 1 : NGX_HTTP_HEADERS_INDEX_SIZE;
+
+        while (total * 3 > size * 2) {
+            size <<= 1;
+        }
+
+        elts = ngx_pcalloc(r->connection->pool,
+                           size * sizeof(ngx_http_headers_index_elt_t));
+        if (elts == NULL) {
+            index->list = NULL;
+            return NULL;
+        }
+
+        if (index->elts) {
+            ngx_pfree(r->connection->pool, index->elts);
+        }
+
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                       "http headers index: %ui of %ui", total, size);
+
+        index->elts = elts;
+        index->mask = size - 1;
+        index->nelts = 0;
+        index->nkeys = 0;
+    }
+
+    index->last = r->headers_in.headers.last;
+    index->last_elts = index->last->elts;
+    index->last_nelts = index->last->nelts;
+    index->nalloc = r->headers_in.headers.nalloc;
+
+    if (index->nelts == total) {
+        return index;
+    }
+
+    n = index->nelts;
+
+    part = &r->headers_in.headers.part;
+
+    while (n >= part->nelts) {
+        n -= part->nelts;
+        part = part->next;
+    }
+
+    header = part->elts;
+
+    for (i = n; /* void */ ; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        index->nelts++;
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        key = ngx_http_headers_index_key(header[i].key.data,
+                                         header[i].key.len);
+
+        for (k = key & index->mask;
+             index->elts[k].header;
+             k = (k + 1) & index->mask)
+        {
+            /* void */
+        }
+
+        index->elts[k].key = key;
+        index->elts[k].header = &header[i];
+        index->nkeys++;
+    }
+
+    return index;
+}
+
+
+/*
+ * Finds the request headers with the name, case-insensitively, in the list
+ * order: "*next" is set to 0 before the first call and kept between calls.
+ * The headers removed, i.e. with zero hash, are skipped.
+ */
+
+ngx_table_elt_t *
+ngx_http_find_header_in(ngx_http_request_t *r, u_char *name, size_t len,
+    ngx_uint_t *next)
+{
+    ngx_uint_t                 i, n, key, start;
+    ngx_list_part_t           *part;
+    ngx_table_elt_t           *h, *header;
+    ngx_http_headers_index_t  *index;
+
+    /* "*next" is the index slot shifted by 1 or the list position with 1 */
+
+    start = next ? *next : 0;
+
+    index = (start & 1) ? NULL : ngx_http_headers_in_index(r);
+
+    if (index) {
+        key = ngx_http_headers_index_key(name, len);
+
+        for (i = start ? (start >> 1) - 1 : key & index->mask;
+             index->elts[i].header;
+             i = (i + 1) & index->mask)
+        {
+            h = index->elts[i].header;
+
+            if (index->elts[i].key != key
+                || h->hash == 0
+                || h->key.len != len
+                || ngx_strncasecmp(h->key.data, name, len) != 0)
+            {
+                continue;
+            }
+
+            if (next) {
+                *next = (((i + 1) & index->mask) + 1) << 1;
+            }
+
+            return h;
+        }
+
+        return NULL;
+    }
+
+    if ((start && (start & 1) == 0)
+        || r->headers_in.headers.part.elts == NULL)
+    {
+        return NULL;
+    }
+
+    start >>= 1;
+
+    n = 0;
+    part = &r->headers_in.headers.part;
+    header = part->elts;
+
+    for (i = 0; /* void */ ; i++, n++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (n < start
+            || header[i].hash == 0
+            || header[i].key.len != len
+            || ngx_strncasecmp(header[i].key.data, name, len) != 0)
+        {
+            continue;
+        }
+
+        if (next) {
+            *next = ((n + 1) << 1) | 1;
+        }
+
+        return &header[i];
+    }
+
+    return NULL;
+}
+
+
 static ngx_int_t
 ngx_http_alloc_large_header_buffer(ngx_http_request_t *r,
     ngx_uint_t request_line)
@@ -2192,6 +2518,13 @@ ngx_http_finalize_connection(ngx_http_request_t *r)
 
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
+#if (NGX_HTTP_V2)
+    if (r->stream) {
+        ngx_http_close_request(r, 0);
+        return;
+    }
+#endif
+
     if (r->main->count != 1) {
 
         if (r->discard_body) {
@@ -2391,6 +2724,19 @@ ngx_http_test_reading(ngx_http_request_t *r)
 
     ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0, "http test reading");
 
+#if (NGX_HTTP_V2)
+
+    if (r->stream) {
+        if (c->error) {
+            err = 0;
+            goto closed;
+        }
+
+        return;
+    }
+
+#endif
+
 #if (NGX_HAVE_KQUEUE)
 
     if (ngx_event_flags & NGX_USE_KQUEUE_EVENT) {
@@ -2587,6 +2933,7 @@ ngx_http_set_keepalive(ngx_http_request_t *r)
     if (hc->free) {
         for (i = 0; i < hc->nfree; i++) {
             ngx_pfree(c->pool, hc->free[i]->start);
+            ngx_pool_recycle(c->pool, hc->free[i], sizeof(ngx_buf_t));
             hc->free[i] = NULL;
         }
 
@@ -2599,6 +2946,7 @@ ngx_http_set_keepalive(ngx_http_request_t *r)
     if (hc->busy) {
         for (i = 0; i < hc->nbusy; i++) {
             ngx_pfree(c->pool, hc->busy[i]->start);
+            ngx_pool_recycle(c->pool, hc->busy[i], sizeof(ngx_buf_t));
             hc->busy[i] = NULL;
         }
 
@@ -2974,7 +3322,7 @@ ngx_http_post_action(ngx_http_request_t *r)
 }
 
 
-static void
+void
 ngx_http_close_request(ngx_http_request_t *r, ngx_int_t rc)
 {
     ngx_connection_t  *c;
@@ -2995,12 +3343,19 @@ ngx_http_close_request(ngx_http_request_t *r, ngx_int_t rc)
         return;
     }
 
+#if (NGX_HTTP_V2)
+    if (r->stream) {
+        ngx_http_v2_close_stream(r->stream, rc);
+        return;
+    }
+#endif
+
     ngx_http_free_request(r, rc);
     ngx_http_close_connection(c);
 }
 
 
-static void
+void
 ngx_http_free_request(ngx_http_request_t *r, ngx_int_t rc)
 {
     unsigned                   keepalive;
@@ -3057,7 +3412,12 @@ ngx_http_free_request(ngx_http_request_t *r, ngx_int_t rc)
 
     log->action = "closing request";
 
-    if (r->connection->timedout) {
+    if (r->connection->timedout
+#if (NGX_HTTP_V2)
+        && r->stream == NULL
+#endif
+       )
+    {
         clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
         if (clcf->reset_timedout_connection) {
@@ -3103,7 +3463,7 @@ ngx_http_log_request(ngx_http_request_t *r)
 }
 
 
-static void
+void
 ngx_http_close_connection(ngx_connection_t *c)
 {
     ngx_pool_t  *pool;
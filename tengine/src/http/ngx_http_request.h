@@ -15,6 +15,10 @@
 /* must be 2^n */
 #define NGX_HTTP_LC_HEADER_LEN             32
 
+/* must be 2^n */
+#define NGX_HTTP_HEADERS_INDEX_SIZE        32
+#define NGX_HTTP_HEADERS_INDEX_LOOKUPS     8
+
 
 #define NGX_HTTP_DISCARD_BUFFER_SIZE       4096
 #define NGX_HTTP_LINGERING_BUFFER_SIZE     4096
@@ -23,6 +27,7 @@
 #define NGX_HTTP_VERSION_9                 9
 #define NGX_HTTP_VERSION_10                1000
 #define NGX_HTTP_VERSION_11                1001
+#define NGX_HTTP_VERSION_20                2000
 
 #define NGX_HTTP_UNKNOWN                   0x0001
 #define NGX_HTTP_GET                       0x0002
@@ -286,6 +291,37 @@ typedef struct {
 } ngx_http_request_body_t;
 
 
+/*
+ * the request headers hashed by their lowercase names with "-" as "_",
+ * the slots of the headers with the same name follow in the list order
+ */
+
+typedef struct {
+    ngx_uint_t                        key;
+    ngx_table_elt_t                  *header;
+} ngx_http_headers_index_elt_t;
+
+
+typedef struct {
+    ngx_http_headers_index_elt_t     *elts;
+    ngx_uint_t                        mask;
+    ngx_uint_t                        nkeys;
+
+    /* the list indexed and the number of its elements indexed */
+    void                             *list;
+    ngx_uint_t                        nelts;
+
+    /* the last part of the list as it was indexed */
+    ngx_list_part_t                  *last;
+    void                             *last_elts;
+    ngx_uint_t                        last_nelts;
+    ngx_uint_t                        nalloc;
+
+    /* the lookups done in the request to fill the index after */
+    ngx_uint_t                        lookups;
+} ngx_http_headers_index_t;
+
+
 typedef struct {
     ngx_http_request_t               *request;
 
@@ -296,6 +332,13 @@ typedef struct {
     ngx_int_t                         nfree;
 
     ngx_uint_t                        pipeline;    /* unsigned  pipeline:1; */
+
+    ngx_http_headers_index_t          headers_index;
+
+#if (NGX_HTTP_V2)
+    ngx_http_v2_stream_t             *stream;
+    ngx_uint_t                        http2;       /* unsigned  http2:1; */
+#endif
 } ngx_http_connection_t;
 
 
@@ -411,6 +454,7 @@ struct ngx_http_request_s {
     ngx_uint_t                        access_code;
 
     ngx_http_variable_value_t        *variables;
+    ngx_http_variable_tables_t       *variable_tables;
 
 #if (NGX_PCRE)
     ngx_uint_t                        ncaptures;
@@ -429,6 +473,10 @@ struct ngx_http_request_s {
 
     ngx_http_connection_t            *http_connection;
 
+#if (NGX_HTTP_V2)
+    ngx_http_v2_stream_t             *stream;
+#endif
+
     ngx_http_log_handler_pt           log_handler;
 
     ngx_http_cleanup_t               *cleanup;
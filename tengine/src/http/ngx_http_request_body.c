@@ -485,6 +485,14 @@ ngx_http_discard_request_body(ngx_http_request_t *r)
         return NGX_OK;
     }
 
+#if (NGX_HTTP_V2)
+    if (r->stream) {
+        /* the rest of the body is dropped as it arrives */
+        r->stream->skip_data = 1;
+        return NGX_OK;
+    }
+#endif
+
     size = r->header_in->last - r->header_in->pos;
 
     if (size) {
@@ -10,16 +10,38 @@
 #include <ngx_http.h>
 
 
+typedef struct {
+    ngx_uint_t                  type;
+    ngx_uint_t                  value;
+    u_char                     *data;
+} ngx_http_script_part_t;
+
+
 static ngx_int_t ngx_http_script_init_arrays(ngx_http_script_compile_t *sc);
 static ngx_int_t ngx_http_script_done(ngx_http_script_compile_t *sc);
+static ngx_int_t ngx_http_script_add_part(ngx_http_script_compile_t *sc,
+    ngx_uint_t type, ngx_uint_t value, u_char *data);
+static ngx_int_t ngx_http_script_flush_parts(ngx_http_script_compile_t *sc);
+static ngx_int_t ngx_http_script_add_concat_code(ngx_http_script_compile_t *sc,
+    ngx_http_script_part_t *part, ngx_uint_t n);
 static ngx_int_t ngx_http_script_add_copy_code(ngx_http_script_compile_t *sc,
     ngx_str_t *value, ngx_uint_t last);
+static ngx_int_t ngx_http_script_emit_copy_code(ngx_http_script_compile_t *sc,
+    u_char *data, size_t len);
 static ngx_int_t ngx_http_script_add_var_code(ngx_http_script_compile_t *sc,
     ngx_str_t *name);
+static ngx_int_t ngx_http_script_emit_var_code(ngx_http_script_compile_t *sc,
+    ngx_uint_t index);
 static ngx_int_t ngx_http_script_add_args_code(ngx_http_script_compile_t *sc);
 #if (NGX_PCRE)
 static ngx_int_t ngx_http_script_add_capture_code(ngx_http_script_compile_t *sc,
      ngx_uint_t n);
+static ngx_int_t ngx_http_script_emit_capture_code(
+    ngx_http_script_compile_t *sc, ngx_uint_t n);
+static size_t ngx_http_script_capture_len(ngx_http_script_engine_t *e,
+    ngx_uint_t n);
+static u_char *ngx_http_script_capture_copy(ngx_http_script_engine_t *e,
+    u_char *pos, ngx_uint_t n);
 #endif
 static ngx_int_t
      ngx_http_script_add_full_name_code(ngx_http_script_compile_t *sc);
@@ -591,6 +613,14 @@ ngx_http_script_init_arrays(ngx_http_script_compile_t *sc)
         }
     }
 
+    if (sc->parts == NULL) {
+        sc->parts = ngx_array_create(sc->cf->temp_pool, 4,
+                                     sizeof(ngx_http_script_part_t));
+        if (sc->parts == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
     sc->variables = 0;
 
     return NGX_OK;
@@ -619,6 +649,10 @@ ngx_http_script_done(ngx_http_script_compile_t *sc)
         }
     }
 
+    if (ngx_http_script_flush_parts(sc) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
     if (sc->complete_lengths) {
         code = ngx_http_script_add_code(*sc->lengths, sizeof(uintptr_t), NULL);
         if (code == NULL) {
@@ -680,17 +714,309 @@ ngx_http_script_add_code(ngx_array_t *codes, size_t size, void *code)
 }
 
 
+/*
+ * The copy, variable and capture codes are collected as parts and emitted
+ * when another code follows or the script is done.  A single part is
+ * emitted as is, a run of them as one concat code, which saves a dispatch
+ * per part in both the lengths and values passes.  Adjacent strings are
+ * folded together.
+ */
+
+static ngx_int_t
+ngx_http_script_add_part(ngx_http_script_compile_t *sc, ngx_uint_t type,
+    ngx_uint_t value, u_char *data)
+{
+    u_char                  *p;
+    ngx_http_script_part_t  *part;
+
+    if (sc->parts->nelts && type == NGX_HTTP_SCRIPT_PART_COPY) {
+
+        part = (ngx_http_script_part_t *) sc->parts->elts
+               + sc->parts->nelts - 1;
+
+        if (part->type == NGX_HTTP_SCRIPT_PART_COPY) {
+            p = ngx_pnalloc(sc->cf->temp_pool, part->value + value);
+            if (p == NULL) {
+                return NGX_ERROR;
+            }
+
+            ngx_memcpy(ngx_cpymem(p, part->data, part->value), data, value);
+
+            part->value += value;
+            part->data = p;
+
+            return NGX_OK;
+        }
+    }
+
+    part = ngx_array_push(sc->parts);
+    if (part == NULL) {
+        return NGX_ERROR;
+    }
+
+    part->type = type;
+    part->value = value;
+    part->data = data;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_script_flush_parts(ngx_http_script_compile_t *sc)
+{
+    ngx_uint_t               n;
+    ngx_http_script_part_t  *part;
+
+    n = sc->parts->nelts;
+
+    if (n == 0) {
+        return NGX_OK;
+    }
+
+    sc->parts->nelts = 0;
+
+    part = sc->parts->elts;
+
+    if (n > 1) {
+        return ngx_http_script_add_concat_code(sc, part, n);
+    }
+
+    switch (part->type) {
+
+    case NGX_HTTP_SCRIPT_PART_COPY:
+        return ngx_http_script_emit_copy_code(sc, part->data, part->value);
+
+    case NGX_HTTP_SCRIPT_PART_VAR:
+        return ngx_http_script_emit_var_code(sc, part->value);
+
+#if (NGX_PCRE)
+    default: /* NGX_HTTP_SCRIPT_PART_CAPTURE */
+        return ngx_http_script_emit_capture_code(sc, part->value);
+#else
+    default:
+        return NGX_ERROR;
+#endif
+    }
+}
+
+
+static ngx_int_t
+ngx_http_script_add_concat_code(ngx_http_script_compile_t *sc,
+    ngx_http_script_part_t *part, ngx_uint_t n)
+{
+    u_char                         *p;
+    size_t                          size, len;
+    ngx_uint_t                      i;
+    ngx_http_script_concat_code_t  *code;
+    ngx_http_script_concat_part_t  *cp;
+
+    len = 0;
+
+    for (i = 0; i < n; i++) {
+        if (part[i].type == NGX_HTTP_SCRIPT_PART_COPY) {
+            len += part[i].value;
+        }
+    }
+
+    size = sizeof(ngx_http_script_concat_code_t)
+           + n * sizeof(ngx_http_script_concat_part_t);
+
+    code = ngx_http_script_add_code(*sc->lengths, size, NULL);
+    if (code == NULL) {
+        return NGX_ERROR;
+    }
+
+    code->code = (ngx_http_script_code_pt) ngx_http_script_concat_len_code;
+    code->nparts = n;
+    code->size = size;
+
+    cp = (ngx_http_script_concat_part_t *) (code + 1);
+
+    for (i = 0; i < n; i++) {
+        cp[i].type = part[i].type;
+        cp[i].value = part[i].value;
+    }
+
+    size = (size + len + sizeof(uintptr_t) - 1) & ~(sizeof(uintptr_t) - 1);
+
+    code = ngx_http_script_add_code(*sc->values, size, &sc->main);
+    if (code == NULL) {
+        return NGX_ERROR;
+    }
+
+    code->code = ngx_http_script_concat_code;
+    code->nparts = n;
+    code->size = size;
+
+    cp = (ngx_http_script_concat_part_t *) (code + 1);
+    p = (u_char *) &cp[n];
+
+    for (i = 0; i < n; i++) {
+        cp[i].type = part[i].type;
+        cp[i].value = part[i].value;
+
+        if (part[i].type == NGX_HTTP_SCRIPT_PART_COPY) {
+            p = ngx_cpymem(p, part[i].data, part[i].value);
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+size_t
+ngx_http_script_concat_len_code(ngx_http_script_engine_t *e)
+{
+    size_t                          len;
+    ngx_uint_t                      i;
+    ngx_http_variable_value_t      *value;
+    ngx_http_script_concat_code_t  *code;
+    ngx_http_script_concat_part_t  *part;
+
+    code = (ngx_http_script_concat_code_t *) e->ip;
+    part = (ngx_http_script_concat_part_t *) (code + 1);
+
+    e->ip += code->size;
+
+    len = 0;
+
+    for (i = 0; i < code->nparts; i++) {
+
+        switch (part[i].type) {
+
+        case NGX_HTTP_SCRIPT_PART_COPY:
+            len += part[i].value;
+            break;
+
+        case NGX_HTTP_SCRIPT_PART_VAR:
+
+            if (e->flushed) {
+                value = ngx_http_get_indexed_variable(e->request,
+                                                      part[i].value);
+
+            } else {
+                value = ngx_http_get_flushed_variable(e->request,
+                                                      part[i].value);
+            }
+
+            if (value && !value->not_found) {
+                len += value->len;
+            }
+
+            break;
+
+#if (NGX_PCRE)
+        default: /* NGX_HTTP_SCRIPT_PART_CAPTURE */
+            len += ngx_http_script_capture_len(e, part[i].value);
+            break;
+#endif
+        }
+    }
+
+    return len;
+}
+
+
+void
+ngx_http_script_concat_code(ngx_http_script_engine_t *e)
+{
+    u_char                         *p, *data;
+    ngx_uint_t                      i;
+    ngx_http_variable_value_t      *value;
+    ngx_http_script_concat_code_t  *code;
+    ngx_http_script_concat_part_t  *part;
+
+    code = (ngx_http_script_concat_code_t *) e->ip;
+    part = (ngx_http_script_concat_part_t *) (code + 1);
+    data = (u_char *) &part[code->nparts];
+
+    e->ip += code->size;
+
+    p = e->pos;
+
+    for (i = 0; i < code->nparts; i++) {
+
+        switch (part[i].type) {
+
+        case NGX_HTTP_SCRIPT_PART_COPY:
+
+            if (!e->skip) {
+                e->pos = ngx_copy(e->pos, data, part[i].value);
+            }
+
+            data += part[i].value;
+            break;
+
+        case NGX_HTTP_SCRIPT_PART_VAR:
+
+            if (e->skip) {
+                break;
+            }
+
+            if (e->flushed) {
+                value = ngx_http_get_indexed_variable(e->request,
+                                                      part[i].value);
+
+            } else {
+                value = ngx_http_get_flushed_variable(e->request,
+                                                      part[i].value);
+            }
+
+            if (value && !value->not_found) {
+                e->pos = ngx_copy(e->pos, value->data, value->len);
+            }
+
+            break;
+
+#if (NGX_PCRE)
+        default: /* NGX_HTTP_SCRIPT_PART_CAPTURE */
+            e->pos = ngx_http_script_capture_copy(e, e->pos, part[i].value);
+            break;
+#endif
+        }
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, e->request->connection->log, 0,
+                   "http script concat: \"%*s\"", e->pos - p, p);
+}
+
+
 static ngx_int_t
 ngx_http_script_add_copy_code(ngx_http_script_compile_t *sc, ngx_str_t *value,
     ngx_uint_t last)
 {
-    u_char                       *p;
-    size_t                        size, len, zero;
-    ngx_http_script_copy_code_t  *code;
+    u_char  *p;
+    size_t   len, zero;
 
     zero = (sc->zero && last);
     len = value->len + zero;
 
+    if (!zero) {
+        return ngx_http_script_add_part(sc, NGX_HTTP_SCRIPT_PART_COPY,
+                                        len, value->data);
+    }
+
+    p = ngx_pnalloc(sc->cf->temp_pool, len);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    *ngx_cpymem(p, value->data, value->len) = '\0';
+
+    sc->zero = 0;
+
+    return ngx_http_script_add_part(sc, NGX_HTTP_SCRIPT_PART_COPY, len, p);
+}
+
+
+static ngx_int_t
+ngx_http_script_emit_copy_code(ngx_http_script_compile_t *sc, u_char *data,
+    size_t len)
+{
+    size_t                        size;
+    ngx_http_script_copy_code_t  *code;
+
     code = ngx_http_script_add_code(*sc->lengths,
                                     sizeof(ngx_http_script_copy_code_t), NULL);
     if (code == NULL) {
@@ -711,13 +1037,8 @@ ngx_http_script_add_copy_code(ngx_http_script_compile_t *sc, ngx_str_t *value,
     code->code = ngx_http_script_copy_code;
     code->len = len;
 
-    p = ngx_cpymem((u_char *) code + sizeof(ngx_http_script_copy_code_t),
-                   value->data, value->len);
-
-    if (zero) {
-        *p = '\0';
-        sc->zero = 0;
-    }
+    ngx_memcpy((u_char *) code + sizeof(ngx_http_script_copy_code_t),
+               data, len);
 
     return NGX_OK;
 }
@@ -762,8 +1083,7 @@ ngx_http_script_copy_code(ngx_http_script_engine_t *e)
 static ngx_int_t
 ngx_http_script_add_var_code(ngx_http_script_compile_t *sc, ngx_str_t *name)
 {
-    ngx_int_t                    index, *p;
-    ngx_http_script_var_code_t  *code;
+    ngx_int_t   index, *p;
 
     index = ngx_http_get_variable_index(sc->cf, name);
 
@@ -780,6 +1100,15 @@ ngx_http_script_add_var_code(ngx_http_script_compile_t *sc, ngx_str_t *name)
         *p = index;
     }
 
+    return ngx_http_script_add_part(sc, NGX_HTTP_SCRIPT_PART_VAR, index, NULL);
+}
+
+
+static ngx_int_t
+ngx_http_script_emit_var_code(ngx_http_script_compile_t *sc, ngx_uint_t index)
+{
+    ngx_http_script_var_code_t  *code;
+
     code = ngx_http_script_add_code(*sc->lengths,
                                     sizeof(ngx_http_script_var_code_t), NULL);
     if (code == NULL) {
@@ -865,6 +1194,10 @@ ngx_http_script_add_args_code(ngx_http_script_compile_t *sc)
 {
     uintptr_t   *code;
 
+    if (ngx_http_script_flush_parts(sc) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
     code = ngx_http_script_add_code(*sc->lengths, sizeof(uintptr_t), NULL);
     if (code == NULL) {
         return NGX_ERROR;
@@ -1170,6 +1503,18 @@ ngx_http_script_regex_end_code(ngx_http_script_engine_t *e)
 
 static ngx_int_t
 ngx_http_script_add_capture_code(ngx_http_script_compile_t *sc, ngx_uint_t n)
+{
+    if (sc->ncaptures < n) {
+        sc->ncaptures = n;
+    }
+
+    return ngx_http_script_add_part(sc, NGX_HTTP_SCRIPT_PART_CAPTURE, 2 * n,
+                                    NULL);
+}
+
+
+static ngx_int_t
+ngx_http_script_emit_capture_code(ngx_http_script_compile_t *sc, ngx_uint_t n)
 {
     ngx_http_script_copy_capture_code_t  *code;
 
@@ -1182,7 +1527,7 @@ ngx_http_script_add_capture_code(ngx_http_script_compile_t *sc, ngx_uint_t n)
 
     code->code = (ngx_http_script_code_pt)
                       ngx_http_script_copy_capture_len_code;
-    code->n = 2 * n;
+    code->n = n;
 
 
     code = ngx_http_script_add_code(*sc->values,
@@ -1193,11 +1538,7 @@ ngx_http_script_add_capture_code(ngx_http_script_compile_t *sc, ngx_uint_t n)
     }
 
     code->code = ngx_http_script_copy_capture_code;
-    code->n = 2 * n;
-
-    if (sc->ncaptures < n) {
-        sc->ncaptures = n;
-    }
+    code->n = n;
 
     return NGX_OK;
 }
@@ -1206,19 +1547,43 @@ ngx_http_script_add_capture_code(ngx_http_script_compile_t *sc, ngx_uint_t n)
 size_t
 ngx_http_script_copy_capture_len_code(ngx_http_script_engine_t *e)
 {
-    int                                  *cap;
-    u_char                               *p;
-    ngx_uint_t                            n;
-    ngx_http_request_t                   *r;
     ngx_http_script_copy_capture_code_t  *code;
 
-    r = e->request;
+    code = (ngx_http_script_copy_capture_code_t *) e->ip;
+
+    e->ip += sizeof(ngx_http_script_copy_capture_code_t);
+
+    return ngx_http_script_capture_len(e, code->n);
+}
+
+
+void
+ngx_http_script_copy_capture_code(ngx_http_script_engine_t *e)
+{
+    u_char                               *pos;
+    ngx_http_script_copy_capture_code_t  *code;
 
     code = (ngx_http_script_copy_capture_code_t *) e->ip;
 
     e->ip += sizeof(ngx_http_script_copy_capture_code_t);
 
-    n = code->n;
+    pos = e->pos;
+
+    e->pos = ngx_http_script_capture_copy(e, pos, code->n);
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, e->request->connection->log, 0,
+                   "http script capture: \"%*s\"", e->pos - pos, pos);
+}
+
+
+static size_t
+ngx_http_script_capture_len(ngx_http_script_engine_t *e, ngx_uint_t n)
+{
+    int                 *cap;
+    u_char              *p;
+    ngx_http_request_t  *r;
+
+    r = e->request;
 
     if (n < r->ncaptures) {
 
@@ -1241,25 +1606,16 @@ ngx_http_script_copy_capture_len_code(ngx_http_script_engine_t *e)
 }
 
 
-void
-ngx_http_script_copy_capture_code(ngx_http_script_engine_t *e)
+static u_char *
+ngx_http_script_capture_copy(ngx_http_script_engine_t *e, u_char *pos,
+    ngx_uint_t n)
 {
-    int                                  *cap;
-    u_char                               *p, *pos;
-    ngx_uint_t                            n;
-    ngx_http_request_t                   *r;
-    ngx_http_script_copy_capture_code_t  *code;
+    int                 *cap;
+    u_char              *p;
+    ngx_http_request_t  *r;
 
     r = e->request;
 
-    code = (ngx_http_script_copy_capture_code_t *) e->ip;
-
-    e->ip += sizeof(ngx_http_script_copy_capture_code_t);
-
-    n = code->n;
-
-    pos = e->pos;
-
     if (n < r->ncaptures) {
 
         cap = r->captures;
@@ -1268,16 +1624,15 @@ ngx_http_script_copy_capture_code(ngx_http_script_engine_t *e)
         if ((e->is_args || e->quote)
             && (e->request->quoted_uri || e->request->plus_in_uri))
         {
-            e->pos = (u_char *) ngx_escape_uri(pos, &p[cap[n]],
-                                               cap[n + 1] - cap[n],
-                                               NGX_ESCAPE_ARGS);
-        } else {
-            e->pos = ngx_copy(pos, &p[cap[n]], cap[n + 1] - cap[n]);
+            return (u_char *) ngx_escape_uri(pos, &p[cap[n]],
+                                             cap[n + 1] - cap[n],
+                                             NGX_ESCAPE_ARGS);
         }
+
+        return ngx_copy(pos, &p[cap[n]], cap[n + 1] - cap[n]);
     }
 
-    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, e->request->connection->log, 0,
-                   "http script capture: \"%*s\"", e->pos - pos, pos);
+    return pos;
 }
 
 #endif
@@ -1288,6 +1643,10 @@ ngx_http_script_add_full_name_code(ngx_http_script_compile_t *sc)
 {
     ngx_http_script_full_name_code_t  *code;
 
+    if (ngx_http_script_flush_parts(sc) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
     code = ngx_http_script_add_code(*sc->lengths,
                                     sizeof(ngx_http_script_full_name_code_t),
                                     NULL);
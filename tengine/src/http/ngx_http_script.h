@@ -51,6 +51,9 @@ typedef struct {
 
     void                       *main;
 
+    /* the pending copy, variable and capture codes, see concat codes */
+    ngx_array_t                *parts;
+
     unsigned                    compile_args:1;
     unsigned                    complete_lengths:1;
     unsigned                    complete_values:1;
@@ -111,6 +114,32 @@ typedef struct {
 } ngx_http_script_copy_capture_code_t;
 
 
+/*
+ * A run of the copy, variable and capture codes is compiled to one concat
+ * code: the header is followed by the parts and, in the values codes, by
+ * the copied strings.
+ */
+
+#define NGX_HTTP_SCRIPT_PART_COPY     0
+#define NGX_HTTP_SCRIPT_PART_VAR      1
+#define NGX_HTTP_SCRIPT_PART_CAPTURE  2
+
+
+typedef struct {
+    ngx_http_script_code_pt     code;
+    uintptr_t                   nparts;
+    uintptr_t                   size;
+} ngx_http_script_concat_code_t;
+
+
+typedef struct {
+    uintptr_t                   type;
+
+    /* the length, the variable index or the capture offset */
+    uintptr_t                   value;
+} ngx_http_script_concat_part_t;
+
+
 #if (NGX_PCRE)
 
 typedef struct {
@@ -234,6 +263,8 @@ size_t ngx_http_script_copy_var_len_code(ngx_http_script_engine_t *e);
 void ngx_http_script_copy_var_code(ngx_http_script_engine_t *e);
 size_t ngx_http_script_copy_capture_len_code(ngx_http_script_engine_t *e);
 void ngx_http_script_copy_capture_code(ngx_http_script_engine_t *e);
+size_t ngx_http_script_concat_len_code(ngx_http_script_engine_t *e);
+void ngx_http_script_concat_code(ngx_http_script_engine_t *e);
 size_t ngx_http_script_mark_args_code(ngx_http_script_engine_t *e);
 void ngx_http_script_start_args_code(ngx_http_script_engine_t *e);
 #if (NGX_PCRE)
@@ -57,6 +57,12 @@ static void
 static ngx_int_t ngx_http_upstream_non_buffered_filter_init(void *data);
 static ngx_int_t ngx_http_upstream_non_buffered_filter(void *data,
     ssize_t bytes);
+#if (NGX_HAVE_SPLICE)
+static ngx_int_t ngx_http_upstream_splice_init(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+static ngx_int_t ngx_http_upstream_splice(ngx_http_request_t *r,
+    ngx_http_upstream_t *u);
+#endif
 static void ngx_http_upstream_process_downstream(ngx_http_request_t *r);
 static void ngx_http_upstream_process_upstream(ngx_http_request_t *r,
     ngx_http_upstream_t *u);
@@ -431,6 +437,13 @@ ngx_http_upstream_init(ngx_http_request_t *r)
         ngx_del_timer(c->read);
     }
 
+#if (NGX_HTTP_V2)
+    if (r->stream) {
+        ngx_http_upstream_init_request(r);
+        return;
+    }
+#endif
+
     if (ngx_event_flags & NGX_USE_CLEAR_EVENT) {
 
         if (!c->write->active) {
@@ -509,6 +522,10 @@ ngx_http_upstream_init_request(ngx_http_request_t *r)
 
     u->peer.local = u->conf->local;
 
+#if (NGX_HAVE_TCP_FASTOPEN_CONNECT)
+    u->peer.fastopen = u->conf->fastopen;
+#endif
+
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
     u->output.alignment = clcf->directio_alignment;
@@ -991,6 +1008,13 @@ ngx_http_upstream_check_broken_connection(ngx_http_request_t *r,
         return;
     }
 
+#if (NGX_HTTP_V2)
+    if (r->stream) {
+        /* the stream errors are reported through c->error */
+        return;
+    }
+#endif
+
 #if (NGX_HAVE_KQUEUE)
 
     if (ngx_event_flags & NGX_USE_KQUEUE_EVENT) {
@@ -2095,6 +2119,29 @@ ngx_http_upstream_send_response(ngx_http_request_t *r, ngx_http_upstream_t *u)
 
     clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
 
+#if (NGX_HAVE_SPLICE)
+
+    /*
+     * a large body that would go through the temporary file anyway
+     * is relayed unbuffered, with splice(), unless its rate is limited:
+     * the unbuffered relay does not honour limit_rate
+     */
+
+    if (u->buffering
+        && u->conf->splice
+        && r->limit_rate == 0
+        && u->headers_in.content_length_n
+           > (off_t) (u->conf->bufs.num * u->conf->bufs.size)
+        && ngx_http_upstream_splice_init(r, u) == NGX_OK)
+    {
+        ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                       "http upstream splice instead of buffering");
+
+        u->buffering = 0;
+    }
+
+#endif
+
     if (!u->buffering) {
 
         if (u->input_filter == NULL) {
@@ -2114,6 +2161,18 @@ ngx_http_upstream_send_response(ngx_http_request_t *r, ngx_http_upstream_t *u)
             return;
         }
 
+#if (NGX_HAVE_SPLICE)
+
+        if (u->splice == NULL
+            && u->conf->splice
+            && ngx_http_upstream_splice_init(r, u) == NGX_ERROR)
+        {
+            ngx_http_upstream_finalize_request(r, u, 0);
+            return;
+        }
+
+#endif
+
         if (clcf->tcp_nodelay && c->tcp_nodelay == NGX_TCP_NODELAY_UNSET) {
             ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0, "tcp_nodelay");
 
@@ -2447,6 +2506,24 @@ ngx_http_upstream_process_non_buffered_request(ngx_http_request_t *r,
             }
         }
 
+#if (NGX_HAVE_SPLICE)
+
+        if (u->splice && u->out_bufs == NULL && u->busy_bufs == NULL) {
+
+            rc = ngx_http_upstream_splice(r, u);
+
+            if (rc == NGX_AGAIN) {
+                break;
+            }
+
+            if (rc != NGX_DECLINED) {
+                ngx_http_upstream_finalize_request(r, u, 0);
+                return;
+            }
+        }
+
+#endif
+
         size = b->end - b->last;
 
         if (size && upstream->read->ready) {
@@ -2506,6 +2583,138 @@ ngx_http_upstream_process_non_buffered_request(ngx_http_request_t *r,
 }
 
 
+#if (NGX_HAVE_SPLICE)
+
+static ngx_int_t
+ngx_http_upstream_splice_init(ngx_http_request_t *r, ngx_http_upstream_t *u)
+{
+    ngx_connection_t  *c;
+
+    c = r->connection;
+
+    /*
+     * the body is relayed as is, so neither the upstream nor the client
+     * framing may change it, and no body filter may need to see it;
+     * the header filters have already set their flags at this point
+     */
+
+    if (u->headers_in.chunked
+        || u->length == 0
+        || u->cacheable
+        || u->store
+        || r != r->main
+        || r->chunked
+        || r->header_only
+        || r->allow_ranges
+        || r->filter_need_in_memory
+        || r->main_filter_need_in_memory
+        || r->filter_need_temporary)
+    {
+        return NGX_DECLINED;
+    }
+
+#if (NGX_HTTP_SSL)
+
+    if (c->ssl || u->peer.connection->ssl) {
+        return NGX_DECLINED;
+    }
+
+#endif
+
+    u->splice = ngx_event_splice_create(r->pool, c->log);
+    if (u->splice == NULL) {
+        return NGX_ERROR;
+    }
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0, "http upstream splice");
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_upstream_splice(ngx_http_request_t *r, ngx_http_upstream_t *u)
+{
+    size_t             size;
+    ssize_t            n;
+    ngx_connection_t  *downstream, *upstream;
+
+    downstream = r->connection;
+    upstream = u->peer.connection;
+
+    /* the data held by the filters must go out first */
+
+    if (r->postponed || downstream->data != r) {
+        return NGX_DECLINED;
+    }
+
+    if (r->out) {
+        if (ngx_http_output_filter(r, NULL) == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+
+        if (r->out) {
+            return NGX_AGAIN;
+        }
+    }
+
+    for ( ;; ) {
+
+        if (u->splice->size) {
+
+            if (!downstream->write->ready) {
+                return NGX_AGAIN;
+            }
+
+            n = ngx_event_splice_write(u->splice, downstream);
+
+            if (n == NGX_ERROR) {
+                downstream->error = 1;
+                return NGX_ERROR;
+            }
+
+            if (u->splice->size) {
+                return NGX_AGAIN;
+            }
+        }
+
+        if (u->length == 0 || upstream->read->eof || upstream->read->error) {
+            return NGX_OK;
+        }
+
+        if (!upstream->read->ready) {
+            return NGX_AGAIN;
+        }
+
+        size = NGX_HTTP_UPSTREAM_SPLICE_SIZE;
+
+        if (u->length != -1 && u->length < (off_t) size) {
+            size = (size_t) u->length;
+        }
+
+        n = ngx_event_splice_read(u->splice, upstream, size);
+
+        if (n == NGX_AGAIN) {
+            return NGX_AGAIN;
+        }
+
+        if (n > 0) {
+            u->state->response_length += n;
+
+            if (u->length != -1) {
+                u->length -= n;
+
+                if (u->length == 0) {
+                    u->keepalive = !u->headers_in.connection_close;
+                }
+            }
+        }
+    }
+}
+
+#endif
+
+
 static ngx_int_t
 ngx_http_upstream_non_buffered_filter_init(void *data)
 {
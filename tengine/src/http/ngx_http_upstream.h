@@ -40,6 +40,9 @@
 #define NGX_HTTP_UPSTREAM_INVALID_HEADER     40
 
 
+#define NGX_HTTP_UPSTREAM_SPLICE_SIZE        65536
+
+
 #define NGX_HTTP_UPSTREAM_IGN_XA_REDIRECT    0x00000002
 #define NGX_HTTP_UPSTREAM_IGN_XA_EXPIRES     0x00000004
 #define NGX_HTTP_UPSTREAM_IGN_EXPIRES        0x00000008
@@ -156,6 +159,12 @@ typedef struct {
     ngx_flag_t                       ignore_client_abort;
     ngx_flag_t                       intercept_errors;
     ngx_flag_t                       cyclic_temp_file;
+#if (NGX_HAVE_SPLICE)
+    ngx_flag_t                       splice;
+#endif
+#if (NGX_HAVE_TCP_FASTOPEN_CONNECT)
+    ngx_flag_t                       fastopen;
+#endif
 
     ngx_path_t                      *temp_path;
 
@@ -286,6 +295,10 @@ struct ngx_http_upstream_s {
     ngx_buf_t                        buffer;
     off_t                            length;
 
+#if (NGX_HAVE_SPLICE)
+    ngx_event_splice_t              *splice;
+#endif
+
     ngx_chain_t                     *out_bufs;
     ngx_chain_t                     *busy_bufs;
     ngx_chain_t                     *free_bufs;
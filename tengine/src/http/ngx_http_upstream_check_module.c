@@ -238,6 +238,7 @@ struct ngx_http_upstream_check_srv_conf_s {
     } code;
 
     ngx_uint_t                               default_down;
+    ngx_uint_t                               fastopen;
 };
 
 
@@ -953,6 +954,10 @@ ngx_http_upstream_check_connect_handler(ngx_event_t *event)
     peer->pc.cached = 0;
     peer->pc.connection = NULL;
 
+#if (NGX_HAVE_TCP_FASTOPEN_CONNECT)
+    peer->pc.fastopen = ucscf->fastopen;
+#endif
+
     rc = ngx_event_connect_peer(&peer->pc);
 
     if (rc == NGX_ERROR || rc == NGX_DECLINED) {
@@ -2277,6 +2282,7 @@ ngx_http_upstream_check(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
 {
     ngx_str_t                           *value, s;
     ngx_uint_t                           i, port, rise, fall, default_down;
+    ngx_uint_t                           fastopen;
     ngx_msec_t                           interval, timeout;
     ngx_http_upstream_check_srv_conf_t  *ucscf;
 
@@ -2287,6 +2293,7 @@ ngx_http_upstream_check(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
     interval = 30000;
     timeout = 1000;
     default_down = 1;
+    fastopen = 0;
 
     value = cf->args->elts;
 
@@ -2400,6 +2407,25 @@ ngx_http_upstream_check(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
             continue;
         }
 
+        if (ngx_strncmp(value[i].data, "fastopen=", 9) == 0) {
+            s.len = value[i].len - 9;
+            s.data = value[i].data + 9;
+
+            if (ngx_strcasecmp(s.data, (u_char *) "on") == 0) {
+                fastopen = 1;
+            } else if (ngx_strcasecmp(s.data, (u_char *) "off") == 0) {
+                fastopen = 0;
+            } else {
+                ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                                   "invalid value \"%s\", "
+                                   "it must be \"on\" or \"off\"",
+                                   value[i].data);
+                return NGX_CONF_ERROR;
+            }
+
+            continue;
+        }
+
         goto invalid_check_parameter;
     }
 
@@ -2415,6 +2441,29 @@ ngx_http_upstream_check(ngx_conf_t *cf, ngx_command_t *cmd, void *conf)
         ucscf->check_type_conf = ngx_http_get_check_type_conf(&s);
     }
 
+    /*
+     * a fast open connection is not established until the first write,
+     * so it is only usable by the checks that send a request first
+     */
+
+    if (fastopen) {
+#if (NGX_HAVE_TCP_FASTOPEN_CONNECT)
+        if (ucscf->check_type_conf->default_send.len == 0) {
+            ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                               "fast open cannot be used "
+                               "with the \"%V\" check",
+                               &ucscf->check_type_conf->name);
+            return NGX_CONF_ERROR;
+        }
+
+        ucscf->fastopen = 1;
+#else
+        ngx_conf_log_error(NGX_LOG_WARN, cf, 0,
+                           "fast open is not supported "
+                           "on this platform, ignored");
+#endif
+    }
+
     return NGX_CONF_OK;
 
 invalid_check_parameter:
@@ -0,0 +1,2969 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+/*
+ * An HTTP/2 connection is multiplexed onto fake connections, one per
+ * stream.  The request head of a stream is rewritten as HTTP/1.x text and
+ * is read through the fake connection together with the DATA payload, so
+ * the request line and header parsers, the body reading and the phases
+ * run unchanged.  The response goes through the usual filters, then the
+ * HEADERS frame is built by ngx_http_v2_filter_module and the body is cut
+ * into DATA frames by the send_chain of the fake connection.  The frames
+ * of all streams are queued on the connection ordered by stream priority.
+ */
+
+
+#define NGX_HTTP_V2_STREAM_INDEX_SIZE   32
+
+#define ngx_http_v2_index(h2c, sid)                                           \
+    (h2c)->streams_index[((sid) >> 1) & (NGX_HTTP_V2_STREAM_INDEX_SIZE - 1)]
+
+#define NGX_HTTP_V2_CONTROL_FRAME_SIZE  32
+
+/* the DATA frames a stream may have in the output queue */
+#define NGX_HTTP_V2_MAX_QUEUED          4
+
+/* the frames passed to a single send_chain() call */
+#define NGX_HTTP_V2_MAX_IOVS            64
+
+#define NGX_HTTP_V2_STREAM_WINDOW       NGX_HTTP_V2_DEFAULT_WINDOW
+#define NGX_HTTP_V2_CONNECTION_WINDOW   NGX_HTTP_V2_MAX_WINDOW
+
+#define NGX_HTTP_V2_CONTROL_RANK        0
+#define NGX_HTTP_V2_CONTROL_WEIGHT      257
+
+
+typedef ngx_int_t (*ngx_http_v2_handler_pt)(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t flags, ngx_uint_t sid, u_char *p, size_t len);
+
+
+static void ngx_http_v2_read_handler(ngx_event_t *rev);
+static void ngx_http_v2_write_handler(ngx_event_t *wev);
+static ngx_int_t ngx_http_v2_process_input(ngx_http_v2_connection_t *h2c);
+
+static ngx_int_t ngx_http_v2_state_data(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t flags, ngx_uint_t sid, u_char *p, size_t len);
+static ngx_int_t ngx_http_v2_buffer_data(ngx_http_v2_stream_t *stream,
+    u_char *p, size_t size);
+static ngx_int_t ngx_http_v2_state_headers(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t flags, ngx_uint_t sid, u_char *p, size_t len);
+static ngx_int_t ngx_http_v2_state_priority(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t flags, ngx_uint_t sid, u_char *p, size_t len);
+static ngx_int_t ngx_http_v2_state_rst_stream(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t flags, ngx_uint_t sid, u_char *p, size_t len);
+static ngx_int_t ngx_http_v2_state_settings(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t flags, ngx_uint_t sid, u_char *p, size_t len);
+static ngx_int_t ngx_http_v2_state_push_promise(
+    ngx_http_v2_connection_t *h2c, ngx_uint_t flags, ngx_uint_t sid,
+    u_char *p, size_t len);
+static ngx_int_t ngx_http_v2_state_ping(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t flags, ngx_uint_t sid, u_char *p, size_t len);
+static ngx_int_t ngx_http_v2_state_goaway(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t flags, ngx_uint_t sid, u_char *p, size_t len);
+static ngx_int_t ngx_http_v2_state_window_update(
+    ngx_http_v2_connection_t *h2c, ngx_uint_t flags, ngx_uint_t sid,
+    u_char *p, size_t len);
+static ngx_int_t ngx_http_v2_state_continuation(
+    ngx_http_v2_connection_t *h2c, ngx_uint_t flags, ngx_uint_t sid,
+    u_char *p, size_t len);
+
+static ngx_int_t ngx_http_v2_add_header_block(ngx_http_v2_connection_t *h2c,
+    u_char *p, size_t len);
+static ngx_int_t ngx_http_v2_process_header_block(
+    ngx_http_v2_connection_t *h2c);
+static ngx_int_t ngx_http_v2_parse_int(u_char **pos, u_char *end,
+    ngx_uint_t prefix, ngx_uint_t *value);
+static ngx_int_t ngx_http_v2_parse_string(ngx_http_v2_connection_t *h2c,
+    ngx_pool_t *pool, u_char **pos, u_char *end, ngx_str_t *str);
+static ngx_int_t ngx_http_v2_decode_header_block(
+    ngx_http_v2_connection_t *h2c, ngx_pool_t *pool, ngx_array_t *headers);
+static ngx_int_t ngx_http_v2_construct_request(ngx_http_v2_stream_t *stream,
+    ngx_array_t *headers);
+static void ngx_http_v2_construct_head(ngx_http_v2_stream_t *stream);
+static void ngx_http_v2_run_request(ngx_http_v2_stream_t *stream);
+
+static ngx_http_v2_stream_t *ngx_http_v2_create_stream(
+    ngx_http_v2_connection_t *h2c, ngx_uint_t sid);
+static ngx_http_v2_stream_t *ngx_http_v2_get_stream(
+    ngx_http_v2_connection_t *h2c, ngx_uint_t sid);
+static void ngx_http_v2_set_dependency(ngx_http_v2_connection_t *h2c,
+    ngx_http_v2_stream_t *stream, ngx_uint_t depend, ngx_uint_t weight,
+    ngx_uint_t exclusive);
+static void ngx_http_v2_unlink_stream(ngx_http_v2_stream_t *stream);
+static void ngx_http_v2_destroy_stream(ngx_http_v2_stream_t *stream);
+
+static ssize_t ngx_http_v2_recv(ngx_connection_t *fc, u_char *buf,
+    size_t size);
+static ssize_t ngx_http_v2_send(ngx_connection_t *fc, u_char *buf,
+    size_t size);
+static ngx_chain_t *ngx_http_v2_send_chain(ngx_connection_t *fc,
+    ngx_chain_t *in, off_t limit);
+
+static ngx_http_v2_out_frame_t *ngx_http_v2_get_frame(
+    ngx_http_v2_connection_t *h2c, size_t len, ngx_uint_t type,
+    ngx_uint_t flags, ngx_uint_t sid);
+static ngx_int_t ngx_http_v2_send_settings(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t ack);
+static ngx_int_t ngx_http_v2_send_window_update(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t sid, size_t window);
+static ngx_int_t ngx_http_v2_send_rst_stream(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t sid, ngx_uint_t status);
+static ngx_int_t ngx_http_v2_send_goaway(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t status);
+static void ngx_http_v2_frame_sent(ngx_http_v2_connection_t *h2c,
+    ngx_http_v2_out_frame_t *frame);
+
+static ngx_int_t ngx_http_v2_terminate_stream(ngx_http_v2_connection_t *h2c,
+    ngx_http_v2_stream_t *stream, ngx_uint_t status);
+static void ngx_http_v2_reset_stream(ngx_http_v2_stream_t *stream);
+static void ngx_http_v2_handle_stream(ngx_http_v2_stream_t *stream);
+static void ngx_http_v2_wait_window(ngx_http_v2_connection_t *h2c,
+    ngx_http_v2_stream_t *stream);
+static void ngx_http_v2_wake_waiting(ngx_http_v2_connection_t *h2c);
+static void ngx_http_v2_finalize_connection(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t status);
+static void ngx_http_v2_close_connection(ngx_http_v2_connection_t *h2c);
+
+static void *ngx_http_v2_create_srv_conf(ngx_conf_t *cf);
+static char *ngx_http_v2_merge_srv_conf(ngx_conf_t *cf, void *parent,
+    void *child);
+
+
+static ngx_conf_num_bounds_t  ngx_http_v2_streams_bounds = {
+    ngx_conf_check_num_bounds, 1, 65535
+};
+
+
+static ngx_command_t  ngx_http_v2_commands[] = {
+
+    { ngx_string("http2_max_concurrent_streams"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_num_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_v2_srv_conf_t, max_concurrent_streams),
+      &ngx_http_v2_streams_bounds },
+
+    { ngx_string("http2_max_header_size"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_size_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_v2_srv_conf_t, max_header_size),
+      NULL },
+
+    { ngx_string("http2_idle_timeout"),
+      NGX_HTTP_MAIN_CONF|NGX_HTTP_SRV_CONF|NGX_CONF_TAKE1,
+      ngx_conf_set_msec_slot,
+      NGX_HTTP_SRV_CONF_OFFSET,
+      offsetof(ngx_http_v2_srv_conf_t, idle_timeout),
+      NULL },
+
+      ngx_null_command
+};
+
+
+static ngx_http_module_t  ngx_http_v2_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    NULL,                                  /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    ngx_http_v2_create_srv_conf,           /* create server configuration */
+    ngx_http_v2_merge_srv_conf,            /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL                                   /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_v2_module = {
+    NGX_MODULE_V1,
+    &ngx_http_v2_module_ctx,               /* module context */
+    ngx_http_v2_commands,                  /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static ngx_http_v2_handler_pt  ngx_http_v2_frame_handlers[] = {
+    ngx_http_v2_state_data,
+    ngx_http_v2_state_headers,
+    ngx_http_v2_state_priority,
+    ngx_http_v2_state_rst_stream,
+    ngx_http_v2_state_settings,
+    ngx_http_v2_state_push_promise,
+    ngx_http_v2_state_ping,
+    ngx_http_v2_state_goaway,
+    ngx_http_v2_state_window_update,
+    ngx_http_v2_state_continuation
+};
+
+#define NGX_HTTP_V2_FRAME_STATES                                              \
+    (sizeof(ngx_http_v2_frame_handlers) / sizeof(ngx_http_v2_handler_pt))
+
+
+void
+ngx_http_v2_init(ngx_event_t *rev)
+{
+    int                        tcp_nodelay;
+    ngx_connection_t          *c;
+    ngx_http_request_t        *r;
+    ngx_http_log_ctx_t        *ctx;
+    ngx_http_v2_connection_t  *h2c;
+
+    c = rev->data;
+    r = c->data;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0, "init http2 connection");
+
+    h2c = ngx_pcalloc(c->pool, sizeof(ngx_http_v2_connection_t));
+    if (h2c == NULL) {
+        ngx_http_close_request(r, NGX_HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+
+    h2c->connection = c;
+    h2c->http_connection = r->http_connection;
+
+    h2c->h2scf = ngx_http_get_module_srv_conf(r, ngx_http_v2_module);
+    h2c->cscf = ngx_http_get_module_srv_conf(r, ngx_http_core_module);
+    h2c->clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+
+    h2c->send_window = NGX_HTTP_V2_DEFAULT_WINDOW;
+    h2c->recv_window = NGX_HTTP_V2_CONNECTION_WINDOW;
+    h2c->init_window = NGX_HTTP_V2_DEFAULT_WINDOW;
+    h2c->frame_size = NGX_HTTP_V2_DEFAULT_FRAME_SIZE;
+
+    h2c->hpack.allocated = NGX_HTTP_V2_TABLE_SIZE;
+
+    h2c->buf = ngx_palloc(c->pool, NGX_HTTP_V2_FRAME_BUFFER_SIZE);
+    if (h2c->buf == NULL) {
+        ngx_http_close_request(r, NGX_HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+
+    h2c->pos = h2c->buf;
+    h2c->last = h2c->buf;
+    h2c->end = h2c->buf + NGX_HTTP_V2_FRAME_BUFFER_SIZE;
+
+    h2c->streams_index = ngx_pcalloc(c->pool, sizeof(ngx_http_v2_stream_t *)
+                                              * NGX_HTTP_V2_STREAM_INDEX_SIZE);
+    if (h2c->streams_index == NULL) {
+        ngx_http_close_request(r, NGX_HTTP_INTERNAL_SERVER_ERROR);
+        return;
+    }
+
+    /* the last frames of a stream are not held back by the Nagle algorithm */
+
+    if (h2c->clcf->tcp_nodelay && c->tcp_nodelay == NGX_TCP_NODELAY_UNSET) {
+        tcp_nodelay = 1;
+
+        if (setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY,
+                       (const void *) &tcp_nodelay, sizeof(int))
+            == -1)
+        {
+            ngx_connection_error(c, ngx_socket_errno,
+                                 "setsockopt(TCP_NODELAY) failed");
+            ngx_http_close_request(r, 0);
+            return;
+        }
+
+        c->tcp_nodelay = NGX_TCP_NODELAY_SET;
+    }
+
+    /*
+     * the request created for the connection only carried the server
+     * configuration, the streams create their own requests
+     */
+
+#if (NGX_STAT_STUB)
+    if (r->stat_reading) {
+        (void) ngx_atomic_fetch_add(ngx_stat_reading, -1);
+    }
+
+    (void) ngx_atomic_fetch_add(ngx_stat_requests, -1);
+#endif
+
+    ngx_destroy_pool(r->pool);
+
+    h2c->http_connection->request = NULL;
+
+    ctx = c->log->data;
+    ctx->request = NULL;
+    ctx->current_request = NULL;
+
+    c->data = h2c;
+    c->log->action = "processing HTTP/2 connection";
+
+    rev->handler = ngx_http_v2_read_handler;
+    c->write->handler = ngx_http_v2_write_handler;
+
+    if (ngx_http_v2_send_settings(h2c, 0) != NGX_OK
+        || ngx_http_v2_send_window_update(h2c, 0,
+                                          NGX_HTTP_V2_CONNECTION_WINDOW
+                                          - NGX_HTTP_V2_DEFAULT_WINDOW)
+           != NGX_OK)
+    {
+        ngx_http_v2_close_connection(h2c);
+        return;
+    }
+
+    ngx_http_v2_read_handler(rev);
+}
+
+
+static void
+ngx_http_v2_read_handler(ngx_event_t *rev)
+{
+    size_t                     available;
+    ssize_t                    n;
+    ngx_int_t                  rc;
+    ngx_connection_t          *c;
+    ngx_http_v2_connection_t  *h2c;
+
+    c = rev->data;
+    h2c = c->data;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0, "http2 read handler");
+
+    if (h2c->closing) {
+        if (h2c->processing == 0) {
+            ngx_http_v2_close_connection(h2c);
+        }
+
+        return;
+    }
+
+    if (rev->timedout) {
+        ngx_log_error(NGX_LOG_INFO, c->log, NGX_ETIMEDOUT, "client timed out");
+        ngx_http_v2_finalize_connection(h2c, NGX_HTTP_V2_NO_ERROR);
+        return;
+    }
+
+    if (c->close) {
+        c->close = 0;
+        ngx_http_v2_finalize_connection(h2c, NGX_HTTP_V2_NO_ERROR);
+        return;
+    }
+
+    do {
+        available = h2c->end - h2c->last;
+
+        n = c->recv(c, h2c->last, available);
+
+        if (n == NGX_AGAIN) {
+            break;
+        }
+
+        if (n == 0 || n == NGX_ERROR) {
+
+            if (n == 0 && h2c->pos != h2c->last) {
+                ngx_log_error(NGX_LOG_INFO, c->log, 0,
+                              "client prematurely closed connection");
+            }
+
+            c->error = 1;
+            ngx_http_v2_finalize_connection(h2c, NGX_HTTP_V2_NO_ERROR);
+            return;
+        }
+
+        h2c->last += n;
+
+        rc = ngx_http_v2_process_input(h2c);
+
+        if (rc != NGX_OK) {
+            ngx_http_v2_finalize_connection(h2c, rc == NGX_ERROR
+                                                 ? NGX_HTTP_V2_INTERNAL_ERROR
+                                                 : (ngx_uint_t) rc);
+            return;
+        }
+
+    } while (rev->ready);
+
+    if (ngx_handle_read_event(rev, 0) != NGX_OK) {
+        ngx_http_v2_finalize_connection(h2c, NGX_HTTP_V2_INTERNAL_ERROR);
+        return;
+    }
+
+    if (ngx_http_v2_send_output_queue(h2c) == NGX_ERROR) {
+        ngx_http_v2_finalize_connection(h2c, NGX_HTTP_V2_NO_ERROR);
+        return;
+    }
+
+    if (h2c->processing == 0) {
+
+        if (h2c->goaway || ngx_exiting) {
+            ngx_http_v2_finalize_connection(h2c, NGX_HTTP_V2_NO_ERROR);
+            return;
+        }
+
+        c->idle = 1;
+        ngx_add_timer(rev, h2c->h2scf->idle_timeout);
+
+    } else if (rev->timer_set) {
+        ngx_del_timer(rev);
+    }
+}
+
+
+static void
+ngx_http_v2_write_handler(ngx_event_t *wev)
+{
+    ngx_connection_t          *c;
+    ngx_http_v2_connection_t  *h2c;
+
+    c = wev->data;
+    h2c = c->data;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0, "http2 write handler");
+
+    if (wev->timedout) {
+        ngx_log_error(NGX_LOG_INFO, c->log, NGX_ETIMEDOUT, "client timed out");
+        c->timedout = 1;
+        c->error = 1;
+    }
+
+    if (h2c->closing || c->error) {
+        ngx_http_v2_finalize_connection(h2c, NGX_HTTP_V2_NO_ERROR);
+        return;
+    }
+
+    if (ngx_http_v2_send_output_queue(h2c) == NGX_ERROR) {
+        ngx_http_v2_finalize_connection(h2c, NGX_HTTP_V2_NO_ERROR);
+    }
+}
+
+
+static ngx_int_t
+ngx_http_v2_process_input(ngx_http_v2_connection_t *h2c)
+{
+    u_char      *p;
+    size_t       len;
+    ngx_int_t    rc;
+    ngx_uint_t   type, flags, sid;
+
+    p = h2c->pos;
+
+    if (!h2c->preface) {
+        len = ngx_min((size_t) (h2c->last - p),
+                      sizeof(NGX_HTTP_V2_PREFACE) - 1);
+
+        if (ngx_memcmp(p, NGX_HTTP_V2_PREFACE, len) != 0) {
+            ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                          "client sent invalid http2 connection preface");
+            return NGX_HTTP_V2_PROTOCOL_ERROR;
+        }
+
+        if (len < sizeof(NGX_HTTP_V2_PREFACE) - 1) {
+            return NGX_OK;
+        }
+
+        p += len;
+        h2c->preface = 1;
+    }
+
+    while (h2c->last - p >= NGX_HTTP_V2_FRAME_HEADER_SIZE) {
+
+        len = ngx_http_v2_parse_length(p);
+        type = p[3];
+        flags = p[4];
+        sid = ngx_http_v2_parse_uint32(&p[5]) & 0x7fffffff;
+
+        if (len > NGX_HTTP_V2_DEFAULT_FRAME_SIZE) {
+            ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                          "client sent too large http2 frame: %uz", len);
+            return NGX_HTTP_V2_SIZE_ERROR;
+        }
+
+        if ((size_t) (h2c->last - p) < NGX_HTTP_V2_FRAME_HEADER_SIZE + len) {
+            break;
+        }
+
+        ngx_log_debug4(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                       "http2 frame type:%ui f:%Xi l:%uz sid:%ui",
+                       type, flags, len, sid);
+
+        if (h2c->hblock_sid && type != NGX_HTTP_V2_CONTINUATION_FRAME) {
+            ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                          "client sent frame type %ui "
+                          "instead of CONTINUATION", type);
+            return NGX_HTTP_V2_PROTOCOL_ERROR;
+        }
+
+        /* the frames of unknown types are ignored */
+
+        if (type < NGX_HTTP_V2_FRAME_STATES) {
+            rc = ngx_http_v2_frame_handlers[type](h2c, flags, sid,
+                                          p + NGX_HTTP_V2_FRAME_HEADER_SIZE,
+                                          len);
+            if (rc != NGX_OK) {
+                return rc;
+            }
+        }
+
+        p += NGX_HTTP_V2_FRAME_HEADER_SIZE + len;
+    }
+
+    /* the incomplete frame is moved to the start of the buffer */
+
+    len = h2c->last - p;
+
+    if (len && p != h2c->buf) {
+        ngx_memmove(h2c->buf, p, len);
+    }
+
+    h2c->pos = h2c->buf;
+    h2c->last = h2c->buf + len;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_state_data(ngx_http_v2_connection_t *h2c, ngx_uint_t flags,
+    ngx_uint_t sid, u_char *p, size_t len)
+{
+    size_t                 size, padding;
+    ngx_int_t              rc;
+    ngx_http_v2_stream_t  *stream;
+
+    if (sid == 0) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client sent DATA frame with stream id 0");
+        return NGX_HTTP_V2_PROTOCOL_ERROR;
+    }
+
+    /* the whole frame including the padding is subject to flow control */
+
+    h2c->recv_window -= len;
+
+    if (h2c->recv_window < 0) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client violated connection flow control");
+        return NGX_HTTP_V2_FLOW_CTRL_ERROR;
+    }
+
+    if (h2c->recv_window < NGX_HTTP_V2_CONNECTION_WINDOW / 4) {
+        if (ngx_http_v2_send_window_update(h2c, 0,
+                                           NGX_HTTP_V2_CONNECTION_WINDOW
+                                           - h2c->recv_window)
+            != NGX_OK)
+        {
+            return NGX_ERROR;
+        }
+
+        h2c->recv_window = NGX_HTTP_V2_CONNECTION_WINDOW;
+    }
+
+    padding = 0;
+    size = len;
+
+    if (flags & NGX_HTTP_V2_PADDED_FLAG) {
+        if (len == 0 || (size_t) p[0] >= len) {
+            ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                          "client sent DATA frame with invalid padding");
+            return NGX_HTTP_V2_PROTOCOL_ERROR;
+        }
+
+        padding = p[0] + 1;
+        size = len - padding;
+        p++;
+    }
+
+    stream = ngx_http_v2_get_stream(h2c, sid);
+
+    if (stream == NULL) {
+
+        if (sid > h2c->last_sid) {
+            ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                          "client sent DATA frame for idle stream %ui", sid);
+            return NGX_HTTP_V2_PROTOCOL_ERROR;
+        }
+
+        /* the stream is already closed or reset, the payload is skipped */
+
+        return NGX_OK;
+    }
+
+    if (stream->in_closed) {
+        return ngx_http_v2_terminate_stream(h2c, stream,
+                                            NGX_HTTP_V2_STREAM_CLOSED);
+    }
+
+    stream->recv_window -= len;
+
+    if (stream->recv_window < 0) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client violated flow control for stream %ui", sid);
+        return ngx_http_v2_terminate_stream(h2c, stream,
+                                            NGX_HTTP_V2_FLOW_CTRL_ERROR);
+    }
+
+    if (flags & NGX_HTTP_V2_END_STREAM_FLAG) {
+        stream->in_closed = 1;
+    }
+
+    if (stream->skip_data) {
+        size = 0;
+        padding = len;
+
+    } else if (stream->no_length) {
+
+        /*
+         * the body without the "content-length" header is buffered
+         * entirely before the request is started, so the window is
+         * not held by the buffered data
+         */
+
+        padding = len;
+    }
+
+    /* the data not buffered returns its window at once */
+
+    if (padding && !stream->in_closed) {
+        stream->recv_window += padding;
+
+        if (ngx_http_v2_send_window_update(h2c, sid, padding) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    if (size) {
+        rc = ngx_http_v2_buffer_data(stream, p, size);
+
+        if (rc == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+
+        if (rc == NGX_DECLINED) {
+            ngx_log_error(NGX_LOG_INFO, stream->fc->log, 0,
+                          "client intended to send too large body "
+                          "without \"content-length\" header");
+
+            return ngx_http_v2_terminate_stream(h2c, stream,
+                                                NGX_HTTP_V2_CANCEL);
+        }
+    }
+
+    if (stream->no_length) {
+
+        if (!stream->in_closed) {
+            return NGX_OK;
+        }
+
+        ngx_http_v2_construct_head(stream);
+        stream->no_length = 0;
+
+        ngx_http_v2_run_request(stream);
+
+        return NGX_OK;
+    }
+
+    if (stream->request && (size || stream->in_closed)) {
+        stream->fc->read->active = 0;
+        stream->fc->read->ready = 1;
+        ngx_post_event(stream->fc->read, &ngx_posted_events);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_buffer_data(ngx_http_v2_stream_t *stream, u_char *p, size_t size)
+{
+    size_t      len, n;
+    ngx_buf_t  *b, *nb;
+
+    b = stream->in;
+
+    if (b == NULL) {
+        b = ngx_create_temp_buf(stream->fc->pool, NGX_HTTP_V2_STREAM_WINDOW);
+        if (b == NULL) {
+            return NGX_ERROR;
+        }
+
+        stream->in = b;
+    }
+
+    if ((size_t) (b->end - b->last) >= size) {
+        b->last = ngx_cpymem(b->last, p, size);
+        return NGX_OK;
+    }
+
+    len = b->last - b->pos;
+
+    if ((size_t) (b->end - b->start) >= len + size) {
+        ngx_memmove(b->start, b->pos, len);
+        b->pos = b->start;
+        b->last = ngx_cpymem(b->start + len, p, size);
+        return NGX_OK;
+    }
+
+    /*
+     * the stream window keeps the buffered body within the buffer,
+     * only the body of unknown length grows up to client_max_body_size
+     */
+
+    n = (size_t) stream->connection->clcf->client_max_body_size;
+
+    if (n && len + size > n) {
+        return NGX_DECLINED;
+    }
+
+    n = ngx_max(2 * (size_t) (b->end - b->start), len + size);
+
+    nb = ngx_create_temp_buf(stream->fc->pool, n);
+    if (nb == NULL) {
+        return NGX_ERROR;
+    }
+
+    nb->last = ngx_cpymem(nb->pos, b->pos, len);
+    nb->last = ngx_cpymem(nb->last, p, size);
+
+    ngx_pfree(stream->fc->pool, b->start);
+
+    stream->in = nb;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_state_headers(ngx_http_v2_connection_t *h2c, ngx_uint_t flags,
+    ngx_uint_t sid, u_char *p, size_t len)
+{
+    u_char      *end;
+    ngx_uint_t   padding, depend;
+
+    if (sid == 0 || sid % 2 == 0) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client sent HEADERS frame with invalid stream id %ui",
+                      sid);
+        return NGX_HTTP_V2_PROTOCOL_ERROR;
+    }
+
+    end = p + len;
+    padding = 0;
+
+    if (flags & NGX_HTTP_V2_PADDED_FLAG) {
+        if (len == 0) {
+            return NGX_HTTP_V2_SIZE_ERROR;
+        }
+
+        padding = *p++;
+    }
+
+    h2c->hblock_priority = 0;
+
+    if (flags & NGX_HTTP_V2_PRIORITY_FLAG) {
+        if (end - p < 5) {
+            return NGX_HTTP_V2_SIZE_ERROR;
+        }
+
+        depend = ngx_http_v2_parse_uint32(p);
+
+        h2c->hblock_priority = 1;
+        h2c->hblock_exclusive = (depend >> 31) ? 1 : 0;
+        h2c->hblock_depend = depend & 0x7fffffff;
+        h2c->hblock_weight = p[4] + 1;
+
+        p += 5;
+    }
+
+    if ((size_t) (end - p) < padding) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client sent HEADERS frame with invalid padding");
+        return NGX_HTTP_V2_PROTOCOL_ERROR;
+    }
+
+    end -= padding;
+
+    h2c->hblock_sid = sid;
+    h2c->hblock_flags = flags;
+    h2c->hblock_len = 0;
+
+    if (ngx_http_v2_add_header_block(h2c, p, end - p) != NGX_OK) {
+        return NGX_HTTP_V2_ENHANCE_YOUR_CALM;
+    }
+
+    if (flags & NGX_HTTP_V2_END_HEADERS_FLAG) {
+        return ngx_http_v2_process_header_block(h2c);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_state_continuation(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t flags, ngx_uint_t sid, u_char *p, size_t len)
+{
+    if (h2c->hblock_sid == 0 || sid != h2c->hblock_sid) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client sent unexpected CONTINUATION frame");
+        return NGX_HTTP_V2_PROTOCOL_ERROR;
+    }
+
+    if (ngx_http_v2_add_header_block(h2c, p, len) != NGX_OK) {
+        return NGX_HTTP_V2_ENHANCE_YOUR_CALM;
+    }
+
+    if (flags & NGX_HTTP_V2_END_HEADERS_FLAG) {
+        return ngx_http_v2_process_header_block(h2c);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_add_header_block(ngx_http_v2_connection_t *h2c, u_char *p,
+    size_t len)
+{
+    size_t  size;
+
+    size = h2c->h2scf->max_header_size;
+
+    if (h2c->hblock_len + len > size) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client exceeded http2_max_header_size limit");
+        return NGX_ERROR;
+    }
+
+    if (h2c->hblock == NULL) {
+        h2c->hblock = ngx_palloc(h2c->connection->pool, size);
+        if (h2c->hblock == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    ngx_memcpy(h2c->hblock + h2c->hblock_len, p, len);
+    h2c->hblock_len += len;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_process_header_block(ngx_http_v2_connection_t *h2c)
+{
+    ngx_int_t              rc;
+    ngx_uint_t             sid, flags;
+    ngx_pool_t            *pool;
+    ngx_array_t            headers;
+    ngx_http_v2_stream_t  *stream;
+
+    sid = h2c->hblock_sid;
+    flags = h2c->hblock_flags;
+
+    h2c->hblock_sid = 0;
+
+    stream = NULL;
+
+    if (sid > h2c->last_sid) {
+        h2c->last_sid = sid;
+
+        if (!h2c->goaway
+            && h2c->processing < h2c->h2scf->max_concurrent_streams)
+        {
+            stream = ngx_http_v2_create_stream(h2c, sid);
+            if (stream == NULL) {
+                return NGX_ERROR;
+            }
+        }
+
+    } else if (ngx_http_v2_get_stream(h2c, sid) == NULL) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client sent HEADERS frame for closed stream %ui", sid);
+        return NGX_HTTP_V2_STREAM_CLOSED;
+
+    } else {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client sent trailers for stream %ui, ignored", sid);
+    }
+
+    /*
+     * the block is decoded anyway to keep the hpack table in sync; without
+     * a stream the fields are not needed after that, and are decoded into
+     * a temporary pool, as the table keeps its own copies
+     */
+
+    if (stream) {
+        pool = stream->fc->pool;
+
+    } else {
+        pool = ngx_create_pool(NGX_DEFAULT_POOL_SIZE, h2c->connection->log);
+        if (pool == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    if (ngx_array_init(&headers, pool, 16, sizeof(ngx_http_v2_header_t))
+        != NGX_OK)
+    {
+        rc = NGX_ERROR;
+
+    } else {
+        rc = ngx_http_v2_decode_header_block(h2c, pool, &headers);
+    }
+
+    if (stream == NULL) {
+        ngx_destroy_pool(pool);
+    }
+
+    if (rc != NGX_OK) {
+        if (stream) {
+            ngx_http_v2_unlink_stream(stream);
+            ngx_http_v2_destroy_stream(stream);
+        }
+
+        return rc == NGX_ERROR ? NGX_ERROR : NGX_HTTP_V2_COMP_ERROR;
+    }
+
+    if (stream == NULL) {
+
+        if (sid == h2c->last_sid
+            && ngx_http_v2_get_stream(h2c, sid) == NULL)
+        {
+            ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                          "concurrent streams exceeded %ui",
+                          h2c->h2scf->max_concurrent_streams);
+
+            if (ngx_http_v2_send_rst_stream(h2c, sid,
+                                            NGX_HTTP_V2_REFUSED_STREAM)
+                != NGX_OK)
+            {
+                return NGX_ERROR;
+            }
+
+            return NGX_OK;
+        }
+
+        /* the trailers end the request body */
+
+        if (flags & NGX_HTTP_V2_END_STREAM_FLAG) {
+            return ngx_http_v2_state_data(h2c, NGX_HTTP_V2_END_STREAM_FLAG,
+                                          sid, NULL, 0);
+        }
+
+        return NGX_OK;
+    }
+
+    if (h2c->hblock_priority) {
+        if (h2c->hblock_depend == sid) {
+            return ngx_http_v2_terminate_stream(h2c, stream,
+                                                NGX_HTTP_V2_PROTOCOL_ERROR);
+        }
+
+        ngx_http_v2_set_dependency(h2c, stream, h2c->hblock_depend,
+                                   h2c->hblock_weight,
+                                   h2c->hblock_exclusive);
+    }
+
+    if (flags & NGX_HTTP_V2_END_STREAM_FLAG) {
+        stream->in_closed = 1;
+    }
+
+    rc = ngx_http_v2_construct_request(stream, &headers);
+
+    if (rc == NGX_ERROR) {
+        return NGX_ERROR;
+    }
+
+    if (rc == NGX_DECLINED) {
+        return ngx_http_v2_terminate_stream(h2c, stream,
+                                            NGX_HTTP_V2_PROTOCOL_ERROR);
+    }
+
+    if (!stream->no_length) {
+        ngx_http_v2_run_request(stream);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_parse_int(u_char **pos, u_char *end, ngx_uint_t prefix,
+    ngx_uint_t *value)
+{
+    u_char      *p;
+    ngx_uint_t   n, shift;
+
+    p = *pos;
+
+    if (p == end) {
+        return NGX_ERROR;
+    }
+
+    n = *p++ & prefix;
+
+    if (n == prefix) {
+        shift = 0;
+
+        do {
+            if (p == end || shift > 21) {
+                return NGX_ERROR;
+            }
+
+            n += (ngx_uint_t) (*p & 0x7f) << shift;
+            shift += 7;
+
+        } while (*p++ & 0x80);
+    }
+
+    *pos = p;
+    *value = n;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_parse_string(ngx_http_v2_connection_t *h2c, ngx_pool_t *pool,
+    u_char **pos, u_char *end, ngx_str_t *str)
+{
+    u_char      *p;
+    ssize_t      n;
+    ngx_uint_t   len, huff;
+
+    p = *pos;
+
+    if (p == end) {
+        return NGX_ERROR;
+    }
+
+    huff = *p & 0x80;
+
+    if (ngx_http_v2_parse_int(&p, end, 0x7f, &len) != NGX_OK
+        || (size_t) (end - p) < len)
+    {
+        return NGX_ERROR;
+    }
+
+    if (huff) {
+
+        /* the shortest code is 5 bits long */
+
+        str->data = ngx_pnalloc(pool, len * 8 / 5 + 1);
+        if (str->data == NULL) {
+            return NGX_ERROR;
+        }
+
+        n = ngx_http_v2_huff_decode(p, len, str->data,
+                                    h2c->connection->log);
+        if (n == NGX_ERROR) {
+            return NGX_DECLINED;
+        }
+
+        str->len = n;
+
+    } else {
+        str->data = ngx_pnalloc(pool, len + 1);
+        if (str->data == NULL) {
+            return NGX_ERROR;
+        }
+
+        ngx_memcpy(str->data, p, len);
+        str->len = len;
+    }
+
+    *pos = p + len;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_decode_header_block(ngx_http_v2_connection_t *h2c,
+    ngx_pool_t *pool, ngx_array_t *headers)
+{
+    u_char                *p, *end;
+    ngx_int_t              rc;
+    ngx_uint_t             index, prefix, indexing, size_update;
+    ngx_http_v2_header_t   header, *h;
+
+    p = h2c->hblock;
+    end = p + h2c->hblock_len;
+
+    size_update = 1;
+
+    while (p < end) {
+
+        if (*p & 0x80) {
+
+            /* an indexed header field */
+
+            if (ngx_http_v2_parse_int(&p, end, 0x7f, &index) != NGX_OK
+                || ngx_http_v2_get_indexed_header(h2c, index, &header, 0)
+                   != NGX_OK)
+            {
+                return NGX_DECLINED;
+            }
+
+            indexing = 0;
+
+            goto copy;
+        }
+
+        if ((*p & 0xe0) == 0x20) {
+
+            /* a dynamic table size update at the start of the block */
+
+            if (!size_update
+                || ngx_http_v2_parse_int(&p, end, 0x1f, &index) != NGX_OK
+                || ngx_http_v2_table_size(h2c, index) != NGX_OK)
+            {
+                return NGX_DECLINED;
+            }
+
+            continue;
+        }
+
+        /* a literal header field with or without incremental indexing */
+
+        if (*p & 0x40) {
+            prefix = 0x3f;
+            indexing = 1;
+
+        } else {
+            prefix = 0x0f;
+            indexing = 0;
+        }
+
+        if (ngx_http_v2_parse_int(&p, end, prefix, &index) != NGX_OK) {
+            return NGX_DECLINED;
+        }
+
+        if (index) {
+            if (ngx_http_v2_get_indexed_header(h2c, index, &header, 1)
+                != NGX_OK)
+            {
+                return NGX_DECLINED;
+            }
+
+        } else {
+            rc = ngx_http_v2_parse_string(h2c, pool, &p, end, &header.name);
+            if (rc != NGX_OK) {
+                return rc;
+            }
+        }
+
+        rc = ngx_http_v2_parse_string(h2c, pool, &p, end, &header.value);
+        if (rc != NGX_OK) {
+            return rc;
+        }
+
+    copy:
+
+        size_update = 0;
+
+        h = ngx_array_push(headers);
+        if (h == NULL) {
+            return NGX_ERROR;
+        }
+
+        /* the table entries may be evicted by the following fields */
+
+        h->name.len = header.name.len;
+        h->name.data = ngx_pstrdup(pool, &header.name);
+        h->value.len = header.value.len;
+        h->value.data = ngx_pstrdup(pool, &header.value);
+
+        if (h->name.data == NULL || h->value.data == NULL) {
+            return NGX_ERROR;
+        }
+
+        if (indexing && ngx_http_v2_add_header(h2c, h) != NGX_OK) {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_construct_request(ngx_http_v2_stream_t *stream,
+    ngx_array_t *headers)
+{
+    u_char                *p, *last;
+    size_t                 len;
+    ngx_str_t              method, path, authority, *name;
+    ngx_uint_t             i, scheme, host, content_length, regular;
+    ngx_http_v2_header_t  *h;
+
+    ngx_str_null(&method);
+    ngx_str_null(&path);
+    ngx_str_null(&authority);
+
+    scheme = 0;
+    host = 0;
+    content_length = 0;
+    regular = 0;
+
+    len = 0;
+
+    h = headers->elts;
+
+    for (i = 0; i < headers->nelts; i++) {
+        name = &h[i].name;
+
+        if (name->len == 0) {
+            return NGX_DECLINED;
+        }
+
+        /* the values are put into the HTTP/1.x text as is */
+
+        for (p = h[i].value.data, last = p + h[i].value.len;
+             p < last;
+             p++)
+        {
+            if (*p == CR || *p == LF || *p == '\0') {
+                ngx_log_error(NGX_LOG_INFO, stream->fc->log, 0,
+                              "client sent invalid header value: \"%V\"",
+                              name);
+                return NGX_DECLINED;
+            }
+        }
+
+        if (name->data[0] == ':') {
+
+            if (regular) {
+                return NGX_DECLINED;
+            }
+
+            if (name->len == sizeof(":method") - 1
+                && ngx_strncmp(name->data, ":method", name->len) == 0)
+            {
+                method = h[i].value;
+
+            } else if (name->len == sizeof(":path") - 1
+                       && ngx_strncmp(name->data, ":path", name->len) == 0)
+            {
+                path = h[i].value;
+
+            } else if (name->len == sizeof(":scheme") - 1
+                       && ngx_strncmp(name->data, ":scheme", name->len) == 0)
+            {
+                scheme = 1;
+
+            } else if (name->len == sizeof(":authority") - 1
+                       && ngx_strncmp(name->data, ":authority", name->len)
+                          == 0)
+            {
+                authority = h[i].value;
+
+            } else {
+                ngx_log_error(NGX_LOG_INFO, stream->fc->log, 0,
+                              "client sent unknown pseudo header \"%V\"",
+                              name);
+                return NGX_DECLINED;
+            }
+
+            continue;
+        }
+
+        regular = 1;
+
+        for (p = name->data, last = p + name->len; p < last; p++) {
+            if ((*p >= 'A' && *p <= 'Z') || *p == ':' || *p <= ' '
+                || *p == 0x7f)
+            {
+                ngx_log_error(NGX_LOG_INFO, stream->fc->log, 0,
+                              "client sent invalid header name: \"%V\"",
+                              name);
+                return NGX_DECLINED;
+            }
+        }
+
+        /* the 100-continue is not sent for the streams */
+
+        if ((name->len == sizeof("expect") - 1
+             && ngx_strncmp(name->data, "expect", name->len) == 0)
+            || (name->len == sizeof("connection") - 1
+                && ngx_strncmp(name->data, "connection", name->len) == 0)
+            || (name->len == sizeof("transfer-encoding") - 1
+                && ngx_strncmp(name->data, "transfer-encoding", name->len)
+                   == 0))
+        {
+            name->len = 0;
+            continue;
+        }
+
+        if (name->len == sizeof("host") - 1
+            && ngx_strncmp(name->data, "host", name->len) == 0)
+        {
+            host = 1;
+        }
+
+        if (name->len == sizeof("content-length") - 1
+            && ngx_strncmp(name->data, "content-length", name->len) == 0)
+        {
+            content_length = 1;
+        }
+
+        len += name->len + sizeof(": ") - 1 + h[i].value.len
+               + sizeof(CRLF) - 1;
+    }
+
+    if (method.len == 0 || path.len == 0 || !scheme) {
+        ngx_log_error(NGX_LOG_INFO, stream->fc->log, 0,
+                      "client sent no required pseudo headers");
+        return NGX_DECLINED;
+    }
+
+    for (p = method.data, last = p + method.len; p < last; p++) {
+        if ((*p < 'A' || *p > 'Z') && *p != '_') {
+            return NGX_DECLINED;
+        }
+    }
+
+    for (p = path.data, last = p + path.len; p < last; p++) {
+        if (*p <= ' ' || *p == 0x7f) {
+            ngx_log_error(NGX_LOG_INFO, stream->fc->log, 0,
+                          "client sent invalid :path \"%V\"", &path);
+            return NGX_DECLINED;
+        }
+    }
+
+    len += method.len + 1 + path.len + sizeof(" HTTP/2.0" CRLF) - 1
+           + sizeof(CRLF) - 1;
+
+    if (!host && authority.len) {
+        len += sizeof("host: ") - 1 + authority.len + sizeof(CRLF) - 1;
+    }
+
+    if (!content_length && !stream->in_closed) {
+
+        /* the "content-length" header is added when the body is read */
+
+        stream->no_length = 1;
+        len += sizeof("content-length: ") - 1 + NGX_SIZE_T_LEN
+               + sizeof(CRLF) - 1;
+    }
+
+    stream->preread = ngx_create_temp_buf(stream->fc->pool, len);
+    if (stream->preread == NULL) {
+        return NGX_ERROR;
+    }
+
+    p = stream->preread->last;
+
+    p = ngx_cpymem(p, method.data, method.len);
+    *p++ = ' ';
+    p = ngx_cpymem(p, path.data, path.len);
+    p = ngx_cpymem(p, " HTTP/2.0" CRLF, sizeof(" HTTP/2.0" CRLF) - 1);
+
+    if (!host && authority.len) {
+        p = ngx_cpymem(p, "host: ", sizeof("host: ") - 1);
+        p = ngx_cpymem(p, authority.data, authority.len);
+        *p++ = CR; *p++ = LF;
+    }
+
+    for (i = 0; i < headers->nelts; i++) {
+        if (h[i].name.len == 0 || h[i].name.data[0] == ':') {
+            continue;
+        }
+
+        p = ngx_cpymem(p, h[i].name.data, h[i].name.len);
+        *p++ = ':'; *p++ = ' ';
+        p = ngx_cpymem(p, h[i].value.data, h[i].value.len);
+        *p++ = CR; *p++ = LF;
+    }
+
+    stream->preread->last = p;
+
+    if (!stream->no_length) {
+        ngx_http_v2_construct_head(stream);
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_v2_construct_head(ngx_http_v2_stream_t *stream)
+{
+    u_char  *p;
+    size_t   size;
+
+    p = stream->preread->last;
+
+    if (stream->no_length) {
+        size = stream->in ? (size_t) (stream->in->last - stream->in->pos) : 0;
+
+        p = ngx_sprintf(p, "content-length: %uz" CRLF, size);
+    }
+
+    *p++ = CR; *p++ = LF;
+
+    stream->preread->last = p;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, stream->fc->log, 0,
+                   "http2 request sid:%ui \"%*s\"", stream->id,
+                   (size_t) (p - stream->preread->pos), stream->preread->pos);
+}
+
+
+static void
+ngx_http_v2_run_request(ngx_http_v2_stream_t *stream)
+{
+    ngx_event_t  *rev;
+
+    rev = stream->fc->read;
+
+    rev->handler = ngx_http_init_request;
+    rev->ready = 1;
+
+#if (NGX_STAT_STUB)
+    (void) ngx_atomic_fetch_add(ngx_stat_reading, 1);
+#endif
+
+    ngx_post_event(rev, &ngx_posted_events);
+}
+
+
+static ngx_int_t
+ngx_http_v2_state_priority(ngx_http_v2_connection_t *h2c, ngx_uint_t flags,
+    ngx_uint_t sid, u_char *p, size_t len)
+{
+    ngx_uint_t             depend;
+    ngx_http_v2_stream_t  *stream;
+
+    if (len != 5) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client sent PRIORITY frame with invalid length %uz",
+                      len);
+        return NGX_HTTP_V2_SIZE_ERROR;
+    }
+
+    if (sid == 0) {
+        return NGX_HTTP_V2_PROTOCOL_ERROR;
+    }
+
+    depend = ngx_http_v2_parse_uint32(p);
+
+    /* the idle and closed streams are not kept in the tree */
+
+    stream = ngx_http_v2_get_stream(h2c, sid);
+
+    if (stream == NULL) {
+        return NGX_OK;
+    }
+
+    if ((depend & 0x7fffffff) == sid) {
+        return ngx_http_v2_terminate_stream(h2c, stream,
+                                            NGX_HTTP_V2_PROTOCOL_ERROR);
+    }
+
+    ngx_http_v2_set_dependency(h2c, stream, depend & 0x7fffffff, p[4] + 1,
+                               depend >> 31);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_state_rst_stream(ngx_http_v2_connection_t *h2c, ngx_uint_t flags,
+    ngx_uint_t sid, u_char *p, size_t len)
+{
+    ngx_http_v2_stream_t  *stream;
+
+    if (len != 4) {
+        return NGX_HTTP_V2_SIZE_ERROR;
+    }
+
+    if (sid == 0) {
+        return NGX_HTTP_V2_PROTOCOL_ERROR;
+    }
+
+    stream = ngx_http_v2_get_stream(h2c, sid);
+
+    if (stream == NULL) {
+        return NGX_OK;
+    }
+
+    ngx_log_error(NGX_LOG_INFO, stream->fc->log, 0,
+                  "client reset stream %ui with status %uD",
+                  sid, ngx_http_v2_parse_uint32(p));
+
+    stream->rst_sent = 1;
+
+    ngx_http_v2_reset_stream(stream);
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_state_settings(ngx_http_v2_connection_t *h2c, ngx_uint_t flags,
+    ngx_uint_t sid, u_char *p, size_t len)
+{
+    u_char                *end;
+    ssize_t                delta;
+    ngx_uint_t             id, value, i;
+    ngx_http_v2_stream_t  *stream;
+
+    if (sid != 0) {
+        return NGX_HTTP_V2_PROTOCOL_ERROR;
+    }
+
+    if (flags & NGX_HTTP_V2_ACK_FLAG) {
+        return len ? NGX_HTTP_V2_SIZE_ERROR : NGX_OK;
+    }
+
+    if (len % NGX_HTTP_V2_SETTINGS_PARAM_SIZE) {
+        return NGX_HTTP_V2_SIZE_ERROR;
+    }
+
+    for (end = p + len; p < end; p += NGX_HTTP_V2_SETTINGS_PARAM_SIZE) {
+        id = ngx_http_v2_parse_uint16(p);
+        value = ngx_http_v2_parse_uint32(&p[2]);
+
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                       "http2 setting %ui:%ui", id, value);
+
+        switch (id) {
+
+        case NGX_HTTP_V2_ENABLE_PUSH_SETTING:
+            if (value > 1) {
+                return NGX_HTTP_V2_PROTOCOL_ERROR;
+            }
+
+            break;
+
+        case NGX_HTTP_V2_INIT_WINDOW_SIZE_SETTING:
+            if (value > NGX_HTTP_V2_MAX_WINDOW) {
+                return NGX_HTTP_V2_FLOW_CTRL_ERROR;
+            }
+
+            /* the change applies to the windows of all open streams */
+
+            delta = (ssize_t) value - (ssize_t) h2c->init_window;
+            h2c->init_window = value;
+
+            for (i = 0; i < NGX_HTTP_V2_STREAM_INDEX_SIZE; i++) {
+                for (stream = h2c->streams_index[i];
+                     stream;
+                     stream = stream->index)
+                {
+                    stream->send_window += delta;
+
+                    if (stream->send_window > 0 && stream->exhausted) {
+                        stream->exhausted = 0;
+                        ngx_http_v2_handle_stream(stream);
+                    }
+                }
+            }
+
+            break;
+
+        case NGX_HTTP_V2_MAX_FRAME_SIZE_SETTING:
+            if (value < NGX_HTTP_V2_DEFAULT_FRAME_SIZE
+                || value > NGX_HTTP_V2_MAX_FRAME_SIZE)
+            {
+                return NGX_HTTP_V2_PROTOCOL_ERROR;
+            }
+
+            /* the frames sent are never larger than the default size */
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return ngx_http_v2_send_settings(h2c, 1);
+}
+
+
+static ngx_int_t
+ngx_http_v2_state_push_promise(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t flags, ngx_uint_t sid, u_char *p, size_t len)
+{
+    ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                  "client sent PUSH_PROMISE frame");
+
+    return NGX_HTTP_V2_PROTOCOL_ERROR;
+}
+
+
+static ngx_int_t
+ngx_http_v2_state_ping(ngx_http_v2_connection_t *h2c, ngx_uint_t flags,
+    ngx_uint_t sid, u_char *p, size_t len)
+{
+    ngx_http_v2_out_frame_t  *frame;
+
+    if (len != 8) {
+        return NGX_HTTP_V2_SIZE_ERROR;
+    }
+
+    if (sid != 0) {
+        return NGX_HTTP_V2_PROTOCOL_ERROR;
+    }
+
+    if (flags & NGX_HTTP_V2_ACK_FLAG) {
+        return NGX_OK;
+    }
+
+    frame = ngx_http_v2_get_frame(h2c, 8, NGX_HTTP_V2_PING_FRAME,
+                                  NGX_HTTP_V2_ACK_FLAG, 0);
+    if (frame == NULL) {
+        return NGX_ERROR;
+    }
+
+    frame->last = ngx_cpymem(frame->last, p, 8);
+
+    return ngx_http_v2_queue_frame(h2c, frame);
+}
+
+
+static ngx_int_t
+ngx_http_v2_state_goaway(ngx_http_v2_connection_t *h2c, ngx_uint_t flags,
+    ngx_uint_t sid, u_char *p, size_t len)
+{
+    if (len < 8) {
+        return NGX_HTTP_V2_SIZE_ERROR;
+    }
+
+    if (sid != 0) {
+        return NGX_HTTP_V2_PROTOCOL_ERROR;
+    }
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 goaway last sid:%uD status:%uD",
+                   ngx_http_v2_parse_uint32(p) & 0x7fffffff,
+                   ngx_http_v2_parse_uint32(&p[4]));
+
+    /* the open streams are completed, no new streams are accepted */
+
+    h2c->goaway = 1;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_state_window_update(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t flags, ngx_uint_t sid, u_char *p, size_t len)
+{
+    size_t                 window;
+    ngx_http_v2_stream_t  *stream;
+
+    if (len != 4) {
+        return NGX_HTTP_V2_SIZE_ERROR;
+    }
+
+    window = ngx_http_v2_parse_uint32(p) & 0x7fffffff;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 window update sid:%ui window:%uz", sid, window);
+
+    if (sid) {
+        stream = ngx_http_v2_get_stream(h2c, sid);
+
+        if (stream == NULL) {
+            return NGX_OK;
+        }
+
+        if (window == 0) {
+            return ngx_http_v2_terminate_stream(h2c, stream,
+                                                NGX_HTTP_V2_PROTOCOL_ERROR);
+        }
+
+        if (window > (size_t) (NGX_HTTP_V2_MAX_WINDOW - stream->send_window)) {
+            return ngx_http_v2_terminate_stream(h2c, stream,
+                                                NGX_HTTP_V2_FLOW_CTRL_ERROR);
+        }
+
+        stream->send_window += window;
+
+        if (stream->send_window > 0 && stream->exhausted) {
+            stream->exhausted = 0;
+            ngx_http_v2_handle_stream(stream);
+        }
+
+        return NGX_OK;
+    }
+
+    if (window == 0) {
+        return NGX_HTTP_V2_PROTOCOL_ERROR;
+    }
+
+    if (window > (size_t) (NGX_HTTP_V2_MAX_WINDOW - h2c->send_window)) {
+        return NGX_HTTP_V2_FLOW_CTRL_ERROR;
+    }
+
+    h2c->send_window += window;
+
+    if (h2c->send_window > 0) {
+        ngx_http_v2_wake_waiting(h2c);
+    }
+
+    return NGX_OK;
+}
+
+
+static ngx_http_v2_stream_t *
+ngx_http_v2_create_stream(ngx_http_v2_connection_t *h2c, ngx_uint_t sid)
+{
+    ngx_log_t               *log;
+    ngx_pool_t              *pool;
+    ngx_event_t             *rev, *wev;
+    ngx_connection_t        *fc, *c;
+    ngx_http_log_ctx_t      *ctx;
+    ngx_http_v2_stream_t    *stream, **index;
+    ngx_http_connection_t   *hc;
+
+    c = h2c->connection;
+
+    /*
+     * the fake connection outlives the stream pool, as the request code
+     * checks fc->destroyed after the request is closed
+     */
+
+    fc = h2c->free_fake_connections;
+
+    if (fc) {
+        h2c->free_fake_connections = fc->data;
+
+        rev = fc->read;
+        wev = fc->write;
+        log = fc->log;
+        ctx = log->data;
+
+    } else {
+        fc = ngx_palloc(c->pool, sizeof(ngx_connection_t));
+        rev = ngx_palloc(c->pool, sizeof(ngx_event_t));
+        wev = ngx_palloc(c->pool, sizeof(ngx_event_t));
+        log = ngx_palloc(c->pool, sizeof(ngx_log_t));
+        ctx = ngx_palloc(c->pool, sizeof(ngx_http_log_ctx_t));
+
+        if (fc == NULL || rev == NULL || wev == NULL || log == NULL
+            || ctx == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    pool = ngx_create_pool(h2c->cscf->connection_pool_size, c->log);
+    if (pool == NULL) {
+        fc->data = h2c->free_fake_connections;
+        h2c->free_fake_connections = fc;
+        return NULL;
+    }
+
+    hc = ngx_pcalloc(pool, sizeof(ngx_http_connection_t));
+    stream = ngx_pcalloc(pool, sizeof(ngx_http_v2_stream_t));
+
+    if (hc == NULL || stream == NULL) {
+        ngx_destroy_pool(pool);
+        fc->data = h2c->free_fake_connections;
+        h2c->free_fake_connections = fc;
+        return NULL;
+    }
+
+    ngx_memzero(fc, sizeof(ngx_connection_t));
+    ngx_memzero(rev, sizeof(ngx_event_t));
+    ngx_memzero(wev, sizeof(ngx_event_t));
+
+    *log = *c->log;
+    log->data = ctx;
+
+    pool->log = log;
+
+    ctx->connection = fc;
+    ctx->request = NULL;
+    ctx->current_request = NULL;
+
+    rev->data = fc;
+    rev->handler = ngx_http_empty_handler;
+    rev->log = log;
+
+    wev->data = fc;
+    wev->write = 1;
+    wev->ready = 1;
+    wev->handler = ngx_http_empty_handler;
+    wev->log = log;
+
+    hc->stream = stream;
+
+    fc->data = hc;
+    fc->read = rev;
+    fc->write = wev;
+    fc->fd = (ngx_socket_t) -1;
+
+    fc->recv = ngx_http_v2_recv;
+    fc->send = ngx_http_v2_send;
+    fc->send_chain = ngx_http_v2_send_chain;
+    fc->need_last_flush = 1;
+
+    fc->listening = c->listening;
+    fc->log = log;
+    fc->pool = pool;
+    fc->sockaddr = c->sockaddr;
+    fc->socklen = c->socklen;
+    fc->addr_text = c->addr_text;
+    fc->local_sockaddr = c->local_sockaddr;
+#if (NGX_SSL)
+    fc->ssl = c->ssl;
+#endif
+    fc->number = c->number;
+    fc->log_error = c->log_error;
+
+    fc->tcp_nodelay = NGX_TCP_NODELAY_DISABLED;
+    fc->tcp_nopush = NGX_TCP_NOPUSH_DISABLED;
+
+#if (NGX_STAT_STUB)
+    ngx_pool_set_stat(pool, ngx_stat_conn_memory);
+#endif
+
+    stream->id = sid;
+    stream->connection = h2c;
+    stream->fc = fc;
+    stream->weight = NGX_HTTP_V2_DEFAULT_WEIGHT;
+    stream->send_window = h2c->init_window;
+    stream->recv_window = NGX_HTTP_V2_STREAM_WINDOW;
+
+    index = &ngx_http_v2_index(h2c, sid);
+
+    stream->index = *index;
+    *index = stream;
+
+    h2c->processing++;
+
+    c->idle = 0;
+
+    return stream;
+}
+
+
+static ngx_http_v2_stream_t *
+ngx_http_v2_get_stream(ngx_http_v2_connection_t *h2c, ngx_uint_t sid)
+{
+    ngx_http_v2_stream_t  *stream;
+
+    for (stream = ngx_http_v2_index(h2c, sid);
+         stream;
+         stream = stream->index)
+    {
+        if (stream->id == sid) {
+            return stream;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * the dependency tree of RFC 7540, 5.3; the rank of a stream is its depth
+ * in the tree, the frames of the lower ranks and of the heavier streams
+ * within a rank are sent first
+ */
+
+static void
+ngx_http_v2_set_dependency(ngx_http_v2_connection_t *h2c,
+    ngx_http_v2_stream_t *stream, ngx_uint_t depend, ngx_uint_t weight,
+    ngx_uint_t exclusive)
+{
+    ngx_uint_t             i;
+    ngx_http_v2_stream_t  *parent, *s;
+
+    parent = depend ? ngx_http_v2_get_stream(h2c, depend) : NULL;
+
+    if (parent) {
+
+        /* the stream cannot depend on its own descendant */
+
+        for (s = parent->parent; s; s = s->parent) {
+            if (s == stream) {
+                parent->parent = stream->parent;
+                break;
+            }
+        }
+    }
+
+    if (exclusive) {
+        for (i = 0; i < NGX_HTTP_V2_STREAM_INDEX_SIZE; i++) {
+            for (s = h2c->streams_index[i]; s; s = s->index) {
+                if (s != stream && s->parent == parent) {
+                    s->parent = stream;
+                }
+            }
+        }
+    }
+
+    ngx_log_debug4(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 stream %ui depends on %ui weight:%ui excl:%ui",
+                   stream->id, depend, weight, exclusive);
+
+    stream->parent = parent;
+    stream->weight = weight;
+}
+
+
+ngx_uint_t
+ngx_http_v2_stream_rank(ngx_http_v2_stream_t *stream)
+{
+    ngx_uint_t  rank;
+
+    rank = 1;
+
+    while (stream->parent && rank < NGX_HTTP_V2_MAX_RANK) {
+        stream = stream->parent;
+        rank++;
+    }
+
+    return rank;
+}
+
+
+static ssize_t
+ngx_http_v2_recv(ngx_connection_t *fc, u_char *buf, size_t size)
+{
+    size_t                 n;
+    ngx_buf_t             *b;
+    ngx_http_request_t    *r;
+    ngx_http_v2_stream_t  *stream;
+
+    r = fc->data;
+    stream = r->stream;
+
+    if (fc->error) {
+        return NGX_ERROR;
+    }
+
+    b = stream->preread;
+
+    if (b == NULL || b->pos == b->last) {
+        b = stream->in;
+    }
+
+    if (b && b->pos < b->last) {
+        n = ngx_min(size, (size_t) (b->last - b->pos));
+
+        buf = ngx_cpymem(buf, b->pos, n);
+        b->pos += n;
+
+        if (b == stream->in && b->pos == b->last) {
+            b->pos = b->start;
+            b->last = b->start;
+
+            /* the window is returned when the buffered body is read */
+
+            if (!stream->in_closed) {
+                size = NGX_HTTP_V2_STREAM_WINDOW - stream->recv_window;
+                stream->recv_window = NGX_HTTP_V2_STREAM_WINDOW;
+
+                if (ngx_http_v2_send_window_update(stream->connection,
+                                                   stream->id, size)
+                    != NGX_OK
+                    || ngx_http_v2_send_output_queue(stream->connection)
+                       == NGX_ERROR)
+                {
+                    return NGX_ERROR;
+                }
+            }
+        }
+
+        ngx_log_debug2(NGX_LOG_DEBUG_HTTP, fc->log, 0,
+                       "http2 recv sid:%ui %uz", stream->id, n);
+
+        return n;
+    }
+
+    if (stream->in_closed) {
+        fc->read->eof = 1;
+        return 0;
+    }
+
+    fc->read->ready = 0;
+    fc->read->active = 1;
+
+    return NGX_AGAIN;
+}
+
+
+static ssize_t
+ngx_http_v2_send(ngx_connection_t *fc, u_char *buf, size_t size)
+{
+    ngx_log_error(NGX_LOG_ALERT, fc->log, 0,
+                  "http2 stream cannot send raw data");
+
+    return NGX_ERROR;
+}
+
+
+static ngx_chain_t *
+ngx_http_v2_send_chain(ngx_connection_t *fc, ngx_chain_t *in, off_t limit)
+{
+    u_char                    *p;
+    off_t                      size, sent;
+    size_t                     n, rest;
+    ngx_buf_t                 *b;
+    ngx_uint_t                 last, flags, blocked;
+    ngx_chain_t               *cl;
+    ngx_http_request_t        *r;
+    ngx_http_v2_stream_t      *stream;
+    ngx_http_v2_out_frame_t   *frame;
+    ngx_http_v2_connection_t  *h2c;
+
+    r = fc->data;
+    stream = r->stream;
+    h2c = stream->connection;
+
+    if (fc->error || h2c->connection->error) {
+        return NGX_CHAIN_ERROR;
+    }
+
+    if (limit == 0 || limit > (off_t) NGX_MAX_SIZE_T_VALUE) {
+        limit = NGX_MAX_SIZE_T_VALUE;
+    }
+
+    size = 0;
+    last = 0;
+
+    for (cl = in; cl; cl = cl->next) {
+        b = cl->buf;
+
+        if (b->last_buf) {
+            last = 1;
+        }
+
+        if (ngx_buf_special(b)) {
+            continue;
+        }
+
+        if (!ngx_buf_in_memory(b)) {
+            ngx_log_error(NGX_LOG_ALERT, fc->log, 0,
+                          "http2 stream got a buffer not in memory");
+            return NGX_CHAIN_ERROR;
+        }
+
+        size += b->last - b->pos;
+    }
+
+    if (stream->out_closed) {
+        size = 0;
+        last = 0;
+    }
+
+    sent = 0;
+    blocked = 0;
+    cl = in;
+
+    while (size || last) {
+
+        if (stream->queued >= NGX_HTTP_V2_MAX_QUEUED) {
+            stream->blocked = 1;
+            blocked = 1;
+            break;
+        }
+
+        n = 0;
+
+        if (size) {
+            if (stream->send_window <= 0) {
+                stream->exhausted = 1;
+                blocked = 1;
+                break;
+            }
+
+            if (h2c->send_window <= 0) {
+                ngx_http_v2_wait_window(h2c, stream);
+                blocked = 1;
+                break;
+            }
+
+            n = (size_t) ngx_min(size, NGX_HTTP_V2_DEFAULT_FRAME_SIZE);
+            n = ngx_min(n, (size_t) stream->send_window);
+            n = ngx_min(n, (size_t) h2c->send_window);
+            n = (size_t) ngx_min((off_t) n, limit - sent);
+
+            if (n == 0) {
+                break;
+            }
+        }
+
+        frame = stream->free_frames;
+
+        if (frame) {
+            stream->free_frames = frame->next;
+
+        } else {
+            frame = ngx_palloc(fc->pool, sizeof(ngx_http_v2_out_frame_t)
+                                         + NGX_HTTP_V2_FRAME_BUFFER_SIZE);
+            if (frame == NULL) {
+                return NGX_CHAIN_ERROR;
+            }
+
+            frame->start = (u_char *) frame
+                           + sizeof(ngx_http_v2_out_frame_t);
+            frame->end = frame->start + NGX_HTTP_V2_FRAME_BUFFER_SIZE;
+        }
+
+        frame->stream = stream;
+
+        p = frame->start + NGX_HTTP_V2_FRAME_HEADER_SIZE;
+
+        for (rest = n; rest; cl = cl->next) {
+            b = cl->buf;
+
+            if (ngx_buf_special(b)) {
+                continue;
+            }
+
+            n = ngx_min(rest, (size_t) (b->last - b->pos));
+
+            p = ngx_cpymem(p, b->pos, n);
+            b->pos += n;
+
+            if (b->in_file) {
+                b->file_pos += n;
+            }
+
+            rest -= n;
+
+            if (b->pos != b->last) {
+                break;
+            }
+        }
+
+        n = p - (frame->start + NGX_HTTP_V2_FRAME_HEADER_SIZE);
+
+        size -= n;
+        sent += n;
+
+        stream->send_window -= n;
+        h2c->send_window -= n;
+
+        flags = NGX_HTTP_V2_NO_FLAG;
+
+        if (size == 0 && last) {
+            flags = NGX_HTTP_V2_END_STREAM_FLAG;
+            stream->out_closed = 1;
+            last = 0;
+        }
+
+        frame->pos = frame->start;
+        frame->last = p;
+
+        (void) ngx_http_v2_write_frame_head(frame->start, n,
+                                            NGX_HTTP_V2_DATA_FRAME, flags,
+                                            stream->id);
+
+        if (ngx_http_v2_queue_frame(h2c, frame) != NGX_OK) {
+            return NGX_CHAIN_ERROR;
+        }
+
+        if (sent >= limit) {
+            break;
+        }
+    }
+
+    fc->sent += sent;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, fc->log, 0,
+                   "http2 send chain sid:%ui sent:%O blocked:%ui",
+                   stream->id, sent, blocked);
+
+    if (ngx_http_v2_send_output_queue(h2c) == NGX_ERROR) {
+        return NGX_CHAIN_ERROR;
+    }
+
+    for (cl = in; cl; cl = cl->next) {
+        b = cl->buf;
+
+        if (ngx_buf_special(b)) {
+            if (b->last_buf && !stream->out_closed) {
+                break;
+            }
+
+            continue;
+        }
+
+        if (b->pos != b->last) {
+            break;
+        }
+    }
+
+    if (cl && blocked) {
+        fc->write->active = 1;
+        fc->write->ready = 0;
+    }
+
+    return cl;
+}
+
+
+u_char *
+ngx_http_v2_write_frame_head(u_char *p, size_t len, ngx_uint_t type,
+    ngx_uint_t flags, ngx_uint_t sid)
+{
+    *p++ = (u_char) (len >> 16);
+    *p++ = (u_char) (len >> 8);
+    *p++ = (u_char) len;
+    *p++ = (u_char) type;
+    *p++ = (u_char) flags;
+
+    return ngx_http_v2_write_uint32(p, sid);
+}
+
+
+static ngx_http_v2_out_frame_t *
+ngx_http_v2_get_frame(ngx_http_v2_connection_t *h2c, size_t len,
+    ngx_uint_t type, ngx_uint_t flags, ngx_uint_t sid)
+{
+    ngx_http_v2_out_frame_t  *frame;
+
+    frame = h2c->free_frames;
+
+    if (frame) {
+        h2c->free_frames = frame->next;
+
+    } else {
+        frame = ngx_palloc(h2c->connection->pool,
+                           sizeof(ngx_http_v2_out_frame_t)
+                           + NGX_HTTP_V2_CONTROL_FRAME_SIZE);
+        if (frame == NULL) {
+            return NULL;
+        }
+
+        frame->start = (u_char *) frame + sizeof(ngx_http_v2_out_frame_t);
+        frame->end = frame->start + NGX_HTTP_V2_CONTROL_FRAME_SIZE;
+    }
+
+    frame->stream = NULL;
+    frame->pos = frame->start;
+    frame->last = ngx_http_v2_write_frame_head(frame->start, len, type,
+                                               flags, sid);
+
+    return frame;
+}
+
+
+static ngx_int_t
+ngx_http_v2_send_settings(ngx_http_v2_connection_t *h2c, ngx_uint_t ack)
+{
+    u_char                   *p;
+    ngx_http_v2_out_frame_t  *frame;
+
+    if (ack) {
+        frame = ngx_http_v2_get_frame(h2c, 0, NGX_HTTP_V2_SETTINGS_FRAME,
+                                      NGX_HTTP_V2_ACK_FLAG, 0);
+        if (frame == NULL) {
+            return NGX_ERROR;
+        }
+
+        return ngx_http_v2_queue_frame(h2c, frame);
+    }
+
+    frame = ngx_http_v2_get_frame(h2c, 2 * NGX_HTTP_V2_SETTINGS_PARAM_SIZE,
+                                  NGX_HTTP_V2_SETTINGS_FRAME,
+                                  NGX_HTTP_V2_NO_FLAG, 0);
+    if (frame == NULL) {
+        return NGX_ERROR;
+    }
+
+    p = frame->last;
+
+    p = ngx_http_v2_write_uint16(p, NGX_HTTP_V2_MAX_STREAMS_SETTING);
+    p = ngx_http_v2_write_uint32(p, h2c->h2scf->max_concurrent_streams);
+
+    p = ngx_http_v2_write_uint16(p, NGX_HTTP_V2_MAX_HEADER_LIST_SETTING);
+    p = ngx_http_v2_write_uint32(p, h2c->h2scf->max_header_size);
+
+    frame->last = p;
+
+    return ngx_http_v2_queue_frame(h2c, frame);
+}
+
+
+static ngx_int_t
+ngx_http_v2_send_window_update(ngx_http_v2_connection_t *h2c, ngx_uint_t sid,
+    size_t window)
+{
+    ngx_http_v2_out_frame_t  *frame;
+
+    if (window == 0) {
+        return NGX_OK;
+    }
+
+    frame = ngx_http_v2_get_frame(h2c, 4, NGX_HTTP_V2_WINDOW_UPDATE_FRAME,
+                                  NGX_HTTP_V2_NO_FLAG, sid);
+    if (frame == NULL) {
+        return NGX_ERROR;
+    }
+
+    frame->last = ngx_http_v2_write_uint32(frame->last, window);
+
+    return ngx_http_v2_queue_frame(h2c, frame);
+}
+
+
+static ngx_int_t
+ngx_http_v2_send_rst_stream(ngx_http_v2_connection_t *h2c, ngx_uint_t sid,
+    ngx_uint_t status)
+{
+    ngx_http_v2_stream_t      *stream;
+    ngx_http_v2_out_frame_t  **ll, *f, *frame;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 send RST_STREAM sid:%ui status:%ui", sid, status);
+
+    frame = ngx_http_v2_get_frame(h2c, 4, NGX_HTTP_V2_RST_STREAM_FRAME,
+                                  NGX_HTTP_V2_NO_FLAG, sid);
+    if (frame == NULL) {
+        return NGX_ERROR;
+    }
+
+    frame->last = ngx_http_v2_write_uint32(frame->last, status);
+
+    stream = ngx_http_v2_get_stream(h2c, sid);
+
+    if (stream == NULL || stream->queued == 0) {
+        return ngx_http_v2_queue_frame(h2c, frame);
+    }
+
+    /* the reset must not overtake the response of the stream */
+
+    frame->rank = ngx_http_v2_stream_rank(stream);
+    frame->weight = stream->weight;
+
+    ll = &h2c->out;
+
+    for (f = h2c->out; f; f = f->next) {
+        if (f->stream == stream) {
+            ll = &f->next;
+        }
+    }
+
+    frame->next = *ll;
+    *ll = frame;
+
+    return NGX_OK;
+}
+
+
+static ngx_int_t
+ngx_http_v2_send_goaway(ngx_http_v2_connection_t *h2c, ngx_uint_t status)
+{
+    ngx_http_v2_out_frame_t  *frame;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 send GOAWAY last sid:%ui status:%ui",
+                   h2c->last_sid, status);
+
+    frame = ngx_http_v2_get_frame(h2c, 8, NGX_HTTP_V2_GOAWAY_FRAME,
+                                  NGX_HTTP_V2_NO_FLAG, 0);
+    if (frame == NULL) {
+        return NGX_ERROR;
+    }
+
+    frame->last = ngx_http_v2_write_uint32(frame->last, h2c->last_sid);
+    frame->last = ngx_http_v2_write_uint32(frame->last, status);
+
+    return ngx_http_v2_queue_frame(h2c, frame);
+}
+
+
+ngx_int_t
+ngx_http_v2_queue_frame(ngx_http_v2_connection_t *h2c,
+    ngx_http_v2_out_frame_t *frame)
+{
+    ngx_http_v2_stream_t      *stream;
+    ngx_http_v2_out_frame_t  **ll, *f;
+
+    stream = frame->stream;
+
+    if (stream) {
+        frame->rank = ngx_http_v2_stream_rank(stream);
+        frame->weight = stream->weight;
+        stream->queued++;
+
+    } else {
+        frame->rank = NGX_HTTP_V2_CONTROL_RANK;
+        frame->weight = NGX_HTTP_V2_CONTROL_WEIGHT;
+    }
+
+    /*
+     * the frame is put after the frames of higher or equal priority and
+     * after the frames of its own stream, a partially sent frame stays
+     * at the head
+     */
+
+    ll = &h2c->out;
+
+    for (f = h2c->out; f; f = f->next) {
+
+        if ((f == h2c->out && f->pos != f->start)
+            || (stream && f->stream == stream)
+            || f->rank < frame->rank
+            || (f->rank == frame->rank && f->weight >= frame->weight))
+        {
+            ll = &f->next;
+        }
+    }
+
+    frame->next = *ll;
+    *ll = frame;
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_http_v2_send_output_queue(ngx_http_v2_connection_t *h2c)
+{
+    ngx_uint_t                 i, n;
+    ngx_buf_t                  bufs[NGX_HTTP_V2_MAX_IOVS];
+    ngx_chain_t               *cl, chain[NGX_HTTP_V2_MAX_IOVS];
+    ngx_event_t               *wev;
+    ngx_connection_t          *c;
+    ngx_http_v2_out_frame_t   *frame, *next, *frames[NGX_HTTP_V2_MAX_IOVS];
+
+    c = h2c->connection;
+    wev = c->write;
+
+    if (c->error) {
+        return NGX_ERROR;
+    }
+
+    if (!wev->ready) {
+        return NGX_AGAIN;
+    }
+
+    while (h2c->out || (c->buffered & NGX_LOWLEVEL_BUFFERED)) {
+
+        n = 0;
+
+        for (frame = h2c->out;
+             frame && n < NGX_HTTP_V2_MAX_IOVS;
+             frame = frame->next)
+        {
+            ngx_memzero(&bufs[n], sizeof(ngx_buf_t));
+
+            bufs[n].memory = 1;
+            bufs[n].start = frame->start;
+            bufs[n].pos = frame->pos;
+            bufs[n].last = frame->last;
+            bufs[n].end = frame->end;
+
+            chain[n].buf = &bufs[n];
+            chain[n].next = &chain[n + 1];
+
+            frames[n++] = frame;
+        }
+
+        if (n) {
+            bufs[n - 1].flush = 1;
+            chain[n - 1].next = NULL;
+        }
+
+        cl = c->send_chain(c, n ? chain : NULL, 0);
+
+        if (cl == NGX_CHAIN_ERROR) {
+            c->error = 1;
+
+            /* the connection is finalized by its own write handler */
+
+            ngx_post_event(wev, &ngx_posted_events);
+
+            return NGX_ERROR;
+        }
+
+        for (i = 0; i < n; i++) {
+            frame = frames[i];
+            frame->pos = bufs[i].pos;
+
+            if (frame->pos != frame->last) {
+                break;
+            }
+
+            next = frame->next;
+            h2c->out = next;
+
+            ngx_http_v2_frame_sent(h2c, frame);
+        }
+
+        if (cl || !wev->ready) {
+            break;
+        }
+    }
+
+    if (h2c->out || (c->buffered & NGX_LOWLEVEL_BUFFERED)) {
+
+        if (!wev->ready) {
+            ngx_add_timer(wev, h2c->clcf->send_timeout);
+
+            if (ngx_handle_write_event(wev, 0) != NGX_OK) {
+                c->error = 1;
+                ngx_post_event(wev, &ngx_posted_events);
+                return NGX_ERROR;
+            }
+        }
+
+        return NGX_AGAIN;
+    }
+
+    if (wev->timer_set) {
+        ngx_del_timer(wev);
+    }
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_v2_frame_sent(ngx_http_v2_connection_t *h2c,
+    ngx_http_v2_out_frame_t *frame)
+{
+    ngx_http_v2_stream_t  *stream;
+
+    stream = frame->stream;
+
+    if (stream == NULL) {
+        frame->next = h2c->free_frames;
+        h2c->free_frames = frame;
+        return;
+    }
+
+    stream->queued--;
+
+    if (frame->end - frame->start == NGX_HTTP_V2_FRAME_BUFFER_SIZE) {
+        frame->next = stream->free_frames;
+        stream->free_frames = frame;
+    }
+
+    if (stream->detached) {
+        if (stream->queued == 0) {
+            ngx_http_v2_destroy_stream(stream);
+        }
+
+        return;
+    }
+
+    if (stream->blocked && stream->queued < NGX_HTTP_V2_MAX_QUEUED) {
+        stream->blocked = 0;
+        ngx_http_v2_handle_stream(stream);
+    }
+}
+
+
+static ngx_int_t
+ngx_http_v2_terminate_stream(ngx_http_v2_connection_t *h2c,
+    ngx_http_v2_stream_t *stream, ngx_uint_t status)
+{
+    if (stream->rst_sent) {
+        return NGX_OK;
+    }
+
+    if (ngx_http_v2_send_rst_stream(h2c, stream->id, status) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    stream->rst_sent = 1;
+
+    ngx_http_v2_reset_stream(stream);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_v2_reset_stream(ngx_http_v2_stream_t *stream)
+{
+    ngx_connection_t  *fc;
+
+    stream->in_closed = 1;
+    stream->out_closed = 1;
+
+    if (stream->request == NULL) {
+        ngx_http_v2_close_stream(stream, 0);
+        return;
+    }
+
+    /* the request notices the error in its event handlers */
+
+    fc = stream->fc;
+    fc->error = 1;
+
+    fc->read->active = 0;
+    fc->read->ready = 1;
+    ngx_post_event(fc->read, &ngx_posted_events);
+
+    if (!fc->write->delayed) {
+        fc->write->active = 0;
+        fc->write->ready = 1;
+        ngx_post_event(fc->write, &ngx_posted_events);
+    }
+}
+
+
+static void
+ngx_http_v2_handle_stream(ngx_http_v2_stream_t *stream)
+{
+    ngx_event_t  *wev;
+
+    if (stream->request == NULL) {
+        return;
+    }
+
+    wev = stream->fc->write;
+
+    if (wev->delayed) {
+        return;
+    }
+
+    wev->active = 0;
+    wev->ready = 1;
+
+    ngx_post_event(wev, &ngx_posted_events);
+}
+
+
+static void
+ngx_http_v2_wait_window(ngx_http_v2_connection_t *h2c,
+    ngx_http_v2_stream_t *stream)
+{
+    ngx_uint_t              rank;
+    ngx_http_v2_stream_t  **ll, *s;
+
+    for (s = h2c->waiting; s; s = s->waiting) {
+        if (s == stream) {
+            return;
+        }
+    }
+
+    rank = ngx_http_v2_stream_rank(stream);
+
+    for (ll = &h2c->waiting; *ll; ll = &(*ll)->waiting) {
+        s = *ll;
+
+        if (ngx_http_v2_stream_rank(s) > rank
+            || (ngx_http_v2_stream_rank(s) == rank
+                && s->weight < stream->weight))
+        {
+            break;
+        }
+    }
+
+    stream->waiting = *ll;
+    *ll = stream;
+}
+
+
+static void
+ngx_http_v2_wake_waiting(ngx_http_v2_connection_t *h2c)
+{
+    ngx_http_v2_stream_t  *stream, *next, *reversed;
+
+    /*
+     * the posted events are handled in the reverse order, so the list
+     * is reversed to run the streams of higher priority first
+     */
+
+    reversed = NULL;
+
+    for (stream = h2c->waiting; stream; stream = next) {
+        next = stream->waiting;
+        stream->waiting = reversed;
+        reversed = stream;
+    }
+
+    h2c->waiting = NULL;
+
+    for (stream = reversed; stream; stream = next) {
+        next = stream->waiting;
+        stream->waiting = NULL;
+
+        ngx_http_v2_handle_stream(stream);
+    }
+}
+
+
+void
+ngx_http_v2_close_stream(ngx_http_v2_stream_t *stream, ngx_int_t rc)
+{
+    ngx_connection_t          *c;
+    ngx_http_v2_connection_t  *h2c;
+
+    h2c = stream->connection;
+    c = h2c->connection;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, c->log, 0,
+                   "http2 close stream %ui, queued %ui",
+                   stream->id, stream->queued);
+
+    if (stream->request) {
+        ngx_http_free_request(stream->request, rc);
+    }
+
+    stream->request = NULL;
+
+    if (!stream->rst_sent && !c->error) {
+
+        /*
+         * the response is incomplete, or the rest of the request body
+         * is not needed
+         */
+
+        if (!stream->out_closed || !stream->in_closed) {
+            if (ngx_http_v2_send_rst_stream(h2c, stream->id,
+                                            stream->out_closed
+                                            ? NGX_HTTP_V2_NO_ERROR
+                                            : NGX_HTTP_V2_INTERNAL_ERROR)
+                != NGX_OK)
+            {
+                c->error = 1;
+            }
+        }
+    }
+
+    ngx_http_v2_unlink_stream(stream);
+
+    if (stream->queued) {
+        stream->detached = 1;
+
+    } else {
+        ngx_http_v2_destroy_stream(stream);
+    }
+
+    if (!c->error) {
+        (void) ngx_http_v2_send_output_queue(h2c);
+    }
+
+    if (h2c->processing == 0) {
+
+        /* the connection is closed or set idle by its own read handler */
+
+        ngx_post_event(c->read, &ngx_posted_events);
+    }
+}
+
+
+static void
+ngx_http_v2_unlink_stream(ngx_http_v2_stream_t *stream)
+{
+    ngx_uint_t                 i;
+    ngx_http_v2_stream_t     **ll, *s;
+    ngx_http_v2_connection_t  *h2c;
+
+    h2c = stream->connection;
+
+    for (ll = &ngx_http_v2_index(h2c, stream->id); *ll; ll = &(*ll)->index) {
+        if (*ll == stream) {
+            *ll = stream->index;
+            break;
+        }
+    }
+
+    for (ll = &h2c->waiting; *ll; ll = &(*ll)->waiting) {
+        if (*ll == stream) {
+            *ll = stream->waiting;
+            break;
+        }
+    }
+
+    /* the children are moved to the parent of the closed stream */
+
+    for (i = 0; i < NGX_HTTP_V2_STREAM_INDEX_SIZE; i++) {
+        for (s = h2c->streams_index[i]; s; s = s->index) {
+            if (s->parent == stream) {
+                s->parent = stream->parent;
+            }
+        }
+    }
+
+    h2c->processing--;
+}
+
+
+static void
+ngx_http_v2_destroy_stream(ngx_http_v2_stream_t *stream)
+{
+    ngx_event_t               *ev;
+    ngx_connection_t          *fc;
+    ngx_http_v2_connection_t  *h2c;
+
+    fc = stream->fc;
+    h2c = stream->connection;
+
+#if (NGX_STAT_STUB)
+    if (fc->read->handler == ngx_http_init_request) {
+
+        /* the request was posted, but ngx_http_init_request() did not run */
+
+        (void) ngx_atomic_fetch_add(ngx_stat_reading, -1);
+    }
+#endif
+
+    ev = fc->read;
+
+    if (ev->timer_set) {
+        ngx_del_timer(ev);
+    }
+
+    if (ev->prev) {
+        ngx_delete_posted_event(ev);
+    }
+
+    ev = fc->write;
+
+    if (ev->timer_set) {
+        ngx_del_timer(ev);
+    }
+
+    if (ev->prev) {
+        ngx_delete_posted_event(ev);
+    }
+
+    fc->destroyed = 1;
+
+    ngx_destroy_pool(fc->pool);
+
+    fc->data = h2c->free_fake_connections;
+    h2c->free_fake_connections = fc;
+}
+
+
+static void
+ngx_http_v2_finalize_connection(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t status)
+{
+    ngx_uint_t             i;
+    ngx_connection_t      *c;
+    ngx_http_v2_stream_t  *stream, *next;
+
+    c = h2c->connection;
+
+    if (h2c->closing) {
+        if (h2c->processing == 0) {
+            ngx_http_v2_close_connection(h2c);
+        }
+
+        return;
+    }
+
+    h2c->closing = 1;
+
+    if (!c->error && ngx_http_v2_send_goaway(h2c, status) == NGX_OK) {
+        (void) ngx_http_v2_send_output_queue(h2c);
+    }
+
+    c->error = 1;
+
+    if (c->read->timer_set) {
+        ngx_del_timer(c->read);
+    }
+
+    if (c->write->timer_set) {
+        ngx_del_timer(c->write);
+    }
+
+    /* the streams with requests are closed by the requests themselves */
+
+    for (i = 0; i < NGX_HTTP_V2_STREAM_INDEX_SIZE; i++) {
+        for (stream = h2c->streams_index[i]; stream; stream = next) {
+            next = stream->index;
+
+            stream->rst_sent = 1;
+            ngx_http_v2_reset_stream(stream);
+        }
+    }
+
+    if (h2c->processing == 0) {
+        ngx_http_v2_close_connection(h2c);
+    }
+}
+
+
+static void
+ngx_http_v2_close_connection(ngx_http_v2_connection_t *h2c)
+{
+    ngx_connection_t         *c;
+    ngx_http_v2_stream_t     *stream;
+    ngx_http_v2_out_frame_t  *frame, *next;
+
+    c = h2c->connection;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_HTTP, c->log, 0, "http2 close connection");
+
+    /* the streams closed with the frames still queued */
+
+    for (frame = h2c->out; frame; frame = next) {
+        next = frame->next;
+        stream = frame->stream;
+
+        if (stream && --stream->queued == 0 && stream->detached) {
+            ngx_http_v2_destroy_stream(stream);
+        }
+    }
+
+    h2c->out = NULL;
+
+    ngx_http_v2_table_free(h2c);
+
+    ngx_http_close_connection(c);
+}
+
+
+static void *
+ngx_http_v2_create_srv_conf(ngx_conf_t *cf)
+{
+    ngx_http_v2_srv_conf_t  *h2scf;
+
+    h2scf = ngx_pcalloc(cf->pool, sizeof(ngx_http_v2_srv_conf_t));
+    if (h2scf == NULL) {
+        return NULL;
+    }
+
+    h2scf->max_concurrent_streams = NGX_CONF_UNSET_UINT;
+    h2scf->max_header_size = NGX_CONF_UNSET_SIZE;
+    h2scf->idle_timeout = NGX_CONF_UNSET_MSEC;
+
+    return h2scf;
+}
+
+
+static char *
+ngx_http_v2_merge_srv_conf(ngx_conf_t *cf, void *parent, void *child)
+{
+    ngx_http_v2_srv_conf_t *prev = parent;
+    ngx_http_v2_srv_conf_t *conf = child;
+
+    ngx_conf_merge_uint_value(conf->max_concurrent_streams,
+                              prev->max_concurrent_streams, 128);
+    ngx_conf_merge_size_value(conf->max_header_size,
+                              prev->max_header_size, 16384);
+    ngx_conf_merge_msec_value(conf->idle_timeout,
+                              prev->idle_timeout, 180000);
+
+    if (conf->max_header_size < 1024) {
+        ngx_conf_log_error(NGX_LOG_EMERG, cf, 0,
+                           "\"http2_max_header_size\" must be at least 1k");
+        return NGX_CONF_ERROR;
+    }
+
+    return NGX_CONF_OK;
+}
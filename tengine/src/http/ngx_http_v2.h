@@ -0,0 +1,242 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#ifndef _NGX_HTTP_V2_H_INCLUDED_
+#define _NGX_HTTP_V2_H_INCLUDED_
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+#define NGX_HTTP_V2_ALPN_ADVERTISE       "\x02h2"
+#define NGX_HTTP_V2_ALPN_PROTO           "h2"
+
+#define NGX_HTTP_V2_PREFACE              "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+
+#define NGX_HTTP_V2_FRAME_HEADER_SIZE    9
+#define NGX_HTTP_V2_DEFAULT_FRAME_SIZE   (1 << 14)
+#define NGX_HTTP_V2_MAX_FRAME_SIZE       ((1 << 24) - 1)
+#define NGX_HTTP_V2_FRAME_BUFFER_SIZE                                         \
+    (NGX_HTTP_V2_FRAME_HEADER_SIZE + NGX_HTTP_V2_DEFAULT_FRAME_SIZE)
+
+#define NGX_HTTP_V2_DEFAULT_WINDOW       65535
+#define NGX_HTTP_V2_MAX_WINDOW           ((1U << 31) - 1)
+
+#define NGX_HTTP_V2_TABLE_SIZE           4096
+#define NGX_HTTP_V2_TABLE_ENTRY_SIZE     32
+
+#define NGX_HTTP_V2_DEFAULT_WEIGHT       16
+#define NGX_HTTP_V2_MAX_RANK             32
+
+/* frame types */
+#define NGX_HTTP_V2_DATA_FRAME           0x0
+#define NGX_HTTP_V2_HEADERS_FRAME        0x1
+#define NGX_HTTP_V2_PRIORITY_FRAME       0x2
+#define NGX_HTTP_V2_RST_STREAM_FRAME     0x3
+#define NGX_HTTP_V2_SETTINGS_FRAME       0x4
+#define NGX_HTTP_V2_PUSH_PROMISE_FRAME   0x5
+#define NGX_HTTP_V2_PING_FRAME           0x6
+#define NGX_HTTP_V2_GOAWAY_FRAME         0x7
+#define NGX_HTTP_V2_WINDOW_UPDATE_FRAME  0x8
+#define NGX_HTTP_V2_CONTINUATION_FRAME   0x9
+
+/* frame flags */
+#define NGX_HTTP_V2_NO_FLAG              0x00
+#define NGX_HTTP_V2_ACK_FLAG             0x01
+#define NGX_HTTP_V2_END_STREAM_FLAG      0x01
+#define NGX_HTTP_V2_END_HEADERS_FLAG     0x04
+#define NGX_HTTP_V2_PADDED_FLAG          0x08
+#define NGX_HTTP_V2_PRIORITY_FLAG        0x20
+
+/* error codes */
+#define NGX_HTTP_V2_NO_ERROR             0x0
+#define NGX_HTTP_V2_PROTOCOL_ERROR       0x1
+#define NGX_HTTP_V2_INTERNAL_ERROR       0x2
+#define NGX_HTTP_V2_FLOW_CTRL_ERROR      0x3
+#define NGX_HTTP_V2_SETTINGS_TIMEOUT     0x4
+#define NGX_HTTP_V2_STREAM_CLOSED        0x5
+#define NGX_HTTP_V2_SIZE_ERROR           0x6
+#define NGX_HTTP_V2_REFUSED_STREAM       0x7
+#define NGX_HTTP_V2_CANCEL               0x8
+#define NGX_HTTP_V2_COMP_ERROR           0x9
+#define NGX_HTTP_V2_CONNECT_ERROR        0xa
+#define NGX_HTTP_V2_ENHANCE_YOUR_CALM    0xb
+
+/* settings */
+#define NGX_HTTP_V2_HEADER_TABLE_SIZE_SETTING    0x1
+#define NGX_HTTP_V2_ENABLE_PUSH_SETTING          0x2
+#define NGX_HTTP_V2_MAX_STREAMS_SETTING          0x3
+#define NGX_HTTP_V2_INIT_WINDOW_SIZE_SETTING     0x4
+#define NGX_HTTP_V2_MAX_FRAME_SIZE_SETTING       0x5
+#define NGX_HTTP_V2_MAX_HEADER_LIST_SETTING      0x6
+
+#define NGX_HTTP_V2_SETTINGS_PARAM_SIZE  6
+
+
+typedef struct ngx_http_v2_connection_s  ngx_http_v2_connection_t;
+typedef struct ngx_http_v2_out_frame_s   ngx_http_v2_out_frame_t;
+
+
+typedef struct {
+    ngx_uint_t                       max_concurrent_streams;
+    size_t                           max_header_size;
+    ngx_msec_t                       idle_timeout;
+} ngx_http_v2_srv_conf_t;
+
+
+typedef struct {
+    ngx_str_t                        name;
+    ngx_str_t                        value;
+} ngx_http_v2_header_t;
+
+
+typedef struct {
+    ngx_http_v2_header_t            *entries;
+    ngx_uint_t                       added;
+    ngx_uint_t                       deleted;
+    size_t                           size;
+    size_t                           allocated;
+} ngx_http_v2_hpack_t;
+
+
+struct ngx_http_v2_out_frame_s {
+    ngx_http_v2_out_frame_t         *next;
+    ngx_http_v2_stream_t            *stream;
+
+    u_char                          *pos;
+    u_char                          *last;
+    u_char                          *start;
+    u_char                          *end;
+
+    ngx_uint_t                       rank;
+    ngx_uint_t                       weight;
+};
+
+
+struct ngx_http_v2_stream_s {
+    ngx_uint_t                       id;
+
+    ngx_http_v2_connection_t        *connection;
+    ngx_connection_t                *fc;
+    ngx_http_request_t              *request;
+
+    ngx_http_v2_stream_t            *index;
+    ngx_http_v2_stream_t            *waiting;
+
+    /* the dependency tree */
+    ngx_http_v2_stream_t            *parent;
+    ngx_uint_t                       weight;
+
+    ssize_t                          send_window;
+    ssize_t                          recv_window;
+
+    /* the request head rewritten as HTTP/1.x text, then the request body */
+    ngx_buf_t                       *preread;
+    ngx_buf_t                       *in;
+
+    ngx_http_v2_out_frame_t         *free_frames;
+    ngx_uint_t                       queued;
+
+    unsigned                         in_closed:1;
+    unsigned                         out_closed:1;
+    unsigned                         rst_sent:1;
+    unsigned                         no_length:1;
+    unsigned                         skip_data:1;
+    unsigned                         exhausted:1;
+    unsigned                         blocked:1;
+    unsigned                         detached:1;
+};
+
+
+struct ngx_http_v2_connection_s {
+    ngx_connection_t                *connection;
+    ngx_http_connection_t           *http_connection;
+
+    ngx_http_v2_srv_conf_t          *h2scf;
+    ngx_http_core_srv_conf_t        *cscf;
+    ngx_http_core_loc_conf_t        *clcf;
+
+    ngx_uint_t                       processing;
+    ngx_uint_t                       last_sid;
+
+    ssize_t                          send_window;
+    ssize_t                          recv_window;
+    size_t                           init_window;
+    size_t                           frame_size;
+
+    /* the incoming frames */
+    u_char                          *buf;
+    u_char                          *pos;
+    u_char                          *last;
+    u_char                          *end;
+
+    /* the header block split over HEADERS and CONTINUATION frames */
+    u_char                          *hblock;
+    size_t                           hblock_len;
+    ngx_uint_t                       hblock_sid;
+    ngx_uint_t                       hblock_flags;
+    ngx_uint_t                       hblock_depend;
+    ngx_uint_t                       hblock_weight;
+    unsigned                         hblock_priority:1;
+    unsigned                         hblock_exclusive:1;
+
+    ngx_http_v2_stream_t           **streams_index;
+
+    ngx_http_v2_out_frame_t         *out;
+    ngx_http_v2_out_frame_t         *free_frames;
+    ngx_connection_t                *free_fake_connections;
+
+    /* the streams waiting for the connection window, by priority */
+    ngx_http_v2_stream_t            *waiting;
+
+    ngx_http_v2_hpack_t              hpack;
+
+    unsigned                         preface:1;
+    unsigned                         goaway:1;
+    unsigned                         closing:1;
+};
+
+
+void ngx_http_v2_init(ngx_event_t *rev);
+void ngx_http_v2_close_stream(ngx_http_v2_stream_t *stream, ngx_int_t rc);
+
+ngx_int_t ngx_http_v2_queue_frame(ngx_http_v2_connection_t *h2c,
+    ngx_http_v2_out_frame_t *frame);
+ngx_int_t ngx_http_v2_send_output_queue(ngx_http_v2_connection_t *h2c);
+ngx_uint_t ngx_http_v2_stream_rank(ngx_http_v2_stream_t *stream);
+u_char *ngx_http_v2_write_frame_head(u_char *p, size_t len, ngx_uint_t type,
+    ngx_uint_t flags, ngx_uint_t sid);
+
+ngx_int_t ngx_http_v2_get_indexed_header(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t index, ngx_http_v2_header_t *header, ngx_uint_t name_only);
+ngx_int_t ngx_http_v2_add_header(ngx_http_v2_connection_t *h2c,
+    ngx_http_v2_header_t *header);
+ngx_int_t ngx_http_v2_table_size(ngx_http_v2_connection_t *h2c, size_t size);
+void ngx_http_v2_table_free(ngx_http_v2_connection_t *h2c);
+
+ssize_t ngx_http_v2_huff_decode(u_char *src, size_t len, u_char *dst,
+    ngx_log_t *log);
+
+
+#define ngx_http_v2_parse_uint16(p)  ((p)[0] << 8 | (p)[1])
+#define ngx_http_v2_parse_uint32(p)                                           \
+    ((uint32_t) (p)[0] << 24 | (p)[1] << 16 | (p)[2] << 8 | (p)[3])
+#define ngx_http_v2_parse_length(p)  ((p)[0] << 16 | (p)[1] << 8 | (p)[2])
+
+#define ngx_http_v2_write_uint16(p, s)                                        \
+    ((p)[0] = (u_char) ((s) >> 8), (p)[1] = (u_char) (s), (p) + 2)
+#define ngx_http_v2_write_uint32(p, s)                                        \
+    ((p)[0] = (u_char) ((s) >> 24), (p)[1] = (u_char) ((s) >> 16),           \
+     (p)[2] = (u_char) ((s) >> 8), (p)[3] = (u_char) (s), (p) + 4)
+
+
+extern ngx_module_t  ngx_http_v2_module;
+
+
+#endif /* _NGX_HTTP_V2_H_INCLUDED_ */
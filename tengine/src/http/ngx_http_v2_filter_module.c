@@ -0,0 +1,535 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+#include <nginx.h>
+
+
+/* the static table indices of RFC 7541, Appendix A */
+
+#define NGX_HTTP_V2_STATUS_INDEX          8
+#define NGX_HTTP_V2_STATUS_200_INDEX      8
+#define NGX_HTTP_V2_STATUS_204_INDEX      9
+#define NGX_HTTP_V2_STATUS_206_INDEX      10
+#define NGX_HTTP_V2_STATUS_304_INDEX      11
+#define NGX_HTTP_V2_STATUS_400_INDEX      12
+#define NGX_HTTP_V2_STATUS_404_INDEX      13
+#define NGX_HTTP_V2_STATUS_500_INDEX      14
+
+#define NGX_HTTP_V2_CONTENT_LENGTH_INDEX  28
+#define NGX_HTTP_V2_CONTENT_TYPE_INDEX    31
+#define NGX_HTTP_V2_DATE_INDEX            33
+#define NGX_HTTP_V2_LAST_MODIFIED_INDEX   44
+#define NGX_HTTP_V2_SERVER_INDEX          54
+#define NGX_HTTP_V2_VARY_INDEX            59
+
+#define NGX_HTTP_V2_INT_LEN               5
+
+
+static u_char *ngx_http_v2_write_int(u_char *pos, ngx_uint_t prefix,
+    ngx_uint_t value);
+static u_char *ngx_http_v2_write_header(u_char *pos, ngx_uint_t index,
+    ngx_str_t *name, u_char *value, size_t len);
+static ngx_int_t ngx_http_v2_filter_init(ngx_conf_t *cf);
+
+
+static ngx_http_module_t  ngx_http_v2_filter_module_ctx = {
+    NULL,                                  /* preconfiguration */
+    ngx_http_v2_filter_init,               /* postconfiguration */
+
+    NULL,                                  /* create main configuration */
+    NULL,                                  /* init main configuration */
+
+    NULL,                                  /* create server configuration */
+    NULL,                                  /* merge server configuration */
+
+    NULL,                                  /* create location configuration */
+    NULL,                                  /* merge location configuration */
+};
+
+
+ngx_module_t  ngx_http_v2_filter_module = {
+    NGX_MODULE_V1,
+    &ngx_http_v2_filter_module_ctx,        /* module context */
+    NULL,                                  /* module directives */
+    NGX_HTTP_MODULE,                       /* module type */
+    NULL,                                  /* init master */
+    NULL,                                  /* init module */
+    NULL,                                  /* init process */
+    NULL,                                  /* init thread */
+    NULL,                                  /* exit thread */
+    NULL,                                  /* exit process */
+    NULL,                                  /* exit master */
+    NGX_MODULE_V1_PADDING
+};
+
+
+static ngx_http_output_header_filter_pt  ngx_http_next_header_filter;
+
+
+static u_char ngx_http_v2_server_string[] = "Tengine";
+static u_char ngx_http_v2_server_full_string[] = TENGINE_VER;
+
+
+/*
+ * the response header is encoded as literals without indexing, so the
+ * HEADERS frames of different streams may be sent in any order and the
+ * encoder keeps no dynamic table
+ */
+
+static ngx_int_t
+ngx_http_v2_header_filter(ngx_http_request_t *r)
+{
+    u_char                    *p, *pos, *last, *start;
+    size_t                     len, size, rest;
+    ngx_str_t                  name;
+    ngx_uint_t                 i, index, status, flags, type;
+    ngx_list_part_t           *part;
+    ngx_table_elt_t           *header;
+    ngx_connection_t          *fc;
+    ngx_http_v2_stream_t      *stream;
+    ngx_http_v2_out_frame_t   *frame;
+    ngx_http_core_loc_conf_t  *clcf;
+    ngx_http_v2_connection_t  *h2c;
+    u_char                     status_value[NGX_INT_T_LEN];
+
+    stream = r->stream;
+
+    if (stream == NULL) {
+        return ngx_http_next_header_filter(r);
+    }
+
+    if (r->header_sent) {
+        return NGX_OK;
+    }
+
+    r->header_sent = 1;
+
+    if (r != r->main) {
+        return NGX_OK;
+    }
+
+    fc = r->connection;
+    h2c = stream->connection;
+
+    if (fc->error || stream->out_closed) {
+        return NGX_ERROR;
+    }
+
+    if (r->method == NGX_HTTP_HEAD) {
+        r->header_only = 1;
+    }
+
+    if (r->headers_out.last_modified_time != -1) {
+        if (r->headers_out.status != NGX_HTTP_OK
+            && r->headers_out.status != NGX_HTTP_PARTIAL_CONTENT
+            && r->headers_out.status != NGX_HTTP_NOT_MODIFIED)
+        {
+            r->headers_out.last_modified_time = -1;
+            r->headers_out.last_modified = NULL;
+        }
+    }
+
+    status = r->headers_out.status;
+
+    if (status == 0 && r->headers_out.status_line.len >= 3) {
+        status = ngx_atoi(r->headers_out.status_line.data, 3);
+
+        if (status == (ngx_uint_t) NGX_ERROR) {
+            status = NGX_HTTP_INTERNAL_SERVER_ERROR;
+        }
+    }
+
+    switch (status) {
+
+    case NGX_HTTP_OK:
+        index = NGX_HTTP_V2_STATUS_200_INDEX;
+        break;
+
+    case NGX_HTTP_NO_CONTENT:
+        r->header_only = 1;
+        ngx_str_null(&r->headers_out.content_type);
+        r->headers_out.last_modified_time = -1;
+        r->headers_out.last_modified = NULL;
+        r->headers_out.content_length = NULL;
+        r->headers_out.content_length_n = -1;
+
+        index = NGX_HTTP_V2_STATUS_204_INDEX;
+        break;
+
+    case NGX_HTTP_PARTIAL_CONTENT:
+        index = NGX_HTTP_V2_STATUS_206_INDEX;
+        break;
+
+    case NGX_HTTP_NOT_MODIFIED:
+        r->header_only = 1;
+        index = NGX_HTTP_V2_STATUS_304_INDEX;
+        break;
+
+    case NGX_HTTP_BAD_REQUEST:
+        index = NGX_HTTP_V2_STATUS_400_INDEX;
+        break;
+
+    case NGX_HTTP_NOT_FOUND:
+        index = NGX_HTTP_V2_STATUS_404_INDEX;
+        break;
+
+    case NGX_HTTP_INTERNAL_SERVER_ERROR:
+        index = NGX_HTTP_V2_STATUS_500_INDEX;
+        break;
+
+    default:
+        index = 0;
+        break;
+    }
+
+    clcf = ngx_http_get_module_loc_conf(r, ngx_http_core_module);
+
+    /* the upper bound of the header block */
+
+    len = 1 + NGX_HTTP_V2_INT_LEN + sizeof(status_value);
+
+    if (r->headers_out.server == NULL) {
+        len += 1 + NGX_HTTP_V2_INT_LEN
+               + ngx_max(sizeof(ngx_http_v2_server_full_string),
+                         clcf->server_tag.len);
+    }
+
+    if (r->headers_out.date == NULL) {
+        len += 1 + NGX_HTTP_V2_INT_LEN + ngx_cached_http_time.len;
+    }
+
+    if (r->headers_out.content_type.len) {
+        len += 1 + NGX_HTTP_V2_INT_LEN + r->headers_out.content_type.len
+               + sizeof("; charset=") - 1 + r->headers_out.charset.len;
+    }
+
+    if (r->headers_out.content_length == NULL
+        && r->headers_out.content_length_n >= 0)
+    {
+        len += 1 + NGX_HTTP_V2_INT_LEN + NGX_OFF_T_LEN;
+    }
+
+    if (r->headers_out.last_modified == NULL
+        && r->headers_out.last_modified_time != -1)
+    {
+        len += 1 + NGX_HTTP_V2_INT_LEN
+               + sizeof("Mon, 28 Sep 1970 06:00:00 GMT") - 1;
+    }
+
+#if (NGX_HTTP_GZIP)
+    if (r->gzip_vary) {
+        if (clcf->gzip_vary) {
+            len += 1 + NGX_HTTP_V2_INT_LEN + sizeof("Accept-Encoding") - 1;
+
+        } else {
+            r->gzip_vary = 0;
+        }
+    }
+#endif
+
+    part = &r->headers_out.headers.part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        len += 1 + 2 * NGX_HTTP_V2_INT_LEN
+               + header[i].key.len + header[i].value.len;
+    }
+
+    start = ngx_pnalloc(r->pool, len);
+    if (start == NULL) {
+        return NGX_ERROR;
+    }
+
+    last = start;
+
+    if (index) {
+        *last++ = (u_char) (0x80 | index);
+
+    } else {
+        p = ngx_sprintf(status_value, "%03ui", status);
+        last = ngx_http_v2_write_header(last, NGX_HTTP_V2_STATUS_INDEX, NULL,
+                                        status_value, p - status_value);
+    }
+
+    if (r->headers_out.server == NULL) {
+
+        if (clcf->server_tag_type == NGX_HTTP_SERVER_TAG_ON) {
+            if (clcf->server_tokens) {
+                p = ngx_http_v2_server_full_string;
+                size = sizeof(ngx_http_v2_server_full_string) - 1;
+
+            } else {
+                p = ngx_http_v2_server_string;
+                size = sizeof(ngx_http_v2_server_string) - 1;
+            }
+
+            last = ngx_http_v2_write_header(last, NGX_HTTP_V2_SERVER_INDEX,
+                                            NULL, p, size);
+
+        } else if (clcf->server_tag_type == NGX_HTTP_SERVER_TAG_CUSTOMIZED) {
+
+            /* the customized tag is kept as the whole "Server: ..." line */
+
+            p = clcf->server_tag.data;
+            size = clcf->server_tag.len;
+
+            if (size > sizeof("Server: ") - 1 + 2) {
+                last = ngx_http_v2_write_header(last,
+                                                NGX_HTTP_V2_SERVER_INDEX,
+                                                NULL,
+                                                p + sizeof("Server: ") - 1,
+                                                size - sizeof("Server: ") + 1
+                                                - 2);
+            }
+        }
+    }
+
+    if (r->headers_out.date == NULL) {
+        last = ngx_http_v2_write_header(last, NGX_HTTP_V2_DATE_INDEX, NULL,
+                                        ngx_cached_http_time.data,
+                                        ngx_cached_http_time.len);
+    }
+
+    if (r->headers_out.content_type.len) {
+        p = ngx_pnalloc(r->pool, r->headers_out.content_type.len
+                                 + sizeof("; charset=") - 1
+                                 + r->headers_out.charset.len);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        pos = ngx_cpymem(p, r->headers_out.content_type.data,
+                         r->headers_out.content_type.len);
+
+        if (r->headers_out.content_type_len == r->headers_out.content_type.len
+            && r->headers_out.charset.len)
+        {
+            pos = ngx_cpymem(pos, "; charset=", sizeof("; charset=") - 1);
+            pos = ngx_cpymem(pos, r->headers_out.charset.data,
+                             r->headers_out.charset.len);
+        }
+
+        last = ngx_http_v2_write_header(last, NGX_HTTP_V2_CONTENT_TYPE_INDEX,
+                                        NULL, p, pos - p);
+    }
+
+    if (r->headers_out.content_length == NULL
+        && r->headers_out.content_length_n >= 0)
+    {
+        p = ngx_pnalloc(r->pool, NGX_OFF_T_LEN);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        pos = ngx_sprintf(p, "%O", r->headers_out.content_length_n);
+
+        last = ngx_http_v2_write_header(last,
+                                        NGX_HTTP_V2_CONTENT_LENGTH_INDEX,
+                                        NULL, p, pos - p);
+    }
+
+    if (r->headers_out.last_modified == NULL
+        && r->headers_out.last_modified_time != -1)
+    {
+        p = ngx_pnalloc(r->pool, sizeof("Mon, 28 Sep 1970 06:00:00 GMT") - 1);
+        if (p == NULL) {
+            return NGX_ERROR;
+        }
+
+        pos = ngx_http_time(p, r->headers_out.last_modified_time);
+
+        last = ngx_http_v2_write_header(last,
+                                        NGX_HTTP_V2_LAST_MODIFIED_INDEX,
+                                        NULL, p, pos - p);
+    }
+
+#if (NGX_HTTP_GZIP)
+    if (r->gzip_vary) {
+        last = ngx_http_v2_write_header(last, NGX_HTTP_V2_VARY_INDEX, NULL,
+                                        (u_char *) "Accept-Encoding",
+                                        sizeof("Accept-Encoding") - 1);
+    }
+#endif
+
+    part = &r->headers_out.headers.part;
+    header = part->elts;
+
+    for (i = 0; /* void */; i++) {
+
+        if (i >= part->nelts) {
+            if (part->next == NULL) {
+                break;
+            }
+
+            part = part->next;
+            header = part->elts;
+            i = 0;
+        }
+
+        if (header[i].hash == 0) {
+            continue;
+        }
+
+        /* the connection-specific fields are not allowed in HTTP/2 */
+
+        name = header[i].key;
+
+        if ((name.len == sizeof("Connection") - 1
+             && ngx_strncasecmp(name.data, (u_char *) "Connection",
+                                name.len) == 0)
+            || (name.len == sizeof("Keep-Alive") - 1
+                && ngx_strncasecmp(name.data, (u_char *) "Keep-Alive",
+                                   name.len) == 0)
+            || (name.len == sizeof("Proxy-Connection") - 1
+                && ngx_strncasecmp(name.data, (u_char *) "Proxy-Connection",
+                                   name.len) == 0)
+            || (name.len == sizeof("Transfer-Encoding") - 1
+                && ngx_strncasecmp(name.data, (u_char *) "Transfer-Encoding",
+                                   name.len) == 0)
+            || (name.len == sizeof("Upgrade") - 1
+                && ngx_strncasecmp(name.data, (u_char *) "Upgrade",
+                                   name.len) == 0))
+        {
+            continue;
+        }
+
+        last = ngx_http_v2_write_header(last, 0, &name,
+                                        header[i].value.data,
+                                        header[i].value.len);
+    }
+
+    /* the block is split into the HEADERS and CONTINUATION frames */
+
+    size = last - start;
+    r->header_size = size;
+    fc->sent += size;
+
+    pos = start;
+    type = NGX_HTTP_V2_HEADERS_FRAME;
+
+    do {
+        rest = ngx_min(size, h2c->frame_size);
+
+        frame = ngx_palloc(fc->pool, sizeof(ngx_http_v2_out_frame_t)
+                                     + NGX_HTTP_V2_FRAME_HEADER_SIZE + rest);
+        if (frame == NULL) {
+            return NGX_ERROR;
+        }
+
+        frame->start = (u_char *) frame + sizeof(ngx_http_v2_out_frame_t);
+        frame->end = frame->start + NGX_HTTP_V2_FRAME_HEADER_SIZE + rest;
+        frame->pos = frame->start;
+        frame->stream = stream;
+
+        flags = (rest == size) ? NGX_HTTP_V2_END_HEADERS_FLAG
+                               : NGX_HTTP_V2_NO_FLAG;
+
+        if (type == NGX_HTTP_V2_HEADERS_FRAME && r->header_only) {
+            flags |= NGX_HTTP_V2_END_STREAM_FLAG;
+        }
+
+        p = ngx_http_v2_write_frame_head(frame->start, rest, type, flags,
+                                         stream->id);
+        frame->last = ngx_cpymem(p, pos, rest);
+
+        if (ngx_http_v2_queue_frame(h2c, frame) != NGX_OK) {
+            return NGX_ERROR;
+        }
+
+        pos += rest;
+        size -= rest;
+        type = NGX_HTTP_V2_CONTINUATION_FRAME;
+
+    } while (size);
+
+    ngx_log_debug3(NGX_LOG_DEBUG_HTTP, fc->log, 0,
+                   "http2 header: sid:%ui status:%ui size:%uz",
+                   stream->id, status, (size_t) (last - start));
+
+    if (r->header_only) {
+        stream->out_closed = 1;
+
+        if (ngx_http_v2_send_output_queue(h2c) == NGX_ERROR) {
+            return NGX_ERROR;
+        }
+    }
+
+    return NGX_OK;
+}
+
+
+static u_char *
+ngx_http_v2_write_int(u_char *pos, ngx_uint_t prefix, ngx_uint_t value)
+{
+    if (value < prefix) {
+        *pos++ |= (u_char) value;
+        return pos;
+    }
+
+    *pos++ |= (u_char) prefix;
+    value -= prefix;
+
+    while (value >= 128) {
+        *pos++ = (u_char) (value % 128 + 128);
+        value /= 128;
+    }
+
+    *pos++ = (u_char) value;
+
+    return pos;
+}
+
+
+static u_char *
+ngx_http_v2_write_header(u_char *pos, ngx_uint_t index, ngx_str_t *name,
+    u_char *value, size_t len)
+{
+    /* a literal header field without indexing, RFC 7541, 6.2.2 */
+
+    *pos = 0;
+    pos = ngx_http_v2_write_int(pos, 0x0f, index);
+
+    if (index == 0) {
+        *pos = 0;
+        pos = ngx_http_v2_write_int(pos, 0x7f, name->len);
+        ngx_strlow(pos, name->data, name->len);
+        pos += name->len;
+    }
+
+    *pos = 0;
+    pos = ngx_http_v2_write_int(pos, 0x7f, len);
+
+    return ngx_cpymem(pos, value, len);
+}
+
+
+static ngx_int_t
+ngx_http_v2_filter_init(ngx_conf_t *cf)
+{
+    ngx_http_next_header_filter = ngx_http_top_header_filter;
+    ngx_http_top_header_filter = ngx_http_v2_header_filter;
+
+    return NGX_OK;
+}
@@ -0,0 +1,238 @@
+
+/*
+ * Copyright (C) Igor Sysoev
+ * Copyright (C) Nginx, Inc.
+ */
+
+
+#include <ngx_config.h>
+#include <ngx_core.h>
+#include <ngx_http.h>
+
+
+#define ngx_http_v2_table_entries                                             \
+    (NGX_HTTP_V2_TABLE_SIZE / NGX_HTTP_V2_TABLE_ENTRY_SIZE)
+
+#define ngx_http_v2_entry_size(h)                                             \
+    ((h)->name.len + (h)->value.len + NGX_HTTP_V2_TABLE_ENTRY_SIZE)
+
+
+static void ngx_http_v2_table_evict(ngx_http_v2_connection_t *h2c,
+    size_t size);
+
+
+static ngx_http_v2_header_t  ngx_http_v2_static_table[] = {
+    { ngx_string(":authority"), ngx_string("") },
+    { ngx_string(":method"), ngx_string("GET") },
+    { ngx_string(":method"), ngx_string("POST") },
+    { ngx_string(":path"), ngx_string("/") },
+    { ngx_string(":path"), ngx_string("/index.html") },
+    { ngx_string(":scheme"), ngx_string("http") },
+    { ngx_string(":scheme"), ngx_string("https") },
+    { ngx_string(":status"), ngx_string("200") },
+    { ngx_string(":status"), ngx_string("204") },
+    { ngx_string(":status"), ngx_string("206") },
+    { ngx_string(":status"), ngx_string("304") },
+    { ngx_string(":status"), ngx_string("400") },
+    { ngx_string(":status"), ngx_string("404") },
+    { ngx_string(":status"), ngx_string("500") },
+    { ngx_string("accept-charset"), ngx_string("") },
+    { ngx_string("accept-encoding"), ngx_string("gzip, deflate") },
+    { ngx_string("accept-language"), ngx_string("") },
+    { ngx_string("accept-ranges"), ngx_string("") },
+    { ngx_string("accept"), ngx_string("") },
+    { ngx_string("access-control-allow-origin"), ngx_string("") },
+    { ngx_string("age"), ngx_string("") },
+    { ngx_string("allow"), ngx_string("") },
+    { ngx_string("authorization"), ngx_string("") },
+    { ngx_string("cache-control"), ngx_string("") },
+    { ngx_string("content-disposition"), ngx_string("") },
+    { ngx_string("content-encoding"), ngx_string("") },
+    { ngx_string("content-language"), ngx_string("") },
+    { ngx_string("content-length"), ngx_string("") },
+    { ngx_string("content-location"), ngx_string("") },
+    { ngx_string("content-range"), ngx_string("") },
+    { ngx_string("content-type"), ngx_string("") },
+    { ngx_string("cookie"), ngx_string("") },
+    { ngx_string("date"), ngx_string("") },
+    { ngx_string("etag"), ngx_string("") },
+    { ngx_string("expect"), ngx_string("") },
+    { ngx_string("expires"), ngx_string("") },
+    { ngx_string("from"), ngx_string("") },
+    { ngx_string("host"), ngx_string("") },
+    { ngx_string("if-match"), ngx_string("") },
+    { ngx_string("if-modified-since"), ngx_string("") },
+    { ngx_string("if-none-match"), ngx_string("") },
+    { ngx_string("if-range"), ngx_string("") },
+    { ngx_string("if-unmodified-since"), ngx_string("") },
+    { ngx_string("last-modified"), ngx_string("") },
+    { ngx_string("link"), ngx_string("") },
+    { ngx_string("location"), ngx_string("") },
+    { ngx_string("max-forwards"), ngx_string("") },
+    { ngx_string("proxy-authenticate"), ngx_string("") },
+    { ngx_string("proxy-authorization"), ngx_string("") },
+    { ngx_string("range"), ngx_string("") },
+    { ngx_string("referer"), ngx_string("") },
+    { ngx_string("refresh"), ngx_string("") },
+    { ngx_string("retry-after"), ngx_string("") },
+    { ngx_string("server"), ngx_string("") },
+    { ngx_string("set-cookie"), ngx_string("") },
+    { ngx_string("strict-transport-security"), ngx_string("") },
+    { ngx_string("transfer-encoding"), ngx_string("") },
+    { ngx_string("user-agent"), ngx_string("") },
+    { ngx_string("vary"), ngx_string("") },
+    { ngx_string("via"), ngx_string("") },
+    { ngx_string("www-authenticate"), ngx_string("") },
+};
+
+#define NGX_HTTP_V2_STATIC_TABLE_ENTRIES                                      \
+    (sizeof(ngx_http_v2_static_table) / sizeof(ngx_http_v2_header_t))
+
+
+ngx_int_t
+ngx_http_v2_get_indexed_header(ngx_http_v2_connection_t *h2c,
+    ngx_uint_t index, ngx_http_v2_header_t *header, ngx_uint_t name_only)
+{
+    ngx_http_v2_header_t  *h;
+
+    if (index == 0) {
+        goto invalid;
+    }
+
+    if (index <= NGX_HTTP_V2_STATIC_TABLE_ENTRIES) {
+        h = &ngx_http_v2_static_table[index - 1];
+
+    } else {
+        index -= NGX_HTTP_V2_STATIC_TABLE_ENTRIES;
+
+        if (index > h2c->hpack.added - h2c->hpack.deleted) {
+            goto invalid;
+        }
+
+        /* the newest entry has the lowest index */
+
+        h = &h2c->hpack.entries[(h2c->hpack.added - index)
+                                % ngx_http_v2_table_entries];
+    }
+
+    header->name = h->name;
+
+    if (!name_only) {
+        header->value = h->value;
+    }
+
+    return NGX_OK;
+
+invalid:
+
+    ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                  "client sent invalid hpack table index %ui", index);
+
+    return NGX_ERROR;
+}
+
+
+ngx_int_t
+ngx_http_v2_add_header(ngx_http_v2_connection_t *h2c,
+    ngx_http_v2_header_t *header)
+{
+    u_char                *p;
+    size_t                 size;
+    ngx_str_t              name, value;
+    ngx_http_v2_header_t  *h;
+
+    size = ngx_http_v2_entry_size(header);
+
+    if (size > h2c->hpack.allocated) {
+
+        /* an entry larger than the table empties it and is not added */
+
+        ngx_http_v2_table_evict(h2c, h2c->hpack.allocated);
+        return NGX_OK;
+    }
+
+    if (h2c->hpack.entries == NULL) {
+        h2c->hpack.entries = ngx_palloc(h2c->connection->pool,
+                                        sizeof(ngx_http_v2_header_t)
+                                        * ngx_http_v2_table_entries);
+        if (h2c->hpack.entries == NULL) {
+            return NGX_ERROR;
+        }
+    }
+
+    /*
+     * the name may refer to an entry that is evicted to make room,
+     * so it is copied before the eviction
+     */
+
+    p = ngx_alloc(header->name.len + header->value.len + 1,
+                  h2c->connection->log);
+    if (p == NULL) {
+        return NGX_ERROR;
+    }
+
+    name.len = header->name.len;
+    name.data = p;
+    p = ngx_cpymem(p, header->name.data, header->name.len);
+
+    value.len = header->value.len;
+    value.data = p;
+    ngx_memcpy(p, header->value.data, header->value.len);
+
+    ngx_http_v2_table_evict(h2c, h2c->hpack.allocated - size);
+
+    h = &h2c->hpack.entries[h2c->hpack.added % ngx_http_v2_table_entries];
+
+    h->name = name;
+    h->value = value;
+
+    h2c->hpack.added++;
+    h2c->hpack.size += size;
+
+    return NGX_OK;
+}
+
+
+ngx_int_t
+ngx_http_v2_table_size(ngx_http_v2_connection_t *h2c, size_t size)
+{
+    if (size > NGX_HTTP_V2_TABLE_SIZE) {
+        ngx_log_error(NGX_LOG_INFO, h2c->connection->log, 0,
+                      "client sent invalid table size update: %uz", size);
+
+        return NGX_ERROR;
+    }
+
+    ngx_log_debug1(NGX_LOG_DEBUG_HTTP, h2c->connection->log, 0,
+                   "http2 table size update: %uz", size);
+
+    ngx_http_v2_table_evict(h2c, size);
+
+    h2c->hpack.allocated = size;
+
+    return NGX_OK;
+}
+
+
+void
+ngx_http_v2_table_free(ngx_http_v2_connection_t *h2c)
+{
+    ngx_http_v2_table_evict(h2c, 0);
+}
+
+
+static void
+ngx_http_v2_table_evict(ngx_http_v2_connection_t *h2c, size_t size)
+{
+    ngx_http_v2_header_t  *h;
+
+    while (h2c->hpack.size > size) {
+        h = &h2c->hpack.entries[h2c->hpack.deleted
+                                % ngx_http_v2_table_entries];
+
+        h2c->hpack.size -= ngx_http_v2_entry_size(h);
+        h2c->hpack.deleted++;
+
+        ngx_free(h->name.data);
+    }
+}
@@ -34,6 +34,19 @@ static ngx_int_t ngx_http_variable_cookie(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
 static ngx_int_t ngx_http_variable_argument(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
+
+static ngx_http_variable_tables_t *ngx_http_variable_tables(
+    ngx_http_request_t *r);
+static ngx_int_t ngx_http_variable_table_init(ngx_http_request_t *r,
+    ngx_http_variable_table_t *t, ngx_uint_t n);
+static void ngx_http_variable_table_add(ngx_http_variable_table_t *t,
+    ngx_uint_t key, u_char *name, size_t len, u_char *value, size_t size);
+static ngx_http_variable_table_elt_t *ngx_http_variable_table_find(
+    ngx_http_variable_table_t *t, ngx_uint_t key, u_char *name, size_t len);
+static ngx_http_variable_table_t *ngx_http_variable_args_table(
+    ngx_http_request_t *r);
+static ngx_http_variable_table_t *ngx_http_variable_cookies_table(
+    ngx_http_request_t *r);
 #if (NGX_HAVE_TCP_INFO)
 static ngx_int_t ngx_http_variable_tcpinfo(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data);
@@ -796,9 +809,68 @@ static ngx_int_t
 ngx_http_variable_unknown_header_in(ngx_http_request_t *r,
     ngx_http_variable_value_t *v, uintptr_t data)
 {
-    return ngx_http_variable_unknown_header(v, (ngx_str_t *) data,
-                                            &r->headers_in.headers.part,
-                                            sizeof("http_") - 1);
+    ngx_str_t *var = (ngx_str_t *) data;
+
+    u_char                     ch, *name;
+    size_t                     len;
+    ngx_uint_t                 i, n, key;
+    ngx_table_elt_t           *h;
+    ngx_http_headers_index_t  *index;
+
+    index = ngx_http_headers_in_index(r);
+
+    if (index == NULL) {
+        return ngx_http_variable_unknown_header(v, var,
+                                                &r->headers_in.headers.part,
+                                                sizeof("http_") - 1);
+    }
+
+    name = var->data + sizeof("http_") - 1;
+    len = var->len - (sizeof("http_") - 1);
+
+    key = ngx_http_headers_index_key(name, len);
+
+    for (i = key & index->mask;
+         index->elts[i].header;
+         i = (i + 1) & index->mask)
+    {
+        h = index->elts[i].header;
+
+        if (index->elts[i].key != key || h->hash == 0 || h->key.len != len) {
+            continue;
+        }
+
+        /* the name matches as in ngx_http_variable_unknown_header() */
+
+        for (n = 0; n < len; n++) {
+            ch = h->key.data[n];
+
+            if (ch >= 'A' && ch <= 'Z') {
+                ch |= 0x20;
+
+            } else if (ch == '-') {
+                ch = '_';
+            }
+
+            if (name[n] != ch) {
+                break;
+            }
+        }
+
+        if (n == len) {
+            v->len = h->value.len;
+            v->valid = 1;
+            v->no_cacheable = 0;
+            v->not_found = 0;
+            v->data = h->value.data;
+
+            return NGX_OK;
+        }
+    }
+
+    v->not_found = 1;
+
+    return NGX_OK;
 }
 
 
@@ -912,13 +984,47 @@ ngx_http_variable_cookie(ngx_http_request_t *r, ngx_http_variable_value_t *v,
 {
     ngx_str_t *name = (ngx_str_t *) data;
 
-    ngx_str_t  cookie, s;
+    u_char                          ch;
+    ngx_str_t                       cookie, s;
+    ngx_uint_t                      i, key;
+    ngx_http_variable_table_t      *t;
+    ngx_http_variable_table_elt_t  *elt;
 
     s.len = name->len - (sizeof("cookie_") - 1);
     s.data = name->data + sizeof("cookie_") - 1;
 
-    if (ngx_http_parse_multi_header_lines(&r->headers_in.cookies, &s, &cookie)
-        == NGX_DECLINED)
+    key = 0;
+
+    for (i = 0; i < s.len; i++) {
+        ch = s.data[i];
+
+        if (ch == ' ' || ch == '=' || ch == ';' || ch == ',') {
+            /* the name the table can not tell apart */
+            break;
+        }
+
+        key = ngx_hash(key, ngx_tolower(ch));
+    }
+
+    t = NULL;
+
+    if (i == s.len && s.len) {
+        t = ngx_http_variable_cookies_table(r);
+    }
+
+    if (t) {
+        elt = ngx_http_variable_table_find(t, key, s.data, s.len);
+
+        if (elt == NULL) {
+            v->not_found = 1;
+            return NGX_OK;
+        }
+
+        cookie = elt->value;
+
+    } else if (ngx_http_parse_multi_header_lines(&r->headers_in.cookies, &s,
+                                                 &cookie)
+               == NGX_DECLINED)
     {
         v->not_found = 1;
         return NGX_OK;
@@ -940,14 +1046,43 @@ ngx_http_variable_argument(ngx_http_request_t *r, ngx_http_variable_value_t *v,
 {
     ngx_str_t *name = (ngx_str_t *) data;
 
-    u_char     *arg;
-    size_t      len;
-    ngx_str_t   value;
+    u_char                         *arg;
+    size_t                          len;
+    ngx_str_t                       value;
+    ngx_uint_t                      i, key;
+    ngx_http_variable_table_t      *t;
+    ngx_http_variable_table_elt_t  *elt;
 
     len = name->len - (sizeof("arg_") - 1);
     arg = name->data + sizeof("arg_") - 1;
 
-    if (ngx_http_arg(r, arg, len, &value) != NGX_OK) {
+    key = 0;
+
+    for (i = 0; i < len; i++) {
+        if (arg[i] == '=' || arg[i] == '&') {
+            break;
+        }
+
+        key = ngx_hash(key, ngx_tolower(arg[i]));
+    }
+
+    t = NULL;
+
+    if (i == len && len) {
+        t = ngx_http_variable_args_table(r);
+    }
+
+    if (t) {
+        elt = ngx_http_variable_table_find(t, key, arg, len);
+
+        if (elt == NULL) {
+            v->not_found = 1;
+            return NGX_OK;
+        }
+
+        value = elt->value;
+
+    } else if (ngx_http_arg(r, arg, len, &value) != NGX_OK) {
         v->not_found = 1;
         return NGX_OK;
     }
@@ -962,6 +1097,286 @@ ngx_http_variable_argument(ngx_http_request_t *r, ngx_http_variable_value_t *v,
 }
 
 
+/*
+ * The tables are open addressed with linear probing, so of the entries
+ * with the same name the first one added is found first, as with the
+ * linear scans.  Building a table costs about as much as a few scans of
+ * its source, so a table is built only after that many lookups have been
+ * done with the scans, and rebuilt if its source has changed since then.
+ */
+
+static ngx_http_variable_tables_t *
+ngx_http_variable_tables(ngx_http_request_t *r)
+{
+    if (r->variable_tables == NULL) {
+        r->variable_tables = ngx_pcalloc(r->pool,
+                                         sizeof(ngx_http_variable_tables_t));
+    }
+
+    return r->variable_tables;
+}
+
+
+static ngx_int_t
+ngx_http_variable_table_init(ngx_http_request_t *r,
+    ngx_http_variable_table_t *t, ngx_uint_t n)
+{
+    ngx_uint_t  size;
+
+    for (size = 8; size < n + n / 2; size <<= 1) { /* void */ }
+
+    t->elts = ngx_pcalloc(r->pool,
+                          size * sizeof(ngx_http_variable_table_elt_t));
+    if (t->elts == NULL) {
+        return NGX_ERROR;
+    }
+
+    t->mask = size - 1;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_HTTP, r->connection->log, 0,
+                   "http variable table: %ui of %ui", n, size);
+
+    return NGX_OK;
+}
+
+
+static void
+ngx_http_variable_table_add(ngx_http_variable_table_t *t, ngx_uint_t key,
+    u_char *name, size_t len, u_char *value, size_t size)
+{
+    ngx_uint_t                      i;
+    ngx_http_variable_table_elt_t  *elt;
+
+    for (i = key & t->mask; t->elts[i].name.data; i = (i + 1) & t->mask) {
+        /* void */
+    }
+
+    elt = &t->elts[i];
+
+    elt->key = key;
+    elt->name.len = len;
+    elt->name.data = name;
+    elt->value.len = size;
+    elt->value.data = value;
+}
+
+
+static ngx_http_variable_table_elt_t *
+ngx_http_variable_table_find(ngx_http_variable_table_t *t, ngx_uint_t key,
+    u_char *name, size_t len)
+{
+    ngx_uint_t                      i;
+    ngx_http_variable_table_elt_t  *elt;
+
+    for (i = key & t->mask; t->elts[i].name.data; i = (i + 1) & t->mask) {
+
+        elt = &t->elts[i];
+
+        if (elt->key == key
+            && elt->name.len == len
+            && ngx_strncasecmp(elt->name.data, name, len) == 0)
+        {
+            return elt;
+        }
+    }
+
+    return NULL;
+}
+
+
+static ngx_http_variable_table_t *
+ngx_http_variable_args_table(ngx_http_request_t *r)
+{
+    u_char                     *p, *last, *name, *value;
+    ngx_uint_t                  n, key;
+    ngx_http_variable_table_t  *t;
+
+    if (ngx_http_variable_tables(r) == NULL) {
+        return NULL;
+    }
+
+    t = &r->variable_tables->args;
+
+    if (t->elts) {
+        if (t->src == r->args.data && t->src_len == r->args.len) {
+            return t;
+        }
+
+    } else if (t->lookups++ < NGX_HTTP_VARIABLE_TABLE_LOOKUPS) {
+        return NULL;
+    }
+
+    p = r->args.data;
+    last = p + r->args.len;
+
+    for (n = 1; p < last; p++) {
+        if (*p == '&') {
+            n++;
+        }
+    }
+
+    if (ngx_http_variable_table_init(r, t, n) != NGX_OK) {
+        return NULL;
+    }
+
+    /* "name=value" pairs separated by "&", as ngx_http_arg() finds them */
+
+    for (p = r->args.data; p < last; p++) {
+
+        name = p;
+        value = NULL;
+        key = 0;
+
+        for ( /* void */ ; p < last && *p != '&'; p++) {
+            if (*p == '=') {
+                value = p + 1;
+                break;
+            }
+
+            key = ngx_hash(key, ngx_tolower(*p));
+        }
+
+        if (value == NULL || p == name) {
+            p = ngx_strlchr(p, last, '&');
+
+            if (p == NULL) {
+                break;
+            }
+
+            continue;
+        }
+
+        p = ngx_strlchr(value, last, '&');
+
+        if (p == NULL) {
+            p = last;
+        }
+
+        ngx_http_variable_table_add(t, key, name, value - 1 - name,
+                                    value, p - value);
+    }
+
+    t->src = r->args.data;
+    t->src_len = r->args.len;
+
+    return t;
+}
+
+
+static ngx_http_variable_table_t *
+ngx_http_variable_cookies_table(ngx_http_request_t *r)
+{
+    u_char                      ch, *start, *end, *name, *last, *p;
+    ngx_uint_t                  i, n, key;
+    ngx_table_elt_t           **h;
+    ngx_http_variable_table_t  *t;
+
+    if (ngx_http_variable_tables(r) == NULL) {
+        return NULL;
+    }
+
+    t = &r->variable_tables->cookies;
+
+    h = r->headers_in.cookies.elts;
+    n = r->headers_in.cookies.nelts;
+
+    if (t->elts) {
+        if (t->src_len == n
+            && (n == 0 || t->src == h[n - 1]->value.data))
+        {
+            return t;
+        }
+
+    } else if (t->lookups++ < NGX_HTTP_VARIABLE_TABLE_LOOKUPS) {
+        return NULL;
+    }
+
+    n = 0;
+
+    for (i = 0; i < r->headers_in.cookies.nelts; i++) {
+        start = h[i]->value.data;
+        end = start + h[i]->value.len;
+
+        for (n++; start < end; start++) {
+            if (*start == ';' || *start == ',') {
+                n++;
+            }
+        }
+    }
+
+    if (ngx_http_variable_table_init(r, t, n) != NGX_OK) {
+        return NULL;
+    }
+
+    /*
+     * the pairs are separated by ";" or ",", but a value lasts up to ";",
+     * as with ngx_http_parse_multi_header_lines()
+     */
+
+    for (i = 0; i < r->headers_in.cookies.nelts; i++) {
+
+        start = h[i]->value.data;
+        end = start + h[i]->value.len;
+
+        while (start < end) {
+
+            name = start;
+            key = 0;
+
+            for ( /* void */ ; start < end; start++) {
+                ch = *start;
+
+                if (ch == '=' || ch == ';' || ch == ',') {
+                    break;
+                }
+            }
+
+            if (start < end && *start == '=') {
+
+                for (last = start; last > name && last[-1] == ' '; last--) {
+                    /* void */
+                }
+
+                for (start++; start < end && *start == ' '; start++) {
+                    /* void */
+                }
+
+                if (last > name) {
+                    for (p = name; p < last; p++) {
+                        key = ngx_hash(key, ngx_tolower(*p));
+                    }
+
+                    p = ngx_strlchr(start, end, ';');
+
+                    if (p == NULL) {
+                        p = end;
+                    }
+
+                    ngx_http_variable_table_add(t, key, name, last - name,
+                                                start, p - start);
+                }
+            }
+
+            while (start < end) {
+                ch = *start++;
+                if (ch == ';' || ch == ',') {
+                    break;
+                }
+            }
+
+            while (start < end && *start == ' ') { start++; }
+        }
+    }
+
+    n = r->headers_in.cookies.nelts;
+
+    t->src = n ? h[n - 1]->value.data : NULL;
+    t->src_len = n;
+
+    return t;
+}
+
+
 #if (NGX_HAVE_TCP_INFO)
 
 static ngx_int_t
@@ -57,6 +57,38 @@ ngx_int_t ngx_http_variable_unknown_header(ngx_http_variable_value_t *v,
     ngx_str_t *var, ngx_list_part_t *part, size_t prefix);
 
 
+/*
+ * the request arguments and cookies hashed by their names,
+ * built on demand for the $arg_* and $cookie_* lookups
+ */
+
+#define NGX_HTTP_VARIABLE_TABLE_LOOKUPS  8
+
+
+typedef struct {
+    ngx_uint_t                    key;
+    ngx_str_t                     name;
+    ngx_str_t                     value;
+} ngx_http_variable_table_elt_t;
+
+
+typedef struct {
+    ngx_http_variable_table_elt_t  *elts;
+    ngx_uint_t                      mask;
+    ngx_uint_t                      lookups;
+
+    /* the snapshot of the source to detect its changes */
+    void                           *src;
+    size_t                          src_len;
+} ngx_http_variable_table_t;
+
+
+typedef struct {
+    ngx_http_variable_table_t     args;
+    ngx_http_variable_table_t     cookies;
+} ngx_http_variable_tables_t;
+
+
 #define ngx_http_clear_variable(r, index) r->variables0[index].text.data = NULL;
 
 
@@ -115,6 +115,8 @@ typedef volatile ngx_atomic_uint_t  ngx_atomic_t;
 #define ngx_memory_barrier()        __sync_synchronize()
 
 #if ( __i386__ || __i386 || __amd64__ || __amd64 )
+/* x86 does not reorder loads with other loads */
+#define ngx_read_barrier()          __asm__ volatile ("" ::: "memory")
 #define ngx_cpu_pause()             __asm__ ("pause")
 #else
 #define ngx_cpu_pause()
@@ -304,6 +306,11 @@ ngx_atomic_fetch_add(ngx_atomic_t *value, ngx_atomic_int_t add)
 #endif
 
 
+#ifndef ngx_read_barrier
+#define ngx_read_barrier()          ngx_memory_barrier()
+#endif
+
+
 void ngx_spinlock(ngx_atomic_t *lock, ngx_atomic_int_t value, ngx_uint_t spin);
 
 #define ngx_trylock(lock)  (*(lock) == 0 && ngx_atomic_cmp_set(lock, 0, 1))
@@ -47,6 +47,8 @@ typedef int               ngx_err_t;
 #define NGX_EHOSTUNREACH  EHOSTUNREACH
 #define NGX_ENOSYS        ENOSYS
 #define NGX_ECANCELED     ECANCELED
+#define NGX_EALREADY      EALREADY
+#define NGX_EOPNOTSUPP    EOPNOTSUPP
 #define NGX_EILSEQ        EILSEQ
 #define NGX_ENOMOREFILES  0
 
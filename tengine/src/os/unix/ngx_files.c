@@ -15,6 +15,18 @@ ngx_uint_t  ngx_file_aio = 1;
 
 #endif
 
+#if (NGX_THREAD_POOL)
+
+#include <ngx_thread_pool.h>
+
+static void ngx_thread_read_handler(void *data, ngx_log_t *log);
+
+#if (NGX_HAVE_PREADV2_NOWAIT)
+static ngx_uint_t  ngx_read_nowait = 1;
+#endif
+
+#endif
+
 
 ssize_t
 ngx_read_file(ngx_file_t *file, u_char *buf, size_t size, off_t offset)
@@ -64,6 +76,161 @@ ngx_read_file(ngx_file_t *file, u_char *buf, size_t size, off_t offset)
 }
 
 
+#if (NGX_THREAD_POOL)
+
+typedef struct {
+    ngx_fd_t       fd;
+    u_char        *buf;
+    size_t         size;
+    off_t          offset;
+
+    size_t         read;
+    ngx_err_t      err;
+} ngx_thread_read_ctx_t;
+
+
+ssize_t
+ngx_thread_read(ngx_file_t *file, u_char *buf, size_t size, off_t offset,
+    ngx_pool_t *pool)
+{
+    ssize_t                 n;
+    ngx_thread_task_t      *task;
+    ngx_thread_read_ctx_t  *ctx;
+
+    ngx_log_debug4(NGX_LOG_DEBUG_CORE, file->log, 0,
+                   "thread read: %d, %p, %uz, %O",
+                   file->fd, buf, size, offset);
+
+    task = file->thread_task;
+
+    if (task && task->event.complete) {
+        task->event.complete = 0;
+
+        ctx = task->ctx;
+
+        if (ctx->err) {
+            ngx_log_error(NGX_LOG_CRIT, file->log, ctx->err,
+                          "pread() \"%s\" failed", file->name.data);
+            return NGX_ERROR;
+        }
+
+        file->offset += ctx->read;
+
+        return ctx->read;
+    }
+
+    /* the pages already in the page cache are read without a thread */
+
+    n = ngx_read_file_nowait(file, buf, size, offset);
+
+    if (n != NGX_AGAIN) {
+        file->offset += n;
+        return n;
+    }
+
+    if (task == NULL) {
+        task = ngx_thread_task_alloc(pool, sizeof(ngx_thread_read_ctx_t));
+        if (task == NULL) {
+            return NGX_ERROR;
+        }
+
+        task->handler = ngx_thread_read_handler;
+
+        file->thread_task = task;
+    }
+
+    ctx = task->ctx;
+
+    ctx->fd = file->fd;
+    ctx->buf = buf;
+    ctx->size = size;
+    ctx->offset = offset;
+
+    if (file->thread_handler(task, file) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    return NGX_AGAIN;
+}
+
+
+static void
+ngx_thread_read_handler(void *data, ngx_log_t *log)
+{
+    ngx_thread_read_ctx_t *ctx = data;
+
+    ssize_t  n;
+
+    ngx_log_debug0(NGX_LOG_DEBUG_CORE, log, 0, "thread read handler");
+
+    n = pread(ctx->fd, ctx->buf, ctx->size, ctx->offset);
+
+    if (n == -1) {
+        ctx->err = ngx_errno;
+
+    } else {
+        ctx->read = n;
+        ctx->err = 0;
+    }
+
+    ngx_log_debug4(NGX_LOG_DEBUG_CORE, log, 0,
+                   "pread: %z (err: %d) of %uz @%O",
+                   n, ctx->err, ctx->size, ctx->offset);
+}
+
+
+/*
+ * ngx_read_file_nowait() reads the file only if the whole range
+ * is in the page cache, otherwise it returns NGX_AGAIN;
+ * it does not update file->offset
+ */
+
+ssize_t
+ngx_read_file_nowait(ngx_file_t *file, u_char *buf, size_t size, off_t offset)
+{
+#if (NGX_HAVE_PREADV2_NOWAIT)
+
+    ssize_t       n;
+    ngx_err_t     err;
+    struct iovec  iov;
+
+    if (!ngx_read_nowait) {
+        return NGX_AGAIN;
+    }
+
+    iov.iov_base = buf;
+    iov.iov_len = size;
+
+    n = preadv2(file->fd, &iov, 1, offset, RWF_NOWAIT);
+
+    if (n == (ssize_t) size) {
+        return n;
+    }
+
+    if (n == -1) {
+        err = ngx_errno;
+
+        if (err == NGX_ENOSYS || err == NGX_EOPNOTSUPP) {
+
+            /* a kernel without preadv2() or RWF_NOWAIT */
+
+            ngx_log_error(NGX_LOG_INFO, file->log, err,
+                          "preadv2(RWF_NOWAIT) is not supported");
+
+            ngx_read_nowait = 0;
+        }
+    }
+
+    /* a short read means that the rest of the range is not cached */
+
+#endif
+
+    return NGX_AGAIN;
+}
+
+#endif
+
+
 ssize_t
 ngx_write_file(ngx_file_t *file, u_char *buf, size_t size, off_t offset)
 {
@@ -64,6 +64,12 @@
 #endif
 
 
+#if (NGX_HAVE_FUTEX)
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+
 #if (NGX_HAVE_SYS_PRCTL_H)
 #include <sys/prctl.h>
 #endif
@@ -77,7 +83,7 @@ extern ssize_t sendfile(int s, int fd, int32_t *offset, size_t size);
 #endif
 
 
-#if (NGX_HAVE_POLL || NGX_HAVE_RTSIG)
+#if (NGX_HAVE_POLL || NGX_HAVE_RTSIG || NGX_HAVE_IOURING)
 #include <poll.h>
 #endif
 
@@ -87,6 +93,17 @@ extern ssize_t sendfile(int s, int fd, int32_t *offset, size_t size);
 #endif
 
 
+#if (NGX_HAVE_SYS_EVENTFD_H)
+#include <sys/eventfd.h>
+#endif
+
+
+#if (NGX_HAVE_IOURING)
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+
 #if (NGX_HAVE_SYSINFO)
 #include <sys/sysinfo.h>
 #endif
@@ -34,6 +34,38 @@
 #endif
 
 
+#if (NGX_THREAD_POOL)
+
+#include <ngx_thread_pool.h>
+
+/*
+ * sendfile() is offloaded to a thread pool if the beginning or the end
+ * of the first NGX_SENDFILE_PROBE bytes of the range is not in the page
+ * cache: a socket send buffer is rarely larger, so this is a cheap
+ * approximation of whether sendfile() would block on disk
+ */
+
+#define NGX_SENDFILE_PROBE  (256 * 1024)
+
+
+typedef struct {
+    ngx_buf_t     *file;
+    ngx_socket_t   socket;
+    off_t          offset;
+    size_t         size;
+
+    size_t         sent;
+    ngx_err_t      err;
+} ngx_linux_sendfile_ctx_t;
+
+
+static ssize_t ngx_linux_sendfile_thread(ngx_connection_t *c, ngx_buf_t *file,
+    size_t size);
+static void ngx_linux_sendfile_thread_handler(void *data, ngx_log_t *log);
+
+#endif
+
+
 ngx_chain_t *
 ngx_linux_sendfile_chain(ngx_connection_t *c, ngx_chain_t *in, off_t limit)
 {
@@ -48,6 +80,9 @@ ngx_linux_sendfile_chain(ngx_connection_t *c, ngx_chain_t *in, off_t limit)
     ngx_event_t   *wev;
     ngx_chain_t   *cl;
     struct iovec  *iov, headers[NGX_HEADERS];
+#if (NGX_THREAD_POOL)
+    ssize_t        n;
+#endif
 #if (NGX_HAVE_SENDFILE64)
     off_t          offset;
 #else
@@ -252,43 +287,69 @@ ngx_linux_sendfile_chain(ngx_connection_t *c, ngx_chain_t *in, off_t limit)
                 return NGX_CHAIN_ERROR;
             }
 #endif
+#if (NGX_THREAD_POOL)
+
+            n = NGX_DECLINED;
+
+            if (file->file->thread_handler) {
+                n = ngx_linux_sendfile_thread(c, file, file_size);
+
+                if (n == NGX_ERROR) {
+                    return NGX_CHAIN_ERROR;
+                }
+
+                if (n == NGX_DONE) {
+
+                    /* the result will be reported by the next call */
+
+                    return in;
+                }
+            }
+
+            if (n != NGX_DECLINED) {
+                sent = (n == NGX_AGAIN) ? 0 : n;
+
+            } else
+#endif
+            {
 #if (NGX_HAVE_SENDFILE64)
-            offset = file->file_pos;
+                offset = file->file_pos;
 #else
-            offset = (int32_t) file->file_pos;
+                offset = (int32_t) file->file_pos;
 #endif
 
-            ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
-                           "sendfile: @%O %uz", file->file_pos, file_size);
+                ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                               "sendfile: @%O %uz", file->file_pos, file_size);
 
-            rc = sendfile(c->fd, file->file->fd, &offset, file_size);
+                rc = sendfile(c->fd, file->file->fd, &offset, file_size);
 
-            if (rc == -1) {
-                err = ngx_errno;
+                if (rc == -1) {
+                    err = ngx_errno;
 
-                switch (err) {
-                case NGX_EAGAIN:
-                    break;
+                    switch (err) {
+                    case NGX_EAGAIN:
+                        break;
 
-                case NGX_EINTR:
-                    eintr = 1;
-                    break;
+                    case NGX_EINTR:
+                        eintr = 1;
+                        break;
 
-                default:
-                    wev->error = 1;
-                    ngx_connection_error(c, err, "sendfile() failed");
-                    return NGX_CHAIN_ERROR;
-                }
+                    default:
+                        wev->error = 1;
+                        ngx_connection_error(c, err, "sendfile() failed");
+                        return NGX_CHAIN_ERROR;
+                    }
 
-                ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, err,
-                               "sendfile() is not ready");
-            }
+                    ngx_log_debug0(NGX_LOG_DEBUG_EVENT, c->log, err,
+                                   "sendfile() is not ready");
+                }
 
-            sent = rc > 0 ? rc : 0;
+                sent = rc > 0 ? rc : 0;
 
-            ngx_log_debug4(NGX_LOG_DEBUG_EVENT, c->log, 0,
-                           "sendfile: %d, @%O %O:%uz",
-                           rc, file->file_pos, sent, file_size);
+                ngx_log_debug4(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                               "sendfile: %d, @%O %O:%uz",
+                               rc, file->file_pos, sent, file_size);
+            }
 
         } else {
             rc = writev(c->fd, header.elts, header.nelts);
@@ -378,3 +439,125 @@ ngx_linux_sendfile_chain(ngx_connection_t *c, ngx_chain_t *in, off_t limit)
         in = cl;
     }
 }
+
+
+#if (NGX_THREAD_POOL)
+
+static ssize_t
+ngx_linux_sendfile_thread(ngx_connection_t *c, ngx_buf_t *file, size_t size)
+{
+    u_char                     ch;
+    off_t                      last;
+    ngx_event_t               *wev;
+    ngx_thread_task_t         *task;
+    ngx_linux_sendfile_ctx_t  *ctx;
+
+    task = c->sendfile_task;
+    wev = c->write;
+
+    if (task && task->event.complete) {
+        task->event.complete = 0;
+
+        ctx = task->ctx;
+
+        if (ctx->err == NGX_EAGAIN) {
+            wev->ready = 0;
+            return NGX_AGAIN;
+        }
+
+        if (ctx->err) {
+            wev->error = 1;
+            ngx_connection_error(c, ctx->err, "sendfile() failed");
+            return NGX_ERROR;
+        }
+
+        if (ctx->sent == 0) {
+            ngx_log_error(NGX_LOG_ALERT, c->log, 0,
+                          "sendfile() reported that \"%s\" was truncated",
+                          file->file->name.data);
+            return NGX_ERROR;
+        }
+
+        return ctx->sent;
+    }
+
+    if (task && task->event.active) {
+
+        /* the write handler may be called while the task is in progress */
+
+        return NGX_DONE;
+    }
+
+    last = file->file_pos + ngx_min(size, NGX_SENDFILE_PROBE) - 1;
+
+    if (ngx_read_file_nowait(file->file, &ch, 1, file->file_pos) == 1
+        && ngx_read_file_nowait(file->file, &ch, 1, last) == 1)
+    {
+        return NGX_DECLINED;
+    }
+
+    if (task == NULL) {
+        task = ngx_thread_task_alloc(c->pool,
+                                     sizeof(ngx_linux_sendfile_ctx_t));
+        if (task == NULL) {
+            return NGX_ERROR;
+        }
+
+        task->handler = ngx_linux_sendfile_thread_handler;
+
+        c->sendfile_task = task;
+    }
+
+    ctx = task->ctx;
+
+    ctx->file = file;
+    ctx->socket = c->fd;
+    ctx->offset = file->file_pos;
+    ctx->size = size;
+
+    ngx_log_debug2(NGX_LOG_DEBUG_EVENT, c->log, 0,
+                   "sendfile thread: @%O %uz", file->file_pos, size);
+
+    if (file->file->thread_handler(task, file->file) != NGX_OK) {
+        return NGX_ERROR;
+    }
+
+    return NGX_DONE;
+}
+
+
+static void
+ngx_linux_sendfile_thread_handler(void *data, ngx_log_t *log)
+{
+    ngx_linux_sendfile_ctx_t *ctx = data;
+
+    ssize_t    n;
+#if (NGX_HAVE_SENDFILE64)
+    off_t      offset;
+#else
+    int32_t    offset;
+#endif
+
+    ngx_log_debug0(NGX_LOG_DEBUG_CORE, log, 0, "linux sendfile thread");
+
+#if (NGX_HAVE_SENDFILE64)
+    offset = ctx->offset;
+#else
+    offset = (int32_t) ctx->offset;
+#endif
+
+    do {
+        n = sendfile(ctx->socket, ctx->file->file->fd, &offset, ctx->size);
+
+        ctx->err = (n == -1) ? ngx_errno : 0;
+
+    } while (ctx->err == NGX_EINTR);
+
+    ctx->sent = (n == -1) ? 0 : n;
+
+    ngx_log_debug3(NGX_LOG_DEBUG_CORE, log, 0,
+                   "sendfile: %z (err: %d) of %uz",
+                   n, ctx->err, ctx->size);
+}
+
+#endif
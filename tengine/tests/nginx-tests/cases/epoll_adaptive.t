@@ -0,0 +1,89 @@
+#!/usr/bin/perl
+
+# Tests for adaptive epoll batching, busy polling and event loop statistics.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+plan(skip_all => 'epoll is Linux specific') if $^O ne 'linux';
+
+my $t = Test::Nginx->new()->has(qw/http stub_status/)->plan(6);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+worker_processes  2;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+    use               epoll;
+    epoll_events      1;
+    epoll_events_max  64;
+    epoll_busy_poll   50;
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /status {
+            stub_status              on;
+        }
+
+        location /loops {
+            stub_status              on;
+            stub_status_event_loops  on;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->run();
+
+###############################################################################
+
+like(http_get('/'), qr/SEE-THIS/, 'request');
+
+unlike(http_get('/status'), qr/Event loops:/, 'event loops off');
+
+my $r = http_get('/loops');
+
+like($r, qr/^Event\ loops:\ pid\ wakeups\ events\ batch\ busy_polls
+	\ wait_time\ loop_time\ handler_time\x0d?$/mx, 'event loops header');
+
+my @loops = $r =~ /^ (\d+ \d+ \d+ \d+ \d+ \d+ \d+ \d+)\x0d?$/mg;
+
+is(scalar @loops, 2, 'event loop per worker');
+
+my @busy = grep { (split / /)[2] > 0 } @loops;
+
+ok(@busy, 'events counted');
+ok((grep { (split / /)[3] > 1 } @busy), 'batch grown');
+
+###############################################################################
@@ -0,0 +1,127 @@
+#!/usr/bin/perl
+
+# Tests for TCP Fast Open on listening sockets, to upstreams and in checks,
+# and for the deferred accept timeout.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+plan(skip_all => 'TCP_FASTOPEN is Linux specific') if $^O ne 'linux';
+
+my $t = Test::Nginx->new()->has(qw/http proxy/)->plan(6);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    upstream u {
+        server  127.0.0.1:8081;
+        check   interval=100 rise=1 fall=1 timeout=1000 type=http fastopen=on;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /proxy/ {
+            proxy_pass      http://u/;
+            proxy_fastopen  on;
+        }
+
+        location /status {
+            check_status  csv;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081 fastopen=16 deferred=5s;
+        server_name  localhost;
+    }
+}
+
+EOF
+
+$t->write_file_expand('tcp.conf', <<'EOF');
+
+error_log  %%TESTDIR%%/tcp.log;
+pid        %%TESTDIR%%/tcp.pid;
+
+events {
+}
+
+http {
+    upstream u {
+        server  127.0.0.1:8081;
+        check   interval=100 type=tcp fastopen=on;
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->write_file('big.html', 'X' x 100000);
+
+$t->run();
+
+###############################################################################
+
+# peers are down until the first check passes
+
+for (1 .. 50) {
+	last if http_get('/status') =~ /^0,u,127\.0\.0\.1:8081,up,/m;
+	select undef, undef, undef, 0.1;
+}
+
+like(http_get('/status'), qr/^0,u,127\.0\.0\.1:8081,up,/m, 'check');
+
+like(http_get('/proxy/index.html'), qr/SEE-THIS/, 'fast open');
+like(http_get('/proxy/index.html'), qr/SEE-THIS/, 'fast open again');
+like(http_get('/proxy/big.html'), qr/\x0d\x0a\x0d\x0aX{50000}X{50000}$/,
+	'fast open big');
+like(http_post('/proxy/index.html'), qr/405 Method Not Allowed/, 'fast open body');
+
+like(`$ENV{TEST_NGINX_BINARY} -t -c ${\($t->testdir())}/tcp.conf 2>&1`,
+	qr/fast open cannot be used with the "tcp" check/, 'tcp check');
+
+###############################################################################
+
+sub http_post {
+	my ($url) = @_;
+	return http(<<EOF);
+POST $url HTTP/1.0
+Host: localhost
+Content-Length: 10
+
+0123456789
+EOF
+}
+
+###############################################################################
@@ -0,0 +1,148 @@
+#!/usr/bin/perl
+
+# Tests for geo and access modules with IPv4 and IPv6 networks, which
+# are looked up in compact radix tables.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http geo access/)->plan(18);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+my $ipv6 = $t->has_module('--with-ipv6');
+
+my $geo6 = $ipv6 ? <<'EOF' : '';
+        2001:db8::/32        doc;
+        2001:db8:1::/48      doc-one;
+        2001:db8:1::1/128    doc-host;
+        ::ffff:0:0/96        mapped;
+EOF
+
+$t->write_file_expand('nginx.conf', <<"EOF");
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    geo \$arg_ip \$geo {
+        default              default;
+
+        10.0.0.0/8           ten;
+        10.1.0.0/16          ten-one;
+        10.1.2.0/24          ten-one-two;
+        10.1.2.3/32          host;
+        10.200.0.0/16        deleted;
+        delete               10.200.0.0/16;
+        0.0.0.0/32           zero;
+$geo6
+    }
+
+    deny  192.0.2.0/24;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            add_header  X-Geo  \$geo;
+        }
+
+        location /first {
+            allow  127.0.0.1;
+            deny   all;
+        }
+
+        location /order {
+            deny   127.0.0.0/8;
+            allow  127.0.0.1;
+        }
+
+        location /narrow {
+            deny   10.0.0.0/8;
+            allow  127.0.0.0/24;
+            deny   127.0.0.0/8;
+
+            location /narrow/all {
+                deny   all;
+            }
+        }
+
+        location /shadow {
+            allow  127.0.0.0/8;
+            deny   127.0.0.1;
+            deny   all;
+        }
+
+        location /none {
+            deny   10.0.0.0/8;
+            deny   192.168.0.0/16;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('index.html', '');
+$t->write_file('first', '');
+$t->write_file('order', '');
+mkdir $t->testdir() . '/narrow';
+$t->write_file('narrow/index.html', '');
+$t->write_file('narrow/all', '');
+$t->write_file('shadow', '');
+$t->write_file('none', '');
+$t->run();
+
+###############################################################################
+
+like(http_get('/?ip=10.9.9.9'), qr/X-Geo: ten\x0d/, 'geo /8');
+like(http_get('/?ip=10.1.9.9'), qr/X-Geo: ten-one\x0d/, 'geo /16');
+like(http_get('/?ip=10.1.2.9'), qr/X-Geo: ten-one-two\x0d/, 'geo /24');
+like(http_get('/?ip=10.1.2.3'), qr/X-Geo: host\x0d/, 'geo /32');
+like(http_get('/?ip=10.200.1.1'), qr/X-Geo: ten\x0d/, 'geo deleted');
+like(http_get('/?ip=0.0.0.0'), qr/X-Geo: zero\x0d/, 'geo zero');
+like(http_get('/?ip=11.0.0.1'), qr/X-Geo: default\x0d/, 'geo default');
+like(http_get('/?ip=bad'), qr/X-Geo: default\x0d/, 'geo bad address');
+
+SKIP: {
+skip 'no ipv6', 4 unless $ipv6;
+
+like(http_get('/?ip=2001:db8:ff::1'), qr/X-Geo: doc\x0d/, 'geo ipv6 /32');
+like(http_get('/?ip=2001:db8:1::2'), qr/X-Geo: doc-one\x0d/, 'geo ipv6 /48');
+like(http_get('/?ip=2001:db8:1::1'), qr/X-Geo: doc-host\x0d/, 'geo ipv6 /128');
+like(http_get('/?ip=::ffff:10.1.2.3'), qr/X-Geo: host\x0d/, 'geo ipv4-mapped');
+
+}
+
+like(http_get('/first'), qr/200 OK/, 'access allow first');
+like(http_get('/order'), qr/403 Forbidden/, 'access first rule wins');
+like(http_get('/narrow/'), qr/200 OK/, 'access narrow network');
+like(http_get('/narrow/all'), qr/403 Forbidden/, 'access nested location');
+like(http_get('/shadow'), qr/200 OK/, 'access shadowed rules');
+like(http_get('/none'), qr/200 OK/, 'access no match');
+
+###############################################################################
@@ -0,0 +1,162 @@
+#!/usr/bin/perl
+
+# Tests for request headers looked up through the index kept in the
+# connection.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+use Socket qw/ CRLF /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http rewrite/)->plan(9);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+my $realip = $t->has_module('--with-http_realip_module');
+my $lua = $t->has_module('--with-http_lua_module');
+
+# the padding variables are there to have the index filled
+
+my $conf = <<'EOF';
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        underscores_in_headers  on;
+
+        %%REALIP%%
+
+        location /headers {
+            return 200 "$http_x_p1$http_x_p2$http_x_p3$http_x_p4$http_x_p5$http_x_p6$http_x_p7$http_x_p8 a=$http_x_a b=$http_x_b h1=$http_x_h1 h40=$http_x_h40 u=$http_x_u";
+        }
+
+        location /realip {
+            return 200 "addr=$remote_addr";
+        }
+
+        %%LUA%%
+    }
+}
+
+EOF
+
+my $realip_conf = $realip
+	? "set_real_ip_from  127.0.0.1/32;\n        real_ip_header    X-Client;"
+	: '';
+$conf =~ s/%%REALIP%%/$realip_conf/;
+
+# the lookups fill the index, then a header is removed in place and
+# another one takes its slot in the list
+
+my $lua_conf = $lua ? <<'EOF' : '';
+location /lua {
+            content_by_lua '
+                for i = 1, 9 do local _ = ngx.var["http_x_p" .. i] end
+                ngx.req.clear_header("X-A")
+                ngx.req.set_header("X-B", "1")
+                ngx.say("a=", ngx.var.http_x_a, " b=", ngx.var.http_x_b)
+            ';
+        }
+EOF
+$conf =~ s/%%LUA%%/$lua_conf/;
+
+$t->write_file_expand('nginx.conf', $conf);
+$t->run();
+
+###############################################################################
+
+my $many = join '', map { "X-H$_: $_" . CRLF } (1 .. 40);
+
+like(http("GET /headers HTTP/1.0" . CRLF . $many . CRLF),
+	qr/ h1=1 h40=40 /, 'many headers');
+
+like(http(<<EOF), qr/a=1 b=2 /, 'first header');
+GET /headers HTTP/1.0
+X-A: 1
+x-b: 2
+x-a: 3
+X-B: 4
+
+EOF
+
+like(http(<<EOF), qr/u=1$/, 'underscore and dash');
+GET /headers HTTP/1.0
+X_U: 1
+X-U: 2
+
+EOF
+
+like(http(<<EOF), qr/u=2$/, 'dash and underscore');
+GET /headers HTTP/1.0
+x-u: 2
+X_U: 1
+
+EOF
+
+like(http_get('/headers'), qr/a= b= h1= h40= u=$/, 'no headers');
+
+my $r = http("GET /headers HTTP/1.1" . CRLF
+	. "Host: localhost" . CRLF
+	. "X-A: 1" . CRLF
+	. $many . CRLF
+	. "GET /headers HTTP/1.1" . CRLF
+	. "Host: localhost" . CRLF
+	. "X-B: 2" . CRLF
+	. "Connection: close" . CRLF . CRLF);
+
+like($r, qr/a=1 b= h1=1 h40=40 u=.*a= b=2 h1= h40= u=$/s, 'keepalive');
+
+SKIP: {
+skip 'no realip', 2 unless $realip;
+
+like(http(<<EOF), qr/addr=192.0.2.1$/, 'realip header');
+GET /realip HTTP/1.0
+x-client: 192.0.2.1
+
+EOF
+
+like(http_get('/realip'), qr/addr=127.0.0.1$/, 'realip no header');
+
+}
+
+SKIP: {
+skip 'no lua', 1 unless $lua;
+
+like(http(<<EOF), qr/a=nil b=1$/m, 'header removed in place');
+GET /lua HTTP/1.0
+X-P1: 1
+X-A: 1
+
+EOF
+
+}
+
+###############################################################################
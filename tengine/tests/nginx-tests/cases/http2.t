@@ -0,0 +1,343 @@
+#!/usr/bin/perl
+
+# Tests for HTTP/2 over cleartext connections with prior knowledge:
+# static files, multiplexed streams and request bodies through proxy.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use IO::Select;
+use IO::Socket::INET;
+use Socket qw/ CRLF /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy stub_status/);
+
+plan(skip_all => 'no http2 module')
+	unless $t->has_module('--with-http_v2_module');
+plan(skip_all => 'no curl with http2')
+	unless `curl -V 2>&1` =~ /HTTP2/;
+
+$t->plan(12);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    server {
+        listen       127.0.0.1:8080 http2;
+        server_name  localhost;
+
+        location / {
+        }
+
+        location /proxy/ {
+            proxy_pass  http://127.0.0.1:8081/;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8082 http2;
+        server_name  localhost;
+
+        http2_max_concurrent_streams  1;
+    }
+
+    server {
+        listen       127.0.0.1:8083;
+        server_name  localhost;
+
+        location / {
+            stub_status         on;
+            stub_status_memory  on;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->write_file('big.html', 'X' x 300000);
+$t->run_daemon(\&length_daemon);
+$t->run();
+
+###############################################################################
+
+my $url = 'http://127.0.0.1:8080';
+my $curl = 'curl -s --http2-prior-knowledge';
+
+like(`$curl -i $url/index.html`, qr!^HTTP/2 200.*SEE-THIS$!s, 'get');
+like(`$curl -I $url/index.html`, qr!^HTTP/2 200.*content-length: 8!si,
+	'head');
+like(`$curl -o /dev/null -w '%{http_code}' $url/nonexistent`, qr/^404$/,
+	'not found');
+is(`$curl -o /dev/null -w '%{size_download}' $url/big.html`, 300000,
+	'large response');
+
+# curl does not reuse prior knowledge connections, so the frames are
+# written by hand: two streams are opened before any response is read
+
+is(h2_streams('/index.html', '/big.html'), '1:8 3:300000',
+	'streams on one connection');
+
+my $body = 'Y' x 100000;
+$t->write_file('body.txt', $body);
+my $file = $t->testdir() . '/body.txt';
+
+is(`$curl --data-binary \@$file $url/proxy/`, 'length:100000',
+	'request body');
+is(`$curl --data-binary \@- $url/proxy/ < $file`, 'length:100000',
+	'request body without length');
+
+like(`$curl -i $url/proxy/`, qr!^HTTP/2 200.*length:0$!s, 'proxy get');
+
+# the header blocks of refused streams are decoded only to keep the hpack
+# table in sync, and are not kept in the connection memory
+
+cmp_ok(h2_refused(200), '<', 500000, 'refused streams memory');
+
+# an invalid hpack index closes the connection with COMPRESSION_ERROR,
+# the stream being created for the block is released
+
+is(h2_goaway("\x82\x86\xbf"), 9, 'malformed header block');
+like(`$curl -i $url/index.html`, qr!^HTTP/2 200.*SEE-THIS$!s,
+	'get after malformed header block');
+unlike(read_file($t->testdir() . '/error.log'),
+	qr/worker process \d+ exited/, 'no worker crashed');
+
+###############################################################################
+
+sub h2_frame {
+	my ($type, $flags, $sid, $payload) = @_;
+
+	return pack('NCN', length($payload) << 8 | $type, $flags, $sid)
+		. $payload;
+}
+
+sub h2_streams {
+	my (@uris) = @_;
+
+	my $s = IO::Socket::INET->new(
+		Proto => 'tcp',
+		PeerAddr => '127.0.0.1:8080'
+	)
+		or die "Can't connect to nginx: $!\n";
+
+	my $out = "PRI * HTTP/2.0\x0d\x0a\x0d\x0aSM\x0d\x0a\x0d\x0a"
+		. h2_frame(4, 0, 0, pack('nN', 4, 1 << 20))
+		. h2_frame(8, 0, 0, pack('N', 1 << 20));
+
+	my $sid = 1;
+
+	for my $uri (@uris) {
+
+		# indexed :method GET and :scheme http, literal :path
+
+		my $block = "\x82\x86\x04" . chr(length($uri)) . $uri
+			. "\x01\x09localhost";
+
+		$out .= h2_frame(1, 0x05, $sid, $block);
+		$sid += 2;
+	}
+
+	$s->syswrite($out);
+
+	my ($buf, %data, %done) = ('');
+
+	while (keys %done < @uris && IO::Select->new($s)->can_read(3)) {
+		last unless $s->sysread($buf, 65536, length($buf));
+
+		while (length($buf) >= 9) {
+			my ($lt, $flags, $id) = unpack('NCN', $buf);
+			my $len = $lt >> 8;
+
+			last if length($buf) < 9 + $len;
+
+			my $payload = substr($buf, 9, $len);
+			substr($buf, 0, 9 + $len) = '';
+
+			if (($lt & 0xff) == 0) {
+				$data{$id} += $len;
+			}
+
+			$done{$id} = 1 if $id && $flags & 0x01;
+		}
+	}
+
+	return join ' ', map { "$_:" . ($data{$_} || 0) } sort keys %data;
+}
+
+sub h2_int {
+	my ($n, $prefix) = @_;
+
+	return chr($n) if $n < $prefix;
+
+	my $out = chr($prefix);
+
+	for ($n -= $prefix; $n >= 128; $n >>= 7) {
+		$out .= chr($n & 0x7f | 0x80);
+	}
+
+	return $out . chr($n);
+}
+
+sub h2_refused {
+	my ($n) = @_;
+
+	my $s = IO::Socket::INET->new(
+		Proto => 'tcp',
+		PeerAddr => '127.0.0.1:8082'
+	)
+		or die "Can't connect to nginx: $!\n";
+
+	# the first stream waits for its body, the others are refused;
+	# a literal field without indexing with a new name pads each block
+
+	my $block = "\x82\x86\x04\x01/\x01\x09localhost"
+		. "\x00\x05x-pad" . h2_int(4000, 127) . ('x' x 4000);
+
+	my $out = "PRI * HTTP/2.0\x0d\x0a\x0d\x0aSM\x0d\x0a\x0d\x0a"
+		. h2_frame(4, 0, 0, '');
+
+	for my $i (0 .. $n) {
+		$out .= h2_frame(1, 0x04, 1 + 2 * $i, $block);
+	}
+
+	$s->syswrite($out);
+
+	my ($buf, $rst) = ('', 0);
+
+	while ($rst < $n && IO::Select->new($s)->can_read(3)) {
+		last unless $s->sysread($buf, 65536, length($buf));
+
+		while (length($buf) >= 9) {
+			my ($lt) = unpack('N', $buf);
+			my $len = $lt >> 8;
+
+			last if length($buf) < 9 + $len;
+
+			$rst++ if ($lt & 0xff) == 3;
+			substr($buf, 0, 9 + $len) = '';
+		}
+	}
+
+	my $c = IO::Socket::INET->new(
+		Proto => 'tcp',
+		PeerAddr => '127.0.0.1:8083'
+	)
+		or die "Can't connect to nginx: $!\n";
+
+	$c->print('GET / HTTP/1.0' . CRLF . CRLF);
+
+	local $/;
+	my $status = $c->getline();
+
+	return $status =~ /^Connection memory: .*\n\s*(\d+) /m ? $1 : undef;
+}
+
+sub h2_goaway {
+	my ($block) = @_;
+
+	my $s = IO::Socket::INET->new(
+		Proto => 'tcp',
+		PeerAddr => '127.0.0.1:8080'
+	)
+		or die "Can't connect to nginx: $!\n";
+
+	$s->syswrite("PRI * HTTP/2.0\x0d\x0a\x0d\x0aSM\x0d\x0a\x0d\x0a"
+		. h2_frame(4, 0, 0, '') . h2_frame(1, 0x05, 1, $block));
+
+	my $buf = '';
+
+	while (IO::Select->new($s)->can_read(3)) {
+		last unless $s->sysread($buf, 65536, length($buf));
+
+		while (length($buf) >= 9) {
+			my ($lt) = unpack('N', $buf);
+			my $len = $lt >> 8;
+
+			last if length($buf) < 9 + $len;
+
+			if (($lt & 0xff) == 7) {
+				return unpack('N', substr($buf, 13, 4));
+			}
+
+			substr($buf, 0, 9 + $len) = '';
+		}
+	}
+
+	return undef;
+}
+
+sub read_file {
+	my ($name) = @_;
+
+	open my $fh, '<', $name or return '';
+	local $/;
+	my $content = <$fh>;
+	close $fh;
+
+	return $content;
+}
+
+sub length_daemon {
+	my $server = IO::Socket::INET->new(
+		Proto => 'tcp',
+		LocalAddr => '127.0.0.1:8081',
+		Listen => 5,
+		Reuse => 1
+	)
+		or die "Can't create listening socket: $!\n";
+
+	while (my $client = $server->accept()) {
+		my $len = 0;
+
+		while (<$client>) {
+			$len = $1 if /^content-length:\s*(\d+)/i;
+			last if (/^\x0d?\x0a?$/);
+		}
+
+		my ($body, $buf) = ('', '');
+
+		while (length($body) < $len && $client->read($buf, $len)) {
+			$body .= $buf;
+		}
+
+		my $reply = 'length:' . length($body);
+
+		print $client 'HTTP/1.0 200 OK' . CRLF
+			. 'Content-Length: ' . length($reply) . CRLF . CRLF
+			. $reply;
+
+		close $client;
+	}
+}
+
+###############################################################################
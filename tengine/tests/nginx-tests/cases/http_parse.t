@@ -0,0 +1,137 @@
+#!/usr/bin/perl
+
+# Tests for the request line and header parsing with long URIs and headers,
+# which exercise the SSE4.2 fast paths of the parser.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use Socket qw/ CRLF /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)->plan(12);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            add_header  X-URI     "$uri";
+            add_header  X-Args    "$args";
+            add_header  X-Cookie  "<$http_cookie>";
+            add_header  X-Long    "<$http_x_a_rather_long_header_name_here>";
+            add_header  X-Under   "<$http_x_header_with_underscores>";
+        }
+    }
+}
+
+EOF
+
+my $dir = 'directory-with-a-long-name/another-long-directory-name';
+
+$t->write_file('index.html', 'SEE-THIS');
+mkdir $t->testdir() . '/directory-with-a-long-name';
+mkdir $t->testdir() . '/' . $dir;
+$t->write_file("$dir/file.html", 'SEE-THIS');
+
+$t->run();
+
+###############################################################################
+
+my $args = 'first=0123456789abcdef0123456789abcdef&second=xyz&third=%20';
+my $cookie = 'sessionid=0123456789abcdef0123456789abcdef; theme=dark;'
+	. '    lang=en';
+
+my $r = request("GET /$dir/file.html?$args HTTP/1.0" . CRLF
+	. 'Cookie: ' . $cookie . '   ' . CRLF
+	. 'X-A-Rather-Long-Header-Name-Here: ' . 'x' x 64 . ' y' . CRLF
+	. 'X-Header_With_Underscores: value' . CRLF . CRLF);
+
+like($r, qr/SEE-THIS/, 'long uri');
+like($r, qr/X-URI: \/$dir\/file.html/, 'long uri parsed');
+like($r, qr/X-Args: \Q$args\E/, 'long args');
+like($r, qr/X-Cookie: <\Q$cookie\E>/, 'long header value with spaces');
+like($r, qr/X-Long: <x{64} y>/, 'long header name');
+like($r, qr/X-Under: <>/, 'underscores in long header name');
+
+$r = request("GET /directory-with-a-long-name/../$dir/./%66ile.html HTTP/1.0"
+	. CRLF . CRLF);
+
+like($r, qr/X-URI: \/$dir\/file.html/, 'complex uri');
+
+$r = request("GET /$dir/file.html?$args HTTP/1.0" . CRLF
+	. 'Cookie: ' . $cookie . CRLF . CRLF, split => 1);
+
+like($r, qr/X-Args: \Q$args\E/, 'split args');
+like($r, qr/X-Cookie: <\Q$cookie\E>/, 'split header value');
+
+like(request("GET /$dir/file.html?a#b HTTP/1.0" . CRLF . CRLF),
+	qr/X-Args: a\x0d/, 'hash in args');
+
+like(request("GET /$dir/file.html HTTP/1.0" . CRLF
+	. 'X-A-Rather-Long-Header-Name-Here: ' . 'x' x 64 . "\0" . CRLF . CRLF),
+	qr/400 Bad/, 'nul in long header value');
+
+like(request("GET /$dir/file\0.html HTTP/1.0" . CRLF . CRLF),
+	qr/400 Bad/, 'nul in long uri');
+
+###############################################################################
+
+sub request {
+	my ($request, %extra) = @_;
+
+	my $s = IO::Socket::INET->new(
+		Proto => 'tcp',
+		PeerAddr => '127.0.0.1:8080'
+	)
+		or die "Can't connect to nginx: $!\n";
+
+	if ($extra{split}) {
+
+		# send the request in parts to stop parsing in the middle
+
+		while (length $request) {
+			$s->syswrite(substr($request, 0, 37, ''));
+			select undef, undef, undef, 0.02;
+		}
+
+	} else {
+		$s->syswrite($request);
+	}
+
+	local $/;
+	return $s->getline();
+}
+
+###############################################################################
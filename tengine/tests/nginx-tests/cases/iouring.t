@@ -0,0 +1,140 @@
+#!/usr/bin/perl
+
+# Tests for the io_uring event method.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use IO::Select;
+use Socket qw/ CRLF /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+plan(skip_all => 'io_uring is Linux specific') if $^O ne 'linux';
+
+my $t = Test::Nginx->new()->has(qw/http proxy/);
+
+my $aio = $t->has_module('--with-file-aio') ? 'aio on;' : '';
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<"EOF");
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+    use  io_uring;
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        keepalive_requests  3;
+
+        location / {
+        }
+
+        location /aio/ {
+            alias     %%TESTDIR%%/;
+            sendfile  off;
+            $aio
+        }
+
+        location /proxy/ {
+            proxy_pass  http://127.0.0.1:8080/;
+        }
+    }
+}
+
+EOF
+
+my $big = join('', map { sprintf("%08d\n", $_) } (1 .. 100000));
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->write_file('big.html', $big);
+
+plan(skip_all => 'io_uring not compiled in')
+	if system("$Test::Nginx::NGINX -t -c " . $t->testdir() . '/nginx.conf'
+		. ' >/dev/null 2>&1') != 0;
+
+# the configuration test leaves the pid file, which is waited for by run()
+
+unlink $t->testdir() . '/nginx.pid';
+
+$t->run();
+
+http_get('/');
+
+plan(skip_all => 'io_uring not supported by the kernel')
+	if `cat $t->{_testdir}/error.log` =~ /io_uring_setup\(\) failed|features/;
+
+$t->plan(6);
+
+###############################################################################
+
+like(http_get('/'), qr/SEE-THIS/, 'request');
+like(http_get('/proxy/'), qr/SEE-THIS/, 'proxied request');
+
+my $r = http_get('/big.html');
+ok($r =~ /\x0d\x0a\x0d\x0a(.*)\z/s && $1 eq $big, 'big response');
+
+SKIP: {
+skip 'no file aio', 1 unless $aio;
+
+$r = http_get('/aio/big.html');
+ok($r =~ /\x0d\x0a\x0d\x0a(.*)\z/s && $1 eq $big, 'aio read');
+
+}
+
+# the connection is closed after keepalive_requests, the closed socket
+# must not be kept alive by the poll request
+
+my $s = IO::Socket::INET->new(
+	Proto => 'tcp',
+	PeerAddr => '127.0.0.1:8080'
+)
+	or die "Can't connect to nginx: $!\n";
+
+my ($n, $closed) = (0, 0);
+
+for (1 .. 3) {
+	$s->syswrite("GET / HTTP/1.1" . CRLF . "Host: localhost" . CRLF . CRLF);
+
+	my $buf;
+	last unless IO::Select->new($s)->can_read(3);
+	last unless $s->sysread($buf, 4096);
+
+	$n++ if $buf =~ /SEE-THIS/;
+}
+
+if (IO::Select->new($s)->can_read(3)) {
+	my $buf;
+	$closed = 1 unless $s->sysread($buf, 4096);
+}
+
+is($n, 3, 'keepalive requests');
+ok($closed, 'keepalive close');
+
+###############################################################################
@@ -0,0 +1,170 @@
+#!/usr/bin/perl
+
+# Tests for regex locations rejected through their JIT compiled union:
+# the first matching location in order wins, captures are set from it,
+# and regexes that can not be joined are still tried one by one.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http rewrite/)->plan(14);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+pcre_jit       on;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            return 200 "prefix";
+        }
+
+        location ^~ /static/ {
+            return 200 "static";
+        }
+
+        location ~ /b/ {
+            return 200 "first";
+        }
+
+        location ~ ^/a {
+            return 200 "second";
+        }
+
+        location ~* ^/img/(.+)\.jpg$ {
+            return 200 "caseless $1";
+        }
+
+        location ~ ^/n/(?<name>\w+)$ {
+            return 200 "named $name";
+        }
+
+        location ~ ^/m/(?<name>\w+)/x$ {
+            return 200 "again $name";
+        }
+
+        location /nested/ {
+            location ~ \.php$ {
+                return 200 "nested php";
+            }
+
+            location ~ \.cgi$ {
+                return 200 "nested cgi";
+            }
+
+            return 200 "nested";
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  backref;
+
+        location / {
+            return 200 "prefix";
+        }
+
+        location ~ ^/(\w)\1$ {
+            return 200 "backref $1";
+        }
+
+        location ~ \.html$ {
+            return 200 "html";
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  cond;
+
+        location / {
+            return 200 "prefix";
+        }
+
+        location ~ ^/c/(x)?y$ {
+            return 200 "group";
+        }
+
+        # group 1 would be the group of the location above in the union
+
+        location ~ ^/d/(a)?(?(1)b|c)$ {
+            return 200 "conditional";
+        }
+    }
+}
+
+EOF
+
+$t->run();
+
+###############################################################################
+
+like(http_get('/a/b/'), qr/first$/, 'first in order, not leftmost');
+like(http_get('/a/c'), qr/second$/, 'second');
+like(http_get('/IMG/pic.JPG'), qr/caseless pic$/, 'caseless with capture');
+like(http_get('/n/foo'), qr/named foo$/, 'named capture');
+like(http_get('/m/bar/x'), qr/again bar$/, 'same name in another location');
+like(http_get('/zzz'), qr/prefix$/, 'no regex match');
+like(http_get('/static/a.jpg'), qr/static$/, 'no regex prefix');
+like(http_get('/nested/x.cgi'), qr/nested cgi$/, 'nested regex');
+like(http_get('/nested/x.txt'), qr/nested$/, 'nested no match');
+
+like(http_get1('/aa'), qr/backref a$/, 'backreference');
+like(http_get1('/ab'), qr/prefix$/, 'backreference no match');
+like(http_get1('/ab.html'), qr/html$/, 'not joined');
+
+like(http_get2('/d/ab'), qr/conditional$/, 'conditional');
+like(http_get2('/d/c'), qr/conditional$/, 'conditional unset');
+
+###############################################################################
+
+sub http_get1 {
+	my ($uri) = @_;
+	return http(<<EOF);
+GET $uri HTTP/1.0
+Host: backref
+
+EOF
+}
+
+sub http_get2 {
+	my ($uri) = @_;
+	return http(<<EOF);
+GET $uri HTTP/1.0
+Host: cond
+
+EOF
+}
+
+###############################################################################
@@ -0,0 +1,132 @@
+#!/usr/bin/perl
+
+# Tests for the pool recycling mode and the pool high-water marks.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use Socket qw/ CRLF /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)->plan(5);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    log_format  peak  '$connection_requests $connection_pool_peak '
+                      '$request_pool_peak';
+
+    client_header_buffer_size    1k;
+    large_client_header_buffers  4 4k;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        pool_recycle  on;
+
+        access_log  %%TESTDIR%%/on.log  peak;
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+
+        access_log  %%TESTDIR%%/off.log  peak;
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->run();
+
+###############################################################################
+
+my $n = 50;
+
+like(keepalive(8080, $n), qr/SEE-THIS/, 'keepalive requests');
+keepalive(8081, $n);
+
+$t->stop();
+
+my @on = peaks('on.log');
+my @off = peaks('off.log');
+
+is(scalar @on, $n, 'logged');
+ok($on[1][2] > 0, 'request pool peak');
+is($on[$n - 1][1], $on[1][1], 'connection pool does not grow');
+cmp_ok($off[$n - 1][1], '>', $on[$n - 1][1], 'connection pool grows');
+
+###############################################################################
+
+sub keepalive {
+	my ($port, $n) = @_;
+
+	my $s = IO::Socket::INET->new(
+		Proto => 'tcp',
+		PeerAddr => "127.0.0.1:$port"
+	)
+		or die "Can't connect to nginx: $!\n";
+
+	# the long header makes nginx use a large header buffer
+
+	my $r = '';
+
+	for my $i (1 .. $n) {
+		$s->print('GET / HTTP/1.1' . CRLF
+			. 'Host: localhost' . CRLF
+			. 'X-Long: ' . ('x' x 2048) . CRLF
+			. ($i == $n ? 'Connection: close' . CRLF : '') . CRLF);
+
+		while (1) {
+			my $buf;
+			last unless $s->sysread($buf, 65536);
+			$r .= $buf;
+			last if $r =~ /SEE-THIS$/;
+		}
+
+		$r .= "\n";
+	}
+
+	return $r;
+}
+
+sub peaks {
+	my ($name) = @_;
+
+	open my $fh, '<', $t->testdir() . '/' . $name
+		or die "Can't open $name: $!";
+
+	return map { [ split ] } <$fh>;
+}
+
+###############################################################################
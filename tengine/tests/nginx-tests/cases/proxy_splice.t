@@ -0,0 +1,185 @@
+#!/usr/bin/perl
+
+# Tests for the "proxy_splice" directive.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+plan(skip_all => 'splice() is Linux specific') if $^O ne 'linux';
+
+my $t = Test::Nginx->new()->has(qw/http proxy gzip ssi/)->plan(11);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    upstream u {
+        server     127.0.0.1:8081;
+        keepalive  1;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        proxy_splice        on;
+        proxy_http_version  1.1;
+        proxy_set_header    Connection  "";
+
+        location / {
+            proxy_pass       http://u/;
+            proxy_buffering  off;
+        }
+
+        location /buffered/ {
+            proxy_pass       http://u/;
+            proxy_buffers    4 4k;
+        }
+
+        location /limited/ {
+            proxy_pass       http://u/;
+            proxy_buffers    4 4k;
+            limit_rate       4m;
+        }
+
+        location /accel/ {
+            proxy_pass       http://u;
+            proxy_buffers    4 4k;
+        }
+
+        location /gzip/ {
+            proxy_pass       http://u/;
+            proxy_buffering  off;
+            gzip             on;
+            gzip_types       text/plain;
+            gzip_min_length  0;
+        }
+
+        location /ssi/ {
+            proxy_pass       http://u/;
+            proxy_buffering  off;
+            ssi              on;
+            ssi_types        text/plain;
+        }
+
+        location /footer/ {
+            proxy_pass       http://u/;
+            proxy_buffering  off;
+            footer           FOOTER;
+            footer_types     text/plain;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+
+        default_type  text/plain;
+
+        location /accel/ {
+            add_header  X-Accel-Limit-Rate  4194304;
+            alias       %%TESTDIR%%/;
+        }
+    }
+}
+
+EOF
+
+my $big = join('', map { sprintf("%08d\n", $_) } (1 .. 100000));
+
+$t->write_file('big.txt', $big);
+$t->write_file('index.html', 'SEE-THIS');
+$t->write_file('ssi.txt', 'X-<!--#echo var="ssi_ok" default="SSI" -->-OK');
+
+$t->run();
+
+my $d = $t->testdir();
+
+###############################################################################
+
+like(http_get('/index.html'), qr/SEE-THIS/, 'small');
+ok(body(http_get('/big.txt')) eq $big, 'unbuffered');
+ok(body(http_get('/big.txt')) eq $big, 'unbuffered keepalive');
+ok(body(http_get('/buffered/big.txt')) eq $big, 'buffered');
+
+SKIP: {
+skip 'no debug log', 1 unless $t->has_module('--with-debug');
+
+is(splice_switches(), 1, 'buffered spliced');
+
+}
+
+# a rate limited body is never switched from buffering to splice
+
+ok(body(http_get('/limited/big.txt')) eq $big, 'limit_rate');
+ok(body(http_get('/accel/big.txt')) eq $big, 'x-accel-limit-rate');
+
+SKIP: {
+skip 'no debug log', 1 unless $t->has_module('--with-debug');
+
+is(splice_switches(), 1, 'rate limited not spliced');
+
+}
+
+like(http_gzip_request('/gzip/big.txt'), qr/Content-Encoding: gzip/,
+	'gzip fallback');
+
+like(http_get('/ssi/ssi.txt'), qr/^X-SSI-OK$/m, 'ssi fallback');
+
+ok(body(http_get('/footer/big.txt')) eq $big . 'FOOTER', 'footer');
+
+###############################################################################
+
+sub body {
+	my ($r) = @_;
+	return $r =~ /\x0d\x0a\x0d\x0a(.*)\z/s ? $1 : '';
+}
+
+sub splice_switches {
+	open my $fh, '<', "$d/error.log" or return 0;
+	my $n = grep { /http upstream splice instead of buffering/ } <$fh>;
+	close $fh;
+
+	return $n;
+}
+
+sub http_gzip_request {
+	my ($url) = @_;
+	return http(<<EOF);
+GET $url HTTP/1.1
+Host: localhost
+Connection: close
+Accept-Encoding: gzip
+
+EOF
+}
+
+###############################################################################
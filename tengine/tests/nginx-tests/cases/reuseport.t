@@ -0,0 +1,91 @@
+#!/usr/bin/perl
+
+# Tests for the "reuseport" parameter of the listen directive.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+plan(skip_all => 'SO_REUSEPORT is Linux specific') if $^O ne 'linux';
+
+my $t = Test::Nginx->new()->has(qw/http/)->plan(4);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+worker_processes  2;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    server {
+        listen       127.0.0.1:8080 reuseport;
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+
+        location / {
+            add_header  X-PID  $pid;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+
+$t->run();
+
+###############################################################################
+
+like(http_get('/'), qr/SEE-THIS/, 'reuseport');
+like(http_get('/', socket => IO::Socket::INET->new('127.0.0.1:8081')),
+	qr/SEE-THIS/, 'no reuseport');
+
+my %pids;
+
+for (1 .. 50) {
+	$pids{$1} = 1 if http_get('/') =~ /X-PID: (\d+)/;
+}
+
+is(keys %pids, 2, 'connections spread over workers');
+
+# each new worker takes over a socket of an old one on reload
+
+chomp(my $pid = `cat $t->{_testdir}/nginx.pid`);
+kill 'HUP', $pid;
+select undef, undef, undef, 1;
+
+my %old = %pids;
+%pids = ();
+
+for (1 .. 50) {
+	$pids{$1} = 1 if http_get('/') =~ /X-PID: (\d+)/;
+}
+
+is(scalar grep({ !$old{$_} } keys %pids), 2, 'spread after reload');
+
+###############################################################################
@@ -0,0 +1,112 @@
+#!/usr/bin/perl
+
+# Tests for scripts with runs of strings, variables and captures
+# compiled into single concat codes.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http rewrite proxy/)->plan(9);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        rewrite ^/r/(\w+)/(\w+)$ /t/$2-x-$1?a=$1&u=$arg_u last;
+        rewrite ^/s/(\w+)$       /t/$1-lit last;
+        rewrite ^/e/(.*)$        /t/e?v=$1 last;
+
+        location /t/ {
+            return 200 "uri=$uri args=$args";
+        }
+
+        location /set {
+            set $a "$arg_x-$arg_y";
+            set $b "<$a>$a";
+            return 200 $b;
+        }
+
+        location /header {
+            add_header X-C "$arg_a:$arg_b:end";
+            return 200 "header";
+        }
+
+        location /proxy {
+            proxy_pass http://127.0.0.1:8081/;
+            proxy_set_header X-E "$arg_n$arg_m";
+            proxy_set_header X-F "f-$arg_f-$arg_g";
+        }
+
+        location /root/ {
+            root %%TESTDIR%%/d$arg_s;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+
+        location / {
+            return 200 "e=$http_x_e f=$http_x_f";
+        }
+    }
+}
+
+EOF
+
+mkdir($t->testdir() . '/d1');
+mkdir($t->testdir() . '/d1/root');
+$t->write_file('d1/root/f.txt', 'root file');
+
+$t->run();
+
+###############################################################################
+
+like(http_get('/r/foo/bar?u=1'), qr/uri=\/t\/bar-x-foo args=a=foo&u=1&u=1$/,
+	'captures and variables');
+like(http_get('/s/abc'), qr/uri=\/t\/abc-lit args=$/, 'captures only');
+like(http_get('/e/a%20b'), qr/args=v=a%20b$/, 'capture escaped in args');
+
+like(http_get('/set?x=1&y=2'), qr/<1-2>1-2$/, 'set');
+like(http_get('/set'), qr/<->-$/, 'set not found');
+
+like(http_get('/header?a=1&b=2'), qr/X-C: 1:2:end/, 'add_header');
+
+like(http_get('/proxy?f=1&g=2'), qr/e= f=f-1-2$/, 'proxy header skipped');
+like(http_get('/proxy?n=3&f=1'), qr/e=3 f=f-1-$/, 'proxy header');
+
+like(http_get('/root/f.txt?s=1'), qr/root file$/, 'root');
+
+###############################################################################
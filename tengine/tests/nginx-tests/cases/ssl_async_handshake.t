@@ -0,0 +1,147 @@
+#!/usr/bin/perl
+
+# Tests for SSL handshakes in thread pools, "ssl_async_handshake" directive.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+eval { require IO::Socket::SSL; };
+plan(skip_all => 'IO::Socket::SSL not installed') if $@;
+
+my $t = Test::Nginx->new()->has(qw/http stub_status/);
+
+plan(skip_all => 'no ssl') unless $t->has_module('--with-http_ssl_module');
+plan(skip_all => 'no thread pools') unless $t->has_module('--with-thread-pool');
+
+$t->plan(6);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+thread_pool  ssl  threads=2 max_queue=16;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    ssl_certificate      localhost.crt;
+    ssl_certificate_key  localhost.key;
+
+    server {
+        listen       127.0.0.1:8443 ssl;
+        server_name  localhost;
+
+        ssl_async_handshake  threads=ssl;
+        ssl_session_cache    shared:SSL:1m;
+    }
+
+    server {
+        listen       127.0.0.1:8444 ssl;
+        server_name  localhost;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /status {
+            stub_status                 on;
+            stub_status_ssl_handshakes  on;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('openssl.conf', <<EOF);
+[ req ]
+default_bits = 2048
+encrypt_key = no
+distinguished_name = req_distinguished_name
+[ req_distinguished_name ]
+EOF
+
+my $d = $t->testdir();
+
+system('openssl req -x509 -new '
+	. "-config '$d/openssl.conf' -subj '/CN=localhost/' "
+	. "-out '$d/localhost.crt' -keyout '$d/localhost.key' "
+	. ">>$d/openssl.out 2>&1") == 0
+	or die "Can't create certificate for localhost: $!\n";
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->run();
+
+###############################################################################
+
+like(https_get(8443, '/'), qr/SEE-THIS/, 'handshake in thread');
+like(https_get(8443, '/'), qr/SEE-THIS/, 'handshake in thread again');
+like(https_get(8444, '/'), qr/SEE-THIS/, 'handshake in place');
+
+like(http_get('/status'), qr/^SSL handshakes: threads queued thread_time$/m,
+	'status header');
+
+my ($threads, $queued) = http_get('/status') =~ /^ (\d+) (\d+) \d+$/m;
+
+ok($threads >= 2, 'handshakes counted');
+is($queued, 0, 'handshakes not queued');
+
+###############################################################################
+
+sub https_get {
+	my ($port, $uri) = @_;
+	my ($s, $r);
+
+	eval {
+		local $SIG{ALRM} = sub { die "timeout\n" };
+		alarm(5);
+
+		$s = IO::Socket::SSL->new(
+			Proto => 'tcp',
+			PeerAddr => "127.0.0.1:$port",
+			SSL_verify_mode => IO::Socket::SSL::SSL_VERIFY_NONE()
+		) or die "connect: $!\n";
+
+		$s->print("GET $uri HTTP/1.0\x0d\x0a\x0d\x0a");
+
+		local $/;
+		$r = $s->getline();
+
+		alarm(0);
+	};
+	alarm(0);
+
+	if ($@) {
+		log_in("died: $@");
+		return undef;
+	}
+
+	return $r;
+}
+
+###############################################################################
@@ -0,0 +1,184 @@
+#!/usr/bin/perl
+
+# Tests for sharded shared SSL session cache, "shards" parameter
+# of the "ssl_session_cache" directive.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+eval { require IO::Socket::SSL; };
+plan(skip_all => 'IO::Socket::SSL not installed') if $@;
+
+my $t = Test::Nginx->new()->has(qw/http stub_status/);
+
+plan(skip_all => 'no ssl') unless $t->has_module('--with-http_ssl_module');
+
+$t->plan(7);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    ssl_certificate      localhost.crt;
+    ssl_certificate_key  localhost.key;
+
+    server {
+        listen       127.0.0.1:8443 ssl;
+        server_name  localhost;
+
+        ssl_session_cache  shared:SSL:1m shards=4;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /status {
+            stub_status                     on;
+            stub_status_ssl_session_caches  on;
+        }
+    }
+}
+
+EOF
+
+$t->write_file_expand('shards.conf', <<'EOF');
+
+error_log  %%TESTDIR%%/shards.log;
+pid        %%TESTDIR%%/shards.pid;
+
+events {
+}
+
+http {
+    server {
+        ssl_session_cache  shared:SSL:1m shards=4;
+    }
+
+    server {
+        ssl_session_cache  shared:SSL:1m shards=8;
+    }
+}
+
+EOF
+
+$t->write_file('openssl.conf', <<EOF);
+[ req ]
+default_bits = 2048
+encrypt_key = no
+distinguished_name = req_distinguished_name
+[ req_distinguished_name ]
+EOF
+
+my $d = $t->testdir();
+
+system('openssl req -x509 -new '
+	. "-config '$d/openssl.conf' -subj '/CN=localhost/' "
+	. "-out '$d/localhost.crt' -keyout '$d/localhost.key' "
+	. ">>$d/openssl.out 2>&1") == 0
+	or die "Can't create certificate for localhost: $!\n";
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->run();
+
+###############################################################################
+
+like(http_get('/status'),
+	qr/^SSL session caches: zone shards hits misses evictions contended$/m,
+	'status header');
+like(http_get('/status'), qr/^ SSL 4 0 0 0 \d+$/m, 'status empty');
+
+# session tickets are disabled by the client to resume by the session id
+
+my @ctx;
+
+for (1 .. 8) {
+	my $ctx = IO::Socket::SSL::SSL_Context->new(
+		SSL_verify_mode => IO::Socket::SSL::SSL_VERIFY_NONE(),
+		SSL_session_cache_size => 100,
+		SSL_create_ctx_callback => sub {
+			Net::SSLeay::CTX_set_options(shift,
+				Net::SSLeay::OP_NO_TICKET());
+		});
+
+	https_reused($ctx);
+	push @ctx, $ctx;
+}
+
+my $reused = 0;
+$reused += https_reused($_) for @ctx;
+
+is($reused, 8, 'sessions reused');
+
+my ($hits, $misses, $evictions) =
+	http_get('/status') =~ /^ SSL 4 (\d+) (\d+) (\d+) \d+$/m;
+
+is($hits, 8, 'hits');
+ok($misses <= 8, 'misses');
+is($evictions, 0, 'evictions');
+
+like(`$ENV{TEST_NGINX_BINARY} -t -c $d/shards.conf 2>&1`,
+	qr/zone "SSL" is already used with other parameters/, 'shards mismatch');
+
+###############################################################################
+
+sub https_reused {
+	my ($ctx) = @_;
+	my ($s, $r);
+
+	eval {
+		local $SIG{ALRM} = sub { die "timeout\n" };
+		alarm(5);
+
+		$s = IO::Socket::SSL->new(
+			Proto => 'tcp',
+			PeerAddr => '127.0.0.1:8443',
+			SSL_reuse_ctx => $ctx
+		) or die "connect: $!\n";
+
+		$s->print("GET / HTTP/1.0\x0d\x0a\x0d\x0a");
+
+		local $/;
+		$r = $s->getline();
+
+		alarm(0);
+	};
+	alarm(0);
+
+	if ($@) {
+		log_in("died: $@");
+		return 0;
+	}
+
+	return $s->get_session_reused() ? 1 : 0;
+}
+
+###############################################################################
@@ -0,0 +1,275 @@
+#!/usr/bin/perl
+
+# Tests for shared session ticket keys, "ssl_session_ticket_keys" directive.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use Digest::SHA qw/ hmac_sha256 /;
+use MIME::Base64 qw/ encode_base64 decode_base64 /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+eval { require IO::Socket::SSL; };
+plan(skip_all => 'IO::Socket::SSL not installed') if $@;
+
+my $t = Test::Nginx->new()->has(qw/http/);
+
+plan(skip_all => 'no ssl') unless $t->has_module('--with-http_ssl_module');
+
+$t->plan(8);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    ssl_certificate      localhost.crt;
+    ssl_certificate_key  localhost.key;
+
+    ssl_session_cache    off;
+
+    server {
+        listen       127.0.0.1:8443 ssl;
+        server_name  localhost;
+
+        ssl_session_ticket_keys  shared:TICKETS rotate=1h keep=2;
+    }
+
+    server {
+        listen       127.0.0.1:8444 ssl;
+        server_name  localhost;
+
+        ssl_session_ticket_keys  shared:TICKETS rotate=1h keep=2;
+    }
+}
+
+EOF
+
+$t->write_file_expand('keep.conf', <<'EOF');
+
+error_log  %%TESTDIR%%/keep.log;
+pid        %%TESTDIR%%/keep.pid;
+
+events {
+}
+
+http {
+    server {
+        ssl_session_ticket_keys  shared:TICKETS keep=100;
+    }
+}
+
+EOF
+
+$t->write_file('openssl.conf', <<EOF);
+[ req ]
+default_bits = 2048
+encrypt_key = no
+distinguished_name = req_distinguished_name
+[ req_distinguished_name ]
+EOF
+
+my $d = $t->testdir();
+
+system('openssl req -x509 -new '
+	. "-config '$d/openssl.conf' -subj '/CN=localhost/' "
+	. "-out '$d/localhost.crt' -keyout '$d/localhost.key' "
+	. ">>$d/openssl.out 2>&1") == 0
+	or die "Can't create certificate for localhost: $!\n";
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->run();
+
+###############################################################################
+
+my $ctx = IO::Socket::SSL::SSL_Context->new(
+	SSL_verify_mode => IO::Socket::SSL::SSL_VERIFY_NONE(),
+	SSL_session_cache_size => 100);
+
+is(https_reused(8443, $ctx), 0, 'full handshake');
+is(https_reused(8443, $ctx), 1, 'ticket reused');
+
+# the key is shared by servers and workers, and survives reloads
+
+is(https_reused(8444, $ctx, 8443), 1, 'ticket reused in other server');
+
+# slots of the key ring not generated yet are not used to decrypt tickets,
+# a ticket with a zero key name sealed with zero keys is not accepted
+
+like(s_client('-sess_out', "$d/sess.pem"), qr/^New,/m, 's_client session');
+like(s_client('-sess_in', forge_session("$d/sess.pem")), qr/^New,/m,
+	'zero key ticket not accepted');
+
+chomp(my $pid = `cat $d/nginx.pid`);
+kill 'HUP', $pid;
+select undef, undef, undef, 1;
+
+is(https_reused(8443, $ctx), 1, 'ticket reused after reload');
+
+like(`$ENV{TEST_NGINX_BINARY} -t -c $d/keep.conf 2>&1`,
+	qr/invalid parameter "keep=100"/, 'keep too big');
+
+$t->stop();
+
+unlike(`cat $d/error.log`, qr/\[(alert|emerg)\]/, 'no alerts');
+
+###############################################################################
+
+sub s_client {
+	my (@args) = @_;
+
+	my $args = join ' ', map { "'$_'" } @args;
+
+	return `openssl s_client -connect 127.0.0.1:8443 -tls1_2 $args \
+		</dev/null 2>&1`;
+}
+
+# replaces the ticket in the session saved by s_client with a ticket
+# of the session itself, sealed as OpenSSL does with zero name and keys
+
+sub forge_session {
+	my ($file) = @_;
+
+	my $pem = read_file($file);
+	$pem =~ s/-----[^-]+-----//g;
+
+	my ($tag, $body) = der_read(decode_base64($pem));
+	my ($der, @elts) = ('');
+
+	while (length $body) {
+		my ($etag, $ebody, $raw) = der_read($body);
+		substr($body, 0, length $raw, '');
+		push @elts, [ $etag, $raw ];
+	}
+
+	my $plain = der_write(0x30,
+		join '', map { $_->[1] } grep { $_->[0] != 0xaa } @elts);
+
+	my $iv = join '', map { chr(int(rand(256))) } (1 .. 16);
+
+	$t->write_file('plain.der', $plain);
+	system("openssl enc -aes-128-cbc -K " . ('00' x 16)
+		. " -iv " . unpack('H*', $iv)
+		. " -in '$d/plain.der' -out '$d/cipher.bin'") == 0
+		or die "Can't encrypt ticket\n";
+
+	my $ticket = ("\x00" x 16) . $iv . read_file("$d/cipher.bin");
+	$ticket .= hmac_sha256($ticket, "\x00" x 16);
+
+	for my $e (@elts) {
+		$e->[1] = der_write(0xaa, der_write(0x04, $ticket))
+			if $e->[0] == 0xaa;
+	}
+
+	$der = der_write(0x30, join '', map { $_->[1] } @elts);
+
+	$t->write_file('forged.pem', "-----BEGIN SSL SESSION PARAMETERS-----\n"
+		. encode_base64($der)
+		. "-----END SSL SESSION PARAMETERS-----\n");
+
+	return "$d/forged.pem";
+}
+
+sub read_file {
+	my ($file) = @_;
+
+	open my $fh, '<', $file or die "Can't open $file: $!\n";
+	binmode $fh;
+	local $/;
+	return <$fh>;
+}
+
+sub der_read {
+	my ($der) = @_;
+
+	my ($tag, $len) = unpack('CC', $der);
+	my $hlen = 2;
+
+	if ($len & 0x80) {
+		my $n = $len & 0x7f;
+		$len = 0;
+		$len = $len * 256 + $_ for unpack("x2C$n", $der);
+		$hlen += $n;
+	}
+
+	return ($tag, substr($der, $hlen, $len), substr($der, 0, $hlen + $len));
+}
+
+sub der_write {
+	my ($tag, $body) = @_;
+
+	my $len = length $body;
+
+	return pack('CC', $tag, $len) . $body if $len < 0x80;
+
+	my $l = '';
+
+	while ($len) {
+		$l = chr($len & 0xff) . $l;
+		$len >>= 8;
+	}
+
+	return pack('CC', $tag, 0x80 | length $l) . $l . $body;
+}
+
+sub https_reused {
+	my ($port, $ctx, $session_port) = @_;
+	my ($s, $r);
+
+	$session_port = $port unless defined $session_port;
+
+	eval {
+		local $SIG{ALRM} = sub { die "timeout\n" };
+		alarm(5);
+
+		$s = IO::Socket::SSL->new(
+			Proto => 'tcp',
+			PeerAddr => "127.0.0.1:$port",
+			SSL_reuse_ctx => $ctx,
+			SSL_session_key => "127.0.0.1:$session_port"
+		) or die "connect: $!\n";
+
+		$s->print("GET / HTTP/1.0\x0d\x0a\x0d\x0a");
+
+		local $/;
+		$r = $s->getline();
+
+		alarm(0);
+	};
+	alarm(0);
+
+	if ($@) {
+		log_in("died: $@");
+		return undef;
+	}
+
+	return $s->get_session_reused() ? 1 : 0;
+}
+
+###############################################################################
@@ -0,0 +1,159 @@
+#!/usr/bin/perl
+
+# Tests for escaping of URIs, arguments and logged variables, with the
+# bytes to be escaped on both sides of 16-byte block boundaries.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+use Socket qw/ CRLF /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy autoindex/)->plan(8);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    log_format  test  '$uri|$args|$http_x_test';
+    log_format  raw   '$request_uri';
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /log {
+            access_log  %%TESTDIR%%/test.log  test;
+        }
+
+        location /ascii {
+            log_escape  ascii;
+            access_log  %%TESTDIR%%/ascii.log  test;
+        }
+
+        location /p/ {
+            proxy_pass  http://127.0.0.1:8081/b/;
+        }
+
+        location /idx/ {
+            autoindex  on;
+        }
+    }
+
+    server {
+        listen       127.0.0.1:8081;
+        server_name  localhost;
+
+        access_log  %%TESTDIR%%/backend.log  raw;
+    }
+}
+
+EOF
+
+my $d = $t->testdir();
+
+my $n1 = 'a' x 15 . '<' . 'b' x 15 . '&' . 'c' x 4;
+my $n2 = 'd' x 14 . q{"'} . 'e' x 14 . ' #' . 'f' x 3;
+
+mkdir "$d/idx";
+$t->write_file("idx/$n1", '');
+$t->write_file("idx/$n2", '');
+
+$t->run();
+
+###############################################################################
+
+my $v = 'a' x 15 . '"' . 'b' x 14 . '\\' . "\x7f" . 'c' x 15 . "\xff\x01"
+	. 'd' x 40 . "\xe9";
+
+my $args = 'x=' . 'y' x 13 . '"' . "\xc3\xa9" . 'z' x 12 . '\\';
+
+http('GET /log/' . 'u' x 10 . '%22' . 'v' x 17 . '%5C?' . $args
+	. ' HTTP/1.0' . CRLF . 'X-Test: ' . $v . CRLF . CRLF);
+
+http('GET /ascii?' . $args . ' HTTP/1.0' . CRLF
+	. 'X-Test: ' . $v . CRLF . CRLF);
+
+http_get('/p/' . 'a' x 15 . '%20' . 'b' x 15 . '%23%3F' . 'c' x 20
+	. '%C3%A9?x=1');
+
+select undef, undef, undef, 0.2;
+
+is(read_log('test.log'),
+	'/log/' . 'u' x 10 . '\x22' . 'v' x 17 . '\x5C|'
+	. 'x=' . 'y' x 13 . '\x22\xC3\xA9' . 'z' x 12 . '\x5C|'
+	. 'a' x 15 . '\x22' . 'b' x 14 . '\x5C\x7F' . 'c' x 15 . '\xFF\x01'
+	. 'd' x 40 . '\xE9',
+	'log escape');
+
+is(read_log('ascii.log'),
+	'/ascii|x=' . 'y' x 13 . '\x22' . "\xc3\xa9" . 'z' x 12 . '\x5C|'
+	. 'a' x 15 . '\x22' . 'b' x 14 . '\x5C\x7F' . 'c' x 15 . "\xff" . '\x01'
+	. 'd' x 40 . "\xe9",
+	'log escape ascii');
+
+is(read_log('backend.log'),
+	'/b/' . 'a' x 15 . '%20' . 'b' x 15 . '%23%3f' . 'c' x 20 . '%c3%a9?x=1',
+	'proxy uri escape');
+
+my $r = http_get('/idx/');
+
+like($r, qr!<a href="\Q${\('a' x 15 . '%3c' . 'b' x 15 . '%26' . 'c' x 4)}\E">!,
+	'autoindex uri component escape');
+like($r, qr!">\Q${\('a' x 15 . '&lt;' . 'b' x 15 . '&amp;' . 'c' x 4)}\E</a>!,
+	'autoindex html escape');
+like($r, qr!<a href="\Q${\('d' x 14 . '%22%27' . 'e' x 14 . '%20%23fff')}\E">!,
+	'autoindex uri component escape 2');
+like($r, qr!">\Q${\('d' x 14 . q{&quot;'} . 'e' x 14 . ' #fff')}\E</a>!,
+	'autoindex html escape 2');
+
+# a long name without bytes to escape
+
+$t->write_file('idx/' . 'g' x 48, '');
+
+like(http_get('/idx/'), qr!<a href="${\('g' x 48)}">${\('g' x 48)}</a>!,
+	'autoindex no escape');
+
+###############################################################################
+
+sub read_log {
+	my ($name) = @_;
+
+	open my $fh, '<', "$d/$name" or return '';
+	binmode $fh;
+	local $/;
+	my $content = <$fh>;
+	close $fh;
+
+	$content =~ s/\n\z//;
+
+	return $content;
+}
+
+###############################################################################
@@ -0,0 +1,84 @@
+#!/usr/bin/perl
+
+# Tests for the shared memory lock statistics of the stub_status module.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http stub_status limit_req/)->plan(6);
+
+$t->set_dso("ngx_http_limit_req_module", "ngx_http_limit_req_module.so");
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    limit_req_zone  $binary_remote_addr  zone=one:1m  rate=100r/s;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            limit_req  zone=one  burst=10;
+        }
+
+        location /status {
+            stub_status        on;
+        }
+
+        location /locks {
+            stub_status        on;
+            stub_status_locks  on;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->run();
+
+###############################################################################
+
+like(http_get('/'), qr/SEE-THIS/, 'request');
+
+unlike(http_get('/status'), qr/Locks:/, 'locks off');
+
+my $r = http_get('/locks');
+
+like($r, qr/Active connections: \d+/, 'status');
+like($r, qr/^Locks: acquired contended wait_time\x0d?$/m, 'locks header');
+like($r, qr/^ one (\d+) \d+ \d+\x0d?$/m, 'zone lock');
+
+my ($acquired) = $r =~ /^ one (\d+)/m;
+ok($acquired > 0, 'zone lock acquired');
+
+###############################################################################
@@ -0,0 +1,103 @@
+#!/usr/bin/perl
+
+# Tests for the connection memory gauge of the stub_status module.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use IO::Socket::INET;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http stub_status/)->plan(5);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        connection_pool_size  4k;
+
+        location /status {
+            stub_status         on;
+        }
+
+        location /memory {
+            stub_status         on;
+            stub_status_memory  on;
+        }
+    }
+}
+
+EOF
+
+$t->run();
+
+###############################################################################
+
+unlike(http_get('/status'), qr/Connection memory:/, 'memory off');
+
+like(http_get('/memory'), qr/^Connection memory: total per_connection\x0d?$/m,
+	'memory header');
+
+my ($total) = memory();
+
+ok($total >= 4096, 'status connection');
+
+# idle connections hold their pools
+
+my @s = map {
+	IO::Socket::INET->new(Proto => 'tcp', PeerAddr => '127.0.0.1:8080')
+		or die "Can't connect to nginx: $!\n";
+} 1 .. 10;
+
+select undef, undef, undef, 0.2;
+
+my ($idle) = memory();
+
+ok($idle >= $total + 10 * 4096, 'idle connections');
+
+close $_ for @s;
+
+select undef, undef, undef, 0.2;
+
+my ($closed) = memory();
+
+is($closed, $total, 'closed connections');
+
+###############################################################################
+
+sub memory {
+	return http_get('/memory') =~ /^ (\d+) (\d+)\x0d?$/m;
+}
+
+###############################################################################
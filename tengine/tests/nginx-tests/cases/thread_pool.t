@@ -0,0 +1,121 @@
+#!/usr/bin/perl
+
+# Tests for thread pools and "aio threads".
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy cache/);
+
+plan(skip_all => 'no thread pools') unless $t->has_module('--with-thread-pool');
+
+$t->plan(6);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+thread_pool  files  threads=2 max_queue=16;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    proxy_cache_path  %%TESTDIR%%/cache  levels=1:2
+                      keys_zone=NAME:10m;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /read/ {
+            alias     %%TESTDIR%%/;
+            sendfile  off;
+            aio       threads;
+        }
+
+        location /sendfile/ {
+            alias     %%TESTDIR%%/;
+            sendfile  on;
+            aio       threads=files;
+        }
+
+        location /cache/ {
+            proxy_pass    http://127.0.0.1:8080/;
+            proxy_cache   NAME;
+            proxy_cache_valid  any 1m;
+            add_header    X-Cache-Status  $upstream_cache_status;
+            aio           threads=files;
+        }
+    }
+}
+
+EOF
+
+my $big = join('', map { sprintf("%08d\n", $_) } (1 .. 100000));
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->write_file('big.html', $big);
+
+$t->run();
+
+###############################################################################
+
+uncache($t->testdir());
+
+like(http_get('/read/index.html'), qr/SEE-THIS/, 'read');
+ok(body(http_get('/read/big.html')) eq $big, 'read big');
+
+uncache($t->testdir());
+
+like(http_get('/sendfile/index.html'), qr/SEE-THIS/, 'sendfile');
+ok(body(http_get('/sendfile/big.html')) eq $big, 'sendfile big');
+
+ok(body(http_get('/cache/big.html')) eq $big, 'cache miss');
+
+uncache($t->testdir());
+
+my $r = http_get('/cache/big.html');
+ok($r =~ /X-Cache-Status: HIT/ && body($r) eq $big, 'cache hit');
+
+###############################################################################
+
+sub body {
+	my ($r) = @_;
+	return $r =~ /\x0d\x0a\x0d\x0a(.*)\z/s ? $1 : '';
+}
+
+# drop the files from the page cache, so the reads are offloaded to threads;
+# dirty pages cannot be dropped, hence sync
+
+sub uncache {
+	my ($d) = @_;
+	system("sync; find $d -type f -exec dd if={} iflag=nocache count=0 "
+		. "status=none \\; >/dev/null 2>&1");
+}
+
+###############################################################################
@@ -0,0 +1,148 @@
+#!/usr/bin/perl
+
+# Tests for the time_source directive: the cached time logged with
+# $msec, $time_local and $time_iso8601.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+use Time::Local;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)->plan(10);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+my $conf = <<'EOF';
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+time_source    %%SOURCE%%;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    log_format  time  '$msec|$time_local|$time_iso8601|$request_time';
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            access_log  %%TESTDIR%%/%%SOURCE%%.log  time;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('index.html', '');
+
+my $d = $t->testdir();
+
+for my $source (qw/ precise coarse /) {
+	(my $c = $conf) =~ s/%%SOURCE%%/$source/g;
+
+	$t->stop();
+	$t->write_file_expand('nginx.conf', $c);
+	$t->run();
+
+	check($source);
+}
+
+###############################################################################
+
+sub check {
+	my ($source) = @_;
+
+	my $start = time();
+
+	for (1 .. 10) {
+		http_get('/');
+		select undef, undef, undef, 0.05;
+	}
+
+	my @lines = split /\n/, read_file("$d/$source.log");
+
+	is(scalar @lines, 10, "$source requests");
+
+	my ($formed, $agreed, $increased) = (1, 1, 1);
+	my $prev = 0;
+
+	for (@lines) {
+		my ($msec, $local, $iso, $rt) = split /\|/;
+
+		unless ($msec =~ /^\d+\.\d{3}$/
+			&& $local =~ m!^(\d\d)/(\w{3})/(\d{4}):(\d\d):(\d\d):(\d\d)
+				\ ([+-])(\d\d)(\d\d)$!x
+			&& $iso =~ /^\d{4}-\d\d-\d\dT\d\d:\d\d:\d\d[+-]\d\d:\d\d$/
+			&& $rt =~ /^\d+\.\d{3}$/)
+		{
+			$formed = 0;
+			next;
+		}
+
+		# the seconds of $msec are the seconds of the logged time
+
+		my %mon = (Jan => 0, Feb => 1, Mar => 2, Apr => 3, May => 4,
+			Jun => 5, Jul => 6, Aug => 7, Sep => 8, Oct => 9,
+			Nov => 10, Dec => 11);
+
+		$local =~ m!^(\d\d)/(\w{3})/(\d{4}):(\d\d):(\d\d):(\d\d)
+			\ ([+-])(\d\d)(\d\d)$!x;
+
+		my $gmt = timegm($6, $5, $4, $1, $mon{$2}, $3)
+			- ($7 eq '-' ? -1 : 1) * ($8 * 3600 + $9 * 60);
+
+		$agreed = 0 if int($msec) != $gmt
+			|| $msec < $start - 1 || $msec > time() + 1;
+
+		$increased = 0 if $msec <= $prev;
+		$prev = $msec;
+	}
+
+	ok($formed, "$source well-formed");
+	ok($agreed, "$source msec matches time");
+	ok($increased, "$source msec increases");
+
+	my ($first) = split /\|/, $lines[0];
+	my ($last) = split /\|/, $lines[-1];
+
+	# 9 pauses of 50ms each
+
+	cmp_ok($last - $first, '>=', 0.4, "$source msec advances");
+}
+
+sub read_file {
+	my ($name) = @_;
+
+	open my $fh, '<', $name or return '';
+	local $/;
+	my $content = <$fh>;
+	close $fh;
+
+	return $content;
+}
+
+###############################################################################
@@ -0,0 +1,129 @@
+#!/usr/bin/perl
+
+# Tests for the timer wheel backend of the event timers.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+use IO::Select;
+use Socket qw/ CRLF /;
+use Time::HiRes qw/ time /;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http proxy limit_req/)->plan(5);
+
+$t->set_dso("ngx_http_limit_req_module", "ngx_http_limit_req_module.so");
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+    timer_wheel  on;
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    limit_req_zone  $binary_remote_addr  zone=one:1m  rate=2r/s;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        keepalive_timeout  1s;
+
+        location / {
+        }
+
+        location /limit {
+            limit_req  zone=one  burst=5;
+            alias      %%TESTDIR%%/index.html;
+        }
+
+        location /proxy {
+            proxy_pass          http://127.0.0.1:8081;
+            proxy_read_timeout  1s;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+
+$t->run_daemon(\&silent_daemon);
+$t->run();
+
+###############################################################################
+
+like(http_get('/limit'), qr/SEE-THIS/, 'limit_req first request');
+like(http_get('/limit'), qr/SEE-THIS/, 'limit_req delayed request');
+
+like(http_get('/proxy'), qr/504 Gateway/, 'proxy read timeout');
+
+my $s = IO::Socket::INET->new(
+	Proto => 'tcp',
+	PeerAddr => '127.0.0.1:8080'
+)
+	or die "Can't connect to nginx: $!\n";
+
+$s->print("GET / HTTP/1.1" . CRLF . "Host: localhost" . CRLF . CRLF);
+
+my ($buf, $reply, $closed) = ('', '', 0);
+my $start = time();
+
+while (IO::Select->new($s)->can_read(3)) {
+	if (!$s->sysread($buf, 1024)) {
+		$closed = 1;
+		last;
+	}
+
+	$reply .= $buf;
+}
+
+like($reply, qr/SEE-THIS/, 'keepalive request');
+ok($closed && time() - $start >= 0.5, 'keepalive timeout');
+
+###############################################################################
+
+sub silent_daemon {
+	my $server = IO::Socket::INET->new(
+		Proto => 'tcp',
+		LocalAddr => '127.0.0.1:8081',
+		Listen => 5,
+		Reuse => 1
+	)
+		or die "Can't create listening socket: $!\n";
+
+	while (my $client = $server->accept()) {
+		while (<$client>) {
+			last if (/^\x0d?\x0a?$/);
+		}
+
+		sleep(3);
+		close $client;
+	}
+}
+
+###############################################################################
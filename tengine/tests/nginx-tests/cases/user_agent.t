@@ -0,0 +1,100 @@
+#!/usr/bin/perl
+
+# Tests for the user_agent module.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http/)->plan(7);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    user_agent $browser {
+        default                  unknown;
+
+        greedy                   Safari;
+
+        Chrome   18.0+           chrome18;
+        Chrome   17.0~17.9999    chrome17;
+        Chrome   5.0-            chrome_low;
+        MSIE     6.0             msie6;
+        Firefox  3.0+            firefox;
+        Safari   500.0+          safari;
+    }
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            add_header  X-Browser  $browser;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('index.html', 'SEE-THIS');
+$t->run();
+
+###############################################################################
+
+like(ua('Mozilla/5.0 (Windows NT 6.1) AppleWebKit/535.19 (KHTML, like Gecko)'
+	. ' Chrome/18.0.1025.168 Safari/535.19'), qr/X-Browser: chrome18/,
+	'greedy keyword skipped');
+like(ua('Mozilla/5.0 (X11) Chrome/17.0.963.56 Safari/535.11'),
+	qr/X-Browser: chrome17/, 'version range');
+like(ua('Mozilla/5.0 (X11) Chrome/4.0.1 Safari/532.0'),
+	qr/X-Browser: chrome_low/, 'version less or equal');
+like(ua('Mozilla/4.0 (compatible; MSIE 6.0; Windows NT 5.1)'),
+	qr/X-Browser: msie6/, 'exact version');
+like(ua('Mozilla/5.0 (Macintosh) AppleWebKit/534.55.3 (KHTML, like Gecko)'
+	. ' Version/5.1.3 Safari/534.53.10'), qr/X-Browser: safari/,
+	'greedy keyword at last');
+like(ua('Mozilla/5.0 (X11; rv:10.0) Gecko/20100101 Firefox/10.0'),
+	qr/X-Browser: firefox/, 'version greater or equal');
+like(ua('curl/7.29.0'), qr/X-Browser: unknown/, 'default');
+
+###############################################################################
+
+sub ua {
+	my ($ua) = @_;
+	return http(<<EOF);
+GET / HTTP/1.0
+Host: localhost
+User-Agent: $ua
+
+EOF
+}
+
+###############################################################################
@@ -0,0 +1,111 @@
+#!/usr/bin/perl
+
+# Tests for $http_*, $arg_* and $cookie_* variables looked up through
+# the per request tables of headers, arguments and cookies.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http rewrite/)->plan(9);
+
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+# the padding variables are there to have the tables built
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location /headers {
+            return 200 "$http_x_p1$http_x_p2$http_x_p3$http_x_p4$http_x_p5$http_x_p6$http_x_p7$http_x_p8 a=$http_x_a b=$http_x_b c=$http_x_c d=$http_x_d";
+        }
+
+        location /args {
+            return 200 "$arg_p1$arg_p2$arg_p3$arg_p4$arg_p5$arg_p6$arg_p7$arg_p8 a=$arg_a b=$arg_b c=$arg_c d=$arg_d e=$arg_e";
+        }
+
+        location /changed {
+            set $old "$arg_p1$arg_p2$arg_p3$arg_p4$arg_p5$arg_p6$arg_p7$arg_p8$arg_a$arg_b";
+            set $args "a=new";
+            return 200 "$arg_p1$arg_p2$arg_p3$arg_p4$arg_p5$arg_p6$arg_p7$arg_p8 old=$old a=$arg_a b=$arg_b";
+        }
+
+        location /cookies {
+            return 200 "$cookie_p1$cookie_p2$cookie_p3$cookie_p4$cookie_p5$cookie_p6$cookie_p7$cookie_p8 a=$cookie_a b=$cookie_b c=$cookie_c d=$cookie_d";
+        }
+    }
+}
+
+EOF
+
+$t->run();
+
+###############################################################################
+
+like(http(<<EOF), qr/a=1 b=2 c= d=4$/, 'headers');
+GET /headers HTTP/1.0
+Host: localhost
+X-A: 1
+x-b: 2
+X-D: 4
+X-A: 3
+
+EOF
+
+like(http_get('/headers'), qr/a= b= c= d=$/, 'no headers');
+
+like(http_get('/args?A=1&b=&c&d=4=5&a=6&xe=7'),
+	qr/a=1 b= c= d=4=5 e=$/, 'args');
+like(http_get('/args'), qr/a= b= c= d= e=$/, 'no args');
+like(http_get('/changed?a=1&b=2'), qr/old=12 a=new b=$/, 'args changed');
+
+like(http_cookie('a=1; B=2; c ; d = 4'), qr/a=1 b=2 c= d=4$/, 'cookies');
+like(http_cookie('a=1, b=2; c=3'), qr/a=1, b=2 b=2 c=3 d=$/,
+	'cookie value up to semicolon');
+like(http_cookie("a=1\nCookie: a=2; d=4"), qr/a=1 b= c= d=4$/,
+	'cookie headers');
+like(http_get('/cookies'), qr/a= b= c= d=$/, 'no cookies');
+
+###############################################################################
+
+sub http_cookie {
+	my ($cookie) = @_;
+	return http(<<EOF);
+GET /cookies HTTP/1.0
+Host: localhost
+Cookie: $cookie
+
+EOF
+}
+
+###############################################################################
@@ -0,0 +1,120 @@
+#!/usr/bin/perl
+
+# Tests for the per-worker slab cache and the slab statistics of the
+# stub_status module.
+
+###############################################################################
+
+use warnings;
+use strict;
+
+use Test::More;
+
+BEGIN { use FindBin; chdir($FindBin::Bin); }
+
+use lib 'lib';
+use Test::Nginx;
+
+###############################################################################
+
+select STDERR; $| = 1;
+select STDOUT; $| = 1;
+
+my $t = Test::Nginx->new()->has(qw/http limit_req stub_status/)->plan(8);
+
+$t->set_dso("ngx_http_limit_req_module", "ngx_http_limit_req_module.so");
+$t->set_dso("ngx_http_fastcgi_module", "ngx_http_fastcgi_module.so");
+$t->set_dso("ngx_http_uwsgi_module", "ngx_http_uwsgi_module.so");
+$t->set_dso("ngx_http_scgi_module", "ngx_http_scgi_module.so");
+
+$t->write_file_expand('nginx.conf', <<'EOF');
+
+%%TEST_GLOBALS%%
+
+daemon         off;
+
+worker_processes   1;
+worker_slab_cache  8;
+
+%%TEST_GLOBALS_DSO%%
+
+events {
+}
+
+http {
+    %%TEST_GLOBALS_HTTP%%
+
+    limit_req_zone  $uri  zone=one:1m  rate=1r/m;
+
+    server {
+        listen       127.0.0.1:8080;
+        server_name  localhost;
+
+        location / {
+            limit_req  zone=one;
+        }
+
+        location /pid {
+            add_header  X-Pid  $pid;
+        }
+
+        location /status {
+            stub_status        on;
+            stub_status_slabs  on;
+        }
+    }
+}
+
+EOF
+
+$t->write_file('pid', '');
+$t->run();
+
+###############################################################################
+
+like(http_get('/status'),
+	qr/^Slab zones: zone pages free max_free fails\x0d?\n one \d+ \d+ \d+ 0$/m,
+	'zones');
+
+like(http_get('/status'),
+	qr/^Slab sizes: zone size total used cached reqs fails\x0d?\n one 8 /m,
+	'sizes');
+
+# the nodes of the zone are allocated through the cache
+
+like(http_get("/a$_"), qr/404 Not Found/, "node $_") for 1 .. 3;
+
+like(http_get('/a1'), qr/503 Service/, 'limited');
+
+my %s = slabs();
+
+ok($s{cached} > 0, 'cached chunks');
+
+# the chunks cached by a killed worker are reclaimed by its successor
+
+my ($pid) = http_get('/pid') =~ /X-Pid: (\d+)/;
+
+kill 'KILL', $pid;
+
+for (1 .. 50) {
+	select undef, undef, undef, 0.1;
+	last if http_get('/pid') =~ /X-Pid: (?!$pid)\d+/;
+}
+
+%s = slabs();
+
+is($s{cached}, 0, 'reclaimed');
+
+###############################################################################
+
+sub slabs {
+	my %s = (cached => 0);
+
+	for (http_get('/status') =~ /^ one \d+ \d+ \d+ (\d+) \d+ \d+\x0d?$/mg) {
+		$s{cached} += $_;
+	}
+
+	return %s;
+}
+
+###############################################################################